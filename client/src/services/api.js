@@ -50,6 +50,30 @@ export function fetchSensorReadings() {
   return request('/sensors/readings');
 }
 
+export function fetchHistory(tags, { from, to, step } = {}) {
+  const params = new URLSearchParams();
+  if (tags && tags.length) params.set('tags', Array.isArray(tags) ? tags.join(',') : tags);
+  if (from !== undefined) params.set('from', String(from));
+  if (to !== undefined) params.set('to', String(to));
+  if (step !== undefined) params.set('step', String(step));
+  return request(`/history?${params.toString()}`);
+}
+
+export function fetchSampleTags(tag, samples) {
+  const params = new URLSearchParams();
+  if (tag) params.set('tag', tag);
+  if (samples) params.set('samples', String(samples));
+  const query = params.toString();
+  return request(query ? `/samples?${query}` : '/samples');
+}
+
+export function saveSampleTagConfig(config) {
+  return request('/samples/config', {
+    method: 'POST',
+    body: JSON.stringify(config),
+  });
+}
+
 export function triggerTimeSync() {
   return request('/time/sync', { method: 'POST' });
 }
@@ -62,6 +86,10 @@ export function fetchPendingNotifications() {
   return request('/sd/pending_notifications');
 }
 
+export function fetchSdWriterStats() {
+  return request('/sd/writer');
+}
+
 export function fetchTagMetadata() {
   return request('/tags');
 }
@@ -182,6 +210,30 @@ export function uploadSdFile(targetDir, file, { timeoutMs = 30000 } = {}) {
   });
 }
 
+export function buildLogExportUrl({ format = 'csv', file = 'current' } = {}) {
+  const params = new URLSearchParams({ format, file });
+  return `${API_BASE}/logs/export?${params.toString()}`;
+}
+
+function logQueryParams(tags, { from, to, step, format = 'csv', source } = {}) {
+  const params = new URLSearchParams({ format });
+  if (tags && tags.length) params.set('tags', Array.isArray(tags) ? tags.join(',') : tags);
+  if (from !== undefined) params.set('from', String(from));
+  if (to !== undefined) params.set('to', String(to));
+  if (step !== undefined) params.set('step', String(step));
+  if (source) params.set('source', source);
+  return params;
+}
+
+export function buildLogQueryUrl(tags, options = {}) {
+  return `${API_BASE}/logs/query?${logQueryParams(tags, options).toString()}`;
+}
+
+export function fetchLogQuery(tags, options = {}) {
+  const params = logQueryParams(tags, { ...options, format: 'json' });
+  return request(`/logs/query?${params.toString()}`, { timeoutMs: 30000 });
+}
+
 export function buildSdFileUrl(path, { download = true } = {}) {
   const params = new URLSearchParams({
     path,
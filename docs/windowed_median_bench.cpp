@@ -0,0 +1,88 @@
+// Host-side micro-benchmark: WindowedMedian vs. the copy + bubble-sort median
+// that readAdsMa() used before. Not part of the firmware build.
+//
+//   g++ -O2 -std=c++17 -Iinclude docs/windowed_median_bench.cpp -o /tmp/wm_bench
+//   /tmp/wm_bench
+//
+// For each window size it checks that both filters agree on every sample and
+// prints the average cost per push+median.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "windowed_median.h"
+
+namespace {
+
+constexpr int MAX_WINDOW = 255;
+constexpr int SAMPLES = 200000;
+
+// Previous implementation: ring buffer, copy the last n entries, bubble sort
+struct SortMedian {
+    int16_t buf[MAX_WINDOW];
+    int idx = 0;
+    int count = 0;
+    int window = 5;
+
+    int16_t push(int16_t v) {
+        buf[idx] = v;
+        idx = (idx + 1) % MAX_WINDOW;
+        if (count < window) count++;
+        int n = count;
+        int tmp[MAX_WINDOW];
+        int start = (idx - n + MAX_WINDOW) % MAX_WINDOW;
+        for (int i = 0; i < n; ++i) tmp[i] = buf[(start + i) % MAX_WINDOW];
+        for (int i = 0; i < n - 1; ++i) for (int j = i + 1; j < n; ++j) if (tmp[j] < tmp[i]) { int t = tmp[i]; tmp[i] = tmp[j]; tmp[j] = t; }
+        return (int16_t)tmp[n / 2];
+    }
+};
+
+template <typename F>
+double nsPerSample(F &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+}
+
+} // namespace
+
+int main() {
+    // 4-20 mA loop in mA*1000 with noise and occasional spikes
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 40.0f);
+    std::uniform_int_distribution<int> spike(0, 99);
+    std::vector<int16_t> input(SAMPLES);
+    for (int i = 0; i < SAMPLES; ++i) {
+        float v = 12000.0f + 4000.0f * (float)(i % 5000) / 5000.0f + noise(rng);
+        if (spike(rng) == 0) v = 20000.0f;
+        input[i] = (int16_t)v;
+    }
+
+    const int windows[] = {5, 21, 63, 255};
+    std::printf("%8s %14s %14s %8s\n", "window", "sort ns/smp", "heap ns/smp", "match");
+    for (int w : windows) {
+        SortMedian ref;
+        ref.window = w;
+        WindowedMedian<int16_t, MAX_WINDOW> wm;
+        wm.setWindow(w);
+
+        std::vector<int16_t> a(SAMPLES), b(SAMPLES);
+        double sortNs = nsPerSample([&] {
+            for (int i = 0; i < SAMPLES; ++i) a[i] = ref.push(input[i]);
+        });
+        double heapNs = nsPerSample([&] {
+            for (int i = 0; i < SAMPLES; ++i) {
+                wm.push(input[i]);
+                b[i] = wm.median();
+            }
+        });
+        bool match = a == b;
+        std::printf("%8d %14.1f %14.1f %8s\n", w, sortNs, heapNs, match ? "yes" : "NO");
+        if (!match) return 1;
+    }
+    return 0;
+}
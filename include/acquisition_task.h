@@ -0,0 +1,62 @@
+#ifndef ACQUISITION_TASK_H
+#define ACQUISITION_TASK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensor_snapshot.h"
+#include "job_scheduler.h"
+
+// Sampling jobs run by the acquisition task. Each has its own period and
+// phase (persisted in NVS namespace "sched"); ACQ_JOB_RECORD sets the cadence
+// of snapshot records consumed by the SD log and pending notifications.
+enum AcquisitionJob {
+    ACQ_JOB_AI1 = 0,
+    ACQ_JOB_AI2,
+    ACQ_JOB_AI3,
+    ACQ_JOB_ADS0,
+    ACQ_JOB_ADS1,
+    ACQ_JOB_DI,
+    ACQ_JOB_RECORD,
+    ACQ_JOB_COUNT
+};
+
+// Timing counters for the acquisition task (microseconds)
+struct AcquisitionStats {
+    bool running = false;
+    uint32_t period_us = 0;     // shortest job period
+    uint32_t cycles = 0;        // wake-ups that ran at least one job
+    uint32_t overruns = 0;      // wake-ups whose work ran past the next deadline
+    uint32_t missed_ticks = 0;  // job periods skipped because a job started late
+    int32_t last_jitter_us = 0; // wake-up latency relative to the deadline
+    int32_t max_jitter_us = 0;
+    uint32_t avg_jitter_us = 0;
+    uint32_t last_cycle_us = 0; // time spent running jobs in the last wake-up
+    uint32_t max_cycle_us = 0;
+};
+
+// Start the acquisition task (FreeRTOS task pinned to ACQ_TASK_CORE). It sleeps
+// on a one-shot esp_timer armed for the earliest job deadline. `periodMs` is the
+// default period for jobs without a stored setting. Returns false if the task
+// or timer could not be created; callers should then fall back to
+// runAcquisitionCycle().
+bool startAcquisitionTask(uint32_t periodMs = SENSOR_READ_INTERVAL);
+bool isAcquisitionRunning();
+
+// Sample every channel once on the calling thread and publish a record
+// (fallback from loop() when the task is not running). The acquisition jobs are
+// the only place that samples the AI/ADS channels and advances their filters.
+void runAcquisitionCycle(int64_t sampleTimeUs);
+
+// Job configuration. Tags are "AI1".."AI3", "ADS0", "ADS1", "DI" (all pulse
+// counters) and "RECORD".
+const char *getAcquisitionJobTag(int job);
+int findAcquisitionJob(const String &tag);
+// Persist and apply a new period/phase (applied by the task before its next sleep).
+// Returns false, storing nothing, when the acquisition task is not running.
+bool setAcquisitionJobPeriod(int job, uint32_t periodMs, uint32_t phaseMs);
+bool getAcquisitionJobInfo(int job, JobInfo &out);
+
+AcquisitionStats getAcquisitionStats();
+void resetAcquisitionStats();
+
+#endif // ACQUISITION_TASK_H
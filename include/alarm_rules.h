@@ -0,0 +1,120 @@
+#ifndef ALARM_RULES_H
+#define ALARM_RULES_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "sensor_snapshot.h"
+
+// On-device alarm rules. Each rule watches one snapshot value (a tag plus a
+// field) and is evaluated by the acquisition task right after it publishes a
+// snapshot, so an output switches within the cycle that saw the excursion.
+// A rule declared as JSON:
+//   {"name":"hi_press","tag":"AI1","field":"pressure","op":"above",
+//    "threshold":6.5,"hysteresis":0.2,"debounce_ms":500,"output":1}
+//
+// Tags and fields (first field is the default):
+//   AI1..AI3    pressure, voltage
+//   ADS0, ADS1  pressure, current, depth, voltage
+//   DI1..DI4    rate (Hz), rate_per_hour, total, count
+// Operators:
+//   above / below          value crosses threshold; releases once it is back
+//                          by more than hysteresis
+//   rise_rate / fall_rate  rate of change in units per second, same hysteresis
+// debounce_ms: the new state must hold this long before the rule switches
+// (both edges). output: DO1..DO4 as 1..4, 0 for an indicator-only rule. An
+// output is on while any rule driving it is active. notify (default true):
+// every transition is queued as an AlarmEvent for immediate delivery,
+// independent of the batch notification interval.
+
+enum AlarmRuleSource : uint8_t {
+    ALARM_SRC_AI = 0,
+    ALARM_SRC_ADS,
+    ALARM_SRC_DI
+};
+
+enum AlarmRuleOp : uint8_t {
+    ALARM_OP_ABOVE = 0,
+    ALARM_OP_BELOW,
+    ALARM_OP_RISE_RATE,
+    ALARM_OP_FALL_RATE
+};
+
+constexpr int ALARM_NUM_OUTPUTS = 4;
+constexpr size_t ALARM_NAME_LEN = 16;
+
+// Plain data so a rule set can be handed between tasks under a spinlock
+struct AlarmRuleConfig {
+    char name[ALARM_NAME_LEN] = "";
+    bool enabled = true;
+    AlarmRuleSource source = ALARM_SRC_AI;
+    uint8_t channel = 0;
+    uint8_t field = 0;
+    AlarmRuleOp op = ALARM_OP_ABOVE;
+    float threshold = 0.0f;
+    float hysteresis = 0.0f;
+    uint32_t debounce_ms = 0;
+    uint8_t output = 0;
+    bool notify = true;
+};
+
+// One rule transition, queued by the evaluator for the notifier task
+struct AlarmEvent {
+    uint8_t rule = 0;
+    char name[ALARM_NAME_LEN] = "";
+    AlarmRuleSource source = ALARM_SRC_AI;
+    uint8_t channel = 0;
+    uint8_t field = 0;
+    AlarmRuleOp op = ALARM_OP_ABOVE;
+    bool active = false;        // true = raised, false = cleared
+    float value = NAN;
+    float rate = NAN;
+    float threshold = 0.0f;
+    uint32_t snapshot_seq = 0;
+    uint32_t millis_at = 0;     // millis() when the transition was detected
+};
+
+struct AlarmRuleStatus {
+    bool active = false;
+    uint32_t hits = 0;          // inactive -> active transitions
+    float value = NAN;          // last evaluated value
+    float rate = NAN;           // units per second between the last two samples
+    uint32_t last_change_ms = 0;
+};
+
+struct AlarmEngineStats {
+    uint32_t evaluations = 0;
+    uint32_t last_eval_us = 0;
+    uint32_t max_eval_us = 0;
+    uint8_t outputs = 0;        // bit n = DO(n+1) driven high
+    uint32_t events_queued = 0;
+    uint32_t events_dropped = 0; // event queue full
+};
+
+// Drive DO1..DO4 low and load the stored rule set (NVS namespace "rules").
+void setupAlarmRules();
+
+// Evaluate every rule against a freshly published snapshot and update the
+// outputs. Called only by the thread that owns acquisition.
+void evaluateAlarmRules(const SensorSnapshot &snap);
+
+// JSON <-> rule set. parseAlarmRules() reports the first error in `error`.
+bool parseAlarmRules(JsonVariantConst json, AlarmRuleConfig *out, int &count, String &error);
+void alarmRuleToJson(const AlarmRuleConfig &rule, JsonObject out);
+
+// Persist and stage a new rule set; it replaces the active one (and clears
+// rule state) on the next evaluation.
+bool setAlarmRules(const AlarmRuleConfig *rules, int count);
+int getAlarmRules(AlarmRuleConfig *out);
+bool getAlarmRuleStatus(int index, AlarmRuleStatus &out);
+AlarmEngineStats getAlarmEngineStats();
+void resetAlarmRuleStats();
+
+int getAlarmOutputPin(int output);
+
+// Block up to timeoutMs for the next rule transition. Returns false on timeout.
+bool waitAlarmEvent(AlarmEvent &out, uint32_t timeoutMs);
+void alarmEventToJson(const AlarmEvent &event, JsonObject out);
+
+#endif // ALARM_RULES_H
@@ -0,0 +1,131 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+#include "sensor_snapshot.h"
+
+// Compact binary datalog (SD log format "bin"). Little-endian file layout:
+//
+//   block 0     BinlogFileHeader: magic "ADZL", block size, file id, creation
+//               time and the column schema, CRC-32 over the header
+//   block 1..n  BinlogBlockHeader (magic "ADZB", file id, block number,
+//               record count, payload bytes, first/last record time in epoch
+//               ms, CRC-32 over header + payload), then the records
+//
+// A record is varint(ms since the previous record; 0 for the first of a
+// block), varint(bitmask of missing columns), then for every present column
+// zigzag-varint(value - the column's previous value in the block). Values
+// are integers scaled by 10^decimals of their column. Every block decodes on
+// its own.
+//
+// The file is preallocated BINLOG_PREALLOC_BYTES at a time and blocks are
+// written in place, so block writes never allocate clusters. A block is
+// valid when its magic, file id, number and CRC match. The writer never
+// skips a block: a full block the SD writer cannot take yet is retried, and
+// records arriving meanwhile are dropped and counted. Readers still skip
+// invalid blocks (torn by a reset, or left by older firmware) up to the
+// last valid block, so a bad block costs only its own records.
+
+constexpr int BINLOG_MAX_COLUMNS = 32;
+constexpr int BINLOG_COLUMN_NAME_LEN = 22;
+constexpr uint32_t BINLOG_FILE_MAGIC = 0x4C5A4441;  // "ADZL"
+constexpr uint32_t BINLOG_BLOCK_MAGIC = 0x425A4441; // "ADZB"
+constexpr uint16_t BINLOG_VERSION = 1;
+
+struct __attribute__((packed)) BinlogColumn {
+    char name[BINLOG_COLUMN_NAME_LEN]; // "AI1.raw", "ADS0.ma", "DI2.count"
+    int8_t decimals;
+    uint8_t reserved;
+};
+
+struct __attribute__((packed)) BinlogFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;
+    uint32_t block_bytes;
+    uint32_t file_id;
+    int64_t created_ms;
+    uint8_t layout[4];   // AI, ADS, DI channel counts the schema was built from
+    uint32_t crc;        // over the header and `columns` entries, with crc = 0
+    BinlogColumn column[BINLOG_MAX_COLUMNS];
+};
+
+struct __attribute__((packed)) BinlogBlockHeader {
+    uint32_t magic;
+    uint32_t file_id;
+    uint32_t block;      // block number, 1 = first data block
+    uint16_t records;
+    uint16_t used;       // payload bytes after this header
+    int64_t first_ms;
+    int64_t last_ms;
+    uint32_t crc;        // over header + payload, with crc = 0
+};
+
+static_assert(sizeof(BinlogFileHeader) <= BINLOG_BLOCK_BYTES, "file header must fit block 0");
+static_assert(sizeof(BinlogBlockHeader) == 36, "block header layout");
+
+// Column schema of a snapshot, in the order of the CSV datalog row
+int buildLogSchema(const SensorSnapshot &snap, BinlogColumn *cols, int maxCols);
+// CSV header line matching that row ("timestamp,AI1.raw,...")
+String logCsvHeader(const SensorSnapshot &snap);
+// Wall-clock time of a snapshot in epoch ms (system clock minus its age)
+int64_t logRecordEpochMs(const SensorSnapshot &snap);
+
+// Encode a record into the open block; the file is opened (or created) on
+// first use and rolled to BINLOG_PREV_PATH when full or when the channel
+// layout changes. Called from loop().
+bool appendBinaryRecord(const SensorSnapshot &snap);
+// Hand the open partial block to the SD writer if it has new records.
+// `timeoutMs` > 0 also waits until it is on the card (before an export);
+// the lock, the hand-over and the sync each wait at most that long, and
+// false means the tail may not be on the card yet.
+bool flushBinaryLog(uint32_t timeoutMs = 0);
+
+struct BinlogWriterStats {
+    uint32_t block = 0;            // block being filled, 0 = no open file
+    bool sealed = false;           // a full block waits for the SD writer
+    uint32_t failed_submits = 0;   // SD writer busy or its ring full
+    uint32_t dropped_records = 0;  // lost while a full block was held back
+};
+
+BinlogWriterStats getBinlogWriterStats();
+
+// Sequential reader (export). Not thread-safe; one per response.
+class BinlogReader {
+public:
+    ~BinlogReader();
+    // False when the file is missing or its header is invalid
+    bool open(const char *path);
+    void close();
+    const BinlogFileHeader &header() const { return hdr; }
+    // Next record; invalid blocks are skipped, false after the last valid
+    // one. `values` holds
+    // header().columns entries; bit i of `missing` marks column i as absent.
+    bool next(int64_t &epochMs, int64_t *values, uint32_t &missing);
+    // Continue at the first block holding records at or after `epochMs`
+    // (binary search on the block times)
+    bool seekTime(int64_t epochMs);
+    // Bytes up to the end of the last valid block
+    uint32_t validBytes();
+
+private:
+    bool loadBlock(uint32_t number);
+
+    File file;
+    BinlogFileHeader hdr;
+    uint8_t *buf = nullptr;
+    uint32_t blockNo = 0;
+    uint32_t pos = 0;
+    uint32_t left = 0;       // records left in the loaded block
+    int64_t lastMs = 0;
+    int64_t prev[BINLOG_MAX_COLUMNS];
+    uint32_t endBlock = 0;   // block after the last valid one, 0 = not searched yet
+};
+
+// Format a scaled column value ("-12.345"); `out` needs 24 bytes
+void formatBinlogValue(int64_t value, int decimals, char *out, size_t len);
+
+#endif // BINARY_LOG_H
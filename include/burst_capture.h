@@ -0,0 +1,105 @@
+#ifndef BURST_CAPTURE_H
+#define BURST_CAPTURE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Transient (water-hammer) capture. While armed, the producers that already
+// run at full rate - the ADC1 DMA drain task for AI1..AI3 and the ADS1115
+// engine for ADS0/ADS1 - copy every conversion of the selected channels into
+// per-channel RAM rings. A trigger (threshold, dP/dt or manual) freezes
+// pre_ms of history and collects post_ms more; loop() then writes the window
+// to CAPTURE_DIR on SD and frees the buffers. The normal acquisition jobs keep
+// reading their own windows/caches and are not slowed down.
+//
+// File format (little-endian), downloadable via /api/sd/file:
+//   CaptureFileHeader
+//   channels x { CaptureChannelHeader, int16_t samples[sample_count] }
+// Samples are raw converter codes (12-bit ADC or signed 16-bit ADS);
+// value ~= code * scale + offset (bar, linearised calibration).
+
+enum CaptureSource : uint8_t {
+    CAPTURE_SRC_AI1 = 0,
+    CAPTURE_SRC_AI2,
+    CAPTURE_SRC_AI3,
+    CAPTURE_SRC_ADS0,
+    CAPTURE_SRC_ADS1,
+    CAPTURE_SRC_COUNT
+};
+
+enum CaptureTriggerType : uint8_t {
+    CAPTURE_TRIG_MANUAL = 0, // fires as soon as the pre-trigger window is full
+    CAPTURE_TRIG_ABOVE,      // value rises above level (bar)
+    CAPTURE_TRIG_BELOW,      // value falls below level (bar)
+    CAPTURE_TRIG_DPDT        // change over dpdt_window_ms exceeds level (bar/s, sign = direction)
+};
+
+enum CapturePhase : uint8_t {
+    CAPTURE_IDLE = 0,
+    CAPTURE_ARMED,
+    CAPTURE_TRIGGERED,
+    CAPTURE_COMPLETE // waiting for loop() to write the file
+};
+
+struct CaptureConfig {
+    uint8_t channel_mask = 1;   // bit n = CaptureSource n
+    uint32_t pre_ms = 100;
+    uint32_t post_ms = 400;
+    uint32_t rate_hz = 0;       // AI decimation target; 0 = every DMA conversion
+    CaptureTriggerType trigger = CAPTURE_TRIG_MANUAL;
+    uint8_t trigger_source = CAPTURE_SRC_AI1;
+    float level = 0.0f;
+    uint16_t dpdt_window_ms = 10;
+};
+
+struct CaptureStatus {
+    CapturePhase phase = CAPTURE_IDLE;
+    CaptureConfig config;
+    uint32_t captures_saved = 0;
+    String last_file;
+    String last_error;
+};
+
+struct __attribute__((packed)) CaptureFileHeader {
+    char magic[4];              // "BCAP"
+    uint16_t version;           // 1
+    uint16_t channels;
+    uint32_t pre_ms;
+    uint32_t post_ms;
+    int64_t trigger_epoch_ms;   // 0 when the wall clock was not set
+    uint8_t trigger_type;       // CaptureTriggerType
+    uint8_t trigger_source;     // CaptureSource
+    uint16_t reserved;
+    float trigger_level;
+};
+
+struct __attribute__((packed)) CaptureChannelHeader {
+    uint8_t source;             // CaptureSource
+    uint8_t reserved[3];
+    float sample_rate_hz;       // measured over the capture
+    uint32_t sample_count;
+    uint32_t trigger_index;     // first sample at/after the trigger
+    float scale;
+    float offset;
+};
+
+// Allocate the rings and start recording. Rejects configs whose pre_ms or
+// post_ms exceeds CAPTURE_MAX_WINDOW_MS, whose window does not fit
+// CAPTURE_MAX_BYTES or whose sources are not running.
+bool armBurstCapture(const CaptureConfig &config, String &error);
+// Fire an armed capture now (pre-trigger data is whatever has been recorded)
+bool triggerBurstCapture();
+void abortBurstCapture();
+CaptureStatus getBurstCaptureStatus();
+
+// Write a completed capture to SD (call from loop())
+void serviceBurstCapture();
+
+// Producer hooks. burstCaptureActive() is a cheap check so producers only
+// build sample blocks while a capture is recording.
+bool burstCaptureActive();
+void burstCaptureFeed(CaptureSource source, const int16_t *codes, int count);
+
+const char *captureSourceName(CaptureSource source);
+
+#endif // BURST_CAPTURE_H
@@ -44,6 +44,134 @@ static const char* const PREFERRED_PASSES[] = {
 #define EMA_ALPHA 0.05f
 #define PRINT_TIME_INTERVAL 5000 // ms
 
+// Acquisition task (sensor sampling runs off the loop() thread)
+#ifndef ACQ_TASK_CORE
+#define ACQ_TASK_CORE 0        // loop() runs on core 1; keep sampling away from it
+#endif
+#define ACQ_TASK_PRIORITY 5
+#define ACQ_TASK_STACK 4096
+#define SNAPSHOT_RECORD_QUEUE_LEN 8   // record snapshots waiting for loop() (SD row, notifications)
+
+// AI1..AI3 capture mode: continuous ADC1 DMA scan (default) or blocking analogRead
+#define ADC_MODE_ONESHOT 0
+#define ADC_MODE_DMA 1
+#ifndef DEFAULT_ADC_MODE
+#define DEFAULT_ADC_MODE ADC_MODE_DMA
+#endif
+#define ADC_DMA_SAMPLE_FREQ_HZ 20000 // total conversions/s shared by the scanned pins
+#define ADC_DMA_FRAME_BYTES 256      // bytes handed over by the driver per read
+
+// ADS1115 background conversion engine (continuous mode, round-robin mux)
+#define ADS_ENGINE_CHANNELS 2   // A0..A(n-1) are scanned; higher channels use single-shot reads
+#define DEFAULT_ADS_SPS 128     // 8, 16, 32, 64, 128, 250, 475 or 860
+
+// Burst capture of AI/ADS transients (RAM ring, saved to SD)
+#ifndef CAPTURE_MAX_BYTES
+#define CAPTURE_MAX_BYTES 49152 // sample memory allocated while a capture is armed
+#endif
+#define CAPTURE_MAX_WINDOW_MS 10000 // upper bound of pre_ms and of post_ms
+#define CAPTURE_DIR "/captures"
+
+// Background SD writer (sd_writer.*): records queue in RAM, one task writes them in blocks
+#define SD_WRITER_RING_BYTES 8192          // record queue (power of two, <= 32 KB)
+#ifndef SD_WRITER_BLOCK_BYTES
+#define SD_WRITER_BLOCK_BYTES 4096         // write unit per file: 4..32 KB, a multiple of 512
+#endif
+#define SD_WRITER_FLUSH_MS 30000UL         // write a partial block once its oldest record is this old
+#define SD_WRITER_SYNC_MS 60000UL          // fsync (directory entry + FAT) at most this often
+#define SD_WRITER_POLL_MS 500              // writer wake-up when producers stay below half the ring
+#define SD_WRITER_SYNC_TIMEOUT_MS 2000     // readers wait this long for queued records to land
+#define SD_WRITER_WEB_SYNC_MS 20           // same, from web handlers (AsyncTCP task); a missed sync still completes
+#define SD_WRITER_TASK_CORE 0
+#define SD_WRITER_TASK_PRIORITY 1          // below acquisition and notifier; SD work is never urgent
+#define SD_WRITER_TASK_STACK 4096
+
+// Hourly log partitions (log_partition.*): /logs/YYYY/MM/DD-HH.*
+#define LOG_PARTITION_DIR "/logs"
+#define LOG_INDEX_EVERY 64                      // sparse index: one entry per this many records of a stream
+#define LOG_INDEX_BATCH 8                       // entries the writer buffers before appending them
+#define LOG_RETENTION_MIN_FREE_PCT 10           // delete the oldest hours while free space is below this
+#define LOG_RETENTION_MAX_HOURS_PER_PASS 48     // bound on one retention pass (runs hourly)
+#define LOG_QUERY_RECORDS_PER_FILL 256          // records /api/logs/query reads per response chunk
+#define LOG_QUERY_LINE_BYTES 512                // longer CSV rows are skipped by the query
+#define LOG_QUERY_READ_BYTES 512                // SD read buffer of a query
+#define PENDING_PREVIEW_MAX_BYTES 8192          // cap on pending notification content in API responses
+
+// Outbound notification queue (outbound_queue.*): /outq/NNNNNNNN.seg
+#define OUTQ_DIR "/outq"
+#define OUTQ_SEGMENT_BYTES 65536UL              // a segment is closed once the next line would pass this
+#define OUTQ_BATCH_MAX_RECORDS 50               // lines per POST
+#define OUTQ_BATCH_MAX_BYTES 16384              // bytes per POST (>= the longest line the SD writer takes)
+#define OUTQ_BATCHES_PER_RUN 4                  // POSTs per drain run
+#define OUTQ_DRAIN_INTERVAL_MS 10000UL          // drain run period while online
+#define OUTQ_RETRY_MIN_MS 30000UL               // wait after a failed POST, doubled per failure
+#define OUTQ_RETRY_MAX_MS 300000UL
+#define OUTQ_CHECKPOINT_MS 60000UL              // NVS checkpoint of the cursors at most this often
+
+// sd_manager upload: POSTs read forward from a (partition hour, offset) cursor in NVS
+#define SD_UPLOAD_BATCH_MAX_RECORDS 300         // rows per POST
+#define SD_UPLOAD_BATCH_MAX_BYTES 8192          // bytes per POST (>= the longest line the SD writer takes)
+#define SD_UPLOAD_BATCHES_PER_RUN 4             // POSTs per upload run while there is a backlog
+#define SD_UPLOAD_FIRST_WINDOW_S 300            // without a cursor, start this far back
+
+// SD datalog format: CSV rows in the hourly partitions or the binary log (binary_log.*)
+#define PREF_SD_LOG_FORMAT "sd_log_fmt"
+#define SD_LOG_FORMAT_CSV 0
+#define SD_LOG_FORMAT_BIN 1
+#define DEFAULT_SD_LOG_FORMAT SD_LOG_FORMAT_CSV
+#define BINLOG_PATH "/datalog.bin"
+#define BINLOG_PREV_PATH "/datalog.prev.bin"    // the previous file after a roll
+#define BINLOG_BLOCK_BYTES 4096                 // CRC'd block, the unit of every write
+#define BINLOG_PREALLOC_BYTES (1024UL * 1024UL) // the file grows by this much at a time
+#define BINLOG_MAX_FILE_BYTES (64UL * 1024UL * 1024UL)
+#define BINLOG_FLUSH_MS SD_WRITER_FLUSH_MS      // rewrite the open partial block this often (same loss window as CSV)
+#define BINLOG_SUBMIT_WAIT_MS 200               // wait for the writer to release the block copy
+
+// Sample store: per-tag averaging windows in RAM, newest samples mirrored in RTC slow memory
+#define SAMPLE_STORE_MAX_SENSORS 3                  // AI pins of the index API (tags AI1..AI3)
+#define SAMPLE_STORE_MAX_TAGS 48                    // AI, ADS, DI and Modbus tags
+#define SAMPLE_STORE_MAX_CAPACITY 16384             // samples per tag in RAM (~4.3 B each, 8.3 B for AI, plus 32 spare)
+#define SAMPLE_STORE_HEAP_RESERVE_BYTES 49152       // largest free heap block a tag's window must leave (TLS, web server)
+#define SAMPLE_STORE_RTC_TAGS 16                    // tags mirrored in RTC memory
+#define SAMPLE_STORE_RTC_CAPACITY 32                // newest samples per mirrored tag (8 B each, 4 KB in all)
+#define SAMPLE_STORE_CHECKPOINT_MS 21600000UL       // NVS checkpoint (only when changed): 6 h
+
+// Dashboard history rollups (history_rollup.*): buckets per tag in each tier
+#define HISTORY_SLOTS_1S 120                        // 1 s buckets: 2 min
+#define HISTORY_SLOTS_1M 360                        // 1 min buckets: 6 h
+#define HISTORY_SLOTS_15M 192                       // 15 min buckets: 48 h
+#define HISTORY_SLOTS_1H 336                        // 1 h buckets: 14 days
+#define HISTORY_MAX_POINTS 1000                     // points per series in one /api/history response
+#define HISTORY_MAX_EXTRA_TAGS 8                    // Modbus points with "history": true (~10 KB each)
+#define HISTORY_HEAP_RESERVE_BYTES 49152            // largest free heap block a tag's rings must leave (TLS, web server)
+
+// DI1..DI4 hardware pulse counters (PCNT)
+#define PULSE_DEFAULT_FILTER_NS 1000        // glitch filter: pulses shorter than this are ignored
+#define PULSE_RATE_MIN_WINDOW_MS 1000       // shortest window a rate is measured over
+#define PULSE_PERSIST_INTERVAL_MS 600000UL  // NVS checkpoint of totals (only when changed)
+
+// Local alarm rules driving DO1..DO4
+#define ALARM_MAX_RULES 8
+#define ALARM_EVENT_QUEUE_LEN 16   // rule transitions waiting for the notifier task
+#define NOTIFY_TASK_CORE 1
+#define NOTIFY_TASK_PRIORITY 2     // above loop(), below acquisition
+#define NOTIFY_TASK_STACK 6144
+
+// Report-by-exception defaults for every tag (SD log, notifications, SSE)
+#define REPORT_DEFAULT_DEADBAND 0.02f              // in tag units (bar, Hz)
+#define REPORT_DEFAULT_MAX_SILENCE_MS 900000UL     // heartbeat: report at least every 15 min
+
+// Streaming sensor-health diagnostics (AI1..AI3, ADS0/ADS1)
+#define HEALTH_WINDOW_SAMPLES 64        // Welford block; stddev/spike rate refresh once per block
+#define HEALTH_STUCK_COUNTS 1           // raw codes within this of the anchor count as unchanged
+#define HEALTH_STUCK_MS 600000UL        // flatline longer than this = stuck
+#define HEALTH_NOISE_BAR 0.2f           // block stddev above this = noisy
+#define HEALTH_SPIKE_SIGMA 6.0f         // step from the previous sample beyond this many step stddevs (last block) = spike
+#define HEALTH_SPIKE_MIN_BAR 0.05f      // ...and at least this large, so a flat signal has no spikes
+#define HEALTH_SPIKE_MAX_PER_BLOCK 3    // more spikes than this in a block = spiky
+#define HEALTH_LOOP_MIN_MA 3.6f         // NAMUR NE43: below = open loop / broken wire
+#define HEALTH_LOOP_MAX_MA 21.0f        // NAMUR NE43: above = short / over-range
+
 // Logging verbosity
 #ifndef ENABLE_VERBOSE_LOGS
 #define ENABLE_VERBOSE_LOGS 0  // Set to 1 for debugging SD card issues
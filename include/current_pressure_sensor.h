@@ -1,44 +1,99 @@
 #pragma once
 
 #include <Arduino.h>
+#include "filter_pipeline.h"
 
 // Initialize ADS1115 at optional I2C address (default 0x48)
 bool setupCurrentPressureSensor(uint8_t i2cAddress = 0x48);
 
-// Read raw ADC value from ADS1115 channel (0-3) as signed 16-bit reading
+// Read raw ADC value from ADS1115 channel (0-3) as signed 16-bit reading.
+// Channels scanned by the background engine are served from its cache (no I2C
+// traffic); other channels fall back to a blocking single-shot conversion.
 int16_t readAdsRaw(uint8_t channel);
 
+// Latest engine conversion for a channel and its esp_timer timestamp (us).
+// Returns false if the channel has not been converted yet.
+bool getAdsCachedRaw(uint8_t channel, int16_t &raw, int64_t &timestampUs);
+
+struct AdsEngineStatus {
+    bool running = false;
+    bool rdy_paced = false; // woken by the ALERT/RDY pin rather than a timed wait
+    int sps = 0;
+    int channels = 0;
+    uint32_t timeouts = 0;  // RDY pulses that never arrived
+    uint32_t conversions[4] = {0, 0, 0, 0};
+	int64_t last_us[4] = {0, 0, 0, 0};
+};
+AdsEngineStatus getAdsEngineStatus();
+
+// Engine data rate (samples/s for the whole device, shared by the scanned channels).
+// setAdsSampleRate() rounds up to a supported rate, persists it and returns it.
+int getAdsSampleRate();
+int setAdsSampleRate(int sps);
+
 // Convert raw ADC reading to millivolts using library computeVolts
 float adsRawToMv(int16_t raw);
 
-// Read current in mA for given ADS channel, using shunt resistor (ohms)
-// and amplifier gain (amp_gain). Defaults follow vendor sample: shunt=119Ω, amp_gain=2.0
-float readAdsMa(uint8_t channel, float shunt_ohm = 119.0f, float amp_gain = 2.0f);
+// Per-channel ADS mode: use shunt resistor (legacy) or TP5551 current-to-voltage module
+enum AdsChannelMode {
+	ADS_MODE_SHUNT = 0,
+	ADS_MODE_TP5551 = 1,
+};
+
+// Per-channel scaling and wiring. Kept in RAM so the acquisition task never
+// opens NVS; loaded by setupCurrentPressureSensor() and refreshed with
+// reloadAdsChannelConfig() after the underlying keys are written.
+struct AdsChannelConfig {
+    int mode = ADS_MODE_TP5551;
+    float tp_scale = 238.0f;   // mV per mA (TP5551 mode)
+    float shunt_ohm = 119.0f;  // shunt mode
+    float amp_gain = 2.0f;     // shunt mode
+    bool enabled = true;
+};
+AdsChannelConfig getAdsChannelConfig(uint8_t channel);
+void reloadAdsChannelConfig(uint8_t channel);
 
-// Return last EMA-smoothed mA value for ADS channel
+// Read current in mA for given ADS channel using its cached config, then
+// advance the channel's filter pipeline
+float readAdsMa(uint8_t channel, const AdsChannelConfig &cfg);
+
+// Instantaneous current for a millivolt reading using the channel's mode
+// (TP5551 tp_scale or shunt/amp). No filter state is touched. NAN if unusable.
+float adsMvToMa(const AdsChannelConfig &cfg, float mv);
+
+// True once setupCurrentPressureSensor() found the ADS1115
+bool isAdsAvailable();
+
+// Return last filtered mA value for ADS channel
 float getAdsSmoothedMa(uint8_t channel);
 
-// Runtime setters (apply immediately)
+// Runtime setters for the default median -> EMA pipeline (apply immediately
+// to channels without a custom pipeline)
 void setAdsEmaAlpha(float a);
 void setAdsNumAvg(int n);
 
+// Per-channel filter pipeline, persisted in ads_cfg "filt_<ch>".
+// setAdsFilterPipeline() returns false for an invalid channel or config;
+// resetAdsFilterPipeline() goes back to the default pipeline.
+bool setAdsFilterPipeline(uint8_t channel, const FilterPipelineConfig &config);
+void resetAdsFilterPipeline(uint8_t channel);
+FilterPipelineConfig getAdsFilterPipeline(uint8_t channel);
+bool isAdsFilterCustom(uint8_t channel);
+
 // Compute depth in mm using sample's formula.
 float computeDepthMm(float current_mA, float current_init_mA, float range_mm, float density);
 
 // Convert 4-20mA measurement into pressure in bar (linear mapping)
 float computePressureBarFromMa(float current_mA, float current_init_mA, float range_bar);
 
-// Per-channel ADS configuration helpers (read from Preferences with defaults)
+// Per-channel ADS configuration helpers (served from the RAM copy above)
 float getAdsShuntOhm(uint8_t channel);
 float getAdsAmpGain(uint8_t channel);
-// Per-channel ADS mode: use shunt resistor (legacy) or TP5551 current-to-voltage module
-enum AdsChannelMode {
-	ADS_MODE_SHUNT = 0,
-	ADS_MODE_TP5551 = 1,
-};
-
 int getAdsChannelMode(uint8_t channel);
 float getAdsTpScale(uint8_t channel);
+// A disabled channel is still converted but reported as disabled and left
+// out of the health diagnostics (nothing wired to it)
+bool getAdsChannelEnabled(uint8_t channel);
 
 // Clear ADS per-channel buffers and reset smoothed values (useful after tp_scale changes)
 void clearAdsBuffers();
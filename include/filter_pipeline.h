@@ -0,0 +1,206 @@
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <math.h>
+
+#include "windowed_median.h"
+
+// Per-channel filter chain. A pipeline is declared as a JSON array, e.g.
+//   [{"type":"median","window":5},{"type":"ema","alpha":0.1}]
+// and compiled into a fixed array of stages. Each stage kernel is a template
+// specialization selected by a switch, so processing a sample allocates
+// nothing and makes no virtual calls. The window state of median, moving_avg
+// and hampel stages (~460 bytes) is allocated by configure() for the stages
+// that use it, so idle stages and pipelines cost a few bytes each.
+//
+// Stage types and parameters:
+//   median      window (1..FILTER_MAX_WINDOW)
+//   ema         alpha (0..1]
+//   moving_avg  window
+//   hampel      window, k (outlier threshold in scaled MADs, default 3)
+//   kalman      q (process noise), r (measurement noise)
+//   deadband    band (output holds until the input moves more than band)
+
+enum FilterStageType : uint8_t {
+    FILTER_NONE = 0,
+    FILTER_MEDIAN,
+    FILTER_EMA,
+    FILTER_MOVING_AVG,
+    FILTER_HAMPEL,
+    FILTER_KALMAN,
+    FILTER_DEADBAND
+};
+
+constexpr int FILTER_MAX_STAGES = 4;
+constexpr int FILTER_MAX_WINDOW = 21;
+
+struct FilterStageConfig {
+    FilterStageType type = FILTER_NONE;
+    uint8_t window = 1;
+    float a = 0.0f; // alpha, k, q or band depending on type
+    float b = 0.0f; // r for kalman
+};
+
+struct FilterPipelineConfig {
+    FilterStageConfig stages[FILTER_MAX_STAGES];
+    uint8_t count = 0;
+};
+
+// Sample window of a median, moving_avg or hampel stage
+struct FilterWindowState {
+    WindowedMedian<float, FILTER_MAX_WINDOW> median; // median, hampel
+    float ring[FILTER_MAX_WINDOW];                   // moving_avg, hampel
+};
+
+// Runtime state of one stage; fields are shared between stage types
+struct FilterStageState {
+    FilterWindowState *win = nullptr; // set for window stages only
+    uint8_t head = 0;
+    uint8_t filled = 0;
+    float sum = 0.0f;
+    float y = 0.0f; // last output / estimate
+    float p = 0.0f; // kalman covariance
+    bool primed = false;
+};
+
+template <FilterStageType K>
+struct FilterKernel;
+
+template <>
+struct FilterKernel<FILTER_MEDIAN> {
+    static float run(const FilterStageConfig &, FilterStageState &s, float x) {
+        s.win->median.push(x);
+        return s.win->median.median();
+    }
+};
+
+template <>
+struct FilterKernel<FILTER_EMA> {
+    static float run(const FilterStageConfig &c, FilterStageState &s, float x) {
+        s.y = s.primed ? c.a * x + (1.0f - c.a) * s.y : x;
+        s.primed = true;
+        return s.y;
+    }
+};
+
+template <>
+struct FilterKernel<FILTER_MOVING_AVG> {
+    static float run(const FilterStageConfig &c, FilterStageState &s, float x) {
+        if (s.filled == c.window) {
+            s.sum -= s.win->ring[s.head];
+        } else {
+            s.filled++;
+        }
+        s.win->ring[s.head] = x;
+        s.sum += x;
+        s.head = (s.head + 1) % c.window;
+        return s.sum / s.filled;
+    }
+};
+
+template <>
+struct FilterKernel<FILTER_HAMPEL> {
+    // Replace the sample with the window median when it lies more than
+    // k * 1.4826 * MAD away from it.
+    static float run(const FilterStageConfig &c, FilterStageState &s, float x) {
+        s.win->median.push(x);
+        s.win->ring[s.head] = x;
+        s.head = (s.head + 1) % c.window;
+        if (s.filled < c.window) s.filled++;
+        float med = s.win->median.median();
+        float dev[FILTER_MAX_WINDOW];
+        for (int i = 0; i < s.filled; ++i) dev[i] = fabsf(s.win->ring[i] - med);
+        // Window is small; insertion sort for the MAD
+        for (int i = 1; i < s.filled; ++i) {
+            float v = dev[i];
+            int j = i - 1;
+            while (j >= 0 && dev[j] > v) { dev[j + 1] = dev[j]; --j; }
+            dev[j + 1] = v;
+        }
+        float mad = 1.4826f * dev[s.filled / 2];
+        return fabsf(x - med) > c.a * mad ? med : x;
+    }
+};
+
+template <>
+struct FilterKernel<FILTER_KALMAN> {
+    // Scalar random-walk model
+    static float run(const FilterStageConfig &c, FilterStageState &s, float x) {
+        if (!s.primed) {
+            s.y = x;
+            s.p = c.b;
+            s.primed = true;
+            return s.y;
+        }
+        s.p += c.a;
+        float gain = s.p / (s.p + c.b);
+        s.y += gain * (x - s.y);
+        s.p *= (1.0f - gain);
+        return s.y;
+    }
+};
+
+template <>
+struct FilterKernel<FILTER_DEADBAND> {
+    static float run(const FilterStageConfig &c, FilterStageState &s, float x) {
+        if (!s.primed || fabsf(x - s.y) > c.a) s.y = x;
+        s.primed = true;
+        return s.y;
+    }
+};
+
+class FilterPipeline {
+public:
+    FilterPipeline() = default;
+    ~FilterPipeline();
+    FilterPipeline(const FilterPipeline&) = delete;
+    FilterPipeline& operator=(const FilterPipeline&) = delete;
+
+    // Compile a configuration; clears all stage state. Invalid configs
+    // (see validateFilterPipeline), or window state the heap cannot hold, are
+    // rejected and leave the pipeline unchanged.
+    bool configure(const FilterPipelineConfig &config);
+    const FilterPipelineConfig &config() const { return config_; }
+
+    // Drop history; the next sample primes every stage.
+    void reset();
+
+    float process(float x) {
+        for (int i = 0; i < config_.count; ++i) {
+            const FilterStageConfig &c = config_.stages[i];
+            FilterStageState &s = state_[i];
+            switch (c.type) {
+                case FILTER_MEDIAN: x = FilterKernel<FILTER_MEDIAN>::run(c, s, x); break;
+                case FILTER_EMA: x = FilterKernel<FILTER_EMA>::run(c, s, x); break;
+                case FILTER_MOVING_AVG: x = FilterKernel<FILTER_MOVING_AVG>::run(c, s, x); break;
+                case FILTER_HAMPEL: x = FilterKernel<FILTER_HAMPEL>::run(c, s, x); break;
+                case FILTER_KALMAN: x = FilterKernel<FILTER_KALMAN>::run(c, s, x); break;
+                case FILTER_DEADBAND: x = FilterKernel<FILTER_DEADBAND>::run(c, s, x); break;
+                default: break;
+            }
+        }
+        return x;
+    }
+
+private:
+    FilterPipelineConfig config_;
+    FilterStageState state_[FILTER_MAX_STAGES];
+};
+
+const char *filterStageName(FilterStageType type);
+// Returns an empty string if the config is valid, otherwise the reason.
+String validateFilterPipeline(const FilterPipelineConfig &config);
+
+// JSON <-> config. parseFilterPipeline() accepts an array of stage objects
+// (missing parameters take defaults) and reports the first error in `error`.
+bool parseFilterPipeline(JsonVariantConst json, FilterPipelineConfig &out, String &error);
+void filterPipelineToJson(const FilterPipelineConfig &config, JsonArray out);
+
+// Persist a pipeline as compact JSON under an NVS key. loadFilterPipeline()
+// returns false (and leaves `out` untouched) when nothing valid is stored.
+void saveFilterPipeline(const char *ns, const char *key, const FilterPipelineConfig &config);
+bool loadFilterPipeline(const char *ns, const char *key, FilterPipelineConfig &out);
+
+#endif // FILTER_PIPELINE_H
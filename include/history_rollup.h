@@ -0,0 +1,89 @@
+#ifndef HISTORY_ROLLUP_H
+#define HISTORY_ROLLUP_H
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "report_filter.h"
+#include "sensor_snapshot.h"
+
+// In-RAM trend history for dashboard charts. Every tag of report_filter.h
+// (AI1..AI3, ADS0/1 pressure, DI1..DI4 rate) is rolled up into cascading
+// tiers of fixed-size rings; each bucket keeps avg (float), min/max as
+// float16 distances from it and a count (saturating at 65535). All tiers
+// are fed from the same sample, so a query reads exactly one tier and never
+// touches the SD card.
+//
+//   tier  bucket  slots               span (defaults)
+//   0     1 s     HISTORY_SLOTS_1S    2 min
+//   1     1 min   HISTORY_SLOTS_1M    6 h
+//   2     15 min  HISTORY_SLOTS_15M   48 h
+//   3     1 h     HISTORY_SLOTS_1H    14 d
+//
+// Buckets are aligned to wall-clock (UTC epoch) seconds; nothing is recorded
+// until the clock is set. Only tags that are configured (Modbus points with
+// "history": true) or were once requested through /api/history (remembered
+// in NVS) are recorded. Their rings (~10 KB per tag with the default slots)
+// are allocated on the first usable value, and only while the largest free
+// heap block keeps HISTORY_HEAP_RESERVE_BYTES after it; a refused tag reports
+// HISTORY_TAG_NO_MEMORY and is retried when requested again.
+//
+// Up to HISTORY_MAX_EXTRA_TAGS named tags from outside the snapshot (Modbus
+// points) can be registered; they take the indices after REPORT_MAX_TAGS.
+
+constexpr int HISTORY_TIER_COUNT = 4;
+constexpr int HISTORY_MAX_TAGS = REPORT_MAX_TAGS + HISTORY_MAX_EXTRA_TAGS;
+
+enum HistoryTagState : uint8_t {
+    HISTORY_TAG_IDLE = 0,    // not requested or configured
+    HISTORY_TAG_PENDING,     // wanted, no usable value yet
+    HISTORY_TAG_RECORDING,
+    HISTORY_TAG_NO_MEMORY    // refused by the heap budget
+};
+
+// Feed the usable tag values of a published snapshot. Called from loop().
+void feedHistory(const SensorSnapshot &snap);
+
+// Register a named tag (the existing index when already registered); -1 when
+// the name is too long or every extra index is taken
+int registerHistoryTag(const char *name);
+// Drop a registered tag and its rings
+void unregisterHistoryTag(int tag);
+// Feed one value of a registered tag, stamped with the current time
+void feedHistoryTag(int tag, float value);
+
+// Index of a built-in or registered tag (case-insensitive), -1 when unknown
+int findHistoryTag(const String &name);
+// Start recording a tag a client asked for (a built-in one is remembered in
+// NVS), or retry one refused for memory
+void requestHistoryTag(int tag);
+HistoryTagState historyTagState(int tag);
+// Name of a tag index; empty for a free extra index
+String historyTagName(int tag);
+
+// Resolution picked for a query; shared by every tag in the response
+struct HistoryPlan {
+    int tier = 0;
+    uint32_t width = 0;      // bucket width of the tier (s)
+    uint32_t start = 0;      // epoch of the first point
+    uint32_t step = 0;       // seconds per point (a multiple of `width`)
+    uint32_t points = 0;
+};
+
+// Pick the tier for [from, to] with at least `step` seconds per point
+// (0 = finest available) and at most HISTORY_MAX_POINTS points. Uses the
+// coarsest tier not coarser than the step that still reaches back to `from`.
+// False when nothing has been recorded yet.
+bool planHistoryQuery(uint32_t from, uint32_t to, uint32_t step, HistoryPlan &plan);
+
+// Fill plan.points values per column for one tag, merging the tier's
+// buckets into each step in one pass. Points without data get NAN and count 0.
+// False when the tag has no history.
+bool readHistory(int tag, const HistoryPlan &plan, float *avg, float *minV, float *maxV, uint32_t *count);
+
+// Latest fed epoch (0 = nothing recorded)
+uint32_t historyLatestEpoch();
+uint32_t historyTierWidth(int tier);
+uint32_t historyTierSlots(int tier);
+
+#endif // HISTORY_ROLLUP_H
@@ -2,13 +2,15 @@
 #define HTTP_NOTIFIER_H
 
 #include <Arduino.h>
+#include "sensor_snapshot.h"
 
 // Function to send HTTP notification for a specific sensor index
 void sendHttpNotification(int sensorIndex, int rawADC, float smoothedADC, float voltage);
 
-// Function to send a single HTTP POST with an array of sensor readings
-// The arrays must have length == numSensors
-void sendHttpNotificationBatch(int numSensors, int sensorIndices[], int rawADC[], float smoothedADC[]);
+// Function to send a single HTTP POST with the AI and ADS readings of one snapshot.
+// With enabledOnly, AI sensors switched off in the sensor settings are skipped.
+// tagMask selects tags by report_filter index (bit n = tag n).
+void sendHttpNotificationBatch(const SensorSnapshot &snap, bool enabledOnly = true, uint32_t tagMask = 0xFFFFFFFFUL);
 
 // Configuration API for notifications
 void setNotificationMode(uint8_t modeMask);
@@ -23,4 +25,20 @@ void routeSensorNotification(int sensorIndex, int rawADC, float smoothedADC, flo
 // Send notification for ADS channel (TP5551 current sensor). `adsChannel` is 0..n
 void sendAdsNotification(int adsChannel, int16_t rawAds, float mv, float ma);
 
+// Alarm rule transitions are delivered by their own task as soon as they are
+// queued (SSE "alarm" event on /api/sse/sensors plus the webhook), without
+// waiting for the batch interval. A failed POST hands the payload to the
+// outbound queue, which retries it with the other pending notifications.
+struct AlarmNotifierStats {
+    uint32_t sent = 0;            // webhook answered 2xx
+    uint32_t failed = 0;          // webhook unreachable or non-2xx
+    uint32_t requeued = 0;        // failed ones taken over by the outbound queue
+    uint32_t lost = 0;            // failed and the outbound queue refused them
+    uint32_t last_latency_ms = 0; // detection to 2xx
+    uint32_t max_latency_ms = 0;
+};
+
+bool startAlarmNotifier();
+AlarmNotifierStats getAlarmNotifierStats();
+
 #endif // HTTP_NOTIFIER_H
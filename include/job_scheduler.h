@@ -0,0 +1,67 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <Arduino.h>
+#include <vector>
+
+// dueUs is the grid deadline the job is being run for, not the wake-up time
+typedef void (*JobFn)(void *ctx, int64_t dueUs);
+
+// Per-job counters reported by the scheduler
+struct JobInfo {
+    const char *name = nullptr;
+    uint32_t period_ms = 0;
+    uint32_t phase_ms = 0;
+    int64_t next_due_us = 0;
+    uint32_t runs = 0;
+    uint32_t skipped = 0;       // periods dropped because the job ran late
+    int32_t last_late_us = 0;   // start time relative to the deadline
+    int32_t max_late_us = 0;
+};
+
+// Min-heap of periodic jobs keyed by their next deadline (esp_timer clock, us).
+// Deadlines sit on a fixed grid: anchor + phase + k * period, so a job never
+// drifts and jobs with the same period but different phases interleave.
+// A job that falls behind skips the missed grid points instead of bursting.
+// Not thread-safe: one owner adds, runs and reconfigures jobs.
+class JobScheduler {
+public:
+    JobScheduler();
+
+    // Register a job; returns its id (stable until clear()) or -1 on bad args.
+    int add(const char *name, uint32_t periodMs, uint32_t phaseMs, JobFn fn, void *ctx, int64_t nowUs);
+    // Change period/phase; the next deadline is recomputed from nowUs.
+    bool setPeriod(int id, uint32_t periodMs, uint32_t phaseMs, int64_t nowUs);
+    void clear();
+
+    // Earliest deadline, or INT64_MAX when no job is registered.
+    int64_t nextDueUs() const;
+    // Run every job whose deadline is <= nowUs (each at most once) and
+    // reschedule it. Returns the number of jobs run.
+    int runDue(int64_t nowUs);
+
+    size_t size() const { return jobs_.size(); }
+    bool getInfo(int id, JobInfo &out) const;
+    // Smallest configured period in ms (0 when empty)
+    uint32_t minPeriodMs() const;
+
+private:
+    struct Job {
+        JobInfo info;
+        JobFn fn = nullptr;
+        void *ctx = nullptr;
+    };
+
+    int64_t firstDueAtOrAfter(const Job &job, int64_t nowUs) const;
+    bool less(int a, int b) const;
+    void swapAt(size_t i, size_t j);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+
+    int64_t anchorUs_ = -1;
+    std::vector<Job> jobs_;
+    std::vector<int> heap_;        // job ids ordered by next_due_us
+    std::vector<size_t> heapPos_;  // job id -> index in heap_
+};
+
+#endif // JOB_SCHEDULER_H
@@ -0,0 +1,74 @@
+#ifndef LOG_PARTITION_H
+#define LOG_PARTITION_H
+
+#include <Arduino.h>
+#include <time.h>
+#include <vector>
+
+#include "config.h"
+
+// Hourly log partitions on the SD card, one directory per month:
+//
+//   /logs/YYYY/MM/DD-HH.csv   datalog rows (SD_FILE_DATALOG)
+//   /logs/YYYY/MM/DD-HH.log   error log lines (SD_FILE_ERRORLOG)
+//   /logs/YYYY/MM/DD-HH.sns   sd_manager sensor rows (SD_FILE_SENSORLOG)
+//   /logs/YYYY/MM/DD-HH.idx   sparse index of all three
+//
+// Hours are UTC. Records written before the clock is set go to the
+// 1970/01/01-00 partition, which retention removes first. Names are 8.3, so
+// each file costs a single FAT directory entry.
+//
+// The index is a sequence of LogIndexEntry, appended by the SD writer every
+// LOG_INDEX_EVERY records of a stream (the first record of a partition
+// included). An entry's time is taken when the writer accepts the record,
+// after the record was stamped, so every record before `offset` is at least
+// as old as `epoch`.
+
+enum LogStream : uint8_t {
+    LOG_STREAM_DATA = 0,
+    LOG_STREAM_ERROR,
+    LOG_STREAM_SENSOR,
+    LOG_STREAM_COUNT
+};
+
+struct __attribute__((packed)) LogIndexEntry {
+    uint32_t epoch;
+    uint32_t offset;      // byte offset of a record in the stream's partition
+    uint8_t stream;       // LogStream
+    uint8_t reserved[3];
+};
+
+constexpr int LOG_PARTITION_PATH_LEN = 32;
+
+// Partition hour (epoch / 3600) of a time; 0 while the clock is not set
+uint32_t logPartitionHour(time_t epoch);
+// Data file of `stream` for `hour`
+void logPartitionPath(LogStream stream, uint32_t hour, char *out, size_t len);
+// Shared index file of `hour`
+void logIndexPath(uint32_t hour, char *out, size_t len);
+// Create /logs/YYYY/MM of `hour` if needed. The last month found is cached;
+// forgetLogPartitionDirs() makes the next call look again (after anything
+// removed directories under /logs).
+bool ensureLogPartitionDir(uint32_t hour);
+void forgetLogPartitionDirs();
+
+// Hours in [fromHour, toHour] that have a `stream` partition, ascending
+std::vector<uint32_t> listLogPartitions(LogStream stream, uint32_t fromHour, uint32_t toHour);
+// Offset to start reading the `stream` partition of `hour` from so that no
+// record at or after `epoch` is skipped (0 without a usable index entry)
+uint32_t logIndexSeek(LogStream stream, uint32_t hour, uint32_t epoch);
+bool appendLogIndex(uint32_t hour, const LogIndexEntry *entries, int count);
+// Remove every partition of `stream` (the index entries stay until retention)
+int removeLogPartitions(LogStream stream);
+
+// Record timestamps of the text logs: "2025-10-09T08:53:20.123Z" (UTC);
+// `out` needs 25 bytes. Parsing also takes it without milliseconds or "Z".
+void formatLogTimestamp(int64_t epochMs, char *out, size_t len);
+bool parseLogTimestamp(const char *text, size_t len, int64_t &epochMs);
+
+// While free space is below LOG_RETENTION_MIN_FREE_PCT, delete the oldest
+// hours (every stream and the index) older than `keepHour`, at most
+// LOG_RETENTION_MAX_HOURS_PER_PASS per call. Returns the hours removed.
+int enforceLogRetention(uint32_t keepHour);
+
+#endif // LOG_PARTITION_H
@@ -0,0 +1,109 @@
+#ifndef LOG_QUERY_H
+#define LOG_QUERY_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+#include "binary_log.h"
+#include "config.h"
+
+// Time-range read of the datalog (/api/logs/query). Rows come from the hourly
+// CSV partitions, entered through their sparse index, or from the binary log,
+// entered by a binary search on block times. Only the selected columns are
+// kept, and `stepSec` > 0 averages them per bucket (stamped with the bucket
+// start). The body is rendered a row at a time into a small buffer, so memory
+// does not depend on the range.
+//
+//   csv   "timestamp,<columns>" then ISO-8601 UTC rows; empty = missing
+//   json  {"from","to","step","source","columns":[...],"rows":[[ms,v|null,...],...]}
+//   bin   per row: int64 epoch ms, then float32 per column (NaN = missing),
+//         little-endian
+
+enum LogQuerySource : uint8_t {
+    LOG_QUERY_SOURCE_CSV = 0,
+    LOG_QUERY_SOURCE_BIN
+};
+
+enum LogQueryFormat : uint8_t {
+    LOG_QUERY_FORMAT_CSV = 0,
+    LOG_QUERY_FORMAT_JSON,
+    LOG_QUERY_FORMAT_BIN
+};
+
+// Resolve a column list against `schema`: a tag ("AI1") selects all of its
+// columns, a full name ("ADS0.ma") just that one; empty or "*" = all
+bool selectLogColumns(const String &list, const BinlogColumn *schema, int count,
+                      std::vector<BinlogColumn> &out, String &error);
+
+// One query; not thread-safe, one per response
+class LogQuery {
+public:
+    LogQuery(LogQuerySource source, LogQueryFormat format, int64_t fromMs, int64_t toMs,
+             uint32_t stepSec, const std::vector<BinlogColumn> &columns);
+    ~LogQuery();
+
+    // Next piece of the body, reading at most LOG_QUERY_RECORDS_PER_FILL
+    // records. 0 while !done() means nothing was ready yet.
+    size_t fill(uint8_t *buffer, size_t maxLen);
+    bool done() const { return finished && offset >= pending.size(); }
+
+private:
+    bool refill();
+    bool nextRecord(int64_t &epochMs, double *values, uint32_t &missing);
+    bool nextCsvRecord(int64_t &epochMs, double *values, uint32_t &missing);
+    bool nextBinRecord(int64_t &epochMs, double *values, uint32_t &missing);
+    bool openCsvPartition();
+    bool openBinFile();
+    bool readLine();
+    void mapCsvHeader();
+    void mapColumn(const char *name, int sourceColumn);
+    void closeSources();
+
+    void append(const char *text);
+    void appendHeader();
+    void appendRow(int64_t epochMs, const double *values, uint32_t missing);
+    void appendFooter();
+    void flushBucket();
+
+    static constexpr int MAX_SOURCE_COLUMNS = 64;
+
+    LogQuerySource source;
+    LogQueryFormat format;
+    int64_t fromMs;
+    int64_t toMs;
+    int64_t stepMs;
+    std::vector<BinlogColumn> cols;
+    uint32_t allMissing;
+    int8_t outColumn[MAX_SOURCE_COLUMNS]; // source column -> selected column, -1 = not selected
+
+    // CSV partitions
+    std::vector<uint32_t> hours;
+    size_t hourIndex = 0;
+    File file;
+    char line[LOG_QUERY_LINE_BYTES];
+    uint8_t readBuf[LOG_QUERY_READ_BYTES];
+    size_t readPos = 0;
+    size_t readLen = 0;
+
+    // Binary log (previous file, then current)
+    BinlogReader reader;
+    int binFile = 0;
+    bool binOpen = false;
+    int64_t rawValues[BINLOG_MAX_COLUMNS];
+    double scale[BINLOG_MAX_COLUMNS];
+
+    // Downsampling
+    int64_t bucketMs = -1;
+    double sum[BINLOG_MAX_COLUMNS];
+    uint32_t count[BINLOG_MAX_COLUMNS];
+
+    bool headerSent = false;
+    bool finished = false;
+    uint32_t rows = 0;
+    int budget = 0;
+    std::vector<uint8_t> pending;
+    size_t offset = 0;
+};
+
+#endif // LOG_QUERY_H
@@ -47,6 +47,14 @@ struct ModbusRegister {
     // Value
     float value = NAN;
     unsigned long last_update_ms = 0;
+
+    // Sample-store tag "MB<slave>.<key>" (id, then address, when key is empty).
+    // "samples"/"retention" in the config apply when the tag is first
+    // registered; "decimals" sets the sample step (default: from the divisor
+    // and data type); "history": true also keeps trend rollups for /api/history.
+    String tag;
+    int sample_tag = -1;
+    int history_tag = -1;
 };
 
 struct ModbusSlave {
@@ -55,6 +63,9 @@ struct ModbusSlave {
     bool enabled = true;
     bool online = false;
     unsigned long last_successful_comm_ms = 0;
+    // Effective poll schedule; defaults stagger slaves poll_interval_ms apart
+    uint32_t poll_interval_ms = 0;
+    uint32_t poll_phase_ms = 0;
     std::vector<ModbusRegister> registers;
 };
 
@@ -66,6 +77,9 @@ String getModbusConfigJson();
 String getDefaultModbusConfigJson();
 
 const std::vector<ModbusSlave>& getModbusSlaves();
+// Give one slave its own poll period/phase (stored in the config JSON).
+// Returns false if no slave has that address.
+bool setModbusSlavePollInterval(uint8_t address, uint32_t periodMs, uint32_t phaseMs);
 
 String pollModbus(const ModbusPollRequest& request);
 
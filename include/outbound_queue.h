@@ -0,0 +1,68 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Disk-backed FIFO of outbound notification payloads, one JSON line each:
+//
+//   /outq/NNNNNNNN.seg   segments of at most OUTQ_SEGMENT_BYTES; a line never
+//                        spans two of them
+//
+// A position is (segment, byte offset). Lines are appended at the tail
+// through the SD writer. The sender reads a batch from the head and
+// acknowledges it with the position after its last line; segments behind
+// the head are deleted whole. Head, tail and the record/byte counts live in
+// RAM, so counting is O(1), and are checkpointed to NVS at most every
+// OUTQ_CHECKPOINT_MS and whenever the queue drains. After a reset, lines
+// appended behind the checkpointed tail are recounted from the card. Acks
+// newer than the checkpoint are lost, so those lines are sent again
+// (at-least-once).
+
+struct OutboundPos {
+    uint32_t segment;
+    uint32_t offset;
+};
+
+struct OutboundQueueStats {
+    bool ready = false;
+    uint32_t records = 0;           // waiting to be sent
+    uint32_t bytes = 0;
+    uint32_t segments = 0;
+    OutboundPos head = {0, 0};
+    OutboundPos tail = {0, 0};
+    uint32_t pushed = 0;            // since boot
+    uint32_t dropped = 0;           // SD writer queue full
+    uint32_t batches = 0;           // acknowledged
+    uint32_t failed_batches = 0;
+    uint32_t acked_records = 0;
+    uint32_t acked_bytes = 0;
+    uint32_t last_batch_records = 0;
+    uint32_t last_batch_bytes = 0;
+    uint32_t last_batch_ms = 0;     // send round trip
+    uint32_t drain_per_min = 0;     // records acknowledged in the last full minute
+    uint32_t eta_s = 0;             // backlog at that rate; 0 = idle or unknown
+};
+
+// After the card is mounted and the SD writer started: restore the cursors,
+// recount what was appended after the last checkpoint and take over a
+// leftover /pending_notifications.jsonl as a segment
+bool beginOutboundQueue();
+bool outboundQueuePush(const char *line, size_t len);
+// Copy whole lines from the head into `buf` (each with its newline), at most
+// `maxRecords` of them. `next` is the position after the last one, for
+// outboundQueueAck(). Returns the bytes copied; 0 when the queue is empty.
+// Waits up to `syncMs` for queued records to reach the card first.
+size_t outboundQueuePeek(char *buf, size_t cap, uint32_t maxRecords, uint32_t &records, OutboundPos &next,
+                         uint32_t syncMs = SD_WRITER_SYNC_TIMEOUT_MS);
+// Drop everything before `next`; `ms` is how long the send took. A position
+// from before a clear is ignored.
+void outboundQueueAck(const OutboundPos &next, uint32_t records, uint32_t bytes, uint32_t ms);
+void outboundQueueSendFailed();
+// False when not ready or the SD writer did not release the segment in time
+bool clearOutboundQueue();
+OutboundQueueStats getOutboundQueueStats();
+// "/outq/00000012.seg"
+void outboundSegmentPath(uint32_t segment, char *out, size_t len);
+
+#endif // OUTBOUND_QUEUE_H
@@ -41,6 +41,10 @@
 
 // ADS1115 Address
 #define ADS1115_ADDR 0x48
+// ADS1115 ALERT/RDY output (conversion-ready pulse). -1 = not wired, engine paces by SPS.
+#ifndef ADS_ALRT_PIN
+#define ADS_ALRT_PIN -1
+#endif
 
 // TFT Display pins (adjust based on actual hardware)
 #define TFT_CS     -1   // Not connected (or set to appropriate pin)
@@ -0,0 +1,48 @@
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Hardware pulse counters on DI1..DI4 (one PCNT unit per input). The
+// peripheral counts rising edges with a glitch filter; the 16-bit counter is
+// extended to 64 bits by an overflow interrupt, so the CPU does no work per
+// pulse. Totals survive reboots through an RTC-memory mirror (warm resets)
+// and a periodic NVS checkpoint (power loss), never a flash write per pulse.
+
+struct PulseCounterConfig {
+    bool enabled = true;
+    float units_per_pulse = 1.0f; // engineering units per pulse (e.g. litres)
+    String unit = "pulse";        // 1..15 characters
+    uint16_t filter_ns = PULSE_DEFAULT_FILTER_NS; // ignore pulses shorter than this (max ~12700)
+};
+
+struct PulseCounterReading {
+    bool enabled = false;
+    uint64_t count = 0;         // pulses since the counter was last reset
+    float total = 0.0f;         // count * units_per_pulse
+    float rate_hz = 0.0f;       // pulses per second over the last rate window
+    float rate_per_hour = 0.0f; // units per hour
+};
+
+// Configure the PCNT units and restore persisted totals. Returns false if no
+// unit could be started.
+bool setupPulseCounters();
+int getNumPulseCounters();
+int getPulseCounterPin(int index);
+
+// Read the counters and update rates (called by the acquisition DI job).
+// Rates are measured over windows of at least PULSE_RATE_MIN_WINDOW_MS.
+void samplePulseCounters(int64_t nowUs);
+bool getPulseCounterReading(int index, PulseCounterReading &out);
+
+PulseCounterConfig getPulseCounterConfig(int index);
+// Persist and apply; returns false on a bad index or parameter.
+bool setPulseCounterConfig(int index, const PulseCounterConfig &config);
+// Set the running total (pulses), e.g. to match a meter register.
+void resetPulseCounter(int index, uint64_t count = 0);
+
+// Write totals that changed since the last checkpoint to NVS (run from loop()).
+void persistPulseCounters();
+
+#endif // PULSE_COUNTER_H
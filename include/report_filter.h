@@ -0,0 +1,99 @@
+#ifndef REPORT_FILTER_H
+#define REPORT_FILTER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "sensor_snapshot.h"
+
+// Report-by-exception. Each consumer of snapshots (sink) passes every tag's
+// value through its own compressor and only emits the points it returns, so a
+// flat signal costs a heartbeat instead of a row per sample. One per-tag
+// configuration drives all sinks; each sink offers samples at its own cadence.
+//
+// Tags, in this index order, and the value compressed:
+//   AI1..AI3    pressure (bar)
+//   ADS0, ADS1  pressure (bar)
+//   DI1..DI4    rate (Hz)
+// Modes:
+//   deadband       emit a sample when it differs from the last emitted one by
+//                  more than the deviation
+//   swinging_door  emit the turning points of the trend: the previous sample
+//                  is emitted once no straight line from the last emitted
+//                  point stays within the deviation of every sample since,
+//                  so linear interpolation between emitted points rebuilds
+//                  the signal to within the deviation
+// deviation = max(deadband, deadband_pct % of the last emitted value).
+// max_silence_ms (0 = off) forces an emit when nothing was emitted for that
+// long. A disabled tag emits every sample.
+
+enum ReportSink : uint8_t {
+    REPORT_SINK_LOG = 0, // SD CSV rows (record cadence)
+    REPORT_SINK_NOTIFY,  // pending notification queue (per-sensor interval)
+    REPORT_SINK_BATCH,   // webhook batch (batch interval)
+    REPORT_SINK_SSE,     // /api/sse debug pushes (every snapshot)
+    REPORT_SINK_COUNT
+};
+
+enum ReportMode : uint8_t {
+    REPORT_MODE_DEADBAND = 0,
+    REPORT_MODE_SWINGING_DOOR
+};
+
+constexpr int REPORT_MAX_TAGS = SNAPSHOT_MAX_AI + SNAPSHOT_MAX_ADS + SNAPSHOT_MAX_DI;
+
+inline int reportTagAi(int i) { return i; }
+inline int reportTagAds(int ch) { return SNAPSHOT_MAX_AI + ch; }
+inline int reportTagDi(int i) { return SNAPSHOT_MAX_AI + SNAPSHOT_MAX_ADS + i; }
+
+// Plain data so a configuration can be handed between tasks under a spinlock
+struct ReportFilterConfig {
+    bool enabled = true;
+    ReportMode mode = REPORT_MODE_DEADBAND;
+    float deadband = REPORT_DEFAULT_DEADBAND;
+    float deadband_pct = 0.0f;
+    uint32_t max_silence_ms = REPORT_DEFAULT_MAX_SILENCE_MS;
+};
+
+struct ReportPoint {
+    int64_t t_us = 0;
+    float value = NAN;
+    uint32_t seq = 0;   // snapshot sequence the value came from
+};
+
+// offerReportSample() result bits. When both are set the held point comes first.
+#define REPORT_EMIT_HELD    0x01 // emit the previously offered sample (returned in `held`)
+#define REPORT_EMIT_CURRENT 0x02 // emit the sample just offered
+
+struct ReportSinkStats {
+    uint32_t offered = 0;
+    uint32_t emitted = 0;
+};
+
+// Load the stored configuration (NVS namespace "report")
+void setupReportFilters();
+
+// Compressed value of a tag, or NAN when the channel has no usable reading
+float reportTagValue(const SensorSnapshot &snap, int tag, int64_t &sampleUs);
+
+// Run one sample through a sink's compressor for `tag`. All sinks are driven
+// from loop(); a staged configuration is adopted (and every compressor
+// restarted) on the next call.
+uint8_t offerReportSample(ReportSink sink, int tag, const ReportPoint &point, ReportPoint &held);
+
+// JSON <-> configuration. parseReportFilters() starts from `inOut` and applies
+// [{tag, enabled?, mode?, deadband?, deadband_pct?, max_silence_ms?}]; tag "*"
+// applies an entry to every tag.
+bool parseReportFilters(JsonVariantConst json, ReportFilterConfig *inOut, String &error);
+void reportFilterToJson(int tag, const ReportFilterConfig &config, JsonObject out);
+
+// Persist and stage a full per-tag configuration (REPORT_MAX_TAGS entries)
+void setReportFilters(const ReportFilterConfig *configs);
+void getReportFilters(ReportFilterConfig *out);
+ReportSinkStats getReportSinkStats(ReportSink sink);
+
+const char *reportTagName(int tag);
+const char *reportSinkName(ReportSink sink);
+
+#endif // REPORT_FILTER_H
@@ -3,12 +3,110 @@
 
 #include <Arduino.h>
 
-// Initialize sample store for total sensors and per-sensor capacity
+// Averaging windows keyed by tag ID: "AI1".."AI3", "ADS0", "ADS1",
+// "DI1".."DI4" and Modbus points "MB<slave>.<key>". Every tag has its own
+// capacity (0 = the store default, samples_per_sensor) and retention:
+//   ram  window only, lost on any reset
+//   rtc  newest SAMPLE_STORE_RTC_CAPACITY samples mirrored in RTC memory and
+//        restored after a soft reset (SAMPLE_STORE_RTC_TAGS tags at most)
+//   nvs  as rtc, and included in the NVS checkpoint restored after power-on
+// A window is one allocation of packed columns (~3.5 B per sample, ~7.5 B
+// for ADC tags that also keep raw/smoothed counts). The value keeps a step of
+// 10^-decimals (per tag, 0.001 by default) unless a 32-sample block spans
+// more than 32768 steps, then that block's step coarsens. |value| is clamped
+// to SAMPLE_VALUE_LIMIT_STEPS (10^6 units at 3 decimals); clamped samples are counted. A
+// per-tag override set with setSampleTagConfig() is kept in NVS and wins over
+// what the source registers with.
+
+constexpr int SAMPLE_TAG_MAX_LEN = 24; // including the terminator
+constexpr int SAMPLE_DEFAULT_DECIMALS = 3;
+constexpr int SAMPLE_MIN_DECIMALS = -3;
+constexpr int SAMPLE_MAX_DECIMALS = 6;
+constexpr int32_t SAMPLE_VALUE_LIMIT_STEPS = 1000000000;
+
+enum SampleRetention : uint8_t {
+    SAMPLE_RETAIN_RAM = 0,
+    SAMPLE_RETAIN_RTC,
+    SAMPLE_RETAIN_NVS
+};
+
+enum SampleTagKind : uint8_t {
+    SAMPLE_TAG_VALUE = 0, // calibrated value only
+    SAMPLE_TAG_ADC        // also raw ADC code and smoothed counts (AI pins)
+};
+
+// Statistics of the newest `count` samples; the calibrated value also gets
+// min/max/stddev. Sums come from per-block prefix sums (two block scans at
+// most), min/max from a segment tree over the blocks in O(log n), stddev
+// from per-block Welford moments merged over the window's blocks.
+// avg_raw/avg_smoothed are NAN for value tags.
+struct SampleWindowStats {
+    int count = 0;
+    int clamped = 0;            // samples pinned at the tag's range limit
+    float avg_raw = 0.0f;
+    float avg_smoothed = 0.0f;
+    float avg_value = 0.0f;
+    float min_value = 0.0f;
+    float max_value = 0.0f;
+    float stddev_value = 0.0f;
+};
+
+struct SampleTagInfo {
+    char tag[SAMPLE_TAG_MAX_LEN] = "";
+    SampleTagKind kind = SAMPLE_TAG_VALUE;
+    SampleRetention retention = SAMPLE_RETAIN_RAM;
+    int capacity = 0;
+    bool default_capacity = true; // follows the store default
+    bool mirrored = false;        // holds an RTC mirror slot
+    int count = 0;
+    int decimals = SAMPLE_DEFAULT_DECIMALS;
+    uint32_t clamped = 0;         // samples clamped since registration
+};
+
+// Initialize the store with the default per-tag capacity and restore the RTC
+// mirror (after power-on: the last NVS checkpoint). The first `totalSensors`
+// AI pins are registered as AI1..; every tag gets its restored samples back
+// when it is registered.
 void initSampleStore(int totalSensors, int samplesPerSensor);
 
+// Register a tag; an existing tag keeps its window and returns its handle
+// (re-quantized when `decimals` changed). capacity <= 0 follows the store
+// default; `decimals` (SAMPLE_MIN_DECIMALS..SAMPLE_MAX_DECIMALS) sets the
+// value step and so the range. Returns -1 when the name is invalid, all
+// SAMPLE_STORE_MAX_TAGS are taken or the heap is short.
+int registerSampleTag(const char *tag, SampleTagKind kind, int capacity = 0,
+                      SampleRetention retention = SAMPLE_RETAIN_NVS,
+                      int decimals = SAMPLE_DEFAULT_DECIMALS);
+// Drop a tag, its window and its RTC mirror slot
+void unregisterSampleTag(int handle);
+int findSampleTag(const char *tag);
+
+// Add a sample to a tag; non-finite values are ignored
+void addTagSample(int handle, float value);
+void addTagSample(int handle, int raw, float smoothed, float value);
+
+// Window over the most recent samples of a tag (up to maxSamples, <= 0 = the
+// whole window). Returns false when the tag has no samples.
+bool getTagWindowStats(int handle, int maxSamples, SampleWindowStats &out);
+
+// Handles run 0..SAMPLE_STORE_MAX_TAGS-1; false for a free handle
+bool getSampleTagInfo(int handle, SampleTagInfo &out);
+
+// Persist a per-tag override (capacity 0 = store default) and apply it at
+// once when the tag is registered. False when the capacity could not be
+// allocated or no RTC slot was left (the override is kept either way).
+bool setSampleTagConfig(const char *tag, int capacity, SampleRetention retention);
+
+const char *sampleRetentionName(SampleRetention retention);
+bool parseSampleRetention(const String &name, SampleRetention &out);
+
+// ---- AI pin API: pin i is tag "AI<i+1>" ----
+
 // Add a sample for a sensor (raw ADC, smoothed value, voltage-like value)
 void addSample(int sensorIndex, int raw, float smoothed, float volt);
 
+bool getWindowStats(int sensorIndex, int maxSamples, SampleWindowStats &out);
+
 // Get averaged values for a sensor. Returns true if sample exists.
 bool getAverages(int sensorIndex, float &avgRaw, float &avgSmoothed, float &avgVolt);
 
@@ -21,16 +119,23 @@ bool getRecentAverage(int sensorIndex, int maxSamples, float &avgRaw, float &avg
 // Get number of samples currently stored for sensor
 int getSampleCount(int sensorIndex);
 
+// Write the mirrored samples of nvs-retention tags to NVS if they changed
+// since the last checkpoint. Runs every SAMPLE_STORE_CHECKPOINT_MS and from
+// the restart shutdown hook.
+bool checkpointSampleStore();
+
 // Deinitialize / free resources (optional)
 void deinitSampleStore();
 
-// Return configured per-sensor sample capacity
+// Return the default per-tag sample capacity
 int getSampleCapacity();
 
-// Resize per-sensor sample capacity at runtime (reinitializes buffers)
+// Resize the default capacity at runtime (1..SAMPLE_STORE_MAX_CAPACITY); tags
+// following the default are resized with it. A tag keeps its current window
+// when the heap cannot hold the new one.
 void resizeSampleStore(int samplesPerSensor);
 
-// Clear all per-sensor sample buffers and reset indexes (does not change capacity)
+// Clear every tag's window and mirror (does not change capacities)
 void clearSampleStore();
 
 #endif // SAMPLE_STORE_H
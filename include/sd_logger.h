@@ -3,28 +3,59 @@
 
 #include <Arduino.h>
 #include <SD.h>
+#include <vector>
+#include "config.h"
+#include "sensor_snapshot.h"
 
 // Function prototypes for SD card logging
 void setupSdLogger();
 void logSensorDataToSd(String data);
+// One datalog record: `csvRow` appended to the hourly CSV partition, or
+// `snap` encoded into the binary log when the log format is
+// SD_LOG_FORMAT_BIN. Every CSV partition starts with a header line matching
+// the row.
+void logSensorRecord(const SensorSnapshot &snap, const String &csvRow);
 
 // Pending notifications on SD (JSON lines). Append per-second payloads and flush every N minutes.
 bool appendPendingNotification(const String &jsonLine);
 bool flushPendingNotifications();
-String readPendingNotifications(int maxLines = -1);
+// Up to `maxLines` lines (-1 = all), cut at a line boundary after `maxBytes`;
+// `truncated` tells whether lines were left out for the byte cap
+String readPendingNotifications(int maxLines = -1, size_t maxBytes = PENDING_PREVIEW_MAX_BYTES,
+                                bool *truncated = nullptr);
 bool clearPendingNotifications();
 size_t countPendingNotifications();
 size_t pendingNotificationsFileSize();
 
 // Error log helpers
 void logErrorToSd(const String &msg);
-String readErrorLog(int maxLines = -1); // maxLines=-1 => return whole file
-void clearErrorLog();
+// False when the SD writer was busy (nothing removed; try again)
+bool clearErrorLog();
+
+// Error log partitions, oldest first, copied into a chunked response buffer
+// by read(); stops after `maxLines` lines (-1 = all)
+class ErrorLogStream {
+public:
+    explicit ErrorLogStream(int maxLines = -1);
+    ~ErrorLogStream();
+    size_t read(uint8_t *buffer, size_t maxLen);
+
+private:
+    std::vector<uint32_t> hours;
+    size_t next = 0;
+    File file;
+    int linesLeft;
+};
 
 // Enable/disable SD logging at runtime
 void setSdEnabled(bool enabled);
 bool getSdEnabled();
 
+// Datalog format (SD_LOG_FORMAT_CSV / SD_LOG_FORMAT_BIN), persisted in NVS
+void setSdLogFormat(int format);
+int getSdLogFormat();
+const char *sdLogFormatName(int format);
+
 // Extern declaration for global variable
 extern bool sdCardFound;
 
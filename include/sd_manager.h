@@ -14,10 +14,12 @@ void sdManagerLoop();
 float readSensor(int sensorPin);
 bool logToSD(const String &csvLine);
 
-// Try upload a batch of recent rows (last N minutes) to cloud; returns true on success
+// Upload the rows logged since the last accepted upload, read forward from a
+// (partition hour, byte offset) cursor kept in NVS, in bounded batches
+// (SD_UPLOAD_*). The cursor moves only after a 2xx; returns true on success
 bool uploadBatchToCloud();
 
-// Utility: get SD log path
+// Utility: get SD log directory (rows go to hourly /logs/YYYY/MM/DD-HH.sns partitions)
 const char* sdLogPath();
 
 // Configure upload endpoint (HTTP POST)
@@ -0,0 +1,98 @@
+#ifndef SD_WRITER_H
+#define SD_WRITER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+// Background SD writer. Producers (loop(), the acquisition task, web
+// handlers) append records to a lock-free RAM ring and return at once; one
+// task drains the ring into per-file block buffers and appends them through
+// file handles that stay open. A file is written when its buffer completes a
+// SD_WRITER_BLOCK_BYTES block of the file (so writes stay block-aligned), or
+// when its oldest buffered byte is SD_WRITER_FLUSH_MS old; the directory
+// entry/FAT are committed (fsync) at most every SD_WRITER_SYNC_MS.
+//
+// The datalog, error log and sensor log are split into hourly partitions
+// under /logs (log_partition.h): the writer opens the partition of the
+// current hour, starts it with the file's header line and appends a sparse
+// index entry every LOG_INDEX_EVERY records. The outbound queue is split
+// into segments (outbound_queue.h) and written to the one last selected
+// with sdWriterSetSegment().
+//
+// Binary log blocks take a second path (sdWriterWriteBlock): whole blocks
+// written in place at a fixed offset of a preallocated file.
+//
+// When the task is not running (card missing at boot, no heap) appends fall
+// back to a synchronous open/append/close.
+
+enum SdWriterFile : uint8_t {
+    SD_FILE_DATALOG = 0, // /logs/YYYY/MM/DD-HH.csv
+    SD_FILE_PENDING,     // /outq/NNNNNNNN.seg (outbound queue)
+    SD_FILE_ERRORLOG,    // /logs/YYYY/MM/DD-HH.log
+    SD_FILE_SENSORLOG,   // /logs/YYYY/MM/DD-HH.sns (sd_manager)
+    SD_FILE_COUNT
+};
+
+// sdWriterSync() bit of the block file written by sdWriterWriteBlock()
+constexpr uint32_t SD_SYNC_BLOCKS = 1UL << SD_FILE_COUNT;
+constexpr uint32_t SD_FILE_ALL = (SD_SYNC_BLOCKS << 1) - 1;
+constexpr int SD_WRITER_PATH_LEN = 40;
+
+struct SdWriterStats {
+    bool running = false;
+    uint32_t queue_bytes = 0;      // ring bytes waiting for the writer
+    uint32_t queue_records = 0;
+    uint32_t queue_capacity = 0;
+    uint32_t max_queue_bytes = 0;
+    uint32_t staged_bytes = 0;     // drained into block buffers, not written yet
+    uint32_t records = 0;          // accepted into the ring
+    uint32_t dropped = 0;          // ring full or record too long
+    uint32_t dropped_bytes = 0;    // lost to failed opens/writes
+    uint32_t write_errors = 0;
+    uint32_t writes = 0;
+    uint32_t bytes_written = 0;
+    uint32_t syncs = 0;
+    uint32_t last_write_us = 0;    // one write() call
+    uint32_t max_write_us = 0;
+    uint32_t avg_write_us = 0;
+    uint32_t max_sync_us = 0;      // one fsync
+};
+
+// Start the writer task (after the card is mounted). False when the ring or
+// the task could not be created; appends then stay synchronous.
+bool startSdWriter();
+bool isSdWriterRunning();
+
+// Queue `len` bytes plus a newline for `file`. False when the record was
+// dropped (queue full, longer than a quarter of the ring) or, in the
+// synchronous fallback, could not be written.
+bool sdWriterAppendLine(SdWriterFile file, const char *data, size_t len);
+bool sdWriterAppendLine(SdWriterFile file, const String &line);
+
+// Header line of a partitioned file: written at the start of every new
+// partition, and once more before the next record when it changes
+bool sdWriterSetHeader(SdWriterFile file, const String &line);
+
+// Segment file that the records of `file` queued after this call go to
+// (segmented files only; 1 and up)
+bool sdWriterSetSegment(SdWriterFile file, uint32_t segment);
+
+// Queue a write of `len` bytes at `offset` of `path`. A file shorter than
+// `extendTo` is first extended to it with one seek past the end, so its
+// clusters are allocated in one pass (contiguous on an unfragmented card)
+// and the block writes that follow never touch the FAT. `*busy` is set here
+// and cleared by the writer once `data` may be reused. One block file is
+// kept open at a time. False (and `*busy` left clear) when the queue is full.
+bool sdWriterWriteBlock(const char *path, uint32_t offset, const uint8_t *data, uint32_t len,
+                        uint32_t extendTo, std::atomic<bool> *busy);
+
+// Write everything queued for the files in `fileMask` so far and fsync them;
+// `close` also closes their handles (before a remove/truncate). Blocks the
+// caller up to `timeoutMs`; false on timeout.
+bool sdWriterSync(uint32_t fileMask, bool close = false, uint32_t timeoutMs = SD_WRITER_SYNC_TIMEOUT_MS);
+
+SdWriterStats getSdWriterStats();
+void resetSdWriterStats();
+
+#endif // SD_WRITER_H
@@ -0,0 +1,63 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "sensor_snapshot.h"
+
+// Streaming health diagnostics for the analog channels. The acquisition task
+// feeds every fresh sample; each update is O(1) (Welford mean/variance over a
+// block of HEALTH_WINDOW_SAMPLES, a flatline anchor, range and spike checks),
+// so the RTU reports its own sensor faults instead of the server mining raw
+// history. The resulting codes land in the snapshot (AiSnapshot/AdsSnapshot
+// `health`) and from there in /api/sensors/readings and notifications.
+
+// Channel index: AI1..AI3 then ADS0, ADS1
+constexpr int HEALTH_MAX_CHANNELS = SNAPSHOT_MAX_AI + SNAPSHOT_MAX_ADS;
+
+inline int healthChannelAi(int i) { return i; }
+inline int healthChannelAds(int ch) { return SNAPSHOT_MAX_AI + ch; }
+
+// Status codes (bitmask)
+#define HEALTH_STUCK      0x01 // raw code unchanged for HEALTH_STUCK_MS
+#define HEALTH_NOISY      0x02 // block stddev above HEALTH_NOISE_BAR
+#define HEALTH_SPIKES     0x04 // more than HEALTH_SPIKE_MAX_PER_BLOCK outliers in a block
+#define HEALTH_OPEN_LOOP  0x08 // 4-20 mA loop below HEALTH_LOOP_MIN_MA (broken wire)
+#define HEALTH_OVER_RANGE 0x10 // 4-20 mA loop above HEALTH_LOOP_MAX_MA (short)
+#define HEALTH_SATURATED  0x20 // converter pinned at full scale
+
+// Codes that make the reading itself untrustworthy (status "fault")
+#define HEALTH_FAULT_MASK (HEALTH_STUCK | HEALTH_OPEN_LOOP | HEALTH_OVER_RANGE)
+// Codes that flag a usable but degraded signal (status "degraded")
+#define HEALTH_DEGRADED_MASK (HEALTH_NOISY | HEALTH_SPIKES)
+
+struct SensorHealthStats {
+    uint16_t codes = 0;
+    uint32_t samples = 0;        // fed since boot / reset
+    float mean = NAN;            // last completed block
+    float stddev = NAN;          // last completed block
+    uint32_t spikes = 0;         // since boot / reset
+    uint16_t block_spikes = 0;   // in the last completed block
+    uint32_t flat_ms = 0;        // time the raw code has not moved
+    float loop_ma = NAN;         // ADS only
+};
+
+// Feed one fresh sample. `value` is the engineering value (bar), `rawCode`
+// the converter code used for flatline detection, `loopMa` the loop current
+// (NAN for 0-10 V inputs). Returns the channel's current codes.
+// Called only by the thread that owns acquisition.
+uint16_t updateSensorHealth(int channel, float value, int32_t rawCode, float loopMa,
+                            bool saturated, int64_t sampleUs);
+
+bool getSensorHealth(int channel, SensorHealthStats &out);
+// Clear statistics and codes on the next update of every channel
+void resetSensorHealth();
+
+// Map health codes to snapshot status flags
+uint8_t healthStatusFlags(uint16_t codes);
+// Append the names of the set codes ("stuck", "noisy", ...) to `out`
+void healthCodesToJson(uint16_t codes, JsonArray out);
+
+#endif // SENSOR_HEALTH_H
@@ -0,0 +1,110 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <Arduino.h>
+
+// Upper bounds for the per-cycle channel arrays (AI1..AI3, ADS A0/A1)
+#define SNAPSHOT_MAX_AI 3
+#define SNAPSHOT_MAX_ADS 2
+#define SNAPSHOT_MAX_DI 4
+
+// An ADS conversion older than this is reported as stale
+#define SNAPSHOT_ADS_STALE_US 1000000LL
+
+// Per-channel status bits (0 = ok)
+#define SENSOR_FLAG_DISABLED    0x01 // channel switched off in sensor settings
+#define SENSOR_FLAG_SATURATED   0x02 // input pinned at full scale
+#define SENSOR_FLAG_STALE       0x04 // no fresh conversion this cycle; values repeat the last one
+#define SENSOR_FLAG_UNAVAILABLE 0x08 // converter not detected
+#define SENSOR_FLAG_FAULT       0x10 // health: stuck, open loop or over-range
+#define SENSOR_FLAG_DEGRADED    0x20 // health: noisy or spiky
+
+// 0-10 V input. Instant values come from this cycle's conversion; the window
+// values average the sample store and fall back to the instant values when
+// the store is still empty. Engineering units are derived from the window.
+struct AiSnapshot {
+    uint8_t flags = 0;
+    int64_t sample_us = 0;    // scheduled (deadline) time of the last sample, esp_timer clock
+    int raw = 0;              // latest single conversion
+    float smoothed = 0.0f;    // decimated ADC counts
+    float value = 0.0f;       // calibrated value (getSmoothedVoltagePressure)
+    int mv_raw = 0;
+    int mv_smoothed = 0;
+    int avg_raw = 0;
+    float avg_smoothed = 0.0f;
+    float avg_value = 0.0f;
+    int window_samples = 0;
+    float window_min = NAN;    // calibrated value over the window
+    float window_max = NAN;
+    float window_stddev = NAN;
+    float voltage_raw = 0.0f;  // V, from avg_raw
+    float voltage = 0.0f;      // V, from avg_smoothed
+    float pressure_raw = 0.0f; // bar, linear calibration on avg_raw
+    float pressure = 0.0f;     // bar, linear calibration on avg_smoothed
+    uint16_t health = 0;       // HEALTH_* codes (sensor_health.h)
+};
+
+// 4-20 mA input on the ADS1115
+struct AdsSnapshot {
+    uint8_t flags = 0;
+    int16_t raw = 0;
+    int64_t sample_us = 0;     // esp_timer time of the conversion
+    float mv = 0.0f;
+    float ma_raw = 0.0f;       // current from this conversion alone
+    float ma = 0.0f;           // median + EMA filtered current
+    float tp_scale = 0.0f;     // mV per mA
+    float voltage_raw = 0.0f;  // V, from mv
+    float voltage = 0.0f;      // V, from ma * tp_scale
+    float pressure_raw = 0.0f; // bar
+    float pressure = 0.0f;     // bar
+    float depth_mm = 0.0f;
+    uint16_t health = 0;       // HEALTH_* codes (sensor_health.h)
+};
+
+// DI1..DI4 hardware pulse counter
+struct DiSnapshot {
+    uint8_t flags = 0;
+    int64_t sample_us = 0;      // scheduled (deadline) time of the counter read
+    uint64_t count = 0;         // pulses since reset
+    float total = 0.0f;         // count * units_per_pulse
+    float rate_hz = 0.0f;
+    float rate_per_hour = 0.0f; // units per hour
+};
+
+// Latest value of every channel. Published by the acquisition task each time
+// one or more channels are sampled (channels run at their own rates) and copied
+// out by value; consumers never touch the hardware. `record_seq` advances on
+// the record cadence that drives the SD log and pending notifications.
+struct SensorSnapshot {
+    uint32_t seq = 0;          // 0 until the first cycle has been published
+    uint32_t record_seq = 0;
+    int64_t mono_us = 0;       // scheduled time of the job batch (esp_timer clock)
+    uint32_t millis_at = 0;    // millis() when published
+    int num_ai = 0;
+    int num_ads = 0;
+    int num_di = 0;
+    AiSnapshot ai[SNAPSHOT_MAX_AI];
+    AdsSnapshot ads[SNAPSHOT_MAX_ADS];
+    DiSnapshot di[SNAPSHOT_MAX_DI];
+};
+
+// Publish a completed snapshot; assigns and returns its sequence number.
+uint32_t publishSensorSnapshot(SensorSnapshot &snap);
+
+// Copy the latest snapshot. Returns false until the first one is published.
+bool getSensorSnapshot(SensorSnapshot &out);
+uint32_t getSensorSnapshotSeq();
+
+// Snapshots that advanced `record_seq` are also queued (at most
+// SNAPSHOT_RECORD_QUEUE_LEN), so a busy loop() still gets every record.
+// Pops the oldest; false when none is waiting.
+bool takeRecordSnapshot(SensorSnapshot &out);
+// Records pushed out of a full queue before loop() took them
+uint32_t getRecordSnapshotDrops();
+void resetRecordSnapshotDrops();
+
+// Map status flags to the strings used in JSON payloads
+// ("ok", "disabled", "unavailable", "fault", "alert", "stale", "degraded")
+const char *sensorStatusString(uint8_t flags);
+
+#endif // SENSOR_SNAPSHOT_H
@@ -2,9 +2,14 @@
 #define VOLTAGE_PRESSURE_SENSOR_H
 
 #include <Arduino.h>
+#include "filter_pipeline.h"
 
 // Function to convert ADC value to voltage
 float convert010V(int adc, int channelIndex = 0);
+// Table-driven conversions of a (possibly fractional, e.g. smoothed) ADC code:
+// corrected 0..10 V, and calibrated pressure. Interpolates between codes.
+float adcCodeToVoltage(float code, int channelIndex);
+float adcCodeToPressure(float code, int channelIndex);
 void setVoltageLinearCalibration(float scale, float offset);
 void getVoltageLinearCalibration(float &scale, float &offset);
 
@@ -35,11 +40,14 @@ void setupVoltagePressureSensor();
 // Initialize ADC characterization (esp_adc_cal) for accurate mV conversion
 void initAdcCalibration();
 
-// Function to update voltage pressure sensor reading for a specific sensor (to be called in loop)
-void updateVoltagePressureSensor(int pinIndex);
+// Function to update voltage pressure sensor reading for a specific sensor (to be called in loop).
+// Returns false when no fresh conversion was available and the previous reading was kept.
+bool updateVoltagePressureSensor(int pinIndex);
 
 // Accessor to get the raw smoothed ADC value for a specific sensor
 float getSmoothedADC(int pinIndex);
+// Last single raw conversion taken by updateVoltagePressureSensor() (no new ADC read)
+int getLastRawADC(int pinIndex);
 // Returns true if the pin has been saturated recently (consecutive full-scale reads)
 bool isPinSaturated(int pinIndex);
 
@@ -47,6 +55,27 @@ bool isPinSaturated(int pinIndex);
 int getAdcNumSamples();
 void setAdcNumSamples(int n);
 
+// Filter pipeline applied to each averaged reading of a pin (empty = none),
+// persisted in adc_cfg "filt_<i>". Applied by the next update of that pin.
+bool setAdcFilterPipeline(int pinIndex, const FilterPipelineConfig &config);
+FilterPipelineConfig getAdcFilterPipeline(int pinIndex);
+
+// Single raw conversion for a sensor. In DMA mode this is the latest conversion
+// from the background scan (no blocking read); otherwise it falls back to analogRead().
+int readVoltageSensorRaw(int pinIndex);
+
+// Capture mode (ADC_MODE_DMA or ADC_MODE_ONESHOT from config.h), persisted in NVS.
+// setAdcCaptureMode() returns false only for an invalid mode. The switch is
+// staged and made by the sampling path before its next AI reading; if DMA
+// fails to start, readings continue through analogRead() and
+// isAdcDmaRunning() stays false.
+int getAdcCaptureMode();
+bool setAdcCaptureMode(int mode);
+bool isAdcDmaRunning();
+// Conversions folded into the most recent reading of a pin, and driver ring overflows
+uint32_t getAdcDmaWindowSamples(int pinIndex);
+uint32_t getAdcDmaOverflows();
+
 // Divider scale helpers
 float getAdcDividerScale(int index);
 void setAdcDividerScale(int index, float scale);
@@ -17,6 +17,8 @@ extern AsyncEventSource *eventSourceSensors;
 // SSE helpers
 void pushSseDebugMessage(const char *event, const String &payload);
 void pushSensorsSnapshotEvent();
+// Priority event ("alarm") on /api/sse/sensors, sent immediately
+void pushSensorsAlarmEvent(const String &payload);
 void flagSensorsSnapshotUpdate();
 void serviceSensorsSnapshotUpdates();
 void ensureSensorSseRegistered(AsyncWebServer *server);
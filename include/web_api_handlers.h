@@ -9,4 +9,19 @@ void registerSystemHandlers(AsyncWebServer *server);
 // Register sensor and calibration related handlers (sensors, calibration, adc, ads)
 void registerSensorHandlers(AsyncWebServer *server);
 
+// Register local alarm rule handlers (/api/rules)
+void registerRuleHandlers(AsyncWebServer *server);
+
+// Register burst capture handlers (/api/capture)
+void registerCaptureHandlers(AsyncWebServer *server);
+
+// Register trend history handlers (/api/history)
+void registerHistoryHandlers(AsyncWebServer *server);
+
+// Register tag-keyed sample window handlers (/api/samples)
+void registerSampleHandlers(AsyncWebServer *server);
+
+// Register datalog export handlers (/api/logs)
+void registerLogHandlers(AsyncWebServer *server);
+
 #endif // WEB_API_HANDLERS_H
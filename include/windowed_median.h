@@ -0,0 +1,158 @@
+#ifndef WINDOWED_MEDIAN_H
+#define WINDOWED_MEDIAN_H
+
+#include <stdint.h>
+
+// Sliding-window median over the last `window` samples (window <= N) with
+// O(log n) insert/evict and no allocation. Samples live in a ring of slots;
+// the lower half sits in a max-heap and the upper half in a min-heap, and each
+// slot remembers its heap position so the oldest sample can be evicted
+// directly. median() returns sorted[n / 2] (the upper median for even n),
+// matching the sort-based filter it replaces.
+//
+// Header-only and free of Arduino dependencies so it can be reused for any
+// channel type and built on the host (see docs/windowed_median_bench.cpp).
+// Not thread-safe.
+template <typename T, int N>
+class WindowedMedian {
+public:
+    WindowedMedian() { reset(); }
+
+    // Change the window length (clamped to 1..N); clears the samples.
+    void setWindow(int window) {
+        if (window < 1) window = 1;
+        if (window > N) window = N;
+        window_ = window;
+        reset();
+    }
+
+    int window() const { return window_; }
+    int size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    void reset() {
+        head_ = 0;
+        count_ = 0;
+        lowSize_ = 0;
+        highSize_ = 0;
+    }
+
+    // Add a sample, evicting the oldest once the window is full.
+    void push(T value) {
+        int slot = head_;
+        if (count_ == window_) {
+            remove(slot);
+        } else {
+            count_++;
+        }
+        values_[slot] = value;
+        insert(slot);
+        head_ = (head_ + 1) % window_;
+    }
+
+    // Median of the samples in the window; T() when empty.
+    T median() const {
+        if (highSize_ == 0) return T();
+        return values_[high_[0]];
+    }
+
+private:
+    // Heap membership per slot
+    enum : uint8_t { IN_LOW = 0, IN_HIGH = 1 };
+
+    // Max-heap for the lower half, min-heap for the upper half
+    bool before(uint8_t heap, int a, int b) const {
+        return heap == IN_LOW ? values_[a] > values_[b] : values_[a] < values_[b];
+    }
+
+    int *heapArray(uint8_t heap) { return heap == IN_LOW ? low_ : high_; }
+    int &heapSize(uint8_t heap) { return heap == IN_LOW ? lowSize_ : highSize_; }
+
+    void place(uint8_t heap, int pos, int slot) {
+        heapArray(heap)[pos] = slot;
+        which_[slot] = heap;
+        pos_[slot] = pos;
+    }
+
+    void siftUp(uint8_t heap, int pos) {
+        int *h = heapArray(heap);
+        int slot = h[pos];
+        while (pos > 0) {
+            int parent = (pos - 1) / 2;
+            if (!before(heap, slot, h[parent])) break;
+            place(heap, pos, h[parent]);
+            pos = parent;
+        }
+        place(heap, pos, slot);
+    }
+
+    void siftDown(uint8_t heap, int pos) {
+        int *h = heapArray(heap);
+        int size = heapSize(heap);
+        int slot = h[pos];
+        for (;;) {
+            int child = 2 * pos + 1;
+            if (child >= size) break;
+            if (child + 1 < size && before(heap, h[child + 1], h[child])) child++;
+            if (!before(heap, h[child], slot)) break;
+            place(heap, pos, h[child]);
+            pos = child;
+        }
+        place(heap, pos, slot);
+    }
+
+    void pushHeap(uint8_t heap, int slot) {
+        int pos = heapSize(heap)++;
+        place(heap, pos, slot);
+        siftUp(heap, pos);
+    }
+
+    int popHeap(uint8_t heap) {
+        int *h = heapArray(heap);
+        int top = h[0];
+        int last = --heapSize(heap);
+        if (last > 0) {
+            place(heap, 0, h[last]);
+            siftDown(heap, 0);
+        }
+        return top;
+    }
+
+    void remove(int slot) {
+        uint8_t heap = which_[slot];
+        int *h = heapArray(heap);
+        int pos = pos_[slot];
+        int last = --heapSize(heap);
+        if (pos != last) {
+            // Fill the hole with the last element and restore heap order
+            int moved = h[last];
+            place(heap, pos, moved);
+            siftUp(heap, pos);
+            siftDown(heap, pos_[moved]);
+        }
+    }
+
+    void insert(int slot) {
+        if (highSize_ > 0 && values_[slot] < values_[high_[0]]) {
+            pushHeap(IN_LOW, slot);
+        } else {
+            pushHeap(IN_HIGH, slot);
+        }
+        // Keep highSize_ == lowSize_ or lowSize_ + 1 so high_[0] is sorted[n / 2]
+        while (lowSize_ > highSize_) pushHeap(IN_HIGH, popHeap(IN_LOW));
+        while (highSize_ > lowSize_ + 1) pushHeap(IN_LOW, popHeap(IN_HIGH));
+    }
+
+    T values_[N];
+    int low_[N];
+    int high_[N];
+    int pos_[N];
+    uint8_t which_[N];
+    int lowSize_ = 0;
+    int highSize_ = 0;
+    int head_ = 0;
+    int count_ = 0;
+    int window_ = N;
+};
+
+#endif // WINDOWED_MEDIAN_H
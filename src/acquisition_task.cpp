@@ -0,0 +1,414 @@
+#include "acquisition_task.h"
+#include "voltage_pressure_sensor.h"
+#include "current_pressure_sensor.h"
+#include "sample_store.h"
+#include "sensors_config.h"
+#include "sensor_calibration_types.h"
+#include "pulse_counter.h"
+#include "alarm_rules.h"
+#include "sensor_health.h"
+#include "report_filter.h"
+#include "storage_helpers.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace {
+
+const char *const JOB_TAGS[ACQ_JOB_COUNT] = {"AI1", "AI2", "AI3", "ADS0", "ADS1", "DI", "RECORD"};
+
+TaskHandle_t acqTaskHandle = nullptr;
+esp_timer_handle_t acqTimer = nullptr;
+portMUX_TYPE acqMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Owned by the acquisition task (or by loop() while the task is not running)
+JobScheduler acqScheduler;
+int jobIds[ACQ_JOB_COUNT] = {-1, -1, -1, -1, -1, -1, -1};
+SensorSnapshot working;
+
+// Period changes requested from other tasks, applied by the acquisition task
+bool pendingChange[ACQ_JOB_COUNT] = {false};
+uint32_t pendingPeriodMs[ACQ_JOB_COUNT] = {0};
+uint32_t pendingPhaseMs[ACQ_JOB_COUNT] = {0};
+
+// Copies of the scheduler's per-job counters for readers on other tasks
+JobInfo jobInfoCopy[ACQ_JOB_COUNT];
+
+// Sample-store handles of the ADS and DI tags (AI pins use the index API)
+int adsSampleTags[SNAPSHOT_MAX_ADS] = {-1, -1};
+int diSampleTags[SNAPSHOT_MAX_DI] = {-1, -1, -1, -1};
+
+AcquisitionStats stats;
+uint64_t jitterSumUs = 0;
+uint32_t skippedTotal = 0;
+uint32_t skippedAtReset = 0;
+
+void sampleAiChannel(int i, int64_t nowUs) {
+    if (i >= working.num_ai) return;
+    AiSnapshot &ai = working.ai[i];
+    ai.flags = 0;
+    ai.sample_us = nowUs;
+    if (!updateVoltagePressureSensor(i)) ai.flags |= SENSOR_FLAG_STALE;
+    ai.raw = getLastRawADC(i);
+    ai.smoothed = getSmoothedADC(i);
+    ai.value = getSmoothedVoltagePressure(i);
+    ai.mv_raw = adcRawToMv(ai.raw);
+    ai.mv_smoothed = adcRawToMv((int)round(ai.smoothed));
+    // Persist the sample into in-memory store for later averaging
+    if (!(ai.flags & SENSOR_FLAG_STALE)) addSample(i, ai.raw, ai.smoothed, ai.value);
+
+    SampleWindowStats window;
+    if (getWindowStats(i, 0, window)) {
+        ai.avg_raw = (int)round(window.avg_raw);
+        ai.avg_smoothed = window.avg_smoothed;
+        ai.avg_value = window.avg_value;
+        ai.window_samples = window.count;
+        ai.window_min = window.min_value;
+        ai.window_max = window.max_value;
+        ai.window_stddev = window.stddev_value;
+    } else {
+        ai.avg_raw = ai.raw;
+        ai.avg_smoothed = ai.smoothed;
+        ai.avg_value = ai.value;
+        ai.window_samples = 0;
+        ai.window_min = ai.window_max = ai.window_stddev = NAN;
+    }
+    if (isPinSaturated(i)) {
+        ai.flags |= SENSOR_FLAG_SATURATED;
+    } else if (ai.avg_raw == 4095) {
+        // A lone full-scale spike is not saturation; report the filtered level
+        ai.avg_raw = (int)round(ai.avg_smoothed);
+    }
+    if (!getSensorEnabled(i)) ai.flags |= SENSOR_FLAG_DISABLED;
+
+    SensorCalibration cal = getCalibrationForPin(i);
+    float smoothedCounts = round(ai.avg_smoothed);
+    ai.voltage_raw = convert010V(ai.avg_raw, i);
+    ai.voltage = convert010V((int)smoothedCounts, i);
+    ai.pressure_raw = (ai.avg_raw * cal.scale) + cal.offset;
+    ai.pressure = (smoothedCounts * cal.scale) + cal.offset;
+
+    // Health follows fresh conversions only; a stale cycle keeps the last codes.
+    // A disabled pin (often unwired, sitting at code 0) is not diagnosed.
+    if (ai.flags & SENSOR_FLAG_DISABLED) {
+        ai.health = 0;
+    } else if (!(ai.flags & SENSOR_FLAG_STALE)) {
+        float instant = (ai.raw * cal.scale) + cal.offset;
+        ai.health = updateSensorHealth(healthChannelAi(i), instant, ai.raw, NAN,
+                                       ai.flags & SENSOR_FLAG_SATURATED, nowUs);
+    }
+    ai.flags |= healthStatusFlags(ai.health);
+}
+
+void sampleAdsChannel(int ch) {
+    if (ch >= working.num_ads) return;
+    AdsSnapshot &ads = working.ads[ch];
+    ads.flags = 0;
+    if (!isAdsAvailable()) {
+        ads.flags |= SENSOR_FLAG_UNAVAILABLE;
+        return;
+    }
+    // RAM copy of the channel's NVS settings; no flash access on this path
+    AdsChannelConfig cfg = getAdsChannelConfig(ch);
+    // readAdsMa() serves the engine cache and advances the median/EMA filter
+    // exactly once per job run; nothing else may call it.
+    ads.ma = readAdsMa(ch, cfg);
+    int16_t cachedRaw = 0;
+    int64_t cachedUs = 0;
+    if (getAdsCachedRaw(ch, cachedRaw, cachedUs)) {
+        ads.raw = cachedRaw;
+        ads.sample_us = cachedUs;
+        if (esp_timer_get_time() - cachedUs > SNAPSHOT_ADS_STALE_US) ads.flags |= SENSOR_FLAG_STALE;
+    } else {
+        ads.raw = readAdsRaw(ch);
+        ads.sample_us = esp_timer_get_time();
+    }
+    ads.mv = adsRawToMv(ads.raw);
+    float maRaw = adsMvToMa(cfg, ads.mv);
+    ads.ma_raw = isnan(maRaw) ? 0.0f : maRaw;
+    if (!cfg.enabled) ads.flags |= SENSOR_FLAG_DISABLED;
+    ads.tp_scale = cfg.tp_scale;
+    ads.voltage_raw = ads.mv / 1000.0f;
+    ads.voltage = (ads.ma * ads.tp_scale) / 1000.0f;
+    ads.pressure_raw = (ads.voltage_raw / 10.0f) * DEFAULT_RANGE_BAR;
+    ads.pressure = (ads.voltage / 10.0f) * DEFAULT_RANGE_BAR;
+    ads.depth_mm = computeDepthMm(ads.ma, DEFAULT_CURRENT_INIT_MA, DEFAULT_RANGE_MM, DEFAULT_DENSITY_WATER);
+
+    if (ads.flags & SENSOR_FLAG_DISABLED) {
+        ads.health = 0;
+    } else if (!(ads.flags & SENSOR_FLAG_STALE)) {
+        // Loop limits judge this conversion's unfiltered current, so a broken
+        // wire shows at once; NAN (no shunt / tp_scale) skips them
+        bool saturated = ads.raw >= 32767 || ads.raw <= -32768;
+        ads.health = updateSensorHealth(healthChannelAds(ch), ads.pressure_raw, ads.raw, maRaw,
+                                        saturated, ads.sample_us);
+    }
+    if (!(ads.flags & SENSOR_FLAG_STALE)) addTagSample(adsSampleTags[ch], ads.pressure);
+    ads.flags |= healthStatusFlags(ads.health);
+}
+
+// Rates use the actual read time (counts accrue until then); the snapshot is
+// stamped with the deadline so DI samples sit on the job grid like AI ones
+void samplePulseInputs(int64_t sampleUs, int64_t nowUs) {
+    samplePulseCounters(nowUs);
+    for (int i = 0; i < working.num_di; ++i) {
+        DiSnapshot &di = working.di[i];
+        PulseCounterReading r;
+        getPulseCounterReading(i, r);
+        di.flags = r.enabled ? 0 : SENSOR_FLAG_DISABLED;
+        di.sample_us = sampleUs;
+        di.count = r.count;
+        di.total = r.total;
+        di.rate_hz = r.rate_hz;
+        di.rate_per_hour = r.rate_per_hour;
+        if (r.enabled) addTagSample(diSampleTags[i], r.rate_hz);
+    }
+}
+
+// JobFn trampolines; ctx carries the channel index. Samples are stamped with
+// the job deadline so wake-up latency does not leak into the time axis; the
+// latency itself is tracked as jitter / JobInfo::last_late_us.
+void aiJob(void *ctx, int64_t dueUs) {
+    sampleAiChannel((int)(intptr_t)ctx, dueUs);
+}
+
+void adsJob(void *ctx, int64_t) {
+    sampleAdsChannel((int)(intptr_t)ctx);
+}
+
+void diJob(void *, int64_t dueUs) {
+    samplePulseInputs(dueUs, esp_timer_get_time());
+}
+
+void recordJob(void *, int64_t) {
+    working.record_seq++;
+}
+
+void initWorkingSnapshot() {
+    working = SensorSnapshot();
+    working.num_ai = min(getNumVoltageSensors(), SNAPSHOT_MAX_AI);
+    working.num_ads = SNAPSHOT_MAX_ADS;
+    working.num_di = min(getNumPulseCounters(), SNAPSHOT_MAX_DI);
+    for (int ch = 0; ch < working.num_ads; ++ch) {
+        adsSampleTags[ch] = registerSampleTag(reportTagName(reportTagAds(ch)), SAMPLE_TAG_VALUE);
+    }
+    for (int i = 0; i < working.num_di; ++i) {
+        diSampleTags[i] = registerSampleTag(reportTagName(reportTagDi(i)), SAMPLE_TAG_VALUE);
+    }
+}
+
+String periodKey(int job) {
+    return String("p_") + JOB_TAGS[job];
+}
+
+String phaseKey(int job) {
+    return String("ph_") + JOB_TAGS[job];
+}
+
+void buildSchedule(uint32_t defaultPeriodMs, int64_t nowUs) {
+    acqScheduler.clear();
+    for (int job = 0; job < ACQ_JOB_COUNT; ++job) {
+        jobIds[job] = -1;
+        bool isAi = job <= ACQ_JOB_AI3;
+        if (isAi && job - ACQ_JOB_AI1 >= working.num_ai) continue;
+        uint32_t period = (uint32_t)loadULongFromNVSns("sched", periodKey(job).c_str(), defaultPeriodMs);
+        uint32_t phase = (uint32_t)loadULongFromNVSns("sched", phaseKey(job).c_str(), 0);
+        if (period == 0) period = defaultPeriodMs;
+        JobFn fn;
+        void *ctx;
+        if (isAi) {
+            fn = aiJob;
+            ctx = (void *)(intptr_t)(job - ACQ_JOB_AI1);
+        } else if (job == ACQ_JOB_RECORD) {
+            fn = recordJob;
+            ctx = nullptr;
+        } else if (job == ACQ_JOB_DI) {
+            fn = diJob;
+            ctx = nullptr;
+        } else {
+            fn = adsJob;
+            ctx = (void *)(intptr_t)(job - ACQ_JOB_ADS0);
+        }
+        jobIds[job] = acqScheduler.add(JOB_TAGS[job], period, phase, fn, ctx, nowUs);
+    }
+}
+
+void applyPendingChanges(int64_t nowUs) {
+    for (int job = 0; job < ACQ_JOB_COUNT; ++job) {
+        portENTER_CRITICAL(&acqMux);
+        bool change = pendingChange[job];
+        uint32_t period = pendingPeriodMs[job];
+        uint32_t phase = pendingPhaseMs[job];
+        pendingChange[job] = false;
+        portEXIT_CRITICAL(&acqMux);
+        if (change) acqScheduler.setPeriod(jobIds[job], period, phase, nowUs);
+    }
+}
+
+void publishJobInfo() {
+    JobInfo infos[ACQ_JOB_COUNT];
+    uint32_t skipped = 0;
+    for (int job = 0; job < ACQ_JOB_COUNT; ++job) {
+        if (!acqScheduler.getInfo(jobIds[job], infos[job])) infos[job] = JobInfo();
+        skipped += infos[job].skipped;
+    }
+    uint32_t minPeriodUs = acqScheduler.minPeriodMs() * 1000UL;
+    portENTER_CRITICAL(&acqMux);
+    for (int job = 0; job < ACQ_JOB_COUNT; ++job) jobInfoCopy[job] = infos[job];
+    skippedTotal = skipped;
+    stats.missed_ticks = skipped - skippedAtReset;
+    stats.period_us = minPeriodUs;
+    portEXIT_CRITICAL(&acqMux);
+}
+
+// esp_timer callback: runs in the esp_timer task, so only wake the acquisition task
+void onAcquisitionDeadline(void *) {
+    if (acqTaskHandle) xTaskNotifyGive(acqTaskHandle);
+}
+
+void acquisitionTask(void *) {
+    for (;;) {
+        applyPendingChanges(esp_timer_get_time());
+        int64_t dueUs = acqScheduler.nextDueUs();
+        int64_t waitUs = dueUs - esp_timer_get_time();
+        if (waitUs > 0) {
+            // Sleep until the earliest deadline; a config change wakes us early
+            esp_timer_stop(acqTimer);
+            esp_timer_start_once(acqTimer, (uint64_t)waitUs);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (esp_timer_get_time() < dueUs) continue;
+        }
+
+        int64_t wakeUs = esp_timer_get_time();
+        int32_t jitter = (int32_t)(wakeUs - dueUs);
+        working.mono_us = dueUs;
+        acqScheduler.runDue(wakeUs);
+        publishSensorSnapshot(working);
+        evaluateAlarmRules(working);
+
+        int64_t endUs = esp_timer_get_time();
+        uint32_t cycleUs = (uint32_t)(endUs - wakeUs);
+        bool overrun = acqScheduler.nextDueUs() < endUs;
+        publishJobInfo();
+        portENTER_CRITICAL(&acqMux);
+        stats.cycles++;
+        stats.last_jitter_us = jitter;
+        if (jitter > stats.max_jitter_us) stats.max_jitter_us = jitter;
+        jitterSumUs += (uint32_t)(jitter < 0 ? -jitter : jitter);
+        stats.last_cycle_us = cycleUs;
+        if (cycleUs > stats.max_cycle_us) stats.max_cycle_us = cycleUs;
+        if (overrun) stats.overruns++;
+        portEXIT_CRITICAL(&acqMux);
+    }
+}
+
+} // namespace
+
+bool startAcquisitionTask(uint32_t periodMs) {
+    if (acqTaskHandle) return true;
+    if (periodMs == 0) periodMs = SENSOR_READ_INTERVAL;
+
+    esp_timer_create_args_t args = {};
+    args.callback = &onAcquisitionDeadline;
+    args.name = "acq_deadline";
+    if (esp_timer_create(&args, &acqTimer) != ESP_OK) {
+        Serial.println("[ACQ] Failed to create acquisition timer");
+        return false;
+    }
+
+    initWorkingSnapshot();
+    buildSchedule(periodMs, esp_timer_get_time());
+    publishJobInfo();
+
+    BaseType_t ok = xTaskCreatePinnedToCore(acquisitionTask, "acq", ACQ_TASK_STACK, nullptr,
+                                            ACQ_TASK_PRIORITY, &acqTaskHandle, ACQ_TASK_CORE);
+    if (ok != pdPASS) {
+        acqTaskHandle = nullptr;
+        esp_timer_delete(acqTimer);
+        acqTimer = nullptr;
+        Serial.println("[ACQ] Failed to create acquisition task");
+        return false;
+    }
+    portENTER_CRITICAL(&acqMux);
+    stats.running = true;
+    portEXIT_CRITICAL(&acqMux);
+    Serial.printf("[ACQ] Acquisition task started on core %d, %u jobs, default period %lu ms\n",
+                  ACQ_TASK_CORE, (unsigned)acqScheduler.size(), (unsigned long)periodMs);
+    return true;
+}
+
+bool isAcquisitionRunning() {
+    return acqTaskHandle != nullptr;
+}
+
+void runAcquisitionCycle(int64_t sampleTimeUs) {
+    if (working.num_ai == 0 && working.num_ads == 0) initWorkingSnapshot();
+    working.mono_us = sampleTimeUs;
+    for (int i = 0; i < working.num_ai; ++i) sampleAiChannel(i, sampleTimeUs);
+    for (int ch = 0; ch < working.num_ads; ++ch) sampleAdsChannel(ch);
+    samplePulseInputs(sampleTimeUs, sampleTimeUs);
+    working.record_seq++;
+    publishSensorSnapshot(working);
+    evaluateAlarmRules(working);
+    portENTER_CRITICAL(&acqMux);
+    stats.cycles++;
+    portEXIT_CRITICAL(&acqMux);
+}
+
+const char *getAcquisitionJobTag(int job) {
+    if (job < 0 || job >= ACQ_JOB_COUNT) return "";
+    return JOB_TAGS[job];
+}
+
+int findAcquisitionJob(const String &tag) {
+    for (int job = 0; job < ACQ_JOB_COUNT; ++job) {
+        if (tag.equalsIgnoreCase(JOB_TAGS[job])) return job;
+    }
+    return -1;
+}
+
+bool setAcquisitionJobPeriod(int job, uint32_t periodMs, uint32_t phaseMs) {
+    if (job < 0 || job >= ACQ_JOB_COUNT || periodMs == 0) return false;
+    // The loop() fallback samples everything every cycle; nothing would apply it
+    if (!acqTaskHandle) return false;
+    saveULongToNVSns("sched", periodKey(job).c_str(), periodMs);
+    saveULongToNVSns("sched", phaseKey(job).c_str(), phaseMs);
+    portENTER_CRITICAL(&acqMux);
+    pendingPeriodMs[job] = periodMs;
+    pendingPhaseMs[job] = phaseMs;
+    pendingChange[job] = true;
+    portEXIT_CRITICAL(&acqMux);
+    xTaskNotifyGive(acqTaskHandle);
+    return true;
+}
+
+bool getAcquisitionJobInfo(int job, JobInfo &out) {
+    if (job < 0 || job >= ACQ_JOB_COUNT) return false;
+    portENTER_CRITICAL(&acqMux);
+    out = jobInfoCopy[job];
+    portEXIT_CRITICAL(&acqMux);
+    return out.name != nullptr;
+}
+
+AcquisitionStats getAcquisitionStats() {
+    portENTER_CRITICAL(&acqMux);
+    AcquisitionStats out = stats;
+    uint32_t jitterCycles = stats.cycles;
+    uint64_t jitterSum = jitterSumUs;
+    portEXIT_CRITICAL(&acqMux);
+    out.avg_jitter_us = jitterCycles > 0 ? (uint32_t)(jitterSum / jitterCycles) : 0;
+    return out;
+}
+
+void resetAcquisitionStats() {
+    portENTER_CRITICAL(&acqMux);
+    bool running = stats.running;
+    uint32_t period = stats.period_us;
+    stats = AcquisitionStats();
+    stats.running = running;
+    stats.period_us = period;
+    jitterSumUs = 0;
+    skippedAtReset = skippedTotal;
+    portEXIT_CRITICAL(&acqMux);
+}
@@ -0,0 +1,452 @@
+#include "alarm_rules.h"
+#include "pins_config.h"
+#include "storage_helpers.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <math.h>
+
+namespace {
+
+const int OUTPUT_PINS[ALARM_NUM_OUTPUTS] = {DO1_PIN, DO2_PIN, DO3_PIN, DO4_PIN};
+
+struct SourceSpec {
+    AlarmRuleSource source;
+    const char *prefix;
+    int firstIndex; // number in the first tag (AI1, ADS0, DI1)
+    int channels;
+    const char *fields[4];
+};
+
+const SourceSpec SOURCE_SPECS[] = {
+    {ALARM_SRC_AI, "AI", 1, SNAPSHOT_MAX_AI, {"pressure", "voltage", nullptr, nullptr}},
+    {ALARM_SRC_ADS, "ADS", 0, SNAPSHOT_MAX_ADS, {"pressure", "current", "depth", "voltage"}},
+    {ALARM_SRC_DI, "DI", 1, SNAPSHOT_MAX_DI, {"rate", "rate_per_hour", "total", "count"}},
+};
+
+const char *const OP_NAMES[] = {"above", "below", "rise_rate", "fall_rate"};
+
+// Per-rule runtime state, owned by the evaluating task
+struct RuleState {
+    bool active = false;
+    bool pending = false;       // condition result waiting out the debounce
+    int64_t pendingSinceUs = 0;
+    int64_t lastSampleUs = 0;
+    float lastValue = NAN;
+};
+
+portMUX_TYPE rulesMux = portMUX_INITIALIZER_UNLOCKED;
+QueueHandle_t eventQueue = nullptr;
+
+// Rule set written by the web task; picked up by the evaluator
+AlarmRuleConfig staged[ALARM_MAX_RULES];
+int stagedCount = 0;
+bool stagedDirty = false;
+bool statsResetRequested = false;
+
+// Evaluator-owned copies
+AlarmRuleConfig rules[ALARM_MAX_RULES];
+int ruleCount = 0;
+RuleState states[ALARM_MAX_RULES];
+AlarmRuleStatus statusWork[ALARM_MAX_RULES];
+uint8_t outputMask = 0;
+
+// Published for readers
+AlarmRuleStatus statusCopy[ALARM_MAX_RULES];
+AlarmEngineStats engineStats;
+
+const SourceSpec &specFor(AlarmRuleSource source) {
+    return SOURCE_SPECS[source];
+}
+
+bool parseTag(const String &tag, AlarmRuleSource &source, uint8_t &channel) {
+    for (const SourceSpec &spec : SOURCE_SPECS) {
+        size_t len = strlen(spec.prefix);
+        if (tag.length() != len + 1 || !tag.substring(0, len).equalsIgnoreCase(spec.prefix)) continue;
+        int n = tag.charAt(len) - '0' - spec.firstIndex;
+        if (n < 0 || n >= spec.channels) return false;
+        source = spec.source;
+        channel = (uint8_t)n;
+        return true;
+    }
+    return false;
+}
+
+String tagFor(const AlarmRuleConfig &rule) {
+    const SourceSpec &spec = specFor(rule.source);
+    return String(spec.prefix) + String(rule.channel + spec.firstIndex);
+}
+
+// Value a rule watches, or NAN when the channel has no usable reading
+float ruleValue(const AlarmRuleConfig &rule, const SensorSnapshot &snap, int64_t &sampleUs) {
+    const uint8_t unusable = SENSOR_FLAG_DISABLED | SENSOR_FLAG_UNAVAILABLE;
+    switch (rule.source) {
+        case ALARM_SRC_AI: {
+            if (rule.channel >= snap.num_ai) return NAN;
+            const AiSnapshot &ai = snap.ai[rule.channel];
+            if (ai.flags & unusable) return NAN;
+            sampleUs = ai.sample_us;
+            return rule.field == 1 ? ai.voltage : ai.pressure;
+        }
+        case ALARM_SRC_ADS: {
+            if (rule.channel >= snap.num_ads) return NAN;
+            const AdsSnapshot &ads = snap.ads[rule.channel];
+            if (ads.flags & unusable) return NAN;
+            sampleUs = ads.sample_us;
+            switch (rule.field) {
+                case 1: return ads.ma;
+                case 2: return ads.depth_mm;
+                case 3: return ads.voltage;
+                default: return ads.pressure;
+            }
+        }
+        case ALARM_SRC_DI: {
+            if (rule.channel >= snap.num_di) return NAN;
+            const DiSnapshot &di = snap.di[rule.channel];
+            if (di.flags & unusable) return NAN;
+            sampleUs = di.sample_us;
+            switch (rule.field) {
+                case 1: return di.rate_per_hour;
+                case 2: return di.total;
+                case 3: return (float)di.count;
+                default: return di.rate_hz;
+            }
+        }
+    }
+    return NAN;
+}
+
+// Threshold test with hysteresis: entering needs the threshold to be
+// crossed, leaving needs the value to come back by more than the band
+bool conditionHolds(const AlarmRuleConfig &rule, bool active, float x) {
+    switch (rule.op) {
+        case ALARM_OP_ABOVE:
+        case ALARM_OP_RISE_RATE:
+            return active ? x >= rule.threshold - rule.hysteresis : x > rule.threshold;
+        case ALARM_OP_BELOW:
+            return active ? x <= rule.threshold + rule.hysteresis : x < rule.threshold;
+        case ALARM_OP_FALL_RATE:
+            // threshold is a positive rate of decrease
+            return active ? -x >= rule.threshold - rule.hysteresis : -x > rule.threshold;
+    }
+    return false;
+}
+
+void writeOutputs(uint8_t mask) {
+    for (int i = 0; i < ALARM_NUM_OUTPUTS; ++i) {
+        bool on = mask & (1 << i);
+        if (on != (bool)(outputMask & (1 << i))) digitalWrite(OUTPUT_PINS[i], on ? HIGH : LOW);
+    }
+    outputMask = mask;
+}
+
+void queueEvent(int index, const AlarmRuleConfig &rule, const AlarmRuleStatus &status,
+                const SensorSnapshot &snap) {
+    AlarmEvent ev;
+    ev.rule = (uint8_t)index;
+    memcpy(ev.name, rule.name, sizeof(ev.name));
+    ev.source = rule.source;
+    ev.channel = rule.channel;
+    ev.field = rule.field;
+    ev.op = rule.op;
+    ev.active = status.active;
+    ev.value = status.value;
+    ev.rate = status.rate;
+    ev.threshold = rule.threshold;
+    ev.snapshot_seq = snap.seq;
+    ev.millis_at = status.last_change_ms;
+    bool queued = eventQueue && xQueueSend(eventQueue, &ev, 0) == pdTRUE;
+    portENTER_CRITICAL(&rulesMux);
+    if (queued) engineStats.events_queued++;
+    else engineStats.events_dropped++;
+    portEXIT_CRITICAL(&rulesMux);
+}
+
+void adoptStagedRules() {
+    portENTER_CRITICAL(&rulesMux);
+    ruleCount = stagedCount;
+    memcpy(rules, staged, sizeof(rules));
+    stagedDirty = false;
+    portEXIT_CRITICAL(&rulesMux);
+    for (int i = 0; i < ALARM_MAX_RULES; ++i) {
+        states[i] = RuleState();
+        statusWork[i] = AlarmRuleStatus();
+    }
+}
+
+void loadStoredRules() {
+    String payload = loadStringFromNVSns("rules", "cfg", "");
+    if (payload.length() == 0) return;
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) return;
+    AlarmRuleConfig parsed[ALARM_MAX_RULES];
+    int count = 0;
+    String error;
+    if (!parseAlarmRules(doc.as<JsonVariantConst>(), parsed, count, error)) {
+        Serial.printf("[RULES] Stored rules rejected: %s\n", error.c_str());
+        return;
+    }
+    portENTER_CRITICAL(&rulesMux);
+    memcpy(staged, parsed, sizeof(staged));
+    stagedCount = count;
+    stagedDirty = true;
+    portEXIT_CRITICAL(&rulesMux);
+}
+
+} // namespace
+
+void setupAlarmRules() {
+    for (int i = 0; i < ALARM_NUM_OUTPUTS; ++i) {
+        pinMode(OUTPUT_PINS[i], OUTPUT);
+        digitalWrite(OUTPUT_PINS[i], LOW);
+    }
+    outputMask = 0;
+    if (!eventQueue) eventQueue = xQueueCreate(ALARM_EVENT_QUEUE_LEN, sizeof(AlarmEvent));
+    loadStoredRules();
+    Serial.printf("[RULES] %d alarm rule(s) loaded\n", stagedCount);
+}
+
+void evaluateAlarmRules(const SensorSnapshot &snap) {
+    int64_t startUs = esp_timer_get_time();
+
+    portENTER_CRITICAL(&rulesMux);
+    bool dirty = stagedDirty;
+    bool resetStats = statsResetRequested;
+    statsResetRequested = false;
+    portEXIT_CRITICAL(&rulesMux);
+    if (dirty) adoptStagedRules();
+    if (resetStats) {
+        for (int i = 0; i < ruleCount; ++i) statusWork[i].hits = 0;
+    }
+
+    uint8_t mask = 0;
+    for (int i = 0; i < ruleCount; ++i) {
+        const AlarmRuleConfig &rule = rules[i];
+        RuleState &st = states[i];
+        AlarmRuleStatus &status = statusWork[i];
+        if (!rule.enabled) continue;
+
+        int64_t sampleUs = 0;
+        float value = ruleValue(rule, snap, sampleUs);
+        if (isnan(value)) {
+            // No usable reading: hold the current state
+            if (st.active && rule.output > 0) mask |= 1 << (rule.output - 1);
+            continue;
+        }
+        if (sampleUs != st.lastSampleUs) {
+            if (!isnan(st.lastValue) && st.lastSampleUs > 0 && sampleUs > st.lastSampleUs) {
+                status.rate = (value - st.lastValue) * 1e6f / (float)(sampleUs - st.lastSampleUs);
+            }
+            st.lastValue = value;
+            st.lastSampleUs = sampleUs;
+        }
+        status.value = value;
+
+        bool rateRule = rule.op == ALARM_OP_RISE_RATE || rule.op == ALARM_OP_FALL_RATE;
+        float x = rateRule ? status.rate : value;
+        bool want = isnan(x) ? st.active : conditionHolds(rule, st.active, x);
+
+        if (want == st.active) {
+            st.pending = false;
+        } else {
+            if (!st.pending) {
+                st.pending = true;
+                st.pendingSinceUs = startUs;
+            }
+            if (startUs - st.pendingSinceUs >= (int64_t)rule.debounce_ms * 1000) {
+                st.active = want;
+                st.pending = false;
+                if (want) status.hits++;
+                status.last_change_ms = millis();
+                status.active = st.active;
+                if (rule.notify) queueEvent(i, rule, status, snap);
+            }
+        }
+        status.active = st.active;
+        if (st.active && rule.output > 0) mask |= 1 << (rule.output - 1);
+    }
+    if (mask != outputMask) writeOutputs(mask);
+
+    uint32_t elapsedUs = (uint32_t)(esp_timer_get_time() - startUs);
+    portENTER_CRITICAL(&rulesMux);
+    memcpy(statusCopy, statusWork, sizeof(statusCopy));
+    if (resetStats) engineStats.max_eval_us = 0;
+    engineStats.evaluations++;
+    engineStats.last_eval_us = elapsedUs;
+    if (elapsedUs > engineStats.max_eval_us) engineStats.max_eval_us = elapsedUs;
+    engineStats.outputs = outputMask;
+    portEXIT_CRITICAL(&rulesMux);
+}
+
+bool parseAlarmRules(JsonVariantConst json, AlarmRuleConfig *out, int &count, String &error) {
+    if (!json.is<JsonArrayConst>()) {
+        error = "rules must be an array";
+        return false;
+    }
+    JsonArrayConst arr = json.as<JsonArrayConst>();
+    if (arr.size() > (size_t)ALARM_MAX_RULES) {
+        error = String("At most ") + ALARM_MAX_RULES + " rules";
+        return false;
+    }
+    int n = 0;
+    for (JsonObjectConst obj : arr) {
+        AlarmRuleConfig rule;
+        String where = String("rule ") + n + ": ";
+        String name = obj["name"] | (String("rule") + (n + 1));
+        if (name.length() == 0 || name.length() >= ALARM_NAME_LEN) {
+            error = where + "name must be 1.." + (ALARM_NAME_LEN - 1) + " characters";
+            return false;
+        }
+        strlcpy(rule.name, name.c_str(), sizeof(rule.name));
+        rule.enabled = obj["enabled"] | true;
+
+        String tag = obj["tag"] | "";
+        if (!parseTag(tag, rule.source, rule.channel)) {
+            error = where + "unknown tag '" + tag + "'";
+            return false;
+        }
+        const SourceSpec &spec = specFor(rule.source);
+        if (!obj["field"].isNull()) {
+            String field = obj["field"].as<String>();
+            int found = -1;
+            for (int f = 0; f < 4 && spec.fields[f]; ++f) {
+                if (field.equalsIgnoreCase(spec.fields[f])) found = f;
+            }
+            if (found < 0) {
+                error = where + "field '" + field + "' not available on " + tag;
+                return false;
+            }
+            rule.field = (uint8_t)found;
+        }
+
+        String op = obj["op"] | "above";
+        int opIndex = -1;
+        for (int o = 0; o < 4; ++o) {
+            if (op.equalsIgnoreCase(OP_NAMES[o])) opIndex = o;
+        }
+        if (opIndex < 0) {
+            error = where + "op must be above, below, rise_rate or fall_rate";
+            return false;
+        }
+        rule.op = (AlarmRuleOp)opIndex;
+
+        if (!obj["threshold"].is<float>()) {
+            error = where + "threshold required";
+            return false;
+        }
+        rule.threshold = obj["threshold"].as<float>();
+        rule.hysteresis = obj["hysteresis"] | 0.0f;
+        long debounce = obj["debounce_ms"] | 0L;
+        int output = obj["output"] | 0;
+        if (!isfinite(rule.threshold) || !isfinite(rule.hysteresis) || rule.hysteresis < 0.0f) {
+            error = where + "threshold must be finite and hysteresis >= 0";
+            return false;
+        }
+        if (debounce < 0 || debounce > 3600000L) {
+            error = where + "debounce_ms must be 0..3600000";
+            return false;
+        }
+        if (output < 0 || output > ALARM_NUM_OUTPUTS) {
+            error = where + "output must be 0..4";
+            return false;
+        }
+        rule.debounce_ms = (uint32_t)debounce;
+        rule.output = (uint8_t)output;
+        rule.notify = obj["notify"] | true;
+        out[n++] = rule;
+    }
+    count = n;
+    return true;
+}
+
+void alarmRuleToJson(const AlarmRuleConfig &rule, JsonObject out) {
+    out["name"] = rule.name;
+    out["enabled"] = rule.enabled;
+    out["tag"] = tagFor(rule);
+    out["field"] = specFor(rule.source).fields[rule.field];
+    out["op"] = OP_NAMES[rule.op];
+    out["threshold"] = rule.threshold;
+    out["hysteresis"] = rule.hysteresis;
+    out["debounce_ms"] = rule.debounce_ms;
+    out["output"] = rule.output;
+    out["notify"] = rule.notify;
+}
+
+bool setAlarmRules(const AlarmRuleConfig *newRules, int count) {
+    if (count < 0 || count > ALARM_MAX_RULES) return false;
+    JsonDocument doc;
+    JsonArray arr = doc.to<JsonArray>();
+    for (int i = 0; i < count; ++i) alarmRuleToJson(newRules[i], arr.add<JsonObject>());
+    String payload;
+    serializeJson(doc, payload);
+    saveStringToNVSns("rules", "cfg", payload);
+
+    portENTER_CRITICAL(&rulesMux);
+    for (int i = 0; i < ALARM_MAX_RULES; ++i) staged[i] = i < count ? newRules[i] : AlarmRuleConfig();
+    stagedCount = count;
+    stagedDirty = true;
+    portEXIT_CRITICAL(&rulesMux);
+    return true;
+}
+
+int getAlarmRules(AlarmRuleConfig *out) {
+    portENTER_CRITICAL(&rulesMux);
+    int count = stagedCount;
+    memcpy(out, staged, sizeof(AlarmRuleConfig) * count);
+    portEXIT_CRITICAL(&rulesMux);
+    return count;
+}
+
+bool getAlarmRuleStatus(int index, AlarmRuleStatus &out) {
+    if (index < 0 || index >= ALARM_MAX_RULES) return false;
+    portENTER_CRITICAL(&rulesMux);
+    // Until the evaluator adopts a new rule set the old statuses are stale
+    bool pending = stagedDirty;
+    out = pending ? AlarmRuleStatus() : statusCopy[index];
+    portEXIT_CRITICAL(&rulesMux);
+    return true;
+}
+
+AlarmEngineStats getAlarmEngineStats() {
+    portENTER_CRITICAL(&rulesMux);
+    AlarmEngineStats out = engineStats;
+    portEXIT_CRITICAL(&rulesMux);
+    return out;
+}
+
+void resetAlarmRuleStats() {
+    portENTER_CRITICAL(&rulesMux);
+    statsResetRequested = true;
+    for (int i = 0; i < ALARM_MAX_RULES; ++i) statusCopy[i].hits = 0;
+    engineStats.max_eval_us = 0;
+    portEXIT_CRITICAL(&rulesMux);
+}
+
+bool waitAlarmEvent(AlarmEvent &out, uint32_t timeoutMs) {
+    if (!eventQueue) {
+        vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+        return false;
+    }
+    return xQueueReceive(eventQueue, &out, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+void alarmEventToJson(const AlarmEvent &event, JsonObject out) {
+    const SourceSpec &spec = specFor(event.source);
+    out["rule"] = event.name;
+    out["tag"] = String(spec.prefix) + String(event.channel + spec.firstIndex);
+    out["field"] = spec.fields[event.field];
+    out["op"] = OP_NAMES[event.op];
+    out["state"] = event.active ? "raised" : "cleared";
+    if (!isnan(event.value)) out["value"] = event.value;
+    if (!isnan(event.rate)) out["rate_per_s"] = event.rate;
+    out["threshold"] = event.threshold;
+    out["seq"] = event.snapshot_seq;
+    out["age_ms"] = (uint32_t)(millis() - event.millis_at);
+}
+
+int getAlarmOutputPin(int output) {
+    if (output < 1 || output > ALARM_NUM_OUTPUTS) return -1;
+    return OUTPUT_PINS[output - 1];
+}
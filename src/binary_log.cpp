@@ -0,0 +1,590 @@
+#include "binary_log.h"
+#include "sd_logger.h"
+#include "sd_writer.h"
+
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+namespace {
+
+const uint32_t BLOCK = BINLOG_BLOCK_BYTES;
+const uint32_t PAYLOAD = BINLOG_BLOCK_BYTES - sizeof(BinlogBlockHeader);
+// dt + missing mask + one 64-bit delta per column, all varints
+const int MAX_RECORD_BYTES = 2 * 10 + BINLOG_MAX_COLUMNS * 10;
+const int64_t SCALE[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+const int MAX_DECIMALS = 6;
+
+// ---- Schema ----
+
+// Collects column definitions and/or scaled values in CSV row order
+struct ColumnSink {
+    BinlogColumn *cols;
+    int64_t *values;
+    uint32_t missing;
+    int count;
+    int max;
+
+    void add(const char *prefix, int index, const char *field, int decimals, double v) {
+        if (count >= max) return;
+        if (cols) {
+            memset(&cols[count], 0, sizeof(BinlogColumn));
+            snprintf(cols[count].name, sizeof(cols[count].name), "%s%d.%s", prefix, index, field);
+            cols[count].decimals = (int8_t)decimals;
+        }
+        if (values) {
+            double scaled = v * (double)SCALE[decimals];
+            if (!isfinite(scaled) || fabs(scaled) > 9.0e15) {
+                values[count] = 0;
+                missing |= 1UL << count;
+            } else {
+                values[count] = llround(scaled);
+            }
+        }
+        count++;
+    }
+};
+
+void collectColumns(const SensorSnapshot &snap, ColumnSink &sink) {
+    for (int i = 0; i < snap.num_ai; ++i) {
+        const AiSnapshot &ai = snap.ai[i];
+        sink.add("AI", i + 1, "raw", 0, ai.raw);
+        sink.add("AI", i + 1, "smoothed", 2, ai.smoothed);
+        sink.add("AI", i + 1, "value", 3, ai.value);
+        sink.add("AI", i + 1, "mv_raw", 0, ai.mv_raw);
+        sink.add("AI", i + 1, "mv_smoothed", 0, ai.mv_smoothed);
+    }
+    for (int ch = 0; ch < snap.num_ads; ++ch) {
+        const AdsSnapshot &ads = snap.ads[ch];
+        sink.add("ADS", ch, "raw", 0, ads.raw);
+        sink.add("ADS", ch, "mv", 2, ads.mv);
+        sink.add("ADS", ch, "ma", 3, ads.ma);
+        sink.add("ADS", ch, "depth_mm", 1, ads.depth_mm);
+    }
+    for (int i = 0; i < snap.num_di; ++i) {
+        const DiSnapshot &di = snap.di[i];
+        sink.add("DI", i + 1, "count", 0, (double)di.count);
+        sink.add("DI", i + 1, "rate_hz", 3, di.rate_hz);
+    }
+}
+
+// ---- Encoding ----
+
+uint8_t *putVarint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// False when the varint runs past `end`
+bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &out) {
+    out = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        out |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+int encodeRecord(uint8_t *out, int64_t dtMs, uint32_t missing, const int64_t *values,
+                 const int64_t *prev, int columns) {
+    uint8_t *p = putVarint(out, zigzag(dtMs));
+    p = putVarint(p, missing);
+    for (int c = 0; c < columns; ++c) {
+        if (missing & (1UL << c)) continue;
+        p = putVarint(p, zigzag(values[c] - prev[c]));
+    }
+    return (int)(p - out);
+}
+
+uint32_t headerCrc(BinlogFileHeader &h) {
+    uint32_t saved = h.crc;
+    h.crc = 0;
+    size_t bytes = offsetof(BinlogFileHeader, column) + (size_t)h.columns * sizeof(BinlogColumn);
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&h), bytes);
+    h.crc = saved;
+    return crc;
+}
+
+uint32_t blockCrc(uint8_t *block) {
+    BinlogBlockHeader *h = reinterpret_cast<BinlogBlockHeader *>(block);
+    uint32_t saved = h->crc;
+    h->crc = 0;
+    uint32_t crc = esp_rom_crc32_le(0, block, sizeof(BinlogBlockHeader) + h->used);
+    h->crc = saved;
+    return crc;
+}
+
+bool headerValid(BinlogFileHeader &h) {
+    return h.magic == BINLOG_FILE_MAGIC && h.version == BINLOG_VERSION &&
+           h.block_bytes == BLOCK && h.columns <= BINLOG_MAX_COLUMNS && headerCrc(h) == h.crc;
+}
+
+bool blockValid(uint8_t *block, uint32_t fileId, uint32_t number) {
+    const BinlogBlockHeader *h = reinterpret_cast<const BinlogBlockHeader *>(block);
+    return h->magic == BINLOG_BLOCK_MAGIC && h->file_id == fileId && h->block == number &&
+           h->used <= PAYLOAD && blockCrc(block) == h->crc;
+}
+
+bool readBlock(File &f, uint32_t number, uint8_t *buf) {
+    return f.seek(number * BLOCK) && f.read(buf, BLOCK) == BLOCK;
+}
+
+bool blockAt(File &f, uint32_t number, uint32_t fileId, uint8_t *scratch) {
+    return readBlock(f, number, scratch) && blockValid(scratch, fileId, number);
+}
+
+// Header check without reading the payload
+bool headerAt(File &f, uint32_t number, uint32_t fileId) {
+    BinlogBlockHeader h;
+    return f.seek(number * BLOCK) &&
+           f.read(reinterpret_cast<uint8_t *>(&h), sizeof(h)) == sizeof(h) &&
+           h.magic == BINLOG_BLOCK_MAGIC && h.file_id == fileId && h.block == number;
+}
+
+// Block after the last valid data block of the file. Blocks are written in
+// order, but a torn block or one lost by an older firmware leaves a hole, so
+// validity is not strictly a prefix: a binary search finds the end of the
+// valid prefix in log2(blocks) reads, then the block headers after it are
+// scanned to the file end (normally the unwritten rest of the last
+// preallocated extent) and only matching ones are CRC-checked.
+uint32_t findEndBlock(File &f, uint32_t fileId, uint8_t *scratch) {
+    uint32_t lo = 1;
+    uint32_t total = (uint32_t)(f.size() / BLOCK);
+    uint32_t hi = total > 1 ? total : 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (blockAt(f, mid, fileId, scratch)) lo = mid + 1;
+        else hi = mid;
+    }
+    uint32_t end = lo;
+    for (uint32_t n = lo + 1; n < total; ++n) {
+        if (headerAt(f, n, fileId) && blockAt(f, n, fileId, scratch)) end = n + 1;
+    }
+    return end;
+}
+
+// First valid block in [from, to), or `to`
+uint32_t nextValidBlock(File &f, uint32_t fileId, uint8_t *scratch, uint32_t from, uint32_t to) {
+    for (; from < to; ++from) {
+        if (blockAt(f, from, fileId, scratch)) return from;
+    }
+    return to;
+}
+
+// ---- Writer state (loop() appends, HTTP export flushes) ----
+
+struct OpenLog {
+    bool ready = false;
+    BinlogFileHeader hdr;
+    uint32_t block = 0;      // number of the block being filled
+    uint8_t *work = nullptr; // block being filled
+    uint8_t *out = nullptr;  // copy handed to the SD writer
+    uint16_t records = 0;
+    uint32_t used = 0;
+    int64_t firstMs = 0;
+    int64_t lastMs = 0;
+    int64_t prev[BINLOG_MAX_COLUMNS];
+    bool dirty = false;      // records not handed to the writer yet
+    bool sealed = false;     // full, but the writer has not taken it yet
+};
+
+OpenLog openLog;
+BinlogWriterStats writerStats;
+std::atomic<bool> outBusy(false);
+SemaphoreHandle_t binlogMutex = NULL;
+
+class BinlogLock {
+public:
+    explicit BinlogLock(TickType_t wait = portMAX_DELAY)
+        : held(binlogMutex && xSemaphoreTake(binlogMutex, wait) == pdTRUE) {}
+    ~BinlogLock() { if (held) xSemaphoreGive(binlogMutex); }
+    const bool held;
+    BinlogLock(const BinlogLock&) = delete;
+    BinlogLock& operator=(const BinlogLock&) = delete;
+};
+
+bool allocBuffers() {
+    if (!openLog.work) openLog.work = (uint8_t *)malloc(BLOCK);
+    if (!openLog.out) openLog.out = (uint8_t *)malloc(BLOCK);
+    return openLog.work && openLog.out;
+}
+
+bool waitOut(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (outBusy.load(std::memory_order_acquire)) {
+        if (millis() - start >= timeoutMs) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+// Queue `out` for `number` (0 = header), growing the file in whole extents
+bool submitOut(uint32_t number) {
+    uint32_t end = (number + 1) * BLOCK;
+    uint32_t extendTo = ((end + BINLOG_PREALLOC_BYTES - 1) / BINLOG_PREALLOC_BYTES) * BINLOG_PREALLOC_BYTES;
+    if (extendTo > BINLOG_MAX_FILE_BYTES) extendTo = BINLOG_MAX_FILE_BYTES;
+    return sdWriterWriteBlock(BINLOG_PATH, number * BLOCK, openLog.out, BLOCK, extendTo, &outBusy);
+}
+
+void resetBlock() {
+    memset(openLog.work, 0, BLOCK);
+    memset(openLog.prev, 0, sizeof(openLog.prev));
+    openLog.records = 0;
+    openLog.used = 0;
+    openLog.dirty = false;
+    openLog.sealed = false;
+}
+
+// Seal the open block and hand a copy to the writer; the block stays open.
+// Waits up to `waitMs` for the writer to release the previous copy.
+bool submitBlock(uint32_t waitMs = BINLOG_SUBMIT_WAIT_MS) {
+    BinlogBlockHeader *h = reinterpret_cast<BinlogBlockHeader *>(openLog.work);
+    h->magic = BINLOG_BLOCK_MAGIC;
+    h->file_id = openLog.hdr.file_id;
+    h->block = openLog.block;
+    h->records = openLog.records;
+    h->used = (uint16_t)openLog.used;
+    h->first_ms = openLog.firstMs;
+    h->last_ms = openLog.lastMs;
+    h->crc = blockCrc(openLog.work);
+    if (!waitOut(waitMs)) {
+        writerStats.failed_submits++;
+        return false;
+    }
+    memcpy(openLog.out, openLog.work, BLOCK);
+    if (!submitOut(openLog.block)) {
+        writerStats.failed_submits++;
+        return false;
+    }
+    openLog.dirty = false;
+    return true;
+}
+
+bool layoutMatches(const SensorSnapshot &snap) {
+    return openLog.hdr.layout[0] == snap.num_ai && openLog.hdr.layout[1] == snap.num_ads &&
+           openLog.hdr.layout[2] == snap.num_di;
+}
+
+// Start a new file at BINLOG_PATH (replacing whatever is there)
+bool startFile(const SensorSnapshot &snap) {
+    sdWriterSync(SD_SYNC_BLOCKS, true);
+    if (SD.exists(BINLOG_PATH)) SD.remove(BINLOG_PATH);
+    BinlogFileHeader &h = openLog.hdr;
+    memset(&h, 0, sizeof(h));
+    ColumnSink sink = {h.column, nullptr, 0, 0, BINLOG_MAX_COLUMNS};
+    collectColumns(snap, sink);
+    h.magic = BINLOG_FILE_MAGIC;
+    h.version = BINLOG_VERSION;
+    h.columns = (uint16_t)sink.count;
+    h.block_bytes = BLOCK;
+    h.file_id = esp_random();
+    h.created_ms = logRecordEpochMs(snap);
+    h.layout[0] = (uint8_t)snap.num_ai;
+    h.layout[1] = (uint8_t)snap.num_ads;
+    h.layout[2] = (uint8_t)snap.num_di;
+    h.crc = headerCrc(h);
+    if (!waitOut(BINLOG_SUBMIT_WAIT_MS)) return false;
+    memset(openLog.out, 0, BLOCK);
+    memcpy(openLog.out, &h, sizeof(h));
+    if (!submitOut(0)) return false;
+    openLog.block = 1;
+    resetBlock();
+    openLog.ready = true;
+    Serial.printf("[BINLOG] Started %s (%d columns)\n", BINLOG_PATH, sink.count);
+    return true;
+}
+
+// Keep the current file as BINLOG_PREV_PATH and start a new one
+bool rollFile(const SensorSnapshot &snap) {
+    if (openLog.ready && openLog.dirty && !submitBlock()) writerStats.dropped_records += openLog.records;
+    openLog.ready = false;
+    sdWriterSync(SD_SYNC_BLOCKS, true);
+    if (SD.exists(BINLOG_PREV_PATH)) SD.remove(BINLOG_PREV_PATH);
+    SD.rename(BINLOG_PATH, BINLOG_PREV_PATH);
+    return startFile(snap);
+}
+
+// Resume an existing file after a restart: new records go to the block
+// after the last valid one. False when it is missing, invalid or was
+// written for another channel layout.
+bool resumeFile(const SensorSnapshot &snap, bool &exists) {
+    exists = false;
+    File f = SD.open(BINLOG_PATH, FILE_READ);
+    if (!f) return false;
+    exists = true;
+    BinlogFileHeader &h = openLog.hdr;
+    bool ok = f.read(reinterpret_cast<uint8_t *>(&h), sizeof(h)) == sizeof(h) &&
+              headerValid(h) && layoutMatches(snap);
+    if (ok) {
+        openLog.block = findEndBlock(f, h.file_id, openLog.work);
+        ok = (openLog.block + 1) * BLOCK <= BINLOG_MAX_FILE_BYTES;
+    }
+    f.close();
+    if (!ok) return false;
+    resetBlock();
+    openLog.ready = true;
+    Serial.printf("[BINLOG] Resuming %s at block %lu\n", BINLOG_PATH, (unsigned long)openLog.block);
+    return true;
+}
+
+// Hand the sealed (full) block to the writer and start the next one. On
+// failure the block stays sealed and is submitted again, without waiting,
+// before the next record; a block is never skipped, so the file has no hole.
+bool advanceBlock(const SensorSnapshot &snap, uint32_t waitMs) {
+    openLog.sealed = true;
+    if (openLog.dirty && !submitBlock(waitMs)) return false;
+    openLog.block++;
+    resetBlock();
+    return (openLog.block + 1) * BLOCK <= BINLOG_MAX_FILE_BYTES || rollFile(snap);
+}
+
+void flushOnShutdown() {
+    if (!binlogMutex || xSemaphoreTake(binlogMutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    if (openLog.ready && openLog.dirty) submitBlock();
+    xSemaphoreGive(binlogMutex);
+}
+
+} // namespace
+
+int buildLogSchema(const SensorSnapshot &snap, BinlogColumn *cols, int maxCols) {
+    ColumnSink sink = {cols, nullptr, 0, 0, maxCols};
+    collectColumns(snap, sink);
+    return sink.count;
+}
+
+String logCsvHeader(const SensorSnapshot &snap) {
+    BinlogColumn cols[BINLOG_MAX_COLUMNS];
+    int n = buildLogSchema(snap, cols, BINLOG_MAX_COLUMNS);
+    String line = "timestamp";
+    for (int c = 0; c < n; ++c) {
+        line += ",";
+        line += cols[c].name;
+    }
+    return line;
+}
+
+int64_t logRecordEpochMs(const SensorSnapshot &snap) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t nowMs = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    int64_t ageMs = (esp_timer_get_time() - snap.mono_us) / 1000;
+    return nowMs - (ageMs > 0 ? ageMs : 0);
+}
+
+bool appendBinaryRecord(const SensorSnapshot &snap) {
+    if (binlogMutex == NULL) {
+        binlogMutex = xSemaphoreCreateMutex();
+        esp_register_shutdown_handler(flushOnShutdown);
+    }
+    BinlogLock lock;
+    if (!sdCardFound || !allocBuffers()) return false;
+
+    if (openLog.ready && !layoutMatches(snap)) {
+        if (!rollFile(snap)) return false;
+    } else if (!openLog.ready) {
+        bool exists = false;
+        bool ok = resumeFile(snap, exists);
+        if (!ok) ok = exists ? rollFile(snap) : startFile(snap);
+        if (!ok) return false;
+    }
+
+    // Records that arrive while the writer still holds back a full block
+    // are lost; they are counted rather than leaving a gap in the file
+    if (openLog.sealed && !advanceBlock(snap, 0)) {
+        writerStats.dropped_records++;
+        return false;
+    }
+
+    int64_t values[BINLOG_MAX_COLUMNS];
+    ColumnSink sink = {nullptr, values, 0, 0, (int)openLog.hdr.columns};
+    collectColumns(snap, sink);
+    int64_t ms = logRecordEpochMs(snap);
+    uint8_t rec[MAX_RECORD_BYTES];
+    int len = encodeRecord(rec, openLog.records ? ms - openLog.lastMs : 0, sink.missing, values,
+                           openLog.prev, sink.count);
+    if (openLog.used + len > PAYLOAD) {
+        // Block full: it is final now, start the next one
+        if (!advanceBlock(snap, BINLOG_SUBMIT_WAIT_MS)) {
+            writerStats.dropped_records++;
+            return false;
+        }
+        len = encodeRecord(rec, 0, sink.missing, values, openLog.prev, sink.count);
+    }
+    memcpy(openLog.work + sizeof(BinlogBlockHeader) + openLog.used, rec, len);
+    openLog.used += len;
+    for (int c = 0; c < sink.count; ++c) {
+        if (!(sink.missing & (1UL << c))) openLog.prev[c] = values[c];
+    }
+    if (openLog.records == 0) openLog.firstMs = ms;
+    openLog.lastMs = ms;
+    openLog.records++;
+    openLog.dirty = true;
+    return true;
+}
+
+bool flushBinaryLog(uint32_t timeoutMs) {
+    if (binlogMutex == NULL) return true;
+    {
+        // loop() may hold the lock for a whole rollFile(); don't queue behind it
+        BinlogLock lock(timeoutMs > 0 ? pdMS_TO_TICKS(timeoutMs) : portMAX_DELAY);
+        if (!lock.held) return false;
+        if (openLog.ready && openLog.dirty && !submitBlock(timeoutMs > 0 ? timeoutMs : BINLOG_SUBMIT_WAIT_MS)) {
+            return false;
+        }
+    }
+    return timeoutMs == 0 || sdWriterSync(SD_SYNC_BLOCKS, false, timeoutMs);
+}
+
+BinlogWriterStats getBinlogWriterStats() {
+    BinlogLock lock;
+    BinlogWriterStats out = writerStats;
+    out.block = openLog.ready ? openLog.block : 0;
+    out.sealed = openLog.sealed;
+    return out;
+}
+
+// ---- Reader ----
+
+BinlogReader::~BinlogReader() {
+    close();
+}
+
+bool BinlogReader::open(const char *path) {
+    close();
+    file = SD.open(path, FILE_READ);
+    if (!file) return false;
+    buf = (uint8_t *)malloc(BLOCK);
+    if (!buf || file.read(reinterpret_cast<uint8_t *>(&hdr), sizeof(hdr)) != sizeof(hdr) || !headerValid(hdr)) {
+        close();
+        return false;
+    }
+    blockNo = 0;
+    left = 0;
+    endBlock = 0;
+    return true;
+}
+
+void BinlogReader::close() {
+    if (file) file.close();
+    free(buf);
+    buf = nullptr;
+}
+
+bool BinlogReader::loadBlock(uint32_t number) {
+    if (!endBlock) endBlock = findEndBlock(file, hdr.file_id, buf);
+    // Invalid blocks before the end are holes: skip them
+    number = nextValidBlock(file, hdr.file_id, buf, number, endBlock);
+    if (number >= endBlock) return false;
+    const BinlogBlockHeader *h = reinterpret_cast<const BinlogBlockHeader *>(buf);
+    blockNo = number;
+    pos = sizeof(BinlogBlockHeader);
+    left = h->records;
+    lastMs = h->first_ms;
+    memset(prev, 0, sizeof(prev));
+    return true;
+}
+
+bool BinlogReader::next(int64_t &epochMs, int64_t *values, uint32_t &missing) {
+    if (!buf) return false;
+    for (;;) {
+        if (left == 0) {
+            if (!loadBlock(blockNo + 1)) return false;
+            continue;
+        }
+        const BinlogBlockHeader *h = reinterpret_cast<const BinlogBlockHeader *>(buf);
+        const uint8_t *p = buf + pos;
+        const uint8_t *end = buf + sizeof(BinlogBlockHeader) + h->used;
+        uint64_t v;
+        bool ok = getVarint(p, end, v);
+        int64_t ms = lastMs + unzigzag(v);
+        ok = ok && getVarint(p, end, v);
+        uint32_t mask = (uint32_t)v;
+        for (int c = 0; ok && c < hdr.columns; ++c) {
+            if (mask & (1UL << c)) {
+                values[c] = 0;
+                continue;
+            }
+            ok = getVarint(p, end, v);
+            prev[c] += unzigzag(v);
+            values[c] = prev[c];
+        }
+        if (!ok) {
+            // Malformed payload (CRC matched, so a writer bug): skip the rest
+            left = 0;
+            continue;
+        }
+        pos = (uint32_t)(p - buf);
+        left--;
+        lastMs = ms;
+        epochMs = ms;
+        missing = mask;
+        return true;
+    }
+}
+
+bool BinlogReader::seekTime(int64_t epochMs) {
+    if (!buf) return false;
+    if (!endBlock) endBlock = findEndBlock(file, hdr.file_id, buf);
+    uint32_t lo = 1;
+    uint32_t hi = endBlock;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        // A hole takes the time of the next valid block
+        uint32_t valid = nextValidBlock(file, hdr.file_id, buf, mid, hi);
+        if (valid < hi && reinterpret_cast<const BinlogBlockHeader *>(buf)->last_ms < epochMs) lo = valid + 1;
+        else hi = mid;
+    }
+    // next() loads block `lo`
+    blockNo = lo - 1;
+    left = 0;
+    return true;
+}
+
+uint32_t BinlogReader::validBytes() {
+    if (!buf) return 0;
+    if (!endBlock) endBlock = findEndBlock(file, hdr.file_id, buf);
+    // The search reused the block buffer; reload the current block
+    if (blockNo && left) {
+        uint32_t keepPos = pos, keepLeft = left;
+        int64_t keepMs = lastMs;
+        int64_t keepPrev[BINLOG_MAX_COLUMNS];
+        memcpy(keepPrev, prev, sizeof(prev));
+        if (loadBlock(blockNo)) {
+            pos = keepPos;
+            left = keepLeft;
+            lastMs = keepMs;
+            memcpy(prev, keepPrev, sizeof(prev));
+        }
+    }
+    return endBlock * BLOCK;
+}
+
+void formatBinlogValue(int64_t value, int decimals, char *out, size_t len) {
+    if (decimals <= 0 || decimals > MAX_DECIMALS) {
+        snprintf(out, len, "%lld", (long long)value);
+        return;
+    }
+    uint64_t mag = value < 0 ? (uint64_t)(-value) : (uint64_t)value;
+    uint64_t scale = (uint64_t)SCALE[decimals];
+    snprintf(out, len, "%s%llu.%0*llu", value < 0 ? "-" : "", (unsigned long long)(mag / scale),
+             decimals, (unsigned long long)(mag % scale));
+}
@@ -0,0 +1,492 @@
+#include "burst_capture.h"
+#include "voltage_pressure_sensor.h"
+#include "current_pressure_sensor.h"
+#include "sd_logger.h"
+
+#include <SD.h>
+#include <math.h>
+#include <time.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace {
+
+const char *const SOURCE_NAMES[CAPTURE_SRC_COUNT] = {"AI1", "AI2", "AI3", "ADS0", "ADS1"};
+
+// One ring per recorded source. Written only by that source's producer task
+// while the capture is armed/triggered; read by loop() once it is complete.
+struct CaptureChannel {
+    bool used = false;
+    int16_t *ring = nullptr;
+    uint32_t capacity = 0;      // preSamples + postSamples + 1
+    uint32_t preSamples = 0;
+    uint32_t postSamples = 0;
+    uint16_t decimate = 1;
+    uint16_t decimCount = 0;
+    uint32_t pushed = 0;        // samples recorded since arming
+    int64_t triggerIndex = -1;  // sample number of the first sample at/after the trigger
+    uint32_t postCollected = 0;
+    bool done = false;
+    int64_t firstUs = 0;
+    int64_t lastUs = 0;
+    float nominalHz = 0.0f;
+    float scale = 0.0f;         // bar per code (linearised)
+    float offset = 0.0f;
+};
+
+CaptureChannel chans[CAPTURE_SRC_COUNT];
+portMUX_TYPE capMux = portMUX_INITIALIZER_UNLOCKED;
+volatile CapturePhase phase = CAPTURE_IDLE;
+int activeFeeders = 0;          // producers inside burstCaptureFeed()
+CaptureConfig activeConfig;
+int64_t triggerUs = 0;
+
+// Trigger compiled to converter codes so producers never convert samples
+int32_t trigCode = 0;
+bool trigWhenCodeAbove = true;
+int32_t trigDeltaCode = 0;      // dP/dt: signed code change over trigWindow samples
+uint32_t trigWindow = 1;
+
+uint32_t capturesSaved = 0;
+char lastFile[48] = "";
+char lastError[96] = "";
+
+void setLastError(const String &msg) {
+    portENTER_CRITICAL(&capMux);
+    strlcpy(lastError, msg.c_str(), sizeof(lastError));
+    portEXIT_CRITICAL(&capMux);
+}
+
+bool isAiSource(int src) {
+    return src <= CAPTURE_SRC_AI3;
+}
+
+// Code range over which the code -> value mapping is monotonic
+void codeRange(int src, int32_t &lo, int32_t &hi) {
+    lo = 0;
+    hi = isAiSource(src) ? 4095 : 32767; // ADS codes below 0 are clamped to 0 mV
+}
+
+// Same conversions as the snapshot's pressure_raw fields
+float codeToValue(int src, int32_t code) {
+    if (isAiSource(src)) return adcCodeToPressure((float)code, src);
+    float mv = adsRawToMv((int16_t)code);
+    return (mv / 1000.0f / 10.0f) * DEFAULT_RANGE_BAR;
+}
+
+// First code in [lo, hi] for which pred holds, for a predicate that switches
+// from false to true once; hi + 1 if it never holds
+template <typename Pred>
+int32_t firstTrue(int32_t lo, int32_t hi, Pred pred) {
+    while (lo <= hi) {
+        int32_t mid = lo + (hi - lo) / 2;
+        if (pred(mid)) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+bool compileTrigger(const CaptureConfig &cfg, String &error) {
+    int src = cfg.trigger_source;
+    int32_t lo, hi;
+    codeRange(src, lo, hi);
+    float vLo = codeToValue(src, lo);
+    float vHi = codeToValue(src, hi);
+    bool increasing = vHi >= vLo;
+    switch (cfg.trigger) {
+        case CAPTURE_TRIG_MANUAL:
+            return true;
+        case CAPTURE_TRIG_ABOVE:
+        case CAPTURE_TRIG_BELOW: {
+            bool above = cfg.trigger == CAPTURE_TRIG_ABOVE;
+            auto hit = [&](int32_t c) {
+                float v = codeToValue(src, c);
+                return above ? v > cfg.level : v < cfg.level;
+            };
+            if (above == increasing) {
+                trigCode = firstTrue(lo, hi, hit);
+                trigWhenCodeAbove = true;
+            } else {
+                trigCode = firstTrue(lo, hi, [&](int32_t c) { return !hit(c); }) - 1;
+                trigWhenCodeAbove = false;
+            }
+            return true;
+        }
+        case CAPTURE_TRIG_DPDT: {
+            float slope = (vHi - vLo) / (float)(hi - lo);
+            if (slope == 0.0f || !isfinite(slope)) {
+                error = "Trigger channel has no usable calibration";
+                return false;
+            }
+            const CaptureChannel &c = chans[src];
+            uint32_t window = (uint32_t)lroundf(cfg.dpdt_window_ms * c.nominalHz / 1000.0f);
+            if (window < 1) window = 1;
+            if (window >= c.capacity) {
+                error = "dpdt_window_ms must be shorter than the capture window";
+                return false;
+            }
+            trigWindow = window;
+            float deltaBar = cfg.level * (float)window / c.nominalHz;
+            int32_t delta = (int32_t)lroundf(deltaBar / slope);
+            if (delta == 0) delta = (deltaBar / slope) >= 0.0f ? 1 : -1;
+            trigDeltaCode = delta;
+            return true;
+        }
+    }
+    error = "Unknown trigger";
+    return false;
+}
+
+bool triggerHit(const CaptureChannel &c, uint32_t n, int16_t code) {
+    switch (activeConfig.trigger) {
+        case CAPTURE_TRIG_MANUAL:
+            return true;
+        case CAPTURE_TRIG_ABOVE:
+        case CAPTURE_TRIG_BELOW:
+            return trigWhenCodeAbove ? code >= trigCode : code <= trigCode;
+        case CAPTURE_TRIG_DPDT: {
+            if (n < trigWindow) return false;
+            int32_t d = (int32_t)code - c.ring[(n - trigWindow) % c.capacity];
+            return trigDeltaCode > 0 ? d >= trigDeltaCode : d <= trigDeltaCode;
+        }
+    }
+    return false;
+}
+
+void waitForFeeders() {
+    for (;;) {
+        portENTER_CRITICAL(&capMux);
+        int feeders = activeFeeders;
+        portEXIT_CRITICAL(&capMux);
+        if (feeders == 0) return;
+        vTaskDelay(1);
+    }
+}
+
+void freeRings() {
+    for (CaptureChannel &c : chans) {
+        if (c.ring) heap_caps_free(c.ring);
+        c = CaptureChannel();
+    }
+}
+
+bool writeCaptureFile() {
+    if (!sdCardFound) {
+        setLastError("SD card not available; capture discarded");
+        return false;
+    }
+    if (!SD.exists(CAPTURE_DIR)) SD.mkdir(CAPTURE_DIR);
+
+    int64_t epochMs = 0;
+    time_t now = time(nullptr);
+    char name[48];
+    if (now > 1600000000) {
+        epochMs = (int64_t)now * 1000 - (esp_timer_get_time() - triggerUs) / 1000;
+        time_t trigSec = (time_t)(epochMs / 1000);
+        struct tm tmv;
+        gmtime_r(&trigSec, &tmv);
+        strftime(name, sizeof(name), CAPTURE_DIR "/cap_%Y%m%d_%H%M%S.bin", &tmv);
+    } else {
+        snprintf(name, sizeof(name), CAPTURE_DIR "/cap_%lu.bin", (unsigned long)millis());
+    }
+
+    File f = SD.open(name, FILE_WRITE);
+    if (!f) {
+        setLastError(String("Failed to create ") + name);
+        return false;
+    }
+
+    CaptureFileHeader hdr = {};
+    memcpy(hdr.magic, "BCAP", 4);
+    hdr.version = 1;
+    for (const CaptureChannel &c : chans) {
+        if (c.used) hdr.channels++;
+    }
+    hdr.pre_ms = activeConfig.pre_ms;
+    hdr.post_ms = activeConfig.post_ms;
+    hdr.trigger_epoch_ms = epochMs;
+    hdr.trigger_type = activeConfig.trigger;
+    hdr.trigger_source = activeConfig.trigger_source;
+    hdr.trigger_level = activeConfig.level;
+    bool ok = f.write((const uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr);
+
+    for (int src = 0; src < CAPTURE_SRC_COUNT && ok; ++src) {
+        const CaptureChannel &c = chans[src];
+        if (!c.used) continue;
+        uint32_t start, end, trigIdx;
+        if (c.triggerIndex >= 0) {
+            uint32_t t = (uint32_t)c.triggerIndex;
+            uint32_t pre = t < c.preSamples ? t : c.preSamples;
+            start = t - pre;
+            end = t + c.postCollected + 1;
+            if (end > c.pushed) end = c.pushed;
+            trigIdx = pre;
+        } else {
+            // Never reached the trigger (producer stalled): keep what the ring holds
+            end = c.pushed;
+            start = end > c.capacity ? end - c.capacity : 0;
+            trigIdx = 0xFFFFFFFF;
+        }
+        CaptureChannelHeader ch = {};
+        ch.source = (uint8_t)src;
+        ch.sample_count = end - start;
+        ch.trigger_index = trigIdx;
+        ch.sample_rate_hz = (c.pushed > 1 && c.lastUs > c.firstUs)
+                                ? (float)((double)(c.pushed - 1) * 1e6 / (double)(c.lastUs - c.firstUs))
+                                : c.nominalHz;
+        ch.scale = c.scale;
+        ch.offset = c.offset;
+        ok = f.write((const uint8_t *)&ch, sizeof(ch)) == sizeof(ch);
+
+        // The window may wrap around the end of the ring
+        uint32_t remaining = end - start;
+        uint32_t idx = start % c.capacity;
+        while (ok && remaining > 0) {
+            uint32_t run = min(remaining, c.capacity - idx);
+            size_t bytes = run * sizeof(int16_t);
+            ok = f.write((const uint8_t *)&c.ring[idx], bytes) == bytes;
+            remaining -= run;
+            idx = 0;
+        }
+    }
+    f.close();
+    if (!ok) {
+        setLastError(String("Write failed: ") + name);
+        return false;
+    }
+    portENTER_CRITICAL(&capMux);
+    strlcpy(lastFile, name, sizeof(lastFile));
+    lastError[0] = '\0';
+    capturesSaved++;
+    portEXIT_CRITICAL(&capMux);
+    Serial.printf("[CAPTURE] Saved %s\n", name);
+    return true;
+}
+
+} // namespace
+
+const char *captureSourceName(CaptureSource source) {
+    return source < CAPTURE_SRC_COUNT ? SOURCE_NAMES[source] : "";
+}
+
+bool armBurstCapture(const CaptureConfig &config, String &error) {
+    if (phase != CAPTURE_IDLE) {
+        error = "A capture is already in progress";
+        return false;
+    }
+    CaptureConfig cfg = config;
+    cfg.channel_mask &= (1 << CAPTURE_SRC_COUNT) - 1;
+    if (cfg.channel_mask == 0) {
+        error = "No channels selected";
+        return false;
+    }
+    if (cfg.post_ms == 0) {
+        error = "post_ms must be > 0";
+        return false;
+    }
+    if (cfg.pre_ms > CAPTURE_MAX_WINDOW_MS || cfg.post_ms > CAPTURE_MAX_WINDOW_MS) {
+        error = String("pre_ms and post_ms must be <= ") + CAPTURE_MAX_WINDOW_MS;
+        return false;
+    }
+    if (cfg.trigger == CAPTURE_TRIG_MANUAL) {
+        for (int src = 0; src < CAPTURE_SRC_COUNT; ++src) {
+            if (cfg.channel_mask & (1 << src)) {
+                cfg.trigger_source = (uint8_t)src;
+                break;
+            }
+        }
+    } else if (cfg.trigger_source >= CAPTURE_SRC_COUNT || !(cfg.channel_mask & (1 << cfg.trigger_source))) {
+        error = "Trigger channel must be one of the captured channels";
+        return false;
+    }
+
+    AdsEngineStatus ads = getAdsEngineStatus();
+    // 64-bit so no channel count x window can wrap past the limit check
+    uint64_t totalBytes = 0;
+    for (int src = 0; src < CAPTURE_SRC_COUNT; ++src) {
+        CaptureChannel &c = chans[src];
+        c = CaptureChannel();
+        if (!(cfg.channel_mask & (1 << src))) continue;
+        float hz;
+        if (isAiSource(src)) {
+            if (src >= getNumVoltageSensors() || !isAdcDmaRunning()) {
+                error = String(SOURCE_NAMES[src]) + ": capture needs the ADC in DMA mode";
+                return false;
+            }
+            float native = (float)ADC_DMA_SAMPLE_FREQ_HZ / getNumVoltageSensors();
+            uint32_t dec = cfg.rate_hz > 0 ? (uint32_t)(native / cfg.rate_hz) : 1;
+            if (dec < 1) dec = 1;
+            if (dec > 1000) dec = 1000;
+            c.decimate = (uint16_t)dec;
+            hz = native / c.decimate;
+        } else {
+            int ch = src - CAPTURE_SRC_ADS0;
+            if (!isAdsAvailable() || !ads.running || ch >= ads.channels) {
+                error = String(SOURCE_NAMES[src]) + ": ADS engine is not scanning this channel";
+                return false;
+            }
+            hz = (float)ads.sps / ads.channels;
+        }
+        c.used = true;
+        c.nominalHz = hz;
+        c.preSamples = (uint32_t)ceilf(cfg.pre_ms * hz / 1000.0f);
+        c.postSamples = (uint32_t)ceilf(cfg.post_ms * hz / 1000.0f);
+        if (c.postSamples < 1) c.postSamples = 1;
+        c.capacity = c.preSamples + c.postSamples + 1;
+        totalBytes += (uint64_t)c.capacity * sizeof(int16_t);
+
+        int32_t lo, hi;
+        codeRange(src, lo, hi);
+        float vLo = codeToValue(src, lo);
+        c.scale = (codeToValue(src, hi) - vLo) / (float)(hi - lo);
+        c.offset = vLo - c.scale * lo;
+    }
+    if (totalBytes > CAPTURE_MAX_BYTES) {
+        error = String("Window needs ") + (uint32_t)totalBytes + " bytes; limit is " + CAPTURE_MAX_BYTES +
+                " (shorten pre/post_ms, lower rate_hz or capture fewer channels)";
+        freeRings();
+        return false;
+    }
+    if (!compileTrigger(cfg, error)) {
+        freeRings();
+        return false;
+    }
+    for (CaptureChannel &c : chans) {
+        if (!c.used) continue;
+        c.ring = (int16_t *)heap_caps_malloc(c.capacity * sizeof(int16_t), MALLOC_CAP_8BIT);
+        if (!c.ring) {
+            error = "Not enough free memory for the capture window";
+            freeRings();
+            return false;
+        }
+    }
+
+    portENTER_CRITICAL(&capMux);
+    activeConfig = cfg;
+    triggerUs = 0;
+    lastError[0] = '\0';
+    phase = CAPTURE_ARMED;
+    portEXIT_CRITICAL(&capMux);
+    Serial.printf("[CAPTURE] Armed: %u bytes, trigger on %s\n", (unsigned)totalBytes, SOURCE_NAMES[cfg.trigger_source]);
+    return true;
+}
+
+bool triggerBurstCapture() {
+    portENTER_CRITICAL(&capMux);
+    bool fired = phase == CAPTURE_ARMED;
+    if (fired) {
+        phase = CAPTURE_TRIGGERED;
+        triggerUs = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&capMux);
+    return fired;
+}
+
+void abortBurstCapture() {
+    portENTER_CRITICAL(&capMux);
+    // A complete capture belongs to loop(), which is writing or about to write it
+    bool recording = phase == CAPTURE_ARMED || phase == CAPTURE_TRIGGERED;
+    if (recording) phase = CAPTURE_IDLE;
+    portEXIT_CRITICAL(&capMux);
+    if (!recording) return;
+    waitForFeeders();
+    freeRings();
+}
+
+CaptureStatus getBurstCaptureStatus() {
+    CaptureStatus st;
+    char file[sizeof(lastFile)];
+    char err[sizeof(lastError)];
+    portENTER_CRITICAL(&capMux);
+    st.phase = phase;
+    st.config = activeConfig;
+    st.captures_saved = capturesSaved;
+    memcpy(file, lastFile, sizeof(file));
+    memcpy(err, lastError, sizeof(err));
+    portEXIT_CRITICAL(&capMux);
+    st.last_file = file;
+    st.last_error = err;
+    return st;
+}
+
+void serviceBurstCapture() {
+    CapturePhase ph = phase;
+    if (ph == CAPTURE_TRIGGERED) {
+        // A stalled producer must not hold the buffers forever
+        int64_t limitUs = (int64_t)activeConfig.post_ms * 1000 + 2000000;
+        if (esp_timer_get_time() - triggerUs > limitUs) {
+            portENTER_CRITICAL(&capMux);
+            if (phase == CAPTURE_TRIGGERED) phase = CAPTURE_COMPLETE;
+            ph = phase;
+            portEXIT_CRITICAL(&capMux);
+        }
+    }
+    if (ph != CAPTURE_COMPLETE) return;
+    waitForFeeders();
+    writeCaptureFile();
+    freeRings();
+    portENTER_CRITICAL(&capMux);
+    phase = CAPTURE_IDLE;
+    portEXIT_CRITICAL(&capMux);
+}
+
+bool burstCaptureActive() {
+    CapturePhase ph = phase;
+    return ph == CAPTURE_ARMED || ph == CAPTURE_TRIGGERED;
+}
+
+void burstCaptureFeed(CaptureSource source, const int16_t *codes, int count) {
+    if (source >= CAPTURE_SRC_COUNT) return;
+    CaptureChannel &c = chans[source];
+    portENTER_CRITICAL(&capMux);
+    CapturePhase ph = phase;
+    bool take = c.used && !c.done && (ph == CAPTURE_ARMED || ph == CAPTURE_TRIGGERED);
+    if (take) activeFeeders++;
+    portEXIT_CRITICAL(&capMux);
+    if (!take) return;
+
+    int64_t nowUs = esp_timer_get_time();
+    bool trigSource = source == activeConfig.trigger_source;
+    for (int i = 0; i < count; ++i) {
+        if (c.decimate > 1) {
+            if (++c.decimCount < c.decimate) continue;
+            c.decimCount = 0;
+        }
+        int16_t code = codes[i];
+        uint32_t n = c.pushed;
+        c.ring[n % c.capacity] = code;
+        c.pushed = n + 1;
+        if (n == 0) c.firstUs = nowUs;
+
+        if (ph == CAPTURE_ARMED) {
+            if (!trigSource || n < c.preSamples || !triggerHit(c, n, code)) continue;
+            portENTER_CRITICAL(&capMux);
+            if (phase == CAPTURE_ARMED) {
+                phase = CAPTURE_TRIGGERED;
+                triggerUs = nowUs;
+            }
+            ph = phase;
+            portEXIT_CRITICAL(&capMux);
+            if (ph == CAPTURE_TRIGGERED) c.triggerIndex = n;
+        } else if (c.triggerIndex < 0) {
+            c.triggerIndex = n;
+        } else if (++c.postCollected >= c.postSamples) {
+            c.done = true;
+            break;
+        }
+    }
+    c.lastUs = nowUs;
+
+    portENTER_CRITICAL(&capMux);
+    activeFeeders--;
+    if (c.done && phase == CAPTURE_TRIGGERED) {
+        bool all = true;
+        for (const CaptureChannel &other : chans) {
+            if (other.used && !other.done) all = false;
+        }
+        if (all) phase = CAPTURE_COMPLETE;
+    }
+    portEXIT_CRITICAL(&capMux);
+}
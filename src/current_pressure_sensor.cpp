@@ -1,28 +1,201 @@
 #include "current_pressure_sensor.h"
 #include "config.h"
+#include "pins_config.h"
 #include <Wire.h>
 #include <Adafruit_ADS1X15.h>
 #include "i2c_helpers.h"
 // Preferences helpers
 #include "calibration_keys.h"
 #include "storage_helpers.h"
+#include "filter_pipeline.h"
+#include "burst_capture.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 static Adafruit_ADS1115 ads; // 16-bit ADC
 static uint8_t adsAddress = 0x48;
 static bool adsInitialized = false;
-// EMA smoothing for ADS channels to reduce jitter from noisy current loop
+// Filtered mA per ADS channel (output of the channel's filter pipeline)
 static float adsSmoothedMa[4] = {0.0f, 0.0f, 0.0f, 0.0f};
 // runtime-configurable smoothing parameters (stored in NVS under "ads_cfg")
 static float adsEmaAlpha = 0.1f; // default smoothing factor
 static int adsNumAvg = 5; // number of readings to median/average (default)
-// Circular buffer for median filter per ADS channel
-static const int ADS_MAX_BUF = 21; // max allowed buffer length
-static int16_t adsBuf[4][ADS_MAX_BUF];
-static int adsBufIdx[4] = {0,0,0,0};
-static int adsBufCount[4] = {0,0,0,0};
+static const int ADS_MAX_BUF = FILTER_MAX_WINDOW; // max allowed median window
+// Per-channel filter chain. Channels without a stored pipeline ("filt_<ch>")
+// use the default median(num_avg) -> ema(ema_alpha).
+static FilterPipeline adsFilter[4];
+static bool adsFilterCustom[4] = {false, false, false, false};
+// RAM copy of the per-channel NVS settings (guarded by adsMutex)
+static AdsChannelConfig adsChannelCfg[4];
+
+static FilterPipelineConfig defaultAdsFilter() {
+    FilterPipelineConfig cfg;
+    cfg.stages[0].type = FILTER_MEDIAN;
+    cfg.stages[0].window = (uint8_t)adsNumAvg;
+    cfg.stages[1].type = FILTER_EMA;
+    cfg.stages[1].a = adsEmaAlpha;
+    cfg.count = 2;
+    return cfg;
+}
+
+// Serializes the median/EMA state between the acquisition task and HTTP handlers.
+static SemaphoreHandle_t adsMutex = NULL;
+// Owns the ADS1115 on the I2C bus: held by the engine for a whole conversion and
+// by single-shot fallback reads.
+static SemaphoreHandle_t adsBusMutex = NULL;
+
+class AdsLock {
+public:
+    AdsLock() { if (adsMutex) xSemaphoreTake(adsMutex, portMAX_DELAY); }
+    ~AdsLock() { if (adsMutex) xSemaphoreGive(adsMutex); }
+    AdsLock(const AdsLock&) = delete;
+    AdsLock& operator=(const AdsLock&) = delete;
+};
+
+class AdsBusLock {
+public:
+    AdsBusLock() { if (adsBusMutex) xSemaphoreTake(adsBusMutex, portMAX_DELAY); }
+    ~AdsBusLock() { if (adsBusMutex) xSemaphoreGive(adsBusMutex); }
+    AdsBusLock(const AdsBusLock&) = delete;
+    AdsBusLock& operator=(const AdsBusLock&) = delete;
+};
+
+// Background conversion engine: one task keeps the ADS1115 in continuous mode,
+// rotates the input mux over A0..A(ADS_ENGINE_CHANNELS-1) and publishes each
+// result into adsCache. readAdsRaw() serves from the cache, so HTTP, SSE and
+// notifier callers never start an I2C conversion themselves.
+struct AdsCacheEntry {
+    int16_t raw = 0;
+    int64_t ts_us = 0;
+    uint32_t conversions = 0;
+    bool valid = false;
+};
+static AdsCacheEntry adsCache[4];
+static portMUX_TYPE adsCacheMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t adsEngineTask = NULL;
+static SemaphoreHandle_t adsRdySem = NULL;
+static volatile int adsEngineSps = DEFAULT_ADS_SPS;
+static volatile bool adsSingleShotUsed = false; // device left continuous mode; engine must rewrite config
+static uint32_t adsEngineTimeouts = 0;
+
+static const uint16_t ADS_MUX_SINGLE[4] = {
+    ADS1X15_REG_CONFIG_MUX_SINGLE_0,
+    ADS1X15_REG_CONFIG_MUX_SINGLE_1,
+    ADS1X15_REG_CONFIG_MUX_SINGLE_2,
+    ADS1X15_REG_CONFIG_MUX_SINGLE_3,
+};
+
+static const int ADS_SPS_STEPS[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+// Round up to the nearest data rate the ADS1115 supports
+static int normalizeAdsSps(int sps) {
+    for (int step : ADS_SPS_STEPS) {
+        if (sps <= step) return step;
+    }
+    return 860;
+}
+
+static uint16_t adsRateBits(int sps) {
+    switch (sps) {
+        case 8: return RATE_ADS1115_8SPS;
+        case 16: return RATE_ADS1115_16SPS;
+        case 32: return RATE_ADS1115_32SPS;
+        case 64: return RATE_ADS1115_64SPS;
+        case 250: return RATE_ADS1115_250SPS;
+        case 475: return RATE_ADS1115_475SPS;
+        case 860: return RATE_ADS1115_860SPS;
+        default: return RATE_ADS1115_128SPS;
+    }
+}
+
+static void IRAM_ATTR onAdsReady() {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(adsRdySem, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+static void adsEngineLoop(void *) {
+    int ch = 0;
+    int activeCh = -1;
+    int activeSps = 0;
+    for (;;) {
+        int sps = adsEngineSps;
+        // Nominal conversion time plus 10% for the internal oscillator tolerance
+        uint32_t convMs = (1100 + sps - 1) / sps + 1;
+        int16_t raw = 0;
+        bool ok = true;
+        {
+            AdsBusLock bus;
+            // Rewriting the config restarts the conversion, so only touch it when
+            // the mux or data rate changes (a single scanned channel never does)
+            if (ch != activeCh || sps != activeSps || adsSingleShotUsed) {
+                ads.setDataRate(adsRateBits(sps));
+                ads.startADCReading(ADS_MUX_SINGLE[ch], /*continuous=*/true);
+                if (adsRdySem) xSemaphoreTake(adsRdySem, 0); // drop a pulse from the previous conversion
+                activeCh = ch;
+                activeSps = sps;
+                adsSingleShotUsed = false;
+            }
+            if (adsRdySem) {
+                ok = xSemaphoreTake(adsRdySem, pdMS_TO_TICKS(convMs * 2)) == pdTRUE;
+            } else {
+                vTaskDelay(pdMS_TO_TICKS(convMs));
+            }
+            if (ok) raw = ads.getLastConversionResults();
+        }
+
+        portENTER_CRITICAL(&adsCacheMux);
+        if (ok) {
+            adsCache[ch].raw = raw;
+            adsCache[ch].ts_us = esp_timer_get_time();
+            adsCache[ch].conversions++;
+            adsCache[ch].valid = true;
+        } else {
+            adsEngineTimeouts++;
+        }
+        portEXIT_CRITICAL(&adsCacheMux);
+
+        if (ok && burstCaptureActive()) burstCaptureFeed((CaptureSource)(CAPTURE_SRC_ADS0 + ch), &raw, 1);
+        if (!ok) activeCh = -1; // RDY pulse missed: restart the conversion
+        ch = (ch + 1) % ADS_ENGINE_CHANNELS;
+        // Let lower-priority work run when scanning at the fastest rates without RDY waits
+        if (adsRdySem == NULL && convMs <= 1) taskYIELD();
+    }
+}
+
+static bool startAdsEngine() {
+    if (adsEngineTask) return true;
+    if (ADS_ALRT_PIN >= 0) {
+        adsRdySem = xSemaphoreCreateBinary();
+        if (adsRdySem) {
+            pinMode(ADS_ALRT_PIN, INPUT_PULLUP);
+            attachInterrupt(digitalPinToInterrupt(ADS_ALRT_PIN), onAdsReady, FALLING);
+        }
+    }
+    if (xTaskCreatePinnedToCore(adsEngineLoop, "ads_eng", 3072, NULL, ACQ_TASK_PRIORITY + 1,
+                                &adsEngineTask, ACQ_TASK_CORE) != pdPASS) {
+        adsEngineTask = NULL;
+        if (adsRdySem) {
+            detachInterrupt(digitalPinToInterrupt(ADS_ALRT_PIN));
+            vSemaphoreDelete(adsRdySem);
+            adsRdySem = NULL;
+        }
+        Serial.println("ADS1115 engine task could not be created; using single-shot reads");
+        return false;
+    }
+    Serial.printf("ADS1115 engine running: %d SPS over %d channel(s), %s\n", (int)adsEngineSps,
+                  ADS_ENGINE_CHANNELS, adsRdySem ? "RDY paced" : "timer paced");
+    return true;
+}
 
 bool setupCurrentPressureSensor(uint8_t i2cAddress) {
     adsAddress = i2cAddress;
+    if (adsMutex == NULL) adsMutex = xSemaphoreCreateMutex();
+    if (adsBusMutex == NULL) adsBusMutex = xSemaphoreCreateMutex();
+    for (int ch = 0; ch < 4; ++ch) reloadAdsChannelConfig(ch);
     // ensure I2C initialized by central helper
     initI2C();
     if (!ads.begin(adsAddress)) {
@@ -36,28 +209,78 @@ bool setupCurrentPressureSensor(uint8_t i2cAddress) {
     ads.setGain(GAIN_TWOTHIRDS);
     adsInitialized = true;
     // Initialize smoothing buffers and load runtime params from Preferences
+    // Load smoothing params from NVS if present
+    adsEmaAlpha = loadFloatFromNVSns("ads_cfg", "ema_alpha", adsEmaAlpha);
+    adsNumAvg = constrain(loadIntFromNVSns("ads_cfg", "num_avg", adsNumAvg), 1, ADS_MAX_BUF);
     for (int ch = 0; ch < 4; ++ch) {
+        char key[16]; snprintf(key, sizeof(key), "filt_%d", ch);
+        FilterPipelineConfig cfg;
+        adsFilterCustom[ch] = loadFilterPipeline("ads_cfg", key, cfg);
+        if (!adsFilterCustom[ch]) cfg = defaultAdsFilter();
+        adsFilter[ch].configure(cfg);
         adsSmoothedMa[ch] = 0.0f;
-        adsBufIdx[ch] = 0;
-        adsBufCount[ch] = 0;
-        for (int i = 0; i < ADS_MAX_BUF; ++i) adsBuf[ch][i] = 0;
     }
-    // Load smoothing params from NVS if present
-    adsEmaAlpha = loadFloatFromNVSns("ads_cfg", "ema_alpha", adsEmaAlpha);
-    adsNumAvg = loadIntFromNVSns("ads_cfg", "num_avg", adsNumAvg);
+    adsEngineSps = normalizeAdsSps(loadIntFromNVSns("ads_cfg", "eng_sps", DEFAULT_ADS_SPS));
     Serial.print("ADS1115 initialized at 0x");
     Serial.println(String(adsAddress, HEX));
+    startAdsEngine();
     return true;
 }
 
 int16_t readAdsRaw(uint8_t channel) {
     if (!adsInitialized) return 0;
     if (channel > 3) return 0;
-    // Read one sample (we'll push into buffer and compute median outside)
+    if (adsEngineTask && channel < ADS_ENGINE_CHANNELS) {
+        portENTER_CRITICAL(&adsCacheMux);
+        bool valid = adsCache[channel].valid;
+        int16_t v = adsCache[channel].raw;
+        portEXIT_CRITICAL(&adsCacheMux);
+        if (valid) return v;
+    }
+    // Channel not scanned by the engine (or no conversion yet): blocking single-shot read
+    AdsBusLock bus;
     int16_t v = ads.readADC_SingleEnded(channel);
+    adsSingleShotUsed = true;
     return v;
 }
 
+bool getAdsCachedRaw(uint8_t channel, int16_t &raw, int64_t &timestampUs) {
+    if (channel > 3) return false;
+    portENTER_CRITICAL(&adsCacheMux);
+    bool valid = adsCache[channel].valid;
+    raw = adsCache[channel].raw;
+    timestampUs = adsCache[channel].ts_us;
+    portEXIT_CRITICAL(&adsCacheMux);
+    return valid;
+}
+
+AdsEngineStatus getAdsEngineStatus() {
+    AdsEngineStatus st;
+    st.running = adsEngineTask != NULL;
+    st.rdy_paced = adsRdySem != NULL;
+    st.sps = adsEngineSps;
+    st.channels = ADS_ENGINE_CHANNELS;
+    portENTER_CRITICAL(&adsCacheMux);
+    st.timeouts = adsEngineTimeouts;
+    for (int ch = 0; ch < 4; ++ch) {
+        st.conversions[ch] = adsCache[ch].conversions;
+        st.last_us[ch] = adsCache[ch].valid ? adsCache[ch].ts_us : 0;
+    }
+    portEXIT_CRITICAL(&adsCacheMux);
+    return st;
+}
+
+int getAdsSampleRate() {
+    return adsEngineSps;
+}
+
+int setAdsSampleRate(int sps) {
+    int applied = normalizeAdsSps(sps);
+    adsEngineSps = applied;
+    saveIntToNVSns("ads_cfg", "eng_sps", applied);
+    return applied;
+}
+
 float adsRawToMv(int16_t raw) {
     if (!adsInitialized) return 0.0f;
     // Prevent tiny negative raw readings (can occur when input floats slightly below ground)
@@ -69,62 +292,39 @@ float adsRawToMv(int16_t raw) {
     return mv;
 }
 
-// Read current in mA using shunt resistor and amplifier gain
-float readAdsMa(uint8_t channel, float shunt_ohm, float amp_gain) {
+// Convert a millivolt reading to loop current for the channel's configured mode.
+// Returns NAN when the channel's scaling is not usable.
+float adsMvToMa(const AdsChannelConfig &cfg, float mv) {
+    if (cfg.mode == ADS_MODE_TP5551) {
+        // TP5551 outputs a voltage proportional to current. Use per-channel tp_scale
+        // which is mV per mA. Default estimated from previous shunt+amp default: 119 * 2 = 238 mV/mA
+        if (cfg.tp_scale <= 0.0f) return NAN;
+        float m = mv / cfg.tp_scale; // mA
+        if (m < 0.0f) m = 0.0f; // avoid tiny negative currents from floating inputs
+        return m;
+    }
+    if (cfg.shunt_ohm <= 0.0f) return NAN;
+    // Vendor example: current = (mv / shunt_ohm) / amp_gain
+    return (mv / cfg.shunt_ohm) / cfg.amp_gain;
+}
+
+// Read current in mA from the channel's latest conversion, then push it
+// through the channel's filter pipeline
+float readAdsMa(uint8_t channel, const AdsChannelConfig &cfg) {
     if (!adsInitialized) return 0.0f;
     if (channel > 3) return 0.0f;
     int16_t raw = readAdsRaw(channel);
     float mv = adsRawToMv(raw);
-    // Determine per-channel mode (shunt vs TP5551)
-    char mkey[16]; snprintf(mkey, sizeof(mkey), "mode_%d", channel);
-    int mode = loadIntFromNVSns("ads_cfg", mkey, ADS_MODE_TP5551);
+    float m = adsMvToMa(cfg, mv);
+    if (isnan(m)) return 0.0f;
 
-        if (mode == ADS_MODE_TP5551) {
-        // TP5551 outputs a voltage proportional to current. Use per-channel tp_scale
-        // which is mV per mA. Default estimated from previous shunt+amp default: 119 * 2 = 238 mV/mA
-    char skey[16]; snprintf(skey, sizeof(skey), "tp_scale_%d", channel);
-    float tp_scale = loadFloatFromNVSns(CAL_NAMESPACE, skey, 238.0f);
-        if (tp_scale <= 0.0f) return 0.0f;
-    float m = mv / tp_scale; // mA
-    if (m < 0.0f) m = 0.0f; // avoid tiny negative currents from floating inputs
-        // Push into median buffer
-    int idx = adsBufIdx[channel] % ADS_MAX_BUF;
-    adsBuf[channel][idx] = (int16_t)round(m * 1000.0f); // store as fixed mA*1000
-        adsBufIdx[channel] = (adsBufIdx[channel] + 1) % ADS_MAX_BUF;
-        if (adsBufCount[channel] < adsNumAvg) adsBufCount[channel]++;
-
-        // Build temp array for median from last adsNumAvg entries
-        int n = adsBufCount[channel];
-        int tmp[ADS_MAX_BUF];
-        int start = (adsBufIdx[channel] - n + ADS_MAX_BUF) % ADS_MAX_BUF;
-        for (int i = 0; i < n; ++i) tmp[i] = adsBuf[channel][(start + i) % ADS_MAX_BUF];
-        // sort small array
-        for (int i = 0; i < n-1; ++i) for (int j = i+1; j < n; ++j) if (tmp[j] < tmp[i]) { int t = tmp[i]; tmp[i] = tmp[j]; tmp[j] = t; }
-        int median = tmp[n/2];
-        float median_ma = ((float)median) / 1000.0f;
-        // EMA smoothing on median
-        adsSmoothedMa[channel] = (adsEmaAlpha * median_ma) + ((1.0f - adsEmaAlpha) * adsSmoothedMa[channel]);
-        return adsSmoothedMa[channel];
-    } else {
-        if (shunt_ohm <= 0.0f) return 0.0f;
-        // Vendor example: current = (mv / shunt_ohm) / amp_gain
-        float m = (mv / shunt_ohm) / amp_gain;
-        // push into buffer as fixed value
-        int idx = adsBufIdx[channel] % ADS_MAX_BUF;
-        adsBuf[channel][idx] = (int16_t)round(m * 1000.0f);
-        adsBufIdx[channel] = (adsBufIdx[channel] + 1) % ADS_MAX_BUF;
-        if (adsBufCount[channel] < adsNumAvg) adsBufCount[channel]++;
-
-        int n = adsBufCount[channel];
-        int tmp[ADS_MAX_BUF];
-        int start = (adsBufIdx[channel] - n + ADS_MAX_BUF) % ADS_MAX_BUF;
-        for (int i = 0; i < n; ++i) tmp[i] = adsBuf[channel][(start + i) % ADS_MAX_BUF];
-        for (int i = 0; i < n-1; ++i) for (int j = i+1; j < n; ++j) if (tmp[j] < tmp[i]) { int t = tmp[i]; tmp[i] = tmp[j]; tmp[j] = t; }
-        int median = tmp[n/2];
-        float median_ma = ((float)median) / 1000.0f;
-        adsSmoothedMa[channel] = (adsEmaAlpha * median_ma) + ((1.0f - adsEmaAlpha) * adsSmoothedMa[channel]);
-        return adsSmoothedMa[channel];
-    }
+    AdsLock lock;
+    adsSmoothedMa[channel] = adsFilter[channel].process(m);
+    return adsSmoothedMa[channel];
+}
+
+bool isAdsAvailable() {
+    return adsInitialized;
 }
 
 // Accessor: get the last smoothed mA value for an ADS channel
@@ -133,16 +333,60 @@ float getAdsSmoothedMa(uint8_t channel) {
     return adsSmoothedMa[channel];
 }
 
+// Reconfigure channels that follow the default pipeline; custom ones keep theirs
+static void applyDefaultAdsFilters() {
+    FilterPipelineConfig cfg = defaultAdsFilter();
+    AdsLock lock;
+    for (int ch = 0; ch < 4; ++ch) {
+        if (!adsFilterCustom[ch]) adsFilter[ch].configure(cfg);
+    }
+}
+
 void setAdsEmaAlpha(float a) {
     if (a <= 0.0f) return;
     if (a > 1.0f) a = 1.0f;
     adsEmaAlpha = a;
+    applyDefaultAdsFilters();
 }
 
 void setAdsNumAvg(int n) {
     if (n < 1) n = 1;
     if (n > ADS_MAX_BUF) n = ADS_MAX_BUF;
     adsNumAvg = n;
+    applyDefaultAdsFilters();
+}
+
+bool setAdsFilterPipeline(uint8_t channel, const FilterPipelineConfig &config) {
+    if (channel > 3) return false;
+    {
+        AdsLock lock;
+        if (!adsFilter[channel].configure(config)) return false;
+        adsFilterCustom[channel] = true;
+    }
+    char key[16]; snprintf(key, sizeof(key), "filt_%d", channel);
+    saveFilterPipeline("ads_cfg", key, config);
+    return true;
+}
+
+void resetAdsFilterPipeline(uint8_t channel) {
+    if (channel > 3) return;
+    {
+        AdsLock lock;
+        adsFilterCustom[channel] = false;
+        adsFilter[channel].configure(defaultAdsFilter());
+    }
+    char key[16]; snprintf(key, sizeof(key), "filt_%d", channel);
+    saveStringToNVSns("ads_cfg", key, "");
+}
+
+FilterPipelineConfig getAdsFilterPipeline(uint8_t channel) {
+    if (channel > 3) return FilterPipelineConfig();
+    AdsLock lock;
+    return adsFilter[channel].config();
+}
+
+bool isAdsFilterCustom(uint8_t channel) {
+    return channel <= 3 && adsFilterCustom[channel];
 }
 
 // Compute depth in mm using sample's formula.
@@ -168,42 +412,67 @@ float computePressureBarFromMa(float current_mA, float current_init_mA, float ra
     return p;
 }
 
-// NVS-backed helpers for per-channel shunt and amp gain
-float getAdsShuntOhm(uint8_t channel) {
+// Re-read one channel's settings from NVS into the RAM copy. Called at setup
+// and by the HTTP handlers after they write shunt/amp/mode/enabled/tp_scale.
+void reloadAdsChannelConfig(uint8_t channel) {
+    if (channel > 3) return;
+    AdsChannelConfig cfg;
     char key[16];
+    snprintf(key, sizeof(key), "mode_%d", channel);
+    cfg.mode = loadIntFromNVSns("ads_cfg", key, ADS_MODE_TP5551);
+    snprintf(key, sizeof(key), "tp_scale_%d", channel);
+    cfg.tp_scale = loadFloatFromNVSns(CAL_NAMESPACE, key, 238.0f);
     snprintf(key, sizeof(key), "shunt_%d", channel);
-    return loadFloatFromNVSns("ads_cfg", key, DEFAULT_SHUNT_OHM);
+    cfg.shunt_ohm = loadFloatFromNVSns("ads_cfg", key, DEFAULT_SHUNT_OHM);
+    snprintf(key, sizeof(key), "amp_%d", channel);
+    cfg.amp_gain = loadFloatFromNVSns("ads_cfg", key, DEFAULT_AMP_GAIN);
+    snprintf(key, sizeof(key), "en_%d", channel);
+    cfg.enabled = loadIntFromNVSns("ads_cfg", key, 1) != 0;
+    AdsLock lock;
+    adsChannelCfg[channel] = cfg;
+}
+
+AdsChannelConfig getAdsChannelConfig(uint8_t channel) {
+    if (channel > 3) return AdsChannelConfig();
+    AdsLock lock;
+    return adsChannelCfg[channel];
+}
+
+float getAdsShuntOhm(uint8_t channel) {
+    return getAdsChannelConfig(channel).shunt_ohm;
 }
 
 float getAdsAmpGain(uint8_t channel) {
-    char key[16];
-    snprintf(key, sizeof(key), "amp_%d", channel);
-    return loadFloatFromNVSns("ads_cfg", key, DEFAULT_AMP_GAIN);
+    return getAdsChannelConfig(channel).amp_gain;
 }
 
 int getAdsChannelMode(uint8_t channel) {
-    char key[16]; snprintf(key, sizeof(key), "mode_%d", channel);
-    return loadIntFromNVSns("ads_cfg", key, ADS_MODE_TP5551);
+    return getAdsChannelConfig(channel).mode;
 }
 
 float getAdsTpScale(uint8_t channel) {
-    char key[16]; snprintf(key, sizeof(key), "tp_scale_%d", channel);
-    return loadFloatFromNVSns(CAL_NAMESPACE, key, 238.0f);
+    return getAdsChannelConfig(channel).tp_scale;
+}
+
+bool getAdsChannelEnabled(uint8_t channel) {
+    return getAdsChannelConfig(channel).enabled;
 }
 
 // Clear ADS per-channel buffers and reset smoothed values (useful after tp_scale changes)
 void clearAdsBuffers() {
-    for (int ch = 0; ch < 4; ++ch) {
-        adsSmoothedMa[ch] = 0.0f;
-        adsBufIdx[ch] = 0;
-        adsBufCount[ch] = 0;
-        for (int i = 0; i < ADS_MAX_BUF; ++i) adsBuf[ch][i] = 0;
+    {
+        AdsLock lock;
+        for (int ch = 0; ch < 4; ++ch) {
+            adsSmoothedMa[ch] = 0.0f;
+            adsFilter[ch].reset();
+        }
     }
-    // Reseed smoothed values from current readings to avoid long ramp-up
+    // Reseed smoothed values from current readings to avoid long ramp-up. The
+    // EMA starts at the current value instead of ramping from zero.
     for (int ch = 0; ch < 4; ++ch) {
-        // perform a single read and push through the same path by calling readAdsMa
-        // using stored defaults; this will populate buffers with one entry each
-        float dummy = readAdsMa(ch, getAdsShuntOhm(ch), getAdsAmpGain(ch));
-        (void)dummy;
+        float m = adsMvToMa(getAdsChannelConfig(ch), adsRawToMv(readAdsRaw(ch)));
+        if (isnan(m)) continue;
+        AdsLock lock;
+        adsSmoothedMa[ch] = adsFilter[ch].process(m);
     }
 }
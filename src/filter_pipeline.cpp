@@ -0,0 +1,200 @@
+#include "filter_pipeline.h"
+#include "storage_helpers.h"
+
+#include <new>
+
+namespace {
+
+struct StageSpec {
+    FilterStageType type;
+    const char *name;
+};
+
+const StageSpec STAGE_SPECS[] = {
+    {FILTER_MEDIAN, "median"},
+    {FILTER_EMA, "ema"},
+    {FILTER_MOVING_AVG, "moving_avg"},
+    {FILTER_HAMPEL, "hampel"},
+    {FILTER_KALMAN, "kalman"},
+    {FILTER_DEADBAND, "deadband"},
+};
+
+FilterStageType stageTypeFromName(const String &name) {
+    for (const StageSpec &spec : STAGE_SPECS) {
+        if (name.equalsIgnoreCase(spec.name)) return spec.type;
+    }
+    return FILTER_NONE;
+}
+
+bool usesWindow(FilterStageType type) {
+    return type == FILTER_MEDIAN || type == FILTER_MOVING_AVG || type == FILTER_HAMPEL;
+}
+
+} // namespace
+
+const char *filterStageName(FilterStageType type) {
+    for (const StageSpec &spec : STAGE_SPECS) {
+        if (spec.type == type) return spec.name;
+    }
+    return "none";
+}
+
+String validateFilterPipeline(const FilterPipelineConfig &config) {
+    if (config.count > FILTER_MAX_STAGES) {
+        return String("At most ") + FILTER_MAX_STAGES + " filter stages";
+    }
+    for (int i = 0; i < config.count; ++i) {
+        const FilterStageConfig &c = config.stages[i];
+        String where = String("stage ") + i + " (" + filterStageName(c.type) + "): ";
+        if (c.type == FILTER_NONE) return String("stage ") + i + ": unknown type";
+        if (usesWindow(c.type) && (c.window < 1 || c.window > FILTER_MAX_WINDOW)) {
+            return where + "window must be 1.." + FILTER_MAX_WINDOW;
+        }
+        if (!isfinite(c.a) || !isfinite(c.b)) return where + "parameters must be finite";
+        switch (c.type) {
+            case FILTER_EMA:
+                if (c.a <= 0.0f || c.a > 1.0f) return where + "alpha must be in (0, 1]";
+                break;
+            case FILTER_HAMPEL:
+                if (c.a <= 0.0f) return where + "k must be > 0";
+                break;
+            case FILTER_KALMAN:
+                if (c.a < 0.0f || c.b <= 0.0f) return where + "q must be >= 0 and r > 0";
+                break;
+            case FILTER_DEADBAND:
+                if (c.a < 0.0f) return where + "band must be >= 0";
+                break;
+            default:
+                break;
+        }
+    }
+    return String();
+}
+
+FilterPipeline::~FilterPipeline() {
+    for (FilterStageState &s : state_) delete s.win;
+}
+
+bool FilterPipeline::configure(const FilterPipelineConfig &config) {
+    if (validateFilterPipeline(config).length() > 0) return false;
+    // Window state for the stages that need it, taken over from the same
+    // stage when it already has one; all of it is in place before anything
+    // changes, so a short heap leaves the running pipeline as it was
+    FilterWindowState *win[FILTER_MAX_STAGES] = {};
+    bool fresh[FILTER_MAX_STAGES] = {};
+    for (int i = 0; i < config.count; ++i) {
+        if (!usesWindow(config.stages[i].type)) continue;
+        win[i] = state_[i].win;
+        if (win[i]) continue;
+        win[i] = new (std::nothrow) FilterWindowState();
+        fresh[i] = true;
+        if (!win[i]) {
+            for (int j = 0; j < i; ++j) {
+                if (fresh[j]) delete win[j];
+            }
+            Serial.println("[FILTER] No memory for filter window state");
+            return false;
+        }
+    }
+    for (int i = 0; i < FILTER_MAX_STAGES; ++i) {
+        if (state_[i].win != win[i]) delete state_[i].win;
+        state_[i].win = win[i];
+    }
+    config_ = config;
+    reset();
+    return true;
+}
+
+void FilterPipeline::reset() {
+    for (int i = 0; i < FILTER_MAX_STAGES; ++i) {
+        FilterStageState &s = state_[i];
+        if (s.win) s.win->median.setWindow(config_.stages[i].window);
+        s.head = 0;
+        s.filled = 0;
+        s.sum = 0.0f;
+        s.y = 0.0f;
+        s.p = 0.0f;
+        s.primed = false;
+    }
+}
+
+bool parseFilterPipeline(JsonVariantConst json, FilterPipelineConfig &out, String &error) {
+    if (!json.is<JsonArrayConst>()) {
+        error = "filters must be an array";
+        return false;
+    }
+    JsonArrayConst arr = json.as<JsonArrayConst>();
+    if (arr.size() > (size_t)FILTER_MAX_STAGES) {
+        error = String("At most ") + FILTER_MAX_STAGES + " filter stages";
+        return false;
+    }
+    FilterPipelineConfig parsed;
+    for (JsonObjectConst obj : arr) {
+        FilterStageConfig &c = parsed.stages[parsed.count];
+        String name = obj["type"].as<String>();
+        c.type = stageTypeFromName(name);
+        if (c.type == FILTER_NONE) {
+            error = String("Unknown filter type: ") + name;
+            return false;
+        }
+        int window = obj["window"] | 5;
+        c.window = (uint8_t)constrain(window, 0, 255);
+        switch (c.type) {
+            case FILTER_EMA: c.a = obj["alpha"] | 0.1f; break;
+            case FILTER_HAMPEL: c.a = obj["k"] | 3.0f; break;
+            case FILTER_KALMAN:
+                c.a = obj["q"] | 0.01f;
+                c.b = obj["r"] | 1.0f;
+                break;
+            case FILTER_DEADBAND: c.a = obj["band"] | 0.0f; break;
+            default: break;
+        }
+        parsed.count++;
+    }
+    error = validateFilterPipeline(parsed);
+    if (error.length() > 0) return false;
+    out = parsed;
+    return true;
+}
+
+void filterPipelineToJson(const FilterPipelineConfig &config, JsonArray out) {
+    for (int i = 0; i < config.count; ++i) {
+        const FilterStageConfig &c = config.stages[i];
+        JsonObject obj = out.add<JsonObject>();
+        obj["type"] = filterStageName(c.type);
+        switch (c.type) {
+            case FILTER_MEDIAN:
+            case FILTER_MOVING_AVG:
+                obj["window"] = c.window;
+                break;
+            case FILTER_EMA: obj["alpha"] = c.a; break;
+            case FILTER_HAMPEL:
+                obj["window"] = c.window;
+                obj["k"] = c.a;
+                break;
+            case FILTER_KALMAN:
+                obj["q"] = c.a;
+                obj["r"] = c.b;
+                break;
+            case FILTER_DEADBAND: obj["band"] = c.a; break;
+            default: break;
+        }
+    }
+}
+
+void saveFilterPipeline(const char *ns, const char *key, const FilterPipelineConfig &config) {
+    JsonDocument doc;
+    filterPipelineToJson(config, doc.to<JsonArray>());
+    String payload;
+    serializeJson(doc, payload);
+    saveStringToNVSns(ns, key, payload);
+}
+
+bool loadFilterPipeline(const char *ns, const char *key, FilterPipelineConfig &out) {
+    String payload = loadStringFromNVSns(ns, key, "");
+    if (payload.length() == 0) return false;
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) return false;
+    String error;
+    return parseFilterPipeline(doc.as<JsonVariantConst>(), out, error);
+}
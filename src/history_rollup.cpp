@@ -0,0 +1,404 @@
+#include "history_rollup.h"
+#include "sample_store.h"
+#include "storage_helpers.h"
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <time.h>
+
+namespace {
+
+const uint32_t TIER_WIDTH[HISTORY_TIER_COUNT] = {1, 60, 900, 3600};
+const uint32_t TIER_SLOTS[HISTORY_TIER_COUNT] = {
+    HISTORY_SLOTS_1S, HISTORY_SLOTS_1M, HISTORY_SLOTS_15M, HISTORY_SLOTS_1H
+};
+const uint32_t TOTAL_SLOTS = HISTORY_SLOTS_1S + HISTORY_SLOTS_1M + HISTORY_SLOTS_15M + HISTORY_SLOTS_1H;
+
+// avg (float) + distance to min and max (float16) + count (uint16)
+const size_t SLOT_BYTES = sizeof(float) + 3 * sizeof(uint16_t);
+const size_t TAG_BYTES = SLOT_BYTES * TOTAL_SLOTS;
+
+// Before this the clock has not been set (NTP/RTC)
+const time_t MIN_VALID_EPOCH = 1600000000;
+
+const char *const PREF_NS = "history";
+const char *const PREF_TAGS = "tags"; // bit per built-in tag that was requested
+
+// Columns of one tier; slot `head` holds the bucket starting at `newest`.
+// min and max are kept as float16 distances from the bucket average; the
+// open (newest) bucket keeps them exact in headMin/headMax until it closes.
+struct TierRing {
+    float *avg;
+    uint16_t *low;   // avg - min
+    uint16_t *high;  // max - avg
+    uint16_t *count; // saturates at UINT16_MAX
+    uint32_t head;
+    uint32_t newest; // 0 = empty
+    float headMin;
+    float headMax;
+};
+
+struct TagHistory {
+    void *block; // one allocation for every column of every tier
+    TierRing tiers[HISTORY_TIER_COUNT];
+    int64_t lastSampleUs;
+    bool active;      // configured (Modbus "history") or requested through the API
+    bool allocFailed; // refused by the heap budget; retried on the next request
+};
+
+TagHistory history[HISTORY_MAX_TAGS];
+char extraNames[HISTORY_MAX_EXTRA_TAGS][SAMPLE_TAG_MAX_LEN]; // "" = free
+uint32_t latestEpoch = 0;
+uint32_t requestedMask = 0;
+bool maskLoaded = false;
+
+// loop() feeds while HTTP handlers read
+SemaphoreHandle_t historyMutex = NULL;
+
+class HistoryLock {
+public:
+    HistoryLock() { if (historyMutex) xSemaphoreTake(historyMutex, portMAX_DELAY); }
+    ~HistoryLock() { if (historyMutex) xSemaphoreGive(historyMutex); }
+    HistoryLock(const HistoryLock&) = delete;
+    HistoryLock& operator=(const HistoryLock&) = delete;
+};
+
+// Non-negative float to IEEE half, rounded to nearest; saturates at 65504
+uint16_t toHalf(float v) {
+    if (!(v > 0.0f)) return 0;
+    if (v >= 65504.0f) return 0x7BFF;
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int32_t exp = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = bits & 0x7FFFFF;
+    if (exp <= 0) {
+        if (exp < -10) return 0;
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t h = mant >> shift;
+        if ((mant >> (shift - 1)) & 1) h++;
+        return (uint16_t)h;
+    }
+    uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+    if (mant & 0x1000) h++;
+    return h > 0x7BFF ? 0x7BFF : (uint16_t)h;
+}
+
+float fromHalf(uint16_t h) {
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    if (exp == 0) return ldexpf((float)mant, -24);
+    return ldexpf((float)(mant | 0x400), (int)exp - 25);
+}
+
+// Rings of a tag, within the heap budget: the allocation must leave
+// HISTORY_HEAP_RESERVE_BYTES in the largest free block
+bool allocTag(TagHistory &h) {
+    if (heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < TAG_BYTES + HISTORY_HEAP_RESERVE_BYTES) return false;
+    uint8_t *block = (uint8_t *)malloc(TAG_BYTES);
+    if (!block) return false;
+    h.block = block;
+    for (int t = 0; t < HISTORY_TIER_COUNT; ++t) {
+        TierRing &r = h.tiers[t];
+        size_t n = TIER_SLOTS[t];
+        r.avg = reinterpret_cast<float *>(block);
+        r.low = reinterpret_cast<uint16_t *>(r.avg + n);
+        r.high = r.low + n;
+        r.count = r.high + n;
+        memset(r.count, 0, n * sizeof(uint16_t));
+        r.head = 0;
+        r.newest = 0;
+        block += SLOT_BYTES * n;
+    }
+    return true;
+}
+
+void clearRing(TierRing &r, int tier) {
+    memset(r.count, 0, TIER_SLOTS[tier] * sizeof(uint16_t));
+    r.head = 0;
+    r.newest = 0;
+}
+
+void bucketRange(const TierRing &r, uint32_t slot, float &minV, float &maxV) {
+    if (slot == r.head) {
+        minV = r.headMin;
+        maxV = r.headMax;
+    } else {
+        minV = r.avg[slot] - fromHalf(r.low[slot]);
+        maxV = r.avg[slot] + fromHalf(r.high[slot]);
+    }
+}
+
+void storeRange(TierRing &r, uint32_t slot, float minV, float maxV) {
+    r.low[slot] = toHalf(r.avg[slot] - minV);
+    r.high[slot] = toHalf(maxV - r.avg[slot]);
+}
+
+void addToBucket(TierRing &r, uint32_t slot, float v) {
+    uint32_t n = r.count[slot];
+    float minV = v, maxV = v;
+    if (n == 0) {
+        r.avg[slot] = v;
+    } else {
+        bucketRange(r, slot, minV, maxV);
+        if (v < minV) minV = v;
+        if (v > maxV) maxV = v;
+        r.avg[slot] += (v - r.avg[slot]) / (float)(n + 1);
+    }
+    if (n < UINT16_MAX) r.count[slot] = (uint16_t)(n + 1);
+    if (slot == r.head) {
+        r.headMin = minV;
+        r.headMax = maxV;
+    } else {
+        storeRange(r, slot, minV, maxV);
+    }
+}
+
+void feedTier(TierRing &r, int tier, uint32_t epoch, float v) {
+    const uint32_t width = TIER_WIDTH[tier];
+    const uint32_t slots = TIER_SLOTS[tier];
+    uint32_t start = epoch - epoch % width;
+    // Empty, or the clock stepped back past the whole ring: start over
+    if (r.newest == 0 || (start < r.newest && r.newest - start >= width * slots)) {
+        clearRing(r, tier);
+        r.newest = start;
+    } else if (start > r.newest) {
+        // Open the bucket for `start`, emptying the ones skipped on the way
+        uint32_t gap = (start - r.newest) / width;
+        uint32_t skipped = gap < slots ? gap : slots;
+        // Close the open bucket
+        if (r.count[r.head]) storeRange(r, r.head, r.headMin, r.headMax);
+        for (uint32_t k = 1; k <= skipped; ++k) r.count[(r.head + k) % slots] = 0;
+        r.head = (r.head + gap % slots) % slots;
+        r.newest = start;
+    }
+    uint32_t back = (r.newest - start) / width;
+    addToBucket(r, (r.head + slots - back) % slots, v);
+}
+
+uint32_t oldestBucket(uint32_t newest, int tier) {
+    uint32_t reach = (TIER_SLOTS[tier] - 1) * TIER_WIDTH[tier];
+    return newest > reach ? newest - reach : 0;
+}
+
+bool tierCovers(int tier, uint32_t from) {
+    uint32_t width = TIER_WIDTH[tier];
+    return from >= oldestBucket(latestEpoch - latestEpoch % width, tier);
+}
+
+const char *tagName(int tag) {
+    return tag < REPORT_MAX_TAGS ? reportTagName(tag) : extraNames[tag - REPORT_MAX_TAGS];
+}
+
+// Add a value to every tier of an active tag; false when it is not
+// recording (inactive, or its rings did not fit the heap budget)
+bool feedValue(int tag, uint32_t epoch, float v) {
+    TagHistory &h = history[tag];
+    if (!h.block) {
+        if (!h.active || h.allocFailed) return false;
+        if (!allocTag(h)) {
+            h.allocFailed = true;
+            Serial.printf("[HISTORY] %s history refused: %u bytes over the heap budget\n", tagName(tag),
+                          (unsigned)TAG_BYTES);
+            return false;
+        }
+    }
+    for (int t = 0; t < HISTORY_TIER_COUNT; ++t) feedTier(h.tiers[t], t, epoch, v);
+    latestEpoch = epoch;
+    return true;
+}
+
+void ensureMutex() {
+    if (historyMutex == NULL) historyMutex = xSemaphoreCreateMutex();
+}
+
+// Call with the lock held
+void loadRequestedTags() {
+    if (maskLoaded) return;
+    maskLoaded = true;
+    requestedMask = (uint32_t)loadULongFromNVSns(PREF_NS, PREF_TAGS, 0UL);
+    for (int tag = 0; tag < REPORT_MAX_TAGS; ++tag) {
+        if (requestedMask & (1UL << tag)) history[tag].active = true;
+    }
+}
+
+} // namespace
+
+void feedHistory(const SensorSnapshot &snap) {
+    time_t now = time(nullptr);
+    if (now < MIN_VALID_EPOCH) return;
+    ensureMutex();
+    int64_t nowUs = esp_timer_get_time();
+    HistoryLock lock;
+    loadRequestedTags();
+    for (int tag = 0; tag < REPORT_MAX_TAGS; ++tag) {
+        if (!history[tag].active) continue;
+        int64_t sampleUs = 0;
+        float v = reportTagValue(snap, tag, sampleUs);
+        if (isnan(v)) continue;
+        TagHistory &h = history[tag];
+        if (h.block && sampleUs == h.lastSampleUs) continue;
+        int64_t ageS = (nowUs - sampleUs) / 1000000;
+        uint32_t epoch = (uint32_t)now - (uint32_t)(ageS > 0 ? ageS : 0);
+        if (feedValue(tag, epoch, v)) h.lastSampleUs = sampleUs;
+    }
+}
+
+int registerHistoryTag(const char *name) {
+    if (!name || name[0] == '\0' || strlen(name) >= (size_t)SAMPLE_TAG_MAX_LEN) return -1;
+    ensureMutex();
+    HistoryLock lock;
+    int freeIndex = -1;
+    for (int e = 0; e < HISTORY_MAX_EXTRA_TAGS; ++e) {
+        if (strcmp(extraNames[e], name) == 0) return REPORT_MAX_TAGS + e;
+        if (extraNames[e][0] == '\0' && freeIndex < 0) freeIndex = e;
+    }
+    if (freeIndex < 0) return -1;
+    strcpy(extraNames[freeIndex], name);
+    history[REPORT_MAX_TAGS + freeIndex].active = true;
+    return REPORT_MAX_TAGS + freeIndex;
+}
+
+void unregisterHistoryTag(int tag) {
+    if (tag < REPORT_MAX_TAGS || tag >= HISTORY_MAX_TAGS) return;
+    HistoryLock lock;
+    free(history[tag].block);
+    history[tag] = TagHistory();
+    extraNames[tag - REPORT_MAX_TAGS][0] = '\0';
+}
+
+void feedHistoryTag(int tag, float value) {
+    if (tag < REPORT_MAX_TAGS || tag >= HISTORY_MAX_TAGS || isnan(value)) return;
+    time_t now = time(nullptr);
+    if (now < MIN_VALID_EPOCH) return;
+    HistoryLock lock;
+    if (extraNames[tag - REPORT_MAX_TAGS][0] == '\0') return;
+    feedValue(tag, (uint32_t)now, value);
+}
+
+int findHistoryTag(const String &name) {
+    for (int tag = 0; tag < REPORT_MAX_TAGS; ++tag) {
+        if (name.equalsIgnoreCase(reportTagName(tag))) return tag;
+    }
+    HistoryLock lock;
+    for (int e = 0; e < HISTORY_MAX_EXTRA_TAGS; ++e) {
+        if (extraNames[e][0] != '\0' && name.equalsIgnoreCase(extraNames[e])) return REPORT_MAX_TAGS + e;
+    }
+    return -1;
+}
+
+void requestHistoryTag(int tag) {
+    if (tag < 0 || tag >= HISTORY_MAX_TAGS) return;
+    ensureMutex();
+    HistoryLock lock;
+    loadRequestedTags();
+    TagHistory &h = history[tag];
+    h.allocFailed = false;
+    if (tag >= REPORT_MAX_TAGS || h.active) return;
+    h.active = true;
+    requestedMask |= 1UL << tag;
+    saveULongToNVSns(PREF_NS, PREF_TAGS, requestedMask);
+}
+
+HistoryTagState historyTagState(int tag) {
+    if (tag < 0 || tag >= HISTORY_MAX_TAGS) return HISTORY_TAG_IDLE;
+    HistoryLock lock;
+    const TagHistory &h = history[tag];
+    if (h.block) return HISTORY_TAG_RECORDING;
+    if (h.allocFailed) return HISTORY_TAG_NO_MEMORY;
+    return h.active ? HISTORY_TAG_PENDING : HISTORY_TAG_IDLE;
+}
+
+String historyTagName(int tag) {
+    if (tag < 0 || tag >= HISTORY_MAX_TAGS) return String();
+    HistoryLock lock;
+    return String(tagName(tag));
+}
+
+bool planHistoryQuery(uint32_t from, uint32_t to, uint32_t step, HistoryPlan &plan) {
+    HistoryLock lock;
+    if (latestEpoch == 0) return false;
+    if (to == 0 || to > latestEpoch) to = latestEpoch;
+    if (from > to) from = to;
+    // Keep the point count within HISTORY_MAX_POINTS
+    uint32_t minStep = (to - from) / (HISTORY_MAX_POINTS - 1) + 1;
+    if (step < minStep) step = minStep;
+
+    int tier = -1;
+    for (int t = HISTORY_TIER_COUNT - 1; t >= 0 && tier < 0; --t) {
+        if (TIER_WIDTH[t] <= step && tierCovers(t, from)) tier = t;
+    }
+    for (int t = 0; t < HISTORY_TIER_COUNT && tier < 0; ++t) {
+        if (tierCovers(t, from)) tier = t;
+    }
+    if (tier < 0) tier = HISTORY_TIER_COUNT - 1;
+
+    uint32_t width = TIER_WIDTH[tier];
+    step = ((step + width - 1) / width) * width;
+    uint32_t start = from - from % step;
+    while ((to - start) / step + 1 > HISTORY_MAX_POINTS) {
+        step += width;
+        start = from - from % step;
+    }
+    plan.tier = tier;
+    plan.width = width;
+    plan.step = step;
+    plan.start = start;
+    plan.points = (to - start) / step + 1;
+    return true;
+}
+
+bool readHistory(int tag, const HistoryPlan &plan, float *avg, float *minV, float *maxV, uint32_t *count) {
+    if (tag < 0 || tag >= HISTORY_MAX_TAGS || plan.tier < 0 || plan.tier >= HISTORY_TIER_COUNT) return false;
+    for (uint32_t k = 0; k < plan.points; ++k) {
+        avg[k] = minV[k] = maxV[k] = NAN;
+        count[k] = 0;
+    }
+    HistoryLock lock;
+    const TagHistory &h = history[tag];
+    if (!h.block) return false;
+    const TierRing &r = h.tiers[plan.tier];
+    if (r.newest == 0) return true;
+
+    const uint32_t width = TIER_WIDTH[plan.tier];
+    const uint32_t slots = TIER_SLOTS[plan.tier];
+    uint32_t first = oldestBucket(r.newest, plan.tier);
+    if (plan.start > first) first = plan.start;
+    uint32_t end = plan.start + plan.points * plan.step;
+    for (uint32_t t = first; t < end && t <= r.newest; t += width) {
+        uint32_t slot = (r.head + slots - (r.newest - t) / width) % slots;
+        uint32_t n = r.count[slot];
+        if (n == 0) continue;
+        uint32_t k = (t - plan.start) / plan.step;
+        uint32_t have = count[k];
+        float lo, hi;
+        bucketRange(r, slot, lo, hi);
+        if (have == 0) {
+            avg[k] = r.avg[slot];
+            minV[k] = lo;
+            maxV[k] = hi;
+        } else {
+            if (lo < minV[k]) minV[k] = lo;
+            if (hi > maxV[k]) maxV[k] = hi;
+            avg[k] += (r.avg[slot] - avg[k]) * ((float)n / (float)(have + n));
+        }
+        count[k] = have + n;
+    }
+    return true;
+}
+
+uint32_t historyLatestEpoch() {
+    HistoryLock lock;
+    return latestEpoch;
+}
+
+uint32_t historyTierWidth(int tier) {
+    return (tier >= 0 && tier < HISTORY_TIER_COUNT) ? TIER_WIDTH[tier] : 0;
+}
+
+uint32_t historyTierSlots(int tier) {
+    return (tier >= 0 && tier < HISTORY_TIER_COUNT) ? TIER_SLOTS[tier] : 0;
+}
@@ -18,6 +18,14 @@
 #include "sample_store.h"
 #include "json_helper.h"
 #include "modbus_manager.h"
+#include "alarm_rules.h"
+#include "web_api_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "pulse_counter.h"
+#include "report_filter.h"
+#include "sensor_health.h"
+#include "sd_logger.h"
 
 unsigned long lastHttpNotificationMillis = 0;
 static uint8_t notificationMode = DEFAULT_NOTIFICATION_MODE;
@@ -74,9 +82,10 @@ uint8_t getNotificationPayloadType() {
     return notificationPayloadType;
 }
 
-// Helper to post payload to HTTP webhook url if configured
-static void postJsonToWebhook(const String &payload) {
-    if (WiFi.status() != WL_CONNECTED) return;
+// Helper to post payload to HTTP webhook url if configured. Returns the HTTP
+// status code, or a value <= 0 when nothing was delivered.
+static int postJsonToWebhook(const String &payload) {
+    if (WiFi.status() != WL_CONNECTED) return 0;
     HTTPClient http;
     http.begin(HTTP_NOTIFICATION_URL);
 #if USE_HTTP_NOTIFICATION_HEADERS
@@ -100,6 +109,7 @@ static void postJsonToWebhook(const String &payload) {
     }
     #endif
     http.end();
+    return code;
 }
 
 // Route a single sensor notification (ADC) - simplified compact payload
@@ -115,16 +125,10 @@ void routeSensorNotification(int sensorIndex, int rawADC, float smoothedADC, flo
     s["source"] = "adc";
     s["enabled"] = getSensorEnabled(sensorIndex) ? 1 : 0;
 
-    // Compute converted value (pressure in bar) and send only the converted value for compactness
-    float avgRawF, avgSmoothedF, avgVoltF;
-    int rawToUse = rawADC;
-    float smoothedToUse = smoothedADC;
-    if (getAverages(sensorIndex, avgRawF, avgSmoothedF, avgVoltF)) {
-        rawToUse = (int)round(avgRawF);
-        smoothedToUse = avgSmoothedF;
-    }
+    // Compute converted value (pressure in bar) and send only the converted value for compactness.
+    // Callers pass the snapshot's window-averaged counts.
     struct SensorCalibration cal = getCalibrationForPin(sensorIndex);
-    float pressure_from_filtered = (round(smoothedToUse) * cal.scale) + cal.offset;
+    float pressure_from_filtered = (round(smoothedADC) * cal.scale) + cal.offset;
     s["value"] = roundToDecimals(pressure_from_filtered, 2);
     s["unit"] = "bar";
 
@@ -178,61 +182,71 @@ void sendAdsNotification(int adsChannel, int16_t rawAds, float mv, float ma) {
     }
 }
 
-// Send batch notification for multiple ADC sensors plus ADS channels appended
-void sendHttpNotificationBatch(int numSensors, int sensorIndices[], int rawADC[], float smoothedADC[]) {
+// Send batch notification for the AI sensors plus ADS channels of one snapshot
+void sendHttpNotificationBatch(const SensorSnapshot &snap, bool enabledOnly, uint32_t tagMask) {
     // Compact batch payload: timestamp, rtu, tags[] { id, source, enabled, value, unit }
     JsonDocument doc;
     doc["timestamp"] = getIsoTimestamp();
     doc["rtu"] = String(getChipId());
+    doc["seq"] = snap.seq;
 
     JsonArray arr = doc["tags"].to<JsonArray>();
 
     // ADC sensors -> value = converted pressure (bar)
-    for (int i = 0; i < numSensors; ++i) {
-        int sensorIndex = sensorIndices[i];
+    for (int i = 0; i < snap.num_ai; ++i) {
+        const AiSnapshot &ai = snap.ai[i];
+        bool enabled = !(ai.flags & SENSOR_FLAG_DISABLED);
+        if (enabledOnly && !enabled) continue;
+        if (!(tagMask & (1UL << reportTagAi(i)))) continue;
         JsonObject obj = arr.add<JsonObject>();
-        obj["id"] = String("AI") + String(sensorIndex + 1);
+        obj["id"] = String("AI") + String(i + 1);
         obj["source"] = "adc";
-        obj["enabled"] = getSensorEnabled(sensorIndex) ? 1 : 0;
-
-        int raw = rawADC[i];
-        float smoothed = smoothedADC[i];
-        struct SensorCalibration cal = getCalibrationForPin(sensorIndex);
-        float pressure_from_raw = (round(raw) * cal.scale) + cal.offset;
-        float pressure_from_smoothed = (round(smoothed) * cal.scale) + cal.offset;
-        
-        JsonObject val = obj.createNestedObject("value");
-        val["raw"] = roundToDecimals(pressure_from_raw, 2);
-        val["filtered"] = roundToDecimals(pressure_from_smoothed, 2);
+        obj["enabled"] = enabled ? 1 : 0;
+        obj["status"] = sensorStatusString(ai.flags);
+        if (ai.health) healthCodesToJson(ai.health, obj["health"].to<JsonArray>());
+
+        JsonObject val = obj["value"].to<JsonObject>();
+        val["raw"] = roundToDecimals(ai.pressure_raw, 2);
+        val["filtered"] = roundToDecimals(ai.pressure, 2);
         obj["unit"] = "bar";
     }
 
     // ADS channels -> value = derived pressure (bar)
-    for (int ch = 0; ch <= 1; ++ch) {
+    for (int ch = 0; ch < snap.num_ads; ++ch) {
+        const AdsSnapshot &ads = snap.ads[ch];
+        if (!(tagMask & (1UL << reportTagAds(ch)))) continue;
         JsonObject a = arr.add<JsonObject>();
         a["id"] = String("ADS_A") + String(ch);
         a["source"] = "ads1115";
-        a["enabled"] = 1;
-
-        // Raw value
-        int16_t raw = readAdsRaw(ch);
-        float mv = adsRawToMv(raw);
-        float voltage_v = mv / 1000.0f;
-        float pressure_bar_raw = (voltage_v / 10.0f) * DEFAULT_RANGE_BAR;
-
-        // Smoothed value
-        float ma_smoothed = getAdsSmoothedMa(ch);
-        float tp_scale = getAdsTpScale(ch);
-        float mv_from_smoothed = ma_smoothed * tp_scale;
-        float voltage_from_smoothed = mv_from_smoothed / 1000.0f;
-        float pressure_bar_smoothed = (voltage_from_smoothed / 10.0f) * DEFAULT_RANGE_BAR;
-
-        JsonObject val = a.createNestedObject("value");
-        val["raw"] = roundToDecimals(pressure_bar_raw, 2);
-        val["filtered"] = roundToDecimals(pressure_bar_smoothed, 2);
+        a["enabled"] = (ads.flags & SENSOR_FLAG_DISABLED) ? 0 : 1;
+        a["status"] = sensorStatusString(ads.flags);
+        if (ads.health) healthCodesToJson(ads.health, a["health"].to<JsonArray>());
+
+        JsonObject val = a["value"].to<JsonObject>();
+        val["raw"] = roundToDecimals(ads.pressure_raw, 2);
+        val["filtered"] = roundToDecimals(ads.pressure, 2);
         a["unit"] = "bar";
     }
 
+    // DI pulse counters -> raw = pulse count, filtered = total in engineering units
+    for (int i = 0; i < snap.num_di; ++i) {
+        const DiSnapshot &di = snap.di[i];
+        bool enabled = !(di.flags & SENSOR_FLAG_DISABLED);
+        if (enabledOnly && !enabled) continue;
+        if (!(tagMask & (1UL << reportTagDi(i)))) continue;
+        PulseCounterConfig cfg = getPulseCounterConfig(i);
+        JsonObject d = arr.add<JsonObject>();
+        d["id"] = String("DI") + String(i + 1);
+        d["source"] = "pulse";
+        d["enabled"] = enabled ? 1 : 0;
+
+        JsonObject val = d["value"].to<JsonObject>();
+        val["raw"] = di.count;
+        val["filtered"] = roundToDecimals(di.total, 3);
+        val["rate_per_hour"] = roundToDecimals(di.rate_per_hour, 3);
+        d["unit"] = cfg.unit;
+    }
+
     doc["tags_total"] = arr.size();
 
     String jsonPayload;
@@ -249,3 +263,72 @@ void sendHttpNotificationBatch(int numSensors, int sensorIndices[], int rawADC[]
     }
 }
 
+
+// --- Priority alarm notifications ---
+// Rule transitions bypass the batch interval: a dedicated task waits on the
+// alarm event queue and pushes each event to SSE and the webhook at once.
+static TaskHandle_t alarmNotifierTask = nullptr;
+static portMUX_TYPE alarmNotifyMux = portMUX_INITIALIZER_UNLOCKED;
+static AlarmNotifierStats alarmNotifyStats;
+
+static void deliverAlarmEvent(const AlarmEvent &event) {
+    JsonDocument doc;
+    doc["timestamp"] = getIsoTimestamp();
+    doc["rtu"] = String(getChipId());
+    doc["type"] = "alarm";
+    doc["priority"] = "high";
+    alarmEventToJson(event, doc["event"].to<JsonObject>());
+    String payload;
+    serializeJson(doc, payload);
+
+    pushSensorsAlarmEvent(payload);
+    if (notificationMode & NOTIF_MODE_SERIAL) {
+        Serial.print("Alarm (serial): ");
+        Serial.println(payload);
+    }
+    if (!(notificationMode & NOTIF_MODE_WEBHOOK)) return;
+
+    int code = postJsonToWebhook(payload);
+    if (code < 200 || code >= 300) {
+        // Keep the event: the outbound queue retries it with backoff
+        bool queued = appendPendingNotification(payload);
+        portENTER_CRITICAL(&alarmNotifyMux);
+        alarmNotifyStats.failed++;
+        if (queued) alarmNotifyStats.requeued++;
+        else alarmNotifyStats.lost++;
+        portEXIT_CRITICAL(&alarmNotifyMux);
+        return;
+    }
+    uint32_t latency = millis() - event.millis_at;
+    portENTER_CRITICAL(&alarmNotifyMux);
+    alarmNotifyStats.sent++;
+    alarmNotifyStats.last_latency_ms = latency;
+    if (latency > alarmNotifyStats.max_latency_ms) alarmNotifyStats.max_latency_ms = latency;
+    portEXIT_CRITICAL(&alarmNotifyMux);
+}
+
+static void alarmNotifierLoop(void *) {
+    AlarmEvent event;
+    for (;;) {
+        if (waitAlarmEvent(event, 1000)) deliverAlarmEvent(event);
+    }
+}
+
+bool startAlarmNotifier() {
+    if (alarmNotifierTask) return true;
+    BaseType_t ok = xTaskCreatePinnedToCore(alarmNotifierLoop, "alarm_notify", NOTIFY_TASK_STACK, nullptr,
+                                            NOTIFY_TASK_PRIORITY, &alarmNotifierTask, NOTIFY_TASK_CORE);
+    if (ok != pdPASS) {
+        alarmNotifierTask = nullptr;
+        Serial.println("[NOTIFY] Failed to create alarm notifier task");
+        return false;
+    }
+    return true;
+}
+
+AlarmNotifierStats getAlarmNotifierStats() {
+    portENTER_CRITICAL(&alarmNotifyMux);
+    AlarmNotifierStats out = alarmNotifyStats;
+    portEXIT_CRITICAL(&alarmNotifyMux);
+    return out;
+}
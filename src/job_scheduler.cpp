@@ -0,0 +1,137 @@
+#include "job_scheduler.h"
+
+JobScheduler::JobScheduler() {}
+
+int64_t JobScheduler::firstDueAtOrAfter(const Job &job, int64_t nowUs) const {
+    int64_t periodUs = (int64_t)job.info.period_ms * 1000;
+    int64_t base = anchorUs_ + (int64_t)job.info.phase_ms * 1000;
+    if (nowUs <= base) return base;
+    int64_t k = (nowUs - base + periodUs - 1) / periodUs;
+    return base + k * periodUs;
+}
+
+int JobScheduler::add(const char *name, uint32_t periodMs, uint32_t phaseMs, JobFn fn, void *ctx, int64_t nowUs) {
+    if (periodMs == 0 || fn == nullptr) return -1;
+    if (anchorUs_ < 0) anchorUs_ = nowUs;
+
+    Job job;
+    job.info.name = name;
+    job.info.period_ms = periodMs;
+    job.info.phase_ms = phaseMs % periodMs;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.info.next_due_us = firstDueAtOrAfter(job, nowUs);
+
+    int id = (int)jobs_.size();
+    jobs_.push_back(job);
+    heap_.push_back(id);
+    heapPos_.push_back(heap_.size() - 1);
+    siftUp(heap_.size() - 1);
+    return id;
+}
+
+bool JobScheduler::setPeriod(int id, uint32_t periodMs, uint32_t phaseMs, int64_t nowUs) {
+    if (id < 0 || id >= (int)jobs_.size() || periodMs == 0) return false;
+    Job &job = jobs_[id];
+    job.info.period_ms = periodMs;
+    job.info.phase_ms = phaseMs % periodMs;
+    int64_t oldDue = job.info.next_due_us;
+    job.info.next_due_us = firstDueAtOrAfter(job, nowUs);
+    size_t pos = heapPos_[id];
+    if (job.info.next_due_us < oldDue) siftUp(pos);
+    else siftDown(pos);
+    return true;
+}
+
+void JobScheduler::clear() {
+    jobs_.clear();
+    heap_.clear();
+    heapPos_.clear();
+    anchorUs_ = -1;
+}
+
+int64_t JobScheduler::nextDueUs() const {
+    if (heap_.empty()) return INT64_MAX;
+    return jobs_[heap_[0]].info.next_due_us;
+}
+
+int JobScheduler::runDue(int64_t nowUs) {
+    int ran = 0;
+    // Bound the pass so a job rescheduled into the past cannot spin forever
+    size_t budget = heap_.size();
+    while (!heap_.empty() && budget-- > 0) {
+        int id = heap_[0];
+        Job &job = jobs_[id];
+        if (job.info.next_due_us > nowUs) break;
+
+        int64_t due = job.info.next_due_us;
+        int32_t late = (int32_t)(nowUs - due);
+        job.info.last_late_us = late;
+        if (late > job.info.max_late_us) job.info.max_late_us = late;
+        job.fn(job.ctx, due);
+        job.info.runs++;
+        ran++;
+
+        // Next grid point strictly after now; count the ones we jumped over
+        int64_t periodUs = (int64_t)job.info.period_ms * 1000;
+        int64_t next = due + periodUs;
+        if (next <= nowUs) {
+            int64_t missed = (nowUs - next) / periodUs + 1;
+            job.info.skipped += (uint32_t)missed;
+            next += missed * periodUs;
+        }
+        job.info.next_due_us = next;
+        siftDown(0);
+    }
+    return ran;
+}
+
+bool JobScheduler::getInfo(int id, JobInfo &out) const {
+    if (id < 0 || id >= (int)jobs_.size()) return false;
+    out = jobs_[id].info;
+    return true;
+}
+
+uint32_t JobScheduler::minPeriodMs() const {
+    uint32_t best = 0;
+    for (const Job &job : jobs_) {
+        if (best == 0 || job.info.period_ms < best) best = job.info.period_ms;
+    }
+    return best;
+}
+
+bool JobScheduler::less(int a, int b) const {
+    return jobs_[a].info.next_due_us < jobs_[b].info.next_due_us;
+}
+
+void JobScheduler::swapAt(size_t i, size_t j) {
+    int a = heap_[i];
+    int b = heap_[j];
+    heap_[i] = b;
+    heap_[j] = a;
+    heapPos_[b] = i;
+    heapPos_[a] = j;
+}
+
+void JobScheduler::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!less(heap_[i], heap_[parent])) break;
+        swapAt(i, parent);
+        i = parent;
+    }
+}
+
+void JobScheduler::siftDown(size_t i) {
+    size_t n = heap_.size();
+    for (;;) {
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        size_t smallest = i;
+        if (l < n && less(heap_[l], heap_[smallest])) smallest = l;
+        if (r < n && less(heap_[r], heap_[smallest])) smallest = r;
+        if (smallest == i) break;
+        swapAt(i, smallest);
+        i = smallest;
+    }
+}
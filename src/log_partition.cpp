@@ -0,0 +1,314 @@
+#include "log_partition.h"
+
+#include <SD.h>
+#include <algorithm>
+#include <stdlib.h>
+
+namespace {
+
+const time_t MIN_VALID_EPOCH = 1600000000;
+const char *const STREAM_EXT[LOG_STREAM_COUNT] = {"csv", "log", "sns"};
+const char *const INDEX_EXT = "idx";
+// Index entries read per SD access while seeking
+const int SEEK_CHUNK = 32;
+
+// Month (tm_year * 12 + tm_mon) whose directory ensureLogPartitionDir() last
+// made sure of; one directory serves ~720 hours. Retention clears it
+// whenever it removes a directory.
+uint32_t readyMonth = UINT32_MAX;
+
+void removeDir(const char *path) {
+    SD.rmdir(path);
+    forgetLogPartitionDirs();
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int32_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void hourToTm(uint32_t hour, struct tm &tmv) {
+    time_t t = (time_t)hour * 3600;
+    gmtime_r(&t, &tmv);
+}
+
+// Parse exactly `digits` decimal digits; -1 otherwise
+int parseNumber(const char *s, int digits) {
+    int v = 0;
+    for (int i = 0; i < digits; ++i) {
+        if (s[i] < '0' || s[i] > '9') return -1;
+        v = v * 10 + (s[i] - '0');
+    }
+    return v;
+}
+
+// Entry name without any leading directories (older cores return full paths)
+const char *baseName(const char *name) {
+    const char *slash = strrchr(name, '/');
+    return slash ? slash + 1 : name;
+}
+
+// Numeric subdirectory names of `path` with `digits` digits, ascending
+std::vector<int> listNumberDirs(const char *path, int digits) {
+    std::vector<int> out;
+    File dir = SD.open(path);
+    if (!dir || !dir.isDirectory()) return out;
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char *name = baseName(entry.name());
+        if (entry.isDirectory() && strlen(name) == (size_t)digits) {
+            int v = parseNumber(name, digits);
+            if (v >= 0) out.push_back(v);
+        }
+        entry.close();
+    }
+    dir.close();
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Hours of the "DD-HH.<ext>" files in a month directory (`ext` null = any),
+// ascending and unique
+std::vector<uint32_t> listMonthHours(int year, int month, const char *ext) {
+    std::vector<uint32_t> out;
+    char path[LOG_PARTITION_PATH_LEN];
+    snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d/%02d", year, month);
+    File dir = SD.open(path);
+    if (!dir || !dir.isDirectory()) return out;
+    int32_t monthDays = daysFromCivil(year, month, 1);
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char *name = baseName(entry.name());
+        bool match = !entry.isDirectory() && strlen(name) == 9 && name[2] == '-' && name[5] == '.' &&
+                     (!ext || strcmp(name + 6, ext) == 0);
+        int day = match ? parseNumber(name, 2) : -1;
+        int hour = match ? parseNumber(name + 3, 2) : -1;
+        if (day >= 1 && day <= 31 && hour >= 0 && hour <= 23) {
+            out.push_back((uint32_t)(monthDays + day - 1) * 24 + hour);
+        }
+        entry.close();
+    }
+    dir.close();
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+void partitionPath(uint32_t hour, const char *ext, char *out, size_t len) {
+    struct tm tmv;
+    hourToTm(hour, tmv);
+    snprintf(out, len, LOG_PARTITION_DIR "/%04d/%02d/%02d-%02d.%s",
+             tmv.tm_year + 1900, tmv.tm_mon + 1, tmv.tm_mday, tmv.tm_hour, ext);
+}
+
+void removeHour(uint32_t hour) {
+    char path[LOG_PARTITION_PATH_LEN];
+    for (int s = 0; s < LOG_STREAM_COUNT; ++s) {
+        partitionPath(hour, STREAM_EXT[s], path, sizeof(path));
+        SD.remove(path);
+    }
+    partitionPath(hour, INDEX_EXT, path, sizeof(path));
+    SD.remove(path);
+}
+
+bool dirEmpty(const char *path) {
+    File dir = SD.open(path);
+    if (!dir) return false;
+    File entry = dir.openNextFile();
+    bool empty = !entry;
+    if (entry) entry.close();
+    dir.close();
+    return empty;
+}
+
+uint64_t freeBytes(uint64_t total) {
+    uint64_t used = SD.usedBytes();
+    return used < total ? total - used : 0;
+}
+
+} // namespace
+
+uint32_t logPartitionHour(time_t epoch) {
+    return epoch >= MIN_VALID_EPOCH ? (uint32_t)(epoch / 3600) : 0;
+}
+
+void logPartitionPath(LogStream stream, uint32_t hour, char *out, size_t len) {
+    partitionPath(hour, STREAM_EXT[stream < LOG_STREAM_COUNT ? stream : 0], out, len);
+}
+
+void logIndexPath(uint32_t hour, char *out, size_t len) {
+    partitionPath(hour, INDEX_EXT, out, len);
+}
+
+bool ensureLogPartitionDir(uint32_t hour) {
+    struct tm tmv;
+    hourToTm(hour, tmv);
+    uint32_t month = (uint32_t)(tmv.tm_year * 12 + tmv.tm_mon);
+    if (month == readyMonth) return true;
+    char path[LOG_PARTITION_PATH_LEN];
+    if (!SD.exists(LOG_PARTITION_DIR) && !SD.mkdir(LOG_PARTITION_DIR)) return false;
+    snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d", tmv.tm_year + 1900);
+    if (!SD.exists(path) && !SD.mkdir(path)) return false;
+    snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d/%02d", tmv.tm_year + 1900, tmv.tm_mon + 1);
+    if (!SD.exists(path) && !SD.mkdir(path)) return false;
+    readyMonth = month;
+    return true;
+}
+
+void forgetLogPartitionDirs() {
+    readyMonth = UINT32_MAX;
+}
+
+std::vector<uint32_t> listLogPartitions(LogStream stream, uint32_t fromHour, uint32_t toHour) {
+    std::vector<uint32_t> out;
+    if (stream >= LOG_STREAM_COUNT || fromHour > toHour) return out;
+    struct tm from, to;
+    hourToTm(fromHour, from);
+    hourToTm(toHour, to);
+    int fromMonth = from.tm_year * 12 + from.tm_mon;
+    int toMonth = to.tm_year * 12 + to.tm_mon;
+    // Walk only the directories that exist
+    for (int year : listNumberDirs(LOG_PARTITION_DIR, 4)) {
+        if (year - 1900 < from.tm_year || year - 1900 > to.tm_year) continue;
+        char path[LOG_PARTITION_PATH_LEN];
+        snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d", year);
+        for (int month : listNumberDirs(path, 2)) {
+            int key = (year - 1900) * 12 + month - 1;
+            if (key < fromMonth || key > toMonth) continue;
+            for (uint32_t hour : listMonthHours(year, month, STREAM_EXT[stream])) {
+                if (hour >= fromHour && hour <= toHour) out.push_back(hour);
+            }
+        }
+    }
+    return out;
+}
+
+uint32_t logIndexSeek(LogStream stream, uint32_t hour, uint32_t epoch) {
+    char path[LOG_PARTITION_PATH_LEN];
+    logIndexPath(hour, path, sizeof(path));
+    File f = SD.open(path, FILE_READ);
+    if (!f) return 0;
+    uint32_t best = 0;
+    LogIndexEntry chunk[SEEK_CHUNK];
+    bool done = false;
+    while (!done) {
+        int n = f.read(reinterpret_cast<uint8_t *>(chunk), sizeof(chunk)) / (int)sizeof(LogIndexEntry);
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (chunk[i].stream != stream) continue;
+            // Entries of a stream are in time order; the first one not
+            // strictly older than `epoch` ends the search
+            if (chunk[i].epoch >= epoch) {
+                done = true;
+                break;
+            }
+            best = chunk[i].offset;
+        }
+    }
+    f.close();
+    return best;
+}
+
+bool appendLogIndex(uint32_t hour, const LogIndexEntry *entries, int count) {
+    if (count <= 0) return true;
+    char path[LOG_PARTITION_PATH_LEN];
+    logIndexPath(hour, path, sizeof(path));
+    File f = SD.open(path, FILE_APPEND);
+    if (!f) return false;
+    size_t bytes = (size_t)count * sizeof(LogIndexEntry);
+    bool ok = f.write(reinterpret_cast<const uint8_t *>(entries), bytes) == bytes;
+    f.close();
+    return ok;
+}
+
+int removeLogPartitions(LogStream stream) {
+    int removed = 0;
+    char path[LOG_PARTITION_PATH_LEN];
+    for (uint32_t hour : listLogPartitions(stream, 0, UINT32_MAX)) {
+        logPartitionPath(stream, hour, path, sizeof(path));
+        if (SD.remove(path)) removed++;
+    }
+    return removed;
+}
+
+void formatLogTimestamp(int64_t epochMs, char *out, size_t len) {
+    int64_t secs = epochMs >= 0 ? epochMs / 1000 : (epochMs - 999) / 1000;
+    time_t t = (time_t)secs;
+    struct tm tmv;
+    gmtime_r(&t, &tmv);
+    snprintf(out, len, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tmv.tm_year + 1900, tmv.tm_mon + 1,
+             tmv.tm_mday, tmv.tm_hour, tmv.tm_min, tmv.tm_sec, (int)(epochMs - secs * 1000));
+}
+
+bool parseLogTimestamp(const char *text, size_t len, int64_t &epochMs) {
+    if (len < 19 || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':' ||
+        text[16] != ':') return false;
+    int year = parseNumber(text, 4);
+    int month = parseNumber(text + 5, 2);
+    int day = parseNumber(text + 8, 2);
+    int hour = parseNumber(text + 11, 2);
+    int minute = parseNumber(text + 14, 2);
+    int second = parseNumber(text + 17, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 || second < 0 || second > 60) return false;
+    int ms = 0;
+    if (len >= 23 && text[19] == '.') {
+        ms = parseNumber(text + 20, 3);
+        if (ms < 0) return false;
+    }
+    epochMs = (((int64_t)daysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60 + second;
+    epochMs = epochMs * 1000 + ms;
+    return true;
+}
+
+int enforceLogRetention(uint32_t keepHour) {
+    uint64_t total = SD.totalBytes();
+    if (total == 0) return 0;
+    uint64_t minFree = total / 100 * LOG_RETENTION_MIN_FREE_PCT;
+    if (freeBytes(total) >= minFree) return 0;
+
+    int removed = 0;
+    char path[LOG_PARTITION_PATH_LEN];
+    while (removed < LOG_RETENTION_MAX_HOURS_PER_PASS) {
+        std::vector<int> years = listNumberDirs(LOG_PARTITION_DIR, 4);
+        if (years.empty()) break;
+        int year = years.front();
+        snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d", year);
+        std::vector<int> months = listNumberDirs(path, 2);
+        if (months.empty()) {
+            removeDir(path);
+            continue;
+        }
+        int month = months.front();
+        bool reachedKeep = false;
+        bool enough = false;
+        for (uint32_t hour : listMonthHours(year, month, nullptr)) {
+            if (hour >= keepHour) {
+                reachedKeep = true;
+                break;
+            }
+            removeHour(hour);
+            removed++;
+            if (freeBytes(total) >= minFree) enough = true;
+            if (enough || removed >= LOG_RETENTION_MAX_HOURS_PER_PASS) break;
+        }
+        snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d/%02d", year, month);
+        if (dirEmpty(path)) {
+            removeDir(path);
+            snprintf(path, sizeof(path), LOG_PARTITION_DIR "/%04d", year);
+            if (dirEmpty(path)) removeDir(path);
+        } else if (!enough && !reachedKeep && removed < LOG_RETENTION_MAX_HOURS_PER_PASS) {
+            // Something other than a partition keeps the month; stop rather than loop
+            break;
+        }
+        if (enough || reachedKeep) break;
+    }
+    if (removed > 0) {
+        Serial.printf("[LOGS] Retention removed %d hour(s); %llu KB free\n", removed,
+                      (unsigned long long)(freeBytes(total) / 1024));
+    }
+    return removed;
+}
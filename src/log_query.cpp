@@ -0,0 +1,378 @@
+#include "log_query.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "log_partition.h"
+
+namespace {
+
+const char *const BIN_PATHS[] = {BINLOG_PREV_PATH, BINLOG_PATH};
+
+bool isHeaderLine(const char *line) {
+    return strncmp(line, "timestamp", 9) == 0;
+}
+
+// `name` selected by `token`: equal, or `token` is its tag ("AI1" for "AI1.raw")
+bool columnMatches(const char *name, const String &token) {
+    size_t len = token.length();
+    if (strncasecmp(name, token.c_str(), len) != 0) return false;
+    return name[len] == '\0' || (name[len] == '.' && token.indexOf('.') < 0);
+}
+
+} // namespace
+
+bool selectLogColumns(const String &list, const BinlogColumn *schema, int count,
+                      std::vector<BinlogColumn> &out, String &error) {
+    out.clear();
+    if (list.length() == 0 || list == "*") {
+        out.assign(schema, schema + count);
+        return count > 0;
+    }
+    int start = 0;
+    while (start <= (int)list.length()) {
+        int comma = list.indexOf(',', start);
+        if (comma < 0) comma = list.length();
+        String token = list.substring(start, comma);
+        token.trim();
+        start = comma + 1;
+        if (token.length() == 0) continue;
+        bool found = false;
+        for (int c = 0; c < count; ++c) {
+            if (!columnMatches(schema[c].name, token)) continue;
+            found = true;
+            bool selected = false;
+            for (const BinlogColumn &col : out) {
+                if (strcmp(col.name, schema[c].name) == 0) selected = true;
+            }
+            if (!selected) out.push_back(schema[c]);
+        }
+        if (!found) {
+            error = "unknown tag '" + token + "'";
+            return false;
+        }
+    }
+    if (out.empty()) {
+        error = "no tags given";
+        return false;
+    }
+    return true;
+}
+
+LogQuery::LogQuery(LogQuerySource source, LogQueryFormat format, int64_t fromMs, int64_t toMs,
+                   uint32_t stepSec, const std::vector<BinlogColumn> &columns)
+    : source(source), format(format), fromMs(fromMs), toMs(toMs), stepMs((int64_t)stepSec * 1000),
+      cols(columns) {
+    if (cols.size() > (size_t)BINLOG_MAX_COLUMNS) cols.resize(BINLOG_MAX_COLUMNS);
+    allMissing = cols.size() >= 32 ? 0xFFFFFFFFUL : (1UL << cols.size()) - 1;
+    memset(outColumn, -1, sizeof(outColumn));
+    pending.reserve(LOG_QUERY_READ_BYTES);
+    if (source == LOG_QUERY_SOURCE_CSV && toMs >= 0) {
+        hours = listLogPartitions(LOG_STREAM_DATA, logPartitionHour((time_t)(fromMs / 1000)),
+                                  logPartitionHour((time_t)(toMs / 1000)));
+    }
+}
+
+LogQuery::~LogQuery() {
+    closeSources();
+}
+
+void LogQuery::closeSources() {
+    if (file) file.close();
+    reader.close();
+    binOpen = false;
+}
+
+void LogQuery::mapColumn(const char *name, int sourceColumn) {
+    if (sourceColumn < 0 || sourceColumn >= MAX_SOURCE_COLUMNS) return;
+    outColumn[sourceColumn] = -1;
+    for (size_t c = 0; c < cols.size(); ++c) {
+        if (strcmp(cols[c].name, name) == 0) {
+            outColumn[sourceColumn] = (int8_t)c;
+            return;
+        }
+    }
+}
+
+// The header line names the columns of the rows that follow it
+void LogQuery::mapCsvHeader() {
+    memset(outColumn, -1, sizeof(outColumn));
+    char *field = strchr(line, ',');
+    int column = 0;
+    while (field) {
+        char *name = field + 1;
+        field = strchr(name, ',');
+        if (field) *field = '\0';
+        mapColumn(name, column++);
+    }
+}
+
+// Next line of the open partition into `line`; false at its end. Lines that
+// do not fit are skipped whole.
+bool LogQuery::readLine() {
+    size_t len = 0;
+    bool overflow = false;
+    for (;;) {
+        if (readPos >= readLen) {
+            int n = file.read(readBuf, sizeof(readBuf));
+            readPos = 0;
+            readLen = n > 0 ? (size_t)n : 0;
+            if (!readLen) {
+                if (len == 0 || overflow) return false;
+                break;
+            }
+        }
+        char c = (char)readBuf[readPos++];
+        if (c == '\n') {
+            if (!overflow) break;
+            len = 0;
+            overflow = false;
+            continue;
+        }
+        if (len + 1 < sizeof(line)) line[len++] = c;
+        else overflow = true;
+    }
+    if (len && line[len - 1] == '\r') len--;
+    line[len] = '\0';
+    return true;
+}
+
+bool LogQuery::openCsvPartition() {
+    if (file) file.close();
+    while (hourIndex < hours.size()) {
+        uint32_t hour = hours[hourIndex++];
+        char path[LOG_PARTITION_PATH_LEN];
+        logPartitionPath(LOG_STREAM_DATA, hour, path, sizeof(path));
+        file = SD.open(path, FILE_READ);
+        if (!file) continue;
+        readPos = readLen = 0;
+        memset(outColumn, -1, sizeof(outColumn));
+        bool header = readLine() && isHeaderLine(line);
+        if (header) mapCsvHeader();
+        // Skip the rows the index places before `from`
+        uint32_t start = logIndexSeek(LOG_STREAM_DATA, hour, (uint32_t)(fromMs / 1000));
+        if (start > 0 || !header) {
+            file.seek(start);
+            readPos = readLen = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool LogQuery::nextCsvRecord(int64_t &epochMs, double *values, uint32_t &missing) {
+    for (;;) {
+        if (!file && !openCsvPartition()) return false;
+        if (!readLine()) {
+            file.close();
+            continue;
+        }
+        if (isHeaderLine(line)) {
+            mapCsvHeader();
+            continue;
+        }
+        char *field = strchr(line, ',');
+        size_t stampLen = field ? (size_t)(field - line) : strlen(line);
+        // Rows written before the clock was set carry no timestamp
+        if (!parseLogTimestamp(line, stampLen, epochMs)) continue;
+        missing = allMissing;
+        int column = 0;
+        while (field) {
+            char *text = field + 1;
+            field = strchr(text, ',');
+            int out = column < MAX_SOURCE_COLUMNS ? outColumn[column] : -1;
+            column++;
+            if (out < 0 || text == field || *text == '\0') continue;
+            char *end;
+            double v = strtod(text, &end);
+            if (end == text) continue;
+            values[out] = v;
+            missing &= ~(1UL << out);
+        }
+        return true;
+    }
+}
+
+bool LogQuery::openBinFile() {
+    reader.close();
+    binOpen = false;
+    while (binFile < 2) {
+        if (!reader.open(BIN_PATHS[binFile++])) continue;
+        const BinlogFileHeader &hdr = reader.header();
+        memset(outColumn, -1, sizeof(outColumn));
+        for (int c = 0; c < hdr.columns; ++c) {
+            char name[BINLOG_COLUMN_NAME_LEN + 1];
+            memcpy(name, hdr.column[c].name, BINLOG_COLUMN_NAME_LEN);
+            name[BINLOG_COLUMN_NAME_LEN] = '\0';
+            mapColumn(name, c);
+            scale[c] = pow(10.0, hdr.column[c].decimals);
+        }
+        reader.seekTime(fromMs);
+        binOpen = true;
+        return true;
+    }
+    return false;
+}
+
+bool LogQuery::nextBinRecord(int64_t &epochMs, double *values, uint32_t &missing) {
+    for (;;) {
+        if (!binOpen && !openBinFile()) return false;
+        uint32_t absent;
+        if (!reader.next(epochMs, rawValues, absent)) {
+            reader.close();
+            binOpen = false;
+            continue;
+        }
+        missing = allMissing;
+        int columns = reader.header().columns;
+        for (int c = 0; c < columns; ++c) {
+            int out = outColumn[c];
+            if (out < 0 || (absent & (1UL << c))) continue;
+            values[out] = rawValues[c] / scale[c];
+            missing &= ~(1UL << out);
+        }
+        return true;
+    }
+}
+
+bool LogQuery::nextRecord(int64_t &epochMs, double *values, uint32_t &missing) {
+    if (source == LOG_QUERY_SOURCE_BIN) return nextBinRecord(epochMs, values, missing);
+    return nextCsvRecord(epochMs, values, missing);
+}
+
+void LogQuery::append(const char *text) {
+    pending.insert(pending.end(), text, text + strlen(text));
+}
+
+void LogQuery::appendHeader() {
+    if (format == LOG_QUERY_FORMAT_BIN) return;
+    if (format == LOG_QUERY_FORMAT_CSV) {
+        append("timestamp");
+        for (const BinlogColumn &col : cols) {
+            append(",");
+            append(col.name);
+        }
+        append("\n");
+        return;
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"from\":%lld,\"to\":%lld,\"step\":%lld,\"source\":\"%s\",\"columns\":[",
+             (long long)(fromMs / 1000), (long long)(toMs / 1000), (long long)(stepMs / 1000),
+             source == LOG_QUERY_SOURCE_BIN ? "bin" : "csv");
+    append(buf);
+    for (size_t c = 0; c < cols.size(); ++c) {
+        append(c ? ",\"" : "\"");
+        append(cols[c].name);
+        append("\"");
+    }
+    append("],\"rows\":[");
+}
+
+void LogQuery::appendRow(int64_t epochMs, const double *values, uint32_t missing) {
+    if (format == LOG_QUERY_FORMAT_BIN) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&epochMs);
+        pending.insert(pending.end(), bytes, bytes + sizeof(epochMs));
+        for (size_t c = 0; c < cols.size(); ++c) {
+            float v = (missing & (1UL << c)) ? NAN : (float)values[c];
+            bytes = reinterpret_cast<const uint8_t *>(&v);
+            pending.insert(pending.end(), bytes, bytes + sizeof(v));
+        }
+        rows++;
+        return;
+    }
+    char buf[32];
+    if (format == LOG_QUERY_FORMAT_CSV) {
+        formatLogTimestamp(epochMs, buf, sizeof(buf));
+    } else {
+        snprintf(buf, sizeof(buf), "%s[%lld", rows ? "," : "", (long long)epochMs);
+    }
+    append(buf);
+    for (size_t c = 0; c < cols.size(); ++c) {
+        if (missing & (1UL << c)) {
+            append(format == LOG_QUERY_FORMAT_CSV ? "," : ",null");
+            continue;
+        }
+        // Averages keep more digits than the stored resolution
+        if (stepMs > 0) snprintf(buf, sizeof(buf), ",%.6g", values[c]);
+        else snprintf(buf, sizeof(buf), ",%.*f", cols[c].decimals, values[c]);
+        append(buf);
+    }
+    append(format == LOG_QUERY_FORMAT_CSV ? "\n" : "]");
+    rows++;
+}
+
+void LogQuery::appendFooter() {
+    if (format == LOG_QUERY_FORMAT_JSON) append("]}");
+}
+
+void LogQuery::flushBucket() {
+    if (bucketMs < 0) return;
+    double values[BINLOG_MAX_COLUMNS];
+    uint32_t missing = allMissing;
+    for (size_t c = 0; c < cols.size(); ++c) {
+        if (!count[c]) continue;
+        values[c] = sum[c] / count[c];
+        missing &= ~(1UL << c);
+    }
+    appendRow(bucketMs, values, missing);
+    bucketMs = -1;
+}
+
+// Queue the next piece of the body; false once everything was queued or the
+// record budget of this fill() is spent
+bool LogQuery::refill() {
+    pending.clear();
+    offset = 0;
+    if (finished) return false;
+    if (!headerSent) {
+        headerSent = true;
+        appendHeader();
+        if (!pending.empty()) return true;
+    }
+    int64_t epochMs;
+    double values[BINLOG_MAX_COLUMNS];
+    uint32_t missing;
+    while (pending.empty() && budget > 0) {
+        budget--;
+        // Records are in log order; the first one past `to` ends the query
+        if (!nextRecord(epochMs, values, missing) || epochMs > toMs) {
+            flushBucket();
+            appendFooter();
+            finished = true;
+            closeSources();
+            break;
+        }
+        if (epochMs < fromMs) continue;
+        if (stepMs <= 0) {
+            appendRow(epochMs, values, missing);
+            continue;
+        }
+        int64_t bucket = fromMs + (epochMs - fromMs) / stepMs * stepMs;
+        if (bucket != bucketMs) {
+            flushBucket();
+            bucketMs = bucket;
+            memset(sum, 0, sizeof(sum));
+            memset(count, 0, sizeof(count));
+        }
+        for (size_t c = 0; c < cols.size(); ++c) {
+            if (missing & (1UL << c)) continue;
+            sum[c] += values[c];
+            count[c]++;
+        }
+    }
+    return !pending.empty();
+}
+
+size_t LogQuery::fill(uint8_t *buffer, size_t maxLen) {
+    budget = LOG_QUERY_RECORDS_PER_FILL;
+    size_t written = 0;
+    while (written < maxLen) {
+        if (offset >= pending.size() && !refill()) break;
+        size_t n = pending.size() - offset;
+        if (n > maxLen - written) n = maxLen - written;
+        memcpy(buffer + written, pending.data() + offset, n);
+        offset += n;
+        written += n;
+    }
+    return written;
+}
@@ -27,28 +27,46 @@
 #include "current_pressure_sensor.h"
 #include "device_id.h"
 #include "modbus_manager.h"
+#include "acquisition_task.h"
+#include "sensor_snapshot.h"
+#include "job_scheduler.h"
+#include "pulse_counter.h"
+#include "alarm_rules.h"
+#include "burst_capture.h"
+#include "report_filter.h"
+#include "history_rollup.h"
+#include "sensor_health.h"
+#include "binary_log.h"
+#include "log_partition.h"
+#include "esp_timer.h"
 
 #include "nvs_flash.h"
 #include "nvs_defaults.h"
 
 // Globals
 
-// Automatic SSE push tuning
-static float *lastSentValue = nullptr;             // last value we pushed for each sensor
-static unsigned long *lastSentMillis = nullptr;    // cooldown timer per sensor
-const float SSE_PUSH_DELTA = 0.02f; // push when value changes more than 0.02 (2% of full scale-ish)
-const unsigned long SSE_PUSH_COOLDOWN_MS = 2000; // don't push more than once per sensor within 2s
+// Previous CSV row (and its snapshot for the binary log), written late when a
+// tag reports it as a turning point
+static String heldLogRow;
+static SensorSnapshot heldLogSnap;
+static bool heldLogRowWritten = true;
 
 // Timers
 unsigned long previousSensorMillis = 0;
-unsigned long previousTimePrintMillis = 0;
-static unsigned long lastBatchNotificationMillis = 0;
+static uint32_t lastHandledSnapshotSeq = 0;
+static uint32_t lastHandledRecordSeq = 0;
 // Per-sensor settings (allocated in setup)
 static bool *sensorEnabled = nullptr;
 static unsigned long *sensorNotificationInterval = nullptr;
-static unsigned long *sensorLastNotificationMillis = nullptr;
+static bool *sensorNotificationDue = nullptr;
 static int configuredNumSensors = 0;
 
+// Housekeeping jobs run from loop(): per-sensor notification deadlines, batch
+// webhook, pending flush and time print. Rebuilt when an interval changes.
+static JobScheduler housekeeping;
+static int *notifyJobIds = nullptr;
+static volatile bool notifyScheduleDirty = false;
+
 
 // Flags
 
@@ -64,6 +82,111 @@ float convert010V(int adc, int channelIndex);
 
 
 
+// --- Housekeeping jobs ---
+static void notifyDueJob(void *ctx, int64_t) {
+    int i = (int)(intptr_t)ctx;
+    if (sensorEnabled && sensorEnabled[i]) sensorNotificationDue[i] = true;
+}
+
+static ReportPoint reportPointFor(const SensorSnapshot &snap, int tag) {
+    ReportPoint point;
+    point.value = reportTagValue(snap, tag, point.t_us);
+    point.seq = snap.seq;
+    return point;
+}
+
+// Only tags whose value moved past their deadband (or hit the heartbeat) go
+// into the batch; an all-quiet batch is not sent at all. The batch carries
+// current values, so a swinging-door turning point just includes the tag.
+static void batchNotificationJob(void *, int64_t) {
+    SensorSnapshot latest;
+    if (!getSensorSnapshot(latest)) return;
+    uint32_t tagMask = 0;
+    for (int tag = 0; tag < REPORT_MAX_TAGS; ++tag) {
+        ReportPoint point = reportPointFor(latest, tag);
+        ReportPoint held;
+        if (!isnan(point.value) && offerReportSample(REPORT_SINK_BATCH, tag, point, held)) tagMask |= 1UL << tag;
+    }
+    if (tagMask) sendHttpNotificationBatch(latest, true, tagMask);
+}
+
+// One datalog record per snapshot that carries news for at least one tag
+static void logRecordByException(const SensorSnapshot &snap, const String &row) {
+    uint8_t emit = 0;
+    int offered = 0;
+    for (int tag = 0; tag < REPORT_MAX_TAGS; ++tag) {
+        ReportPoint point = reportPointFor(snap, tag);
+        if (isnan(point.value)) continue;
+        offered++;
+        ReportPoint held;
+        emit |= offerReportSample(REPORT_SINK_LOG, tag, point, held);
+    }
+    if (offered == 0) emit = REPORT_EMIT_CURRENT; // nothing to compress on
+    if ((emit & REPORT_EMIT_HELD) && !heldLogRowWritten) logSensorRecord(heldLogSnap, heldLogRow);
+    if (emit & REPORT_EMIT_CURRENT) logSensorRecord(snap, row);
+    heldLogRow = row;
+    heldLogSnap = snap;
+    heldLogRowWritten = emit & REPORT_EMIT_CURRENT;
+}
+
+static void pushSensorDebug(int i, const ReportPoint &point, const AiSnapshot *ai) {
+    JsonDocument p;
+    p["pin_index"] = i;
+    p["tag"] = String("AI") + String(i + 1);
+    p["seq"] = point.seq;
+    p["pressure"] = roundToDecimals(point.value, 3);
+    if (ai) {
+        p["value"] = roundToDecimals(ai->value, 3);
+        p["smoothed"] = roundToDecimals(ai->smoothed, 3);
+        p["raw"] = ai->raw;
+    } else {
+        p["held"] = true;
+    }
+    String out; serializeJson(p, out);
+    pushSseDebugMessage("sensor_debug", out);
+}
+
+// Drain the outbound queue on SD a few batches at a time
+static void pendingFlushJob(void *, int64_t) {
+    if (getSdEnabled() && sdCardFound) {
+        if (!flushPendingNotifications() && WiFi.status() == WL_CONNECTED) {
+            Serial.println("Pending notifications flush failed (will retry later)");
+        }
+    }
+}
+
+static void timePrintJob(void *, int64_t) {
+    printCurrentTime();
+}
+
+static void pulsePersistJob(void *, int64_t) {
+    persistPulseCounters();
+}
+
+static void sampleStoreCheckpointJob(void *, int64_t) {
+    checkpointSampleStore();
+}
+
+static void binaryLogFlushJob(void *, int64_t) {
+    flushBinaryLog();
+}
+
+static void setupHousekeeping() {
+    int64_t nowUs = esp_timer_get_time();
+    housekeeping.clear();
+    for (int i = 0; i < configuredNumSensors; ++i) {
+        unsigned long interval = sensorNotificationInterval[i];
+        if (interval == 0) interval = HTTP_NOTIFICATION_INTERVAL;
+        notifyJobIds[i] = housekeeping.add("notify", interval, 0, notifyDueJob, (void *)(intptr_t)i, nowUs);
+    }
+    housekeeping.add("batch", HTTP_NOTIFICATION_INTERVAL, 0, batchNotificationJob, nullptr, nowUs);
+    housekeeping.add("flush", OUTQ_DRAIN_INTERVAL_MS, 0, pendingFlushJob, nullptr, nowUs);
+    housekeeping.add("time", PRINT_TIME_INTERVAL, 0, timePrintJob, nullptr, nowUs);
+    housekeeping.add("pulse", PULSE_PERSIST_INTERVAL_MS, 0, pulsePersistJob, nullptr, nowUs);
+    housekeeping.add("sstore", SAMPLE_STORE_CHECKPOINT_MS, 0, sampleStoreCheckpointJob, nullptr, nowUs);
+    housekeeping.add("binlog", BINLOG_FLUSH_MS, 0, binaryLogFlushJob, nullptr, nowUs);
+}
+
 // --- Main Setup & Loop ---
 void setup() {
     Serial.begin(115200);
@@ -115,7 +238,8 @@ void setup() {
     configuredNumSensors = numSensors;
     sensorEnabled = new bool[numSensors];
     sensorNotificationInterval = new unsigned long[numSensors];
-    sensorLastNotificationMillis = new unsigned long[numSensors];
+    sensorNotificationDue = new bool[numSensors];
+    notifyJobIds = new int[numSensors];
 
     for (int i = 0; i < numSensors; ++i) {
         String enKey = String(PREF_SENSOR_ENABLED_PREFIX) + String(i);
@@ -125,7 +249,8 @@ void setup() {
         unsigned long interval = loadULongFromNVSns("sensors", ivKey.c_str(), DEFAULT_SENSOR_NOTIFICATION_INTERVAL);
         sensorEnabled[i] = enabled;
         sensorNotificationInterval[i] = interval;
-        sensorLastNotificationMillis[i] = 0;
+        sensorNotificationDue[i] = false;
+        notifyJobIds[i] = -1;
         #if ENABLE_VERBOSE_LOGS
         Serial.printf("Sensor %d enabled=%d interval=%lu\n", i, enabled, interval);
         #endif
@@ -134,15 +259,7 @@ void setup() {
     // Initialize sensor runtime settings module
     initSensorRuntimeSettings();
 
-    // Allocate SSE push tracking arrays
-    if (configuredNumSensors > 0) {
-        lastSentValue = new float[configuredNumSensors];
-        lastSentMillis = new unsigned long[configuredNumSensors];
-        for (int i = 0; i < configuredNumSensors; ++i) {
-            lastSentValue[i] = NAN; // not sent yet
-            lastSentMillis[i] = 0;
-        }
-    }
+    setupReportFilters();
 
     setupTimeSync();
     setupAndConnectWiFi(); // Setup and connect to WiFi
@@ -167,6 +284,20 @@ void setup() {
     setupWebServer();
 
     setupModbus();
+
+    if (!setupPulseCounters()) {
+        Serial.println("Pulse counters unavailable");
+    }
+    setupAlarmRules();
+    startAlarmNotifier();
+
+    // Sampling runs on its own core, paced by a hardware timer, so blocking
+    // webhook/Modbus/WiFi work in loop() cannot stretch the sample period.
+    if (!startAcquisitionTask(SENSOR_READ_INTERVAL)) {
+        Serial.println("Acquisition task unavailable; sampling from loop()");
+    }
+
+    setupHousekeeping();
 }
 
 // --- Sensors runtime + persistence API (exposed via sensors_config.h) ---
@@ -199,7 +330,10 @@ unsigned long getSensorNotificationInterval(int index) {
 void setSensorNotificationInterval(int index, unsigned long interval) {
     if (!sensorNotificationInterval) return;
     if (index < 0 || index >= configuredNumSensors) return;
+    if (sensorNotificationInterval[index] == interval) return;
     sensorNotificationInterval[index] = interval;
+    // Called from the web server task; loop() owns the scheduler
+    notifyScheduleDirty = true;
 }
 
 void persistSensorSettings() {
@@ -211,197 +345,152 @@ void persistSensorSettings() {
     }
 }
 
-void loop() {
-    
+// One published snapshot: trend history and SSE on every update, CSV row and
+// pending notifications when it is a record
+static void handleSnapshot(const SensorSnapshot &snap, bool record) {
+    lastHandledSnapshotSeq = snap.seq;
+    if (record) lastHandledRecordSeq = snap.record_seq;
+    feedHistory(snap);
+    // Build CSV: timestamp, then for each sensor: raw, smoothed, voltage
+    String dataString = "";
+    if (record) {
+        // UTC with milliseconds, from when the snapshot was taken
+        char timestamp[32];
+        formatLogTimestamp(logRecordEpochMs(snap), timestamp, sizeof(timestamp));
+        dataString += timestamp;
+    }
 
-    loopTimeSync();
-    loopModbus();
+    // Collect enabled & due sensors for the pending notification; with
+    // report-by-exception a due sensor is only queued when its value moved
+    std::vector<int> dueSensorIndices;
+    std::vector<std::pair<int, ReportPoint>> heldPoints;
 
-    // Non-blocking sensor reading and logging
-    unsigned long currentMillis = millis();
-    static unsigned long lastPendingFlushMillis = 0;
+    for (int i = 0; i < snap.num_ai; ++i) {
+        const AiSnapshot &ai = snap.ai[i];
+        int raw = ai.raw;
+        float smoothed = ai.smoothed;
+        float volt = ai.value;
 
-    if (currentMillis - previousSensorMillis >= SENSOR_READ_INTERVAL) {
-        previousSensorMillis = currentMillis;
-        // Update all configured voltage sensors and collect logging values
-        for (int i = 0; i < getNumVoltageSensors(); ++i) {
-            updateVoltagePressureSensor(i);
-        }
-        // Build CSV: timestamp, then for each sensor: raw, smoothed, voltage
-        String dataString = "";
-        if (rtcFound) {
-            DateTime now = rtc.now();
-            char timestamp[25];
-            sprintf(timestamp, "%04d-%02d-%02dT%02d:%02d:%02d",
-                    now.year(), now.month(), now.day(),
-                    now.hour(), now.minute(), now.second());
-            dataString += timestamp;
+        if (record) dataString += "," + String(raw) + "," + String(smoothed) + "," + String(volt) + "," + String(ai.mv_raw) + "," + String(ai.mv_smoothed);
+        #if ENABLE_VERBOSE_LOGS
+        Serial.printf("AI%d Pin %d (raw): %d | (smoothed): %.2f | Voltage: %.3f V | mV_raw: %d mV | mV_smoothed: %d mV\n", i+1, getVoltageSensorPin(i), raw, smoothed, volt, ai.mv_raw, ai.mv_smoothed);
+        #endif
+
+        ReportPoint point = reportPointFor(snap, reportTagAi(i));
+        if (record && i < configuredNumSensors && sensorNotificationDue[i]) {
+            sensorNotificationDue[i] = false;
+            ReportPoint held;
+            uint8_t emit = isnan(point.value) ? REPORT_EMIT_CURRENT
+                                              : offerReportSample(REPORT_SINK_NOTIFY, reportTagAi(i), point, held);
+            if (emit & REPORT_EMIT_HELD) heldPoints.push_back(std::make_pair(i, held));
+            if (emit & REPORT_EMIT_CURRENT) dueSensorIndices.push_back(i);
         }
 
-        // Prepare arrays for batch notification only for enabled & due sensors
-        int totalSensors = getNumVoltageSensors();
-        int *rawVals = new int[totalSensors];
-        float *smoothedVals = new float[totalSensors];
-        float *voltVals = new float[totalSensors];
-        std::vector<int> dueSensorIndices;
-        int batchCount = 0;
-
-        unsigned long now = millis();
-        for (int i = 0; i < totalSensors; ++i) {
-            int raw = analogRead(getVoltageSensorPin(i));
-            float smoothed = getSmoothedADC(i);
-            float volt = getSmoothedVoltagePressure(i);
-
-            // Persist the sample into in-memory store for later averaging
-            addSample(i, raw, smoothed, volt);
-
-            int mv_raw = adcRawToMv(raw);
-            int mv_sm = adcRawToMv(static_cast<int>(round(smoothed)));
-            dataString += "," + String(raw) + "," + String(smoothed) + "," + String(volt) + "," + String(mv_raw) + "," + String(mv_sm);
-            #if ENABLE_VERBOSE_LOGS
-            Serial.printf("AI%d Pin %d (raw): %d | (smoothed): %.2f | Voltage: %.3f V | mV_raw: %d mV | mV_smoothed: %d mV\n", i+1, getVoltageSensorPin(i), raw, smoothed, volt, mv_raw, mv_sm);
-            #endif
-
-            if (sensorEnabled && sensorEnabled[i]) {
-                unsigned long interval = sensorNotificationInterval ? sensorNotificationInterval[i] : HTTP_NOTIFICATION_INTERVAL;
-                if (now - sensorLastNotificationMillis[i] >= interval) {
-                    dueSensorIndices.push_back(i);
-                    sensorLastNotificationMillis[i] = now; // Update timestamp immediately
-
-                    // Use averages from sample store for cleaner notification values if available
-                    float avgRaw, avgSmoothed, avgVolt;
-                    if (getAverages(i, avgRaw, avgSmoothed, avgVolt)) {
-                        rawVals[i] = static_cast<int>(round(avgRaw));
-                        smoothedVals[i] = avgSmoothed;
-                    } else {
-                        rawVals[i] = raw;
-                        smoothedVals[i] = smoothed;
-                    }
-                }
-            }
-
-            // Automatic SSE push on significant change (independent of HTTP notification)
-            if (lastSentValue && lastSentMillis) {
-                bool send = false;
-                float prev = lastSentValue[i];
-                unsigned long lm = lastSentMillis[i];
-                if (isnan(prev)) {
-                    // never sent before, send initial
-                    send = true;
-                } else {
-                    float diff = fabs(volt - prev);
-                    if (diff >= SSE_PUSH_DELTA) send = true;
-                }
-                if (send && (millis() - lm >= SSE_PUSH_COOLDOWN_MS)) {
-                    // Build simple JSON payload and push
-                    JsonDocument p;
-                    p["pin_index"] = i;
-                    p["tag"] = String("AI") + String(i + 1);
-                    p["value"] = roundToDecimals(volt, 3);
-                    p["smoothed"] = roundToDecimals(smoothed, 3);
-                    p["raw"] = raw;
-                    String out; serializeJson(p, out);
-                    pushSseDebugMessage("sensor_debug", out);
-                    lastSentValue[i] = volt;
-                    lastSentMillis[i] = millis();
-                }
-            }
+        // Automatic SSE push on significant change (independent of HTTP notification)
+        if (!isnan(point.value)) {
+            ReportPoint held;
+            uint8_t emit = offerReportSample(REPORT_SINK_SSE, reportTagAi(i), point, held);
+            if (emit & REPORT_EMIT_HELD) pushSensorDebug(i, held, nullptr);
+            if (emit & REPORT_EMIT_CURRENT) pushSensorDebug(i, point, &ai);
         }
+    }
 
-        if (!dueSensorIndices.empty()) {
+    if (!dueSensorIndices.empty() || !heldPoints.empty()) {
         // Build minimal batch JSON payload for pending notification storage
         JsonDocument doc;
         doc["timestamp"] = getIsoTimestamp();
-            doc["rtu"] = String(getChipId());
-            JsonArray tags = doc["tags"].to<JsonArray>();
-            for (int k = 0; k < (int)dueSensorIndices.size(); ++k) {
-                int si = dueSensorIndices[k];
-                JsonObject obj = tags.add<JsonObject>();
-                obj["id"] = String("AI") + String(si + 1);
-                obj["index"] = si;
-                obj["raw"] = rawVals[si];
-                obj["filtered"] = smoothedVals[si];
-                obj["value"] = getSmoothedVoltagePressure(si);
-            }
-            String payload;
-            serializeJson(doc, payload);
-
-            // Append pending notification to SD (backup)
-            appendPendingNotification(payload);
-
-            // Attempt immediate send as well
-            // sendHttpNotificationBatch(dueSensorIndices.size(), dueSensorIndices.data(), rawVals, smoothedVals);
+        doc["rtu"] = String(getChipId());
+        doc["seq"] = snap.seq;
+        JsonArray tags = doc["tags"].to<JsonArray>();
+        // Turning points of the trend, emitted one interval late
+        for (const auto &h : heldPoints) {
+            JsonObject obj = tags.add<JsonObject>();
+            obj["id"] = String("AI") + String(h.first + 1);
+            obj["index"] = h.first;
+            obj["seq"] = h.second.seq;
+            obj["pressure"] = h.second.value;
+            obj["held"] = true;
         }
-
-        delete[] rawVals;
-        delete[] smoothedVals;
-        delete[] voltVals;
-
-        flagSensorsSnapshotUpdate();
-
-        // Append ADS1115 A0/A1 readings (raw, mV, mA) to CSV and serial output
-        for (int ch = 0; ch <= 1; ++ch) {
-            int16_t rawAds = readAdsRaw(ch);
-            float mv = adsRawToMv(rawAds);
-            float shunt = getAdsShuntOhm(ch);
-            float ampGain = getAdsAmpGain(ch);
-            float ma = readAdsMa(ch, shunt, ampGain);
-            float depth = computeDepthMm(ma, DEFAULT_CURRENT_INIT_MA, DEFAULT_RANGE_MM, DEFAULT_DENSITY_WATER);
-            dataString += "," + String(rawAds) + "," + String(mv) + "," + String(ma) + "," + String(depth);
-            #if ENABLE_VERBOSE_LOGS
-            Serial.printf("ADS A%d raw: %d | mv: %.2f mV | ma: %.3f mA | depth: %.1f mm\n", ch, rawAds, mv, ma, depth);
-            #endif
+        for (int k = 0; k < (int)dueSensorIndices.size(); ++k) {
+            int si = dueSensorIndices[k];
+            JsonObject obj = tags.add<JsonObject>();
+            obj["id"] = String("AI") + String(si + 1);
+            obj["index"] = si;
+            // Sample-store averages give cleaner notification values
+            obj["raw"] = snap.ai[si].avg_raw;
+            obj["filtered"] = snap.ai[si].avg_smoothed;
+            obj["value"] = snap.ai[si].value;
+            obj["pressure"] = snap.ai[si].pressure;
+            obj["status"] = sensorStatusString(snap.ai[si].flags);
+            if (snap.ai[si].health) healthCodesToJson(snap.ai[si].health, obj["health"].to<JsonArray>());
         }
+        String payload;
+        serializeJson(doc, payload);
 
-        // Always log the CSV data to SD
-        logSensorDataToSd(dataString);
+        // Append pending notification to SD (backup)
+        appendPendingNotification(payload);
     }
 
-    // Periodic batch notification independent of sensor read loop
-    if (currentMillis - lastBatchNotificationMillis >= HTTP_NOTIFICATION_INTERVAL) {
-        lastBatchNotificationMillis = currentMillis;
-
-        int totalSensors = getNumVoltageSensors();
-        std::vector<int> allSensorIndices;
-        int *rawVals = new int[totalSensors];
-        float *smoothedVals = new float[totalSensors];
-
-        for (int i = 0; i < totalSensors; ++i) {
-            if (getSensorEnabled(i)) {
-                allSensorIndices.push_back(i);
-                float avgRaw, avgSmoothed, avgVolt;
-                if (getAverages(i, avgRaw, avgSmoothed, avgVolt)) {
-                    rawVals[i] = static_cast<int>(round(avgRaw));
-                    smoothedVals[i] = avgSmoothed;
-                } else {
-                    rawVals[i] = analogRead(getVoltageSensorPin(i));
-                    smoothedVals[i] = getSmoothedADC(i);
-                }
-            }
-        }
+    flagSensorsSnapshotUpdate();
 
-        if (!allSensorIndices.empty()) {
-            sendHttpNotificationBatch(allSensorIndices.size(), allSensorIndices.data(), rawVals, smoothedVals);
-        }
+    // Append ADS1115 A0/A1 readings (raw, mV, mA) to CSV and serial output
+    for (int ch = 0; ch < snap.num_ads; ++ch) {
+        const AdsSnapshot &ads = snap.ads[ch];
+        if (record) dataString += "," + String(ads.raw) + "," + String(ads.mv) + "," + String(ads.ma) + "," + String(ads.depth_mm);
+        #if ENABLE_VERBOSE_LOGS
+        Serial.printf("ADS A%d raw: %d | mv: %.2f mV | ma: %.3f mA | depth: %.1f mm\n", ch, ads.raw, ads.mv, ads.ma, ads.depth_mm);
+        #endif
+    }
 
-        delete[] rawVals;
-        delete[] smoothedVals;
+    // Append DI pulse counters (count, Hz)
+    for (int i = 0; i < snap.num_di; ++i) {
+        const DiSnapshot &di = snap.di[i];
+        if (!record) continue;
+        char field[48];
+        snprintf(field, sizeof(field), ",%llu,%.3f", (unsigned long long)di.count, di.rate_hz);
+        dataString += field;
     }
 
-    // Periodic flush: every 5 minutes attempt to flush pending notifications from SD
-    if (currentMillis - lastPendingFlushMillis >= 5UL * 60UL * 1000UL) {
-        lastPendingFlushMillis = currentMillis;
-        if (getSdEnabled() && sdCardFound) {
-            bool ok = flushPendingNotifications();
-            if (!ok) Serial.println("Pending notifications flush failed (will retry later)");
-            else Serial.println("Pending notifications flushed successfully");
-        }
+    // Log one CSV row per record that changed beyond the report deadbands
+    if (record) logRecordByException(snap, dataString);
+}
+
+void loop() {
+    
+
+    loopTimeSync();
+    loopModbus();
+
+    // Non-blocking sensor reading and logging
+    unsigned long currentMillis = millis();
+
+    // Fallback only: normally the acquisition task samples on its own timer
+    if (!isAcquisitionRunning() && currentMillis - previousSensorMillis >= SENSOR_READ_INTERVAL) {
+        previousSensorMillis = currentMillis;
+        runAcquisitionCycle(esp_timer_get_time());
     }
 
-    // Non-blocking time printing
-    if (currentMillis - previousTimePrintMillis >= PRINT_TIME_INTERVAL) {
-        previousTimePrintMillis = currentMillis;
-        printCurrentTime();
+    if (notifyScheduleDirty) {
+        notifyScheduleDirty = false;
+        int64_t nowUs = esp_timer_get_time();
+        for (int i = 0; i < configuredNumSensors; ++i) {
+            unsigned long interval = sensorNotificationInterval[i];
+            if (interval == 0) interval = HTTP_NOTIFICATION_INTERVAL;
+            housekeeping.setPeriod(notifyJobIds[i], interval, 0, nowUs);
+        }
+    }
+    housekeeping.runDue(esp_timer_get_time());
+    // Flush a finished burst capture to SD off the acquisition path
+    serviceBurstCapture();
+
+    // Records come through their queue, in order, so a blocked loop() does not
+    // lose CSV rows or notification points; then the latest snapshot, unless
+    // it is a record still waiting in the queue
+    SensorSnapshot snap;
+    while (takeRecordSnapshot(snap)) handleSnapshot(snap, true);
+    if (getSensorSnapshotSeq() != lastHandledSnapshotSeq && getSensorSnapshot(snap) &&
+        snap.record_seq == lastHandledRecordSeq) {
+        handleSnapshot(snap, false);
     }
 
     // Service web server
@@ -10,7 +10,11 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "json_helper.h"
+#include "job_scheduler.h"
+#include "history_rollup.h"
+#include "sample_store.h"
 #include "web_api_common.h"
 
 namespace {
@@ -54,10 +58,12 @@ private:
 };
 
 std::vector<ModbusSlave> slaves;
-size_t currentSlaveIndex = 0;
-unsigned long lastPollTime = 0;
 String currentConfigJson;
 
+// One poll job per slave, owned by loopModbus(); rebuilt after a config change
+JobScheduler pollScheduler;
+volatile bool pollScheduleDirty = true;
+
 void modbusIdleTask() {
     delay(1); // Yield to keep watchdog fed while waiting on bus
 }
@@ -137,6 +143,74 @@ ModbusRegisterType stringToRegisterType(const String& str) {
     return ModbusRegisterType::HOLDING_REGISTER; // Default
 }
 
+String modbusTagName(uint8_t address, const ModbusRegister &reg) {
+    String name = String("MB") + String(address) + ".";
+    if (reg.key.length()) name += reg.key;
+    else if (reg.id.length()) name += reg.id;
+    else name += String(reg.address);
+    return name;
+}
+
+// Sample-store step of a register: one raw count after the divisor, coarsened
+// until the whole raw range fits the store's range. Floats keep the default.
+int sampleDecimalsFor(const ModbusRegister &reg) {
+    float divisor = fabsf(reg.divisor);
+    if (divisor == 0.0f || reg.data_type == ModbusDataType::FLOAT32) return SAMPLE_DEFAULT_DECIMALS;
+    bool wide = reg.data_type == ModbusDataType::UINT32 || reg.data_type == ModbusDataType::INT32;
+    float maxAbs = (wide ? 4294967295.0f : 65535.0f) / divisor;
+    int decimals = (int)ceilf(log10f(divisor) - 0.0001f);
+    if (decimals > SAMPLE_MAX_DECIMALS) decimals = SAMPLE_MAX_DECIMALS;
+    while (decimals > SAMPLE_MIN_DECIMALS && maxAbs * powf(10.0f, (float)decimals) >= (float)SAMPLE_VALUE_LIMIT_STEPS) {
+        decimals--;
+    }
+    return decimals < SAMPLE_MIN_DECIMALS ? SAMPLE_MIN_DECIMALS : decimals;
+}
+
+// Per-register store settings of a parsed configuration, in register order
+struct TagRequest {
+    int samples;
+    SampleRetention retention;
+    int decimals;
+    bool history;
+};
+
+// Drop the sample/history tags that no register of the new configuration uses
+void releaseDroppedTags(const std::vector<ModbusSlave> &previous, const std::vector<ModbusSlave> &current,
+                        const std::vector<TagRequest> &requests) {
+    for (const ModbusSlave &old : previous) {
+        for (const ModbusRegister &reg : old.registers) {
+            bool keepSamples = false;
+            bool keepHistory = false;
+            size_t k = 0;
+            for (const ModbusSlave &slave : current) {
+                for (const ModbusRegister &r : slave.registers) {
+                    bool same = r.tag == reg.tag;
+                    keepSamples = keepSamples || same;
+                    keepHistory = keepHistory || (same && requests[k].history);
+                    k++;
+                }
+            }
+            if (!keepSamples) unregisterSampleTag(reg.sample_tag);
+            if (!keepHistory) unregisterHistoryTag(reg.history_tag);
+        }
+    }
+}
+
+// Release first, so new tags can take the slots of dropped ones
+void registerTags(const std::vector<ModbusSlave> &previous, std::vector<ModbusSlave> &current,
+                  const std::vector<TagRequest> &requests) {
+    releaseDroppedTags(previous, current, requests);
+    size_t k = 0;
+    for (ModbusSlave &slave : current) {
+        for (ModbusRegister &reg : slave.registers) {
+            const TagRequest &req = requests[k++];
+            reg.sample_tag = registerSampleTag(reg.tag.c_str(), SAMPLE_TAG_VALUE, req.samples, req.retention,
+                                               req.decimals);
+            if (req.history) reg.history_tag = registerHistoryTag(reg.tag.c_str());
+        }
+    }
+}
+
 } // namespace
 
 String getDefaultModbusConfigJson() {
@@ -163,7 +237,14 @@ bool applyModbusConfig(const String &json) {
         return false;
     }
 
+    // Without per-slave settings, slaves are polled round-robin one every
+    // poll_interval_ms, as before per-slave scheduling existed
+    uint32_t stagger = doc["poll_interval_ms"].is<uint32_t>() ? doc["poll_interval_ms"].as<uint32_t>() : POLL_INTERVAL_MS;
+    if (stagger == 0) stagger = POLL_INTERVAL_MS;
+    size_t slaveCount = doc["slaves"].as<JsonArray>().size();
+
     std::vector<ModbusSlave> parsedSlaves;
+    std::vector<TagRequest> tagRequests;
     for (JsonObject slaveObj : doc["slaves"].as<JsonArray>()) {
         if (!slaveObj["address"].is<uint8_t>()) continue;
 
@@ -171,6 +252,10 @@ bool applyModbusConfig(const String &json) {
         slave.address = slaveObj["address"].as<uint8_t>();
         slave.label = slaveObj["label"].as<String>();
         slave.enabled = slaveObj["enabled"].is<bool>() ? slaveObj["enabled"].as<bool>() : true;
+        uint32_t interval = slaveObj["poll_interval_ms"].as<uint32_t>();
+        slave.poll_interval_ms = interval > 0 ? interval : stagger * slaveCount;
+        slave.poll_phase_ms = slaveObj["poll_phase_ms"].is<uint32_t>() ? slaveObj["poll_phase_ms"].as<uint32_t>()
+                                                                        : stagger * parsedSlaves.size();
 
         if (slaveObj["registers"].is<JsonArray>()) {
             for (JsonObject regObj : slaveObj["registers"].as<JsonArray>()) {
@@ -183,6 +268,14 @@ bool applyModbusConfig(const String &json) {
                 reg.data_type = stringToDataType(regObj["data_type"].as<String>());
                 reg.unit = regObj["unit"].as<String>();
                 reg.divisor = regObj["divisor"].is<float>() ? regObj["divisor"].as<float>() : 1.0;
+                reg.tag = modbusTagName(slave.address, reg);
+                TagRequest req;
+                req.samples = regObj["samples"] | 0;
+                req.retention = SAMPLE_RETAIN_NVS;
+                parseSampleRetention(regObj["retention"] | String("nvs"), req.retention);
+                req.decimals = regObj["decimals"].is<int>() ? regObj["decimals"].as<int>() : sampleDecimalsFor(reg);
+                req.history = regObj["history"] | false;
+                tagRequests.push_back(req);
                 slave.registers.push_back(reg);
             }
         }
@@ -190,14 +283,13 @@ bool applyModbusConfig(const String &json) {
     }
 
     {
+        // The poller samples under this mutex, so it never writes through a
+        // handle released (and maybe reused) here
         CriticalSection guard(modbusMutex);
+        registerTags(slaves, parsedSlaves, tagRequests);
         slaves.swap(parsedSlaves);
-        if (!slaves.empty()) {
-            currentSlaveIndex = currentSlaveIndex % slaves.size();
-        } else {
-            currentSlaveIndex = 0;
-        }
     }
+    pollScheduleDirty = true;
 
     String canonical;
     serializeJson(doc, canonical);
@@ -262,6 +354,8 @@ void processRegisterValue(ModbusRegister& reg, uint16_t* buffer) {
         reg.value /= reg.divisor;
     }
     reg.last_update_ms = millis();
+    addTagSample(reg.sample_tag, reg.value);
+    feedHistoryTag(reg.history_tag, reg.value);
 
     bool currentNan = isnan(reg.value);
     bool valueChanged = false;
@@ -279,20 +373,14 @@ void processRegisterValue(ModbusRegister& reg, uint16_t* buffer) {
     }
 }
 
-void loopModbus() {
+static void pollSlave(size_t index) {
     unsigned long now = millis();
-    if (now - lastPollTime < POLL_INTERVAL_MS) {
-        return;
-    }
-    lastPollTime = now;
-
     CriticalSection guard(modbusMutex);
-    if (slaves.empty()) {
+    if (index >= slaves.size()) {
         return;
     }
 
-    currentSlaveIndex = (currentSlaveIndex + 1) % slaves.size();
-    ModbusSlave& currentSlave = slaves[currentSlaveIndex];
+    ModbusSlave& currentSlave = slaves[index];
 
     if (!currentSlave.enabled) {
         return;
@@ -344,10 +432,49 @@ void loopModbus() {
     }
 }
 
+static void pollSlaveJob(void *ctx, int64_t) {
+    pollSlave((size_t)(uintptr_t)ctx);
+}
+
+static void rebuildPollSchedule() {
+    int64_t nowUs = esp_timer_get_time();
+    pollScheduler.clear();
+    CriticalSection guard(modbusMutex);
+    for (size_t i = 0; i < slaves.size(); ++i) {
+        pollScheduler.add("modbus", slaves[i].poll_interval_ms, slaves[i].poll_phase_ms,
+                          pollSlaveJob, (void *)(uintptr_t)i, nowUs);
+    }
+}
+
+void loopModbus() {
+    if (pollScheduleDirty) {
+        pollScheduleDirty = false;
+        rebuildPollSchedule();
+    }
+    pollScheduler.runDue(esp_timer_get_time());
+}
+
 const std::vector<ModbusSlave>& getModbusSlaves() {
     return slaves;
 }
 
+bool setModbusSlavePollInterval(uint8_t address, uint32_t periodMs, uint32_t phaseMs) {
+    if (periodMs == 0) return false;
+    JsonDocument doc;
+    if (deserializeJson(doc, getModbusConfigJson())) return false;
+    bool found = false;
+    for (JsonObject slaveObj : doc["slaves"].as<JsonArray>()) {
+        if (slaveObj["address"].as<uint8_t>() != address) continue;
+        slaveObj["poll_interval_ms"] = periodMs;
+        slaveObj["poll_phase_ms"] = phaseMs;
+        found = true;
+    }
+    if (!found) return false;
+    String json;
+    serializeJson(doc, json);
+    return applyModbusConfig(json);
+}
+
 String pollModbus(const ModbusPollRequest& request) {
     CriticalSection guard(modbusMutex); // Ensure exclusive access to the bus
 
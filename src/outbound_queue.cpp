@@ -0,0 +1,314 @@
+#include "outbound_queue.h"
+#include "sd_logger.h"
+#include "sd_writer.h"
+#include "storage_helpers.h"
+
+#include <SD.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+namespace {
+
+static_assert(OUTQ_BATCH_MAX_BYTES >= SD_WRITER_RING_BYTES / 4, "a batch must fit the longest queued line");
+static_assert(OUTQ_SEGMENT_BYTES >= OUTQ_BATCH_MAX_BYTES, "segments must hold a batch");
+
+const char *const PREF_NS = "outq";
+const char *const CKPT_KEY = "ckpt";
+const uint32_t CKPT_MAGIC = 0x3151544F; // "OTQ1"
+const char *const LEGACY_PATH = "/pending_notifications.jsonl";
+
+struct __attribute__((packed)) Checkpoint {
+    uint32_t magic;
+    OutboundPos head;
+    OutboundPos tail;
+    uint32_t records;
+    uint32_t bytes;
+};
+
+// loop() pushes and drains while HTTP handlers read stats, preview and clear
+SemaphoreHandle_t queueMutex = NULL;
+
+class QueueLock {
+public:
+    QueueLock() { if (queueMutex) xSemaphoreTake(queueMutex, portMAX_DELAY); }
+    ~QueueLock() { if (queueMutex) xSemaphoreGive(queueMutex); }
+    QueueLock(const QueueLock &) = delete;
+    QueueLock &operator=(const QueueLock &) = delete;
+};
+
+OutboundQueueStats state;
+Checkpoint saved;
+uint32_t lastCheckpointMs = 0;
+// Drain rate: records acknowledged in the current and the last full minute
+uint32_t minuteStartMs = 0;
+uint32_t minuteRecords = 0;
+
+bool samePos(const OutboundPos &a, const OutboundPos &b) {
+    return a.segment == b.segment && a.offset == b.offset;
+}
+
+bool beforePos(const OutboundPos &a, const OutboundPos &b) {
+    return a.segment < b.segment || (a.segment == b.segment && a.offset < b.offset);
+}
+
+// Call with the lock held; `force` skips the rate limit
+void checkpoint(bool force) {
+    uint32_t now = millis();
+    if (!force && now - lastCheckpointMs < OUTQ_CHECKPOINT_MS) return;
+    Checkpoint c;
+    c.magic = CKPT_MAGIC;
+    c.head = state.head;
+    c.tail = state.tail;
+    c.records = state.records;
+    c.bytes = state.bytes;
+    lastCheckpointMs = now;
+    if (memcmp(&c, &saved, sizeof(c)) == 0) return;
+    if (saveBytesToNVSns(PREF_NS, CKPT_KEY, &c, sizeof(c))) saved = c;
+}
+
+bool loadCheckpoint(Checkpoint &c) {
+    if (getBytesLengthFromNVSns(PREF_NS, CKPT_KEY) != sizeof(c)) return false;
+    if (!loadBytesFromNVSns(PREF_NS, CKPT_KEY, &c, sizeof(c))) return false;
+    return c.magic == CKPT_MAGIC && c.head.segment > 0 && !beforePos(c.tail, c.head);
+}
+
+// Segment numbers present on the card
+void segmentRange(uint32_t &first, uint32_t &last) {
+    first = UINT32_MAX;
+    last = 0;
+    File dir = SD.open(OUTQ_DIR);
+    if (!dir || !dir.isDirectory()) return;
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char *name = entry.name();
+        const char *slash = strrchr(name, '/');
+        if (slash) name = slash + 1;
+        char *end;
+        unsigned long seg = strtoul(name, &end, 10);
+        if (!entry.isDirectory() && end == name + 8 && strcmp(end, ".seg") == 0 && seg > 0) {
+            if (seg < first) first = (uint32_t)seg;
+            if (seg > last) last = (uint32_t)seg;
+        }
+        entry.close();
+    }
+    dir.close();
+}
+
+// Count the whole lines from the tail to the end of the last segment and
+// move the tail behind them. A torn last line is left behind: appends then
+// continue in a fresh segment.
+void recoverTail(uint32_t lastSegment) {
+    char path[SD_WRITER_PATH_LEN];
+    uint8_t buf[256];
+    bool torn = false;
+    for (uint32_t seg = state.tail.segment; seg <= lastSegment; ++seg) {
+        outboundSegmentPath(seg, path, sizeof(path));
+        File f = SD.open(path, FILE_READ);
+        if (!f) continue;
+        uint32_t pos = seg == state.tail.segment ? state.tail.offset : 0;
+        if (pos > f.size() || !f.seek(pos)) {
+            f.close();
+            continue;
+        }
+        uint32_t lineStart = pos;
+        int n;
+        while ((n = f.read(buf, sizeof(buf))) > 0) {
+            for (int i = 0; i < n; ++i) {
+                if (buf[i] != '\n') continue;
+                uint32_t lineEnd = pos + i + 1;
+                if (lineEnd - lineStart > 1) {
+                    state.records++;
+                    state.bytes += lineEnd - lineStart;
+                }
+                lineStart = lineEnd;
+            }
+            pos += n;
+        }
+        f.close();
+        state.tail.segment = seg;
+        state.tail.offset = lineStart;
+        torn = lineStart != pos;
+    }
+    if (torn) {
+        state.tail.segment++;
+        state.tail.offset = 0;
+    }
+}
+
+void removeSegments(uint32_t from, uint32_t to) {
+    char path[SD_WRITER_PATH_LEN];
+    for (uint32_t seg = from; seg < to; ++seg) {
+        outboundSegmentPath(seg, path, sizeof(path));
+        SD.remove(path);
+    }
+}
+
+} // namespace
+
+void outboundSegmentPath(uint32_t segment, char *out, size_t len) {
+    snprintf(out, len, OUTQ_DIR "/%08lu.seg", (unsigned long)segment);
+}
+
+bool beginOutboundQueue() {
+    if (!sdCardFound) return false;
+    if (queueMutex == NULL) queueMutex = xSemaphoreCreateMutex();
+    QueueLock lock;
+    if (state.ready) return true;
+    if (!SD.exists(OUTQ_DIR) && !SD.mkdir(OUTQ_DIR)) return false;
+    uint32_t first, last;
+    segmentRange(first, last);
+    Checkpoint c;
+    if (loadCheckpoint(c)) {
+        saved = c;
+        state.head = c.head;
+        state.tail = c.tail;
+        state.records = c.records;
+        state.bytes = c.bytes;
+    } else {
+        // No usable checkpoint: everything on the card is unsent
+        uint32_t start = first != UINT32_MAX ? first : 1;
+        state.head = {start, 0};
+        state.tail = {start, 0};
+        state.records = 0;
+        state.bytes = 0;
+    }
+    // The single-file queue of earlier firmware becomes the next segment
+    if (SD.exists(LEGACY_PATH)) {
+        uint32_t seg = (last > state.tail.segment ? last : state.tail.segment) + 1;
+        char path[SD_WRITER_PATH_LEN];
+        outboundSegmentPath(seg, path, sizeof(path));
+        if (SD.rename(LEGACY_PATH, path)) last = seg;
+    }
+    recoverTail(last);
+    if (state.head.segment > state.tail.segment) state.head = state.tail;
+    if (!sdWriterSetSegment(SD_FILE_PENDING, state.tail.segment)) return false;
+    state.ready = true;
+    checkpoint(true);
+    Serial.printf("[OUTQ] %lu records (%lu bytes) pending in segments %lu..%lu\n",
+                  (unsigned long)state.records, (unsigned long)state.bytes,
+                  (unsigned long)state.head.segment, (unsigned long)state.tail.segment);
+    return true;
+}
+
+bool outboundQueuePush(const char *line, size_t len) {
+    QueueLock lock;
+    if (!state.ready || !sdCardFound) return false;
+    uint32_t need = (uint32_t)len + 1;
+    if (state.tail.offset > 0 && state.tail.offset + need > OUTQ_SEGMENT_BYTES) {
+        // Start the next segment; it applies from the next queued line on
+        if (!sdWriterSetSegment(SD_FILE_PENDING, state.tail.segment + 1)) {
+            state.dropped++;
+            return false;
+        }
+        state.tail.segment++;
+        state.tail.offset = 0;
+    }
+    if (!sdWriterAppendLine(SD_FILE_PENDING, line, len)) {
+        state.dropped++;
+        return false;
+    }
+    state.tail.offset += need;
+    state.records++;
+    state.bytes += need;
+    state.pushed++;
+    checkpoint(false);
+    return true;
+}
+
+size_t outboundQueuePeek(char *buf, size_t cap, uint32_t maxRecords, uint32_t &records, OutboundPos &next,
+                         uint32_t syncMs) {
+    OutboundPos tail;
+    records = 0;
+    {
+        QueueLock lock;
+        next = state.head;
+        tail = state.tail;
+        if (!state.ready || !sdCardFound || cap == 0) return 0;
+    }
+    sdWriterSync(1UL << SD_FILE_PENDING, false, syncMs);
+    size_t used = 0;
+    char path[SD_WRITER_PATH_LEN];
+    while (records < maxRecords && used < cap) {
+        outboundSegmentPath(next.segment, path, sizeof(path));
+        File f = SD.open(path, FILE_READ);
+        uint32_t size = f ? (uint32_t)f.size() : 0;
+        size_t n = 0;
+        if (next.offset < size && f.seek(next.offset)) {
+            int got = f.read(reinterpret_cast<uint8_t *>(buf + used), cap - used);
+            n = got > 0 ? (size_t)got : 0;
+        }
+        if (f) f.close();
+        // Keep whole lines only
+        size_t take = 0;
+        for (size_t i = 0; i < n && records < maxRecords; ++i) {
+            if (buf[used + i] != '\n') continue;
+            take = i + 1;
+            records++;
+        }
+        bool atEnd = next.offset + n >= size;
+        used += take;
+        next.offset += take;
+        if (records >= maxRecords || !atEnd || next.segment >= tail.segment) break;
+        // A finished segment, possibly ending in a line torn by a reset
+        next.segment++;
+        next.offset = 0;
+    }
+    return used;
+}
+
+void outboundQueueAck(const OutboundPos &next, uint32_t records, uint32_t bytes, uint32_t ms) {
+    QueueLock lock;
+    if (!state.ready || beforePos(next, state.head) || beforePos(state.tail, next)) return;
+    removeSegments(state.head.segment, next.segment);
+    state.head = next;
+    state.records = records < state.records ? state.records - records : 0;
+    state.bytes = bytes < state.bytes ? state.bytes - bytes : 0;
+    if (samePos(state.head, state.tail)) state.records = state.bytes = 0;
+    if (records > 0) {
+        state.batches++;
+        state.acked_records += records;
+        state.acked_bytes += bytes;
+        state.last_batch_records = records;
+        state.last_batch_bytes = bytes;
+        state.last_batch_ms = ms;
+    }
+    uint32_t now = millis();
+    if (now - minuteStartMs >= 60000UL) {
+        state.drain_per_min = now - minuteStartMs < 120000UL ? minuteRecords : 0;
+        minuteStartMs = now;
+        minuteRecords = 0;
+    }
+    minuteRecords += records;
+    checkpoint(state.records == 0);
+}
+
+void outboundQueueSendFailed() {
+    QueueLock lock;
+    state.failed_batches++;
+}
+
+bool clearOutboundQueue() {
+    QueueLock lock;
+    if (!state.ready || !sdCardFound) return false;
+    // Release the writer's handle before the files go (only web handlers clear)
+    if (!sdWriterSync(1UL << SD_FILE_PENDING, true, SD_WRITER_WEB_SYNC_MS)) return false;
+    uint32_t first, last;
+    segmentRange(first, last);
+    if (first != UINT32_MAX) removeSegments(first, last + 1);
+    uint32_t seg = (last > state.tail.segment ? last : state.tail.segment) + 1;
+    if (!sdWriterSetSegment(SD_FILE_PENDING, seg)) return false;
+    state.head = {seg, 0};
+    state.tail = {seg, 0};
+    state.records = 0;
+    state.bytes = 0;
+    checkpoint(true);
+    return true;
+}
+
+OutboundQueueStats getOutboundQueueStats() {
+    QueueLock lock;
+    OutboundQueueStats out = state;
+    out.segments = state.ready ? state.tail.segment - state.head.segment + 1 : 0;
+    if (millis() - minuteStartMs >= 120000UL) out.drain_per_min = 0;
+    out.eta_s = out.drain_per_min ? (uint32_t)((uint64_t)out.records * 60 / out.drain_per_min) : 0;
+    return out;
+}
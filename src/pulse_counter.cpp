@@ -0,0 +1,327 @@
+#include "pulse_counter.h"
+#include "pins_config.h"
+#include "storage_helpers.h"
+
+#include "driver/pcnt.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+namespace {
+
+constexpr int NUM_PULSE_COUNTERS = 4;
+constexpr int16_t PCNT_HIGH_LIMIT = 30000; // counter wraps to 0 here and raises an overflow
+constexpr uint32_t RTC_MIRROR_MAGIC = 0x50434E54; // "PCNT"
+constexpr size_t PULSE_UNIT_LEN = 16;
+
+const int PULSE_PINS[NUM_PULSE_COUNTERS] = {DI1_PIN, DI2_PIN, DI3_PIN, DI4_PIN};
+const pcnt_unit_t PULSE_UNITS[NUM_PULSE_COUNTERS] = {PCNT_UNIT_0, PCNT_UNIT_1, PCNT_UNIT_2, PCNT_UNIT_3};
+
+// Config fields are plain values so they can be copied under the spinlock
+// (no heap allocation inside a critical section)
+struct PulseChannel {
+    bool enabled = true;
+    float unitsPerPulse = 1.0f;
+    char unit[PULSE_UNIT_LEN] = "pulse";
+    uint16_t filterNs = PULSE_DEFAULT_FILTER_NS;
+    bool running = false;
+    uint64_t base = 0;            // total when the PCNT unit was last cleared
+    uint64_t lastCount = 0;
+    uint64_t rateCount = 0;       // count at the start of the current rate window
+    int64_t rateUs = 0;
+    float rateHz = 0.0f;
+    uint64_t persistedCount = 0;  // last value written to NVS
+    uint32_t epoch = 0;           // bumped on every rebase; stale reads are dropped
+};
+
+PulseChannel channels[NUM_PULSE_COUNTERS];
+volatile uint32_t overflows[NUM_PULSE_COUNTERS] = {0, 0, 0, 0};
+portMUX_TYPE pulseMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Totals mirrored into RTC slow memory: kept across software resets, panics
+// and watchdog resets, lost on power-off (the NVS checkpoint covers that)
+struct RtcPulseMirror {
+    uint32_t magic;
+    uint64_t counts[NUM_PULSE_COUNTERS];
+    uint32_t check;
+};
+RTC_NOINIT_ATTR RtcPulseMirror rtcMirror;
+
+uint32_t mirrorChecksum(const RtcPulseMirror &m) {
+    uint32_t c = m.magic;
+    for (int i = 0; i < NUM_PULSE_COUNTERS; ++i) {
+        c = (c * 31) ^ (uint32_t)m.counts[i];
+        c = (c * 31) ^ (uint32_t)(m.counts[i] >> 32);
+    }
+    return c;
+}
+
+bool rtcMirrorValid() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) return false;
+    return rtcMirror.magic == RTC_MIRROR_MAGIC && rtcMirror.check == mirrorChecksum(rtcMirror);
+}
+
+void updateRtcMirror() {
+    rtcMirror.magic = RTC_MIRROR_MAGIC;
+    for (int i = 0; i < NUM_PULSE_COUNTERS; ++i) rtcMirror.counts[i] = channels[i].lastCount;
+    rtcMirror.check = mirrorChecksum(rtcMirror);
+}
+
+String nvsKey(const char *prefix, int index) {
+    return String(prefix) + String(index);
+}
+
+uint64_t loadPersistedCount(int index) {
+    uint64_t v = 0;
+    String key = nvsKey("tot_", index);
+    if (getBytesLengthFromNVSns("pulse", key.c_str()) != sizeof(v)) return 0;
+    loadBytesFromNVSns("pulse", key.c_str(), &v, sizeof(v));
+    return v;
+}
+
+void IRAM_ATTR onPcntOverflow(void *arg) {
+    int index = (int)(intptr_t)arg;
+    uint32_t status = 0;
+    pcnt_get_event_status(PULSE_UNITS[index], &status);
+    if (status & PCNT_EVT_H_LIM) overflows[index]++;
+}
+
+// Pulses counted by the unit since it was last cleared, including overflows
+uint64_t readHardwareCount(int index) {
+    uint32_t before, after;
+    int16_t value = 0;
+    do {
+        before = overflows[index];
+        pcnt_get_counter_value(PULSE_UNITS[index], &value);
+        after = overflows[index];
+    } while (before != after);
+    return (uint64_t)after * PCNT_HIGH_LIMIT + (uint16_t)value;
+}
+
+uint16_t filterTicks(uint16_t ns) {
+    // Filter counts APB clock cycles (80 MHz); the register holds 10 bits
+    uint32_t ticks = (uint32_t)ns * 80 / 1000;
+    return ticks > 1023 ? 1023 : (uint16_t)ticks;
+}
+
+bool startUnit(int index) {
+    pcnt_unit_t unit = PULSE_UNITS[index];
+    pcnt_config_t cfg = {};
+    cfg.pulse_gpio_num = PULSE_PINS[index];
+    cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    cfg.channel = PCNT_CHANNEL_0;
+    cfg.unit = unit;
+    cfg.pos_mode = PCNT_COUNT_INC;
+    cfg.neg_mode = PCNT_COUNT_DIS;
+    cfg.lctrl_mode = PCNT_MODE_KEEP;
+    cfg.hctrl_mode = PCNT_MODE_KEEP;
+    cfg.counter_h_lim = PCNT_HIGH_LIMIT;
+    cfg.counter_l_lim = 0;
+    if (pcnt_unit_config(&cfg) != ESP_OK) return false;
+
+    uint16_t ticks = filterTicks(channels[index].filterNs);
+    if (ticks > 0) {
+        pcnt_set_filter_value(unit, ticks);
+        pcnt_filter_enable(unit);
+    } else {
+        pcnt_filter_disable(unit);
+    }
+    pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+    pcnt_counter_pause(unit);
+    pcnt_counter_clear(unit);
+    if (pcnt_isr_handler_add(unit, onPcntOverflow, (void *)(intptr_t)index) != ESP_OK) return false;
+    pcnt_counter_resume(unit);
+    return true;
+}
+
+void stopUnit(int index) {
+    pcnt_unit_t unit = PULSE_UNITS[index];
+    pcnt_counter_pause(unit);
+    pcnt_isr_handler_remove(unit);
+    pcnt_event_disable(unit, PCNT_EVT_H_LIM);
+}
+
+// Fold the hardware count into base and clear the unit (caller holds no lock)
+void rebaseUnit(int index, uint64_t newTotal) {
+    pcnt_counter_pause(PULSE_UNITS[index]);
+    pcnt_counter_clear(PULSE_UNITS[index]);
+    portENTER_CRITICAL(&pulseMux);
+    overflows[index] = 0;
+    channels[index].epoch++;
+    channels[index].base = newTotal;
+    channels[index].lastCount = newTotal;
+    channels[index].rateCount = newTotal;
+    channels[index].rateUs = esp_timer_get_time();
+    channels[index].rateHz = 0.0f;
+    portEXIT_CRITICAL(&pulseMux);
+    if (channels[index].running) pcnt_counter_resume(PULSE_UNITS[index]);
+}
+
+void applyConfig(PulseChannel &c, const PulseCounterConfig &config) {
+    char unit[PULSE_UNIT_LEN];
+    strlcpy(unit, config.unit.c_str(), sizeof(unit));
+    portENTER_CRITICAL(&pulseMux);
+    c.enabled = config.enabled;
+    c.unitsPerPulse = config.units_per_pulse;
+    memcpy(c.unit, unit, sizeof(unit));
+    c.filterNs = config.filter_ns;
+    portEXIT_CRITICAL(&pulseMux);
+}
+
+void loadConfig(int index) {
+    PulseCounterConfig cfg;
+    cfg.enabled = loadIntFromNVSns("pulse", nvsKey("en_", index).c_str(), 1) != 0;
+    cfg.units_per_pulse = loadFloatFromNVSns("pulse", nvsKey("upp_", index).c_str(), 1.0f);
+    cfg.unit = loadStringFromNVSns("pulse", nvsKey("unit_", index).c_str(), "pulse");
+    cfg.filter_ns = (uint16_t)loadIntFromNVSns("pulse", nvsKey("flt_", index).c_str(), PULSE_DEFAULT_FILTER_NS);
+    if (!isfinite(cfg.units_per_pulse) || cfg.units_per_pulse <= 0.0f) cfg.units_per_pulse = 1.0f;
+    applyConfig(channels[index], cfg);
+}
+
+} // namespace
+
+bool setupPulseCounters() {
+    esp_err_t err = pcnt_isr_service_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        Serial.println("[PCNT] Failed to install ISR service");
+        return false;
+    }
+    bool fromRtc = rtcMirrorValid();
+    int started = 0;
+    for (int i = 0; i < NUM_PULSE_COUNTERS; ++i) {
+        PulseChannel &c = channels[i];
+        loadConfig(i);
+        uint64_t stored = loadPersistedCount(i);
+        // The RTC mirror is at least as recent as the last checkpoint
+        uint64_t total = fromRtc && rtcMirror.counts[i] >= stored ? rtcMirror.counts[i] : stored;
+        c.persistedCount = stored;
+        c.base = total;
+        c.lastCount = total;
+        c.rateCount = total;
+        c.rateUs = esp_timer_get_time();
+        overflows[i] = 0;
+        if (!c.enabled) continue;
+        c.running = startUnit(i);
+        if (c.running) started++;
+        else Serial.printf("[PCNT] DI%d: unit configuration failed\n", i + 1);
+    }
+    updateRtcMirror();
+    Serial.printf("[PCNT] %d pulse counter(s) running, totals restored from %s\n", started, fromRtc ? "RTC memory" : "NVS");
+    return started > 0;
+}
+
+int getNumPulseCounters() {
+    return NUM_PULSE_COUNTERS;
+}
+
+int getPulseCounterPin(int index) {
+    if (index < 0 || index >= NUM_PULSE_COUNTERS) return -1;
+    return PULSE_PINS[index];
+}
+
+void samplePulseCounters(int64_t nowUs) {
+    for (int i = 0; i < NUM_PULSE_COUNTERS; ++i) {
+        PulseChannel &c = channels[i];
+        if (!c.running) continue;
+        portENTER_CRITICAL(&pulseMux);
+        uint32_t epoch = c.epoch;
+        portEXIT_CRITICAL(&pulseMux);
+        uint64_t hw = readHardwareCount(i);
+        portENTER_CRITICAL(&pulseMux);
+        if (epoch != c.epoch) {
+            // Rebased while reading; the next sample picks up the new base
+            portEXIT_CRITICAL(&pulseMux);
+            continue;
+        }
+        uint64_t count = c.base + hw;
+        // An overflow whose interrupt has not run yet reads as a step back
+        if (count < c.lastCount) count = c.lastCount;
+        c.lastCount = count;
+        int64_t dtUs = nowUs - c.rateUs;
+        if (dtUs >= (int64_t)PULSE_RATE_MIN_WINDOW_MS * 1000) {
+            c.rateHz = (float)((double)(count - c.rateCount) * 1e6 / (double)dtUs);
+            c.rateCount = count;
+            c.rateUs = nowUs;
+        }
+        portEXIT_CRITICAL(&pulseMux);
+    }
+    updateRtcMirror();
+}
+
+bool getPulseCounterReading(int index, PulseCounterReading &out) {
+    if (index < 0 || index >= NUM_PULSE_COUNTERS) return false;
+    portENTER_CRITICAL(&pulseMux);
+    const PulseChannel &c = channels[index];
+    out.enabled = c.running;
+    out.count = c.lastCount;
+    out.rate_hz = c.rateHz;
+    float upp = c.unitsPerPulse;
+    portEXIT_CRITICAL(&pulseMux);
+    out.total = (float)((double)out.count * upp);
+    out.rate_per_hour = out.rate_hz * upp * 3600.0f;
+    return true;
+}
+
+PulseCounterConfig getPulseCounterConfig(int index) {
+    if (index < 0 || index >= NUM_PULSE_COUNTERS) return PulseCounterConfig();
+    const PulseChannel &c = channels[index];
+    char unit[PULSE_UNIT_LEN];
+    PulseCounterConfig cfg;
+    portENTER_CRITICAL(&pulseMux);
+    cfg.enabled = c.enabled;
+    cfg.units_per_pulse = c.unitsPerPulse;
+    cfg.filter_ns = c.filterNs;
+    memcpy(unit, c.unit, sizeof(unit));
+    portEXIT_CRITICAL(&pulseMux);
+    cfg.unit = unit;
+    return cfg;
+}
+
+bool setPulseCounterConfig(int index, const PulseCounterConfig &config) {
+    if (index < 0 || index >= NUM_PULSE_COUNTERS) return false;
+    if (!isfinite(config.units_per_pulse) || config.units_per_pulse <= 0.0f) return false;
+    PulseChannel &c = channels[index];
+    if (config.unit.length() == 0 || config.unit.length() >= PULSE_UNIT_LEN) return false;
+    bool restart = c.enabled != config.enabled || c.filterNs != config.filter_ns;
+    applyConfig(c, config);
+    saveIntToNVSns("pulse", nvsKey("en_", index).c_str(), config.enabled ? 1 : 0);
+    saveFloatToNVSns("pulse", nvsKey("upp_", index).c_str(), config.units_per_pulse);
+    saveStringToNVSns("pulse", nvsKey("unit_", index).c_str(), config.unit);
+    saveIntToNVSns("pulse", nvsKey("flt_", index).c_str(), config.filter_ns);
+    if (restart) {
+        uint64_t hw = c.running ? readHardwareCount(index) : 0;
+        portENTER_CRITICAL(&pulseMux);
+        uint64_t total = c.running ? c.base + hw : c.lastCount;
+        portEXIT_CRITICAL(&pulseMux);
+        if (total < c.lastCount) total = c.lastCount;
+        if (c.running) {
+            stopUnit(index);
+            c.running = false;
+        }
+        rebaseUnit(index, total);
+        if (config.enabled) c.running = startUnit(index);
+    }
+    return true;
+}
+
+void resetPulseCounter(int index, uint64_t count) {
+    if (index < 0 || index >= NUM_PULSE_COUNTERS) return;
+    rebaseUnit(index, count);
+    updateRtcMirror();
+    saveBytesToNVSns("pulse", nvsKey("tot_", index).c_str(), &count, sizeof(count));
+    channels[index].persistedCount = count;
+}
+
+void persistPulseCounters() {
+    for (int i = 0; i < NUM_PULSE_COUNTERS; ++i) {
+        portENTER_CRITICAL(&pulseMux);
+        uint64_t count = channels[i].lastCount;
+        portEXIT_CRITICAL(&pulseMux);
+        if (count == channels[i].persistedCount) continue;
+        if (saveBytesToNVSns("pulse", nvsKey("tot_", i).c_str(), &count, sizeof(count))) {
+            channels[i].persistedCount = count;
+        }
+    }
+}
@@ -0,0 +1,290 @@
+#include "report_filter.h"
+#include "storage_helpers.h"
+
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+
+namespace {
+
+const char *const TAG_NAMES[REPORT_MAX_TAGS] = {
+    "AI1", "AI2", "AI3", "ADS0", "ADS1", "DI1", "DI2", "DI3", "DI4"
+};
+static_assert(REPORT_MAX_TAGS == 9, "TAG_NAMES must list every report tag");
+
+const char *const SINK_NAMES[REPORT_SINK_COUNT] = {"log", "notify", "batch", "sse"};
+const char *const MODE_NAMES[] = {"deadband", "swinging_door"};
+
+// Compressor state of one tag in one sink. The swinging door is kept as the
+// range of slopes [slopeLo, slopeHi] (units per second) of lines from the last
+// emitted point that pass within the deviation of every sample since.
+struct TagState {
+    bool started = false;
+    ReportPoint emitted;        // last emitted point
+    ReportPoint last;           // last offered point
+    bool lastEmitted = false;
+    float slopeLo = -INFINITY;
+    float slopeHi = INFINITY;
+};
+
+portMUX_TYPE reportMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Written by the web task, adopted by loop() on the next offer
+ReportFilterConfig staged[REPORT_MAX_TAGS];
+bool stagedDirty = false;
+
+// loop()-owned
+ReportFilterConfig active[REPORT_MAX_TAGS];
+TagState states[REPORT_SINK_COUNT][REPORT_MAX_TAGS];
+
+ReportSinkStats sinkStats[REPORT_SINK_COUNT];
+
+void adoptStaged() {
+    portENTER_CRITICAL(&reportMux);
+    memcpy(active, staged, sizeof(active));
+    stagedDirty = false;
+    portEXIT_CRITICAL(&reportMux);
+    for (int s = 0; s < REPORT_SINK_COUNT; ++s) {
+        for (int t = 0; t < REPORT_MAX_TAGS; ++t) states[s][t] = TagState();
+    }
+}
+
+float deviationFor(const ReportFilterConfig &cfg, float ref) {
+    float pct = fabsf(ref) * cfg.deadband_pct / 100.0f;
+    return pct > cfg.deadband ? pct : cfg.deadband;
+}
+
+void restartDoor(TagState &st, const ReportPoint &from) {
+    st.emitted = from;
+    st.slopeLo = -INFINITY;
+    st.slopeHi = INFINITY;
+}
+
+// Narrow the door by one sample; false once it has closed
+bool narrowDoor(TagState &st, const ReportPoint &p, float dev) {
+    float dt = (float)(p.t_us - st.emitted.t_us) / 1e6f;
+    if (dt <= 0.0f) return fabsf(p.value - st.emitted.value) <= dev;
+    float lo = (p.value - st.emitted.value - dev) / dt;
+    float hi = (p.value - st.emitted.value + dev) / dt;
+    if (lo > st.slopeLo) st.slopeLo = lo;
+    if (hi < st.slopeHi) st.slopeHi = hi;
+    return st.slopeLo <= st.slopeHi;
+}
+
+uint8_t compress(const ReportFilterConfig &cfg, TagState &st, const ReportPoint &p, ReportPoint &held) {
+    if (!cfg.enabled || !st.started) {
+        st.started = true;
+        st.last = p;
+        st.lastEmitted = true;
+        restartDoor(st, p);
+        return REPORT_EMIT_CURRENT;
+    }
+
+    uint8_t out = 0;
+    float dev = deviationFor(cfg, st.emitted.value);
+    bool heartbeat = cfg.max_silence_ms > 0 &&
+                     p.t_us - st.emitted.t_us >= (int64_t)cfg.max_silence_ms * 1000;
+    if (cfg.mode == REPORT_MODE_DEADBAND) {
+        if (heartbeat || fabsf(p.value - st.emitted.value) > dev) {
+            out = REPORT_EMIT_CURRENT;
+            restartDoor(st, p);
+        }
+    } else if (heartbeat) {
+        // Close the segment at the last sample before restarting from this one
+        if (!st.lastEmitted) {
+            held = st.last;
+            out |= REPORT_EMIT_HELD;
+        }
+        out |= REPORT_EMIT_CURRENT;
+        restartDoor(st, p);
+    } else if (!narrowDoor(st, p, dev)) {
+        // The previous sample is the turning point; the door restarts there
+        // and already contains this sample
+        held = st.last;
+        out = REPORT_EMIT_HELD;
+        restartDoor(st, st.last);
+        narrowDoor(st, p, deviationFor(cfg, st.emitted.value));
+    }
+    st.last = p;
+    st.lastEmitted = out & REPORT_EMIT_CURRENT;
+    return out;
+}
+
+bool findTag(const String &name, int &tag) {
+    for (int t = 0; t < REPORT_MAX_TAGS; ++t) {
+        if (name.equalsIgnoreCase(TAG_NAMES[t])) {
+            tag = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+void loadStoredFilters() {
+    String payload = loadStringFromNVSns("report", "cfg", "");
+    if (payload.length() == 0) return;
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) return;
+    ReportFilterConfig parsed[REPORT_MAX_TAGS];
+    String error;
+    if (!parseReportFilters(doc.as<JsonVariantConst>(), parsed, error)) {
+        Serial.printf("[REPORT] Stored configuration rejected: %s\n", error.c_str());
+        return;
+    }
+    portENTER_CRITICAL(&reportMux);
+    memcpy(staged, parsed, sizeof(staged));
+    stagedDirty = true;
+    portEXIT_CRITICAL(&reportMux);
+}
+
+} // namespace
+
+void setupReportFilters() {
+    loadStoredFilters();
+    portENTER_CRITICAL(&reportMux);
+    stagedDirty = true;
+    portEXIT_CRITICAL(&reportMux);
+}
+
+float reportTagValue(const SensorSnapshot &snap, int tag, int64_t &sampleUs) {
+    const uint8_t unusable = SENSOR_FLAG_DISABLED | SENSOR_FLAG_UNAVAILABLE;
+    if (tag < 0) return NAN;
+    if (tag < SNAPSHOT_MAX_AI) {
+        if (tag >= snap.num_ai || (snap.ai[tag].flags & unusable)) return NAN;
+        sampleUs = snap.ai[tag].sample_us;
+        return snap.ai[tag].pressure;
+    }
+    tag -= SNAPSHOT_MAX_AI;
+    if (tag < SNAPSHOT_MAX_ADS) {
+        if (tag >= snap.num_ads || (snap.ads[tag].flags & unusable)) return NAN;
+        sampleUs = snap.ads[tag].sample_us;
+        return snap.ads[tag].pressure;
+    }
+    tag -= SNAPSHOT_MAX_ADS;
+    if (tag < SNAPSHOT_MAX_DI) {
+        if (tag >= snap.num_di || (snap.di[tag].flags & unusable)) return NAN;
+        sampleUs = snap.di[tag].sample_us;
+        return snap.di[tag].rate_hz;
+    }
+    return NAN;
+}
+
+uint8_t offerReportSample(ReportSink sink, int tag, const ReportPoint &point, ReportPoint &held) {
+    if (sink >= REPORT_SINK_COUNT || tag < 0 || tag >= REPORT_MAX_TAGS) return REPORT_EMIT_CURRENT;
+    portENTER_CRITICAL(&reportMux);
+    bool dirty = stagedDirty;
+    portEXIT_CRITICAL(&reportMux);
+    if (dirty) adoptStaged();
+
+    TagState &st = states[sink][tag];
+    // Same conversion offered again (another channel triggered the snapshot)
+    if (st.started && point.t_us == st.last.t_us) return 0;
+    uint8_t out = compress(active[tag], st, point, held);
+    uint32_t emitted = ((out & REPORT_EMIT_HELD) ? 1 : 0) + ((out & REPORT_EMIT_CURRENT) ? 1 : 0);
+    portENTER_CRITICAL(&reportMux);
+    sinkStats[sink].offered++;
+    sinkStats[sink].emitted += emitted;
+    portEXIT_CRITICAL(&reportMux);
+    return out;
+}
+
+bool parseReportFilters(JsonVariantConst json, ReportFilterConfig *inOut, String &error) {
+    if (!json.is<JsonArrayConst>()) {
+        error = "tags must be an array";
+        return false;
+    }
+    ReportFilterConfig work[REPORT_MAX_TAGS];
+    memcpy(work, inOut, sizeof(work));
+    for (JsonObjectConst obj : json.as<JsonArrayConst>()) {
+        String name = obj["tag"] | "";
+        int first = 0;
+        int last = REPORT_MAX_TAGS - 1;
+        if (name != "*") {
+            if (!findTag(name, first)) {
+                error = "unknown tag '" + name + "'";
+                return false;
+            }
+            last = first;
+        }
+        String where = name + ": ";
+        for (int t = first; t <= last; ++t) {
+            ReportFilterConfig cfg = work[t];
+            if (!obj["enabled"].isNull()) cfg.enabled = obj["enabled"].as<bool>();
+            if (!obj["mode"].isNull()) {
+                String mode = obj["mode"].as<String>();
+                if (mode.equalsIgnoreCase(MODE_NAMES[0])) cfg.mode = REPORT_MODE_DEADBAND;
+                else if (mode.equalsIgnoreCase(MODE_NAMES[1])) cfg.mode = REPORT_MODE_SWINGING_DOOR;
+                else {
+                    error = where + "mode must be deadband or swinging_door";
+                    return false;
+                }
+            }
+            if (!obj["deadband"].isNull()) cfg.deadband = obj["deadband"].as<float>();
+            if (!obj["deadband_pct"].isNull()) cfg.deadband_pct = obj["deadband_pct"].as<float>();
+            if (!obj["max_silence_ms"].isNull()) {
+                long silence = obj["max_silence_ms"].as<long>();
+                if (silence < 0 || silence > 86400000L) {
+                    error = where + "max_silence_ms must be 0..86400000";
+                    return false;
+                }
+                cfg.max_silence_ms = (uint32_t)silence;
+            }
+            if (!isfinite(cfg.deadband) || cfg.deadband < 0.0f) {
+                error = where + "deadband must be >= 0";
+                return false;
+            }
+            if (!isfinite(cfg.deadband_pct) || cfg.deadband_pct < 0.0f || cfg.deadband_pct > 100.0f) {
+                error = where + "deadband_pct must be 0..100";
+                return false;
+            }
+            work[t] = cfg;
+        }
+    }
+    memcpy(inOut, work, sizeof(work));
+    return true;
+}
+
+void reportFilterToJson(int tag, const ReportFilterConfig &config, JsonObject out) {
+    out["tag"] = reportTagName(tag);
+    out["enabled"] = config.enabled;
+    out["mode"] = MODE_NAMES[config.mode];
+    out["deadband"] = config.deadband;
+    out["deadband_pct"] = config.deadband_pct;
+    out["max_silence_ms"] = config.max_silence_ms;
+}
+
+void setReportFilters(const ReportFilterConfig *configs) {
+    JsonDocument doc;
+    JsonArray arr = doc.to<JsonArray>();
+    for (int t = 0; t < REPORT_MAX_TAGS; ++t) reportFilterToJson(t, configs[t], arr.add<JsonObject>());
+    String payload;
+    serializeJson(doc, payload);
+    saveStringToNVSns("report", "cfg", payload);
+
+    portENTER_CRITICAL(&reportMux);
+    memcpy(staged, configs, sizeof(staged));
+    stagedDirty = true;
+    portEXIT_CRITICAL(&reportMux);
+}
+
+void getReportFilters(ReportFilterConfig *out) {
+    portENTER_CRITICAL(&reportMux);
+    memcpy(out, staged, sizeof(staged));
+    portEXIT_CRITICAL(&reportMux);
+}
+
+ReportSinkStats getReportSinkStats(ReportSink sink) {
+    ReportSinkStats out;
+    if (sink >= REPORT_SINK_COUNT) return out;
+    portENTER_CRITICAL(&reportMux);
+    out = sinkStats[sink];
+    portEXIT_CRITICAL(&reportMux);
+    return out;
+}
+
+const char *reportTagName(int tag) {
+    return (tag >= 0 && tag < REPORT_MAX_TAGS) ? TAG_NAMES[tag] : "";
+}
+
+const char *reportSinkName(ReportSink sink) {
+    return sink < REPORT_SINK_COUNT ? SINK_NAMES[sink] : "";
+}
@@ -1,9 +1,19 @@
 #include "sample_store.h"
 #include <vector>
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
+#include "config.h"
 #include "storage_helpers.h"
 
-static int g_totalSensors = 0;
-static int g_capacity = 0;
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static int g_defaultCapacity = 0;
 
 struct SampleEntry {
     int raw;
@@ -11,188 +21,1090 @@ struct SampleEntry {
     float volt;
 };
 
-// Per-sensor circular buffers and state
-static std::vector<std::vector<SampleEntry>> buffers;
-static std::vector<int> writeIndex;
-static std::vector<int> filledCount;
-
+// NVS: checkpoint blob and per-tag overrides ("t" + tag hash)
 static const char* PREF_NS = "sstore";
+static const char* CKPT_KEY = "ckpt";
+static uint32_t checkpointGeneration = 0;
+
+// The acquisition task and the Modbus poller write samples while loop() and
+// HTTP handlers read windows, so every public entry point takes this mutex.
+static SemaphoreHandle_t storeMutex = NULL;
+
+class StoreLock {
+public:
+    StoreLock() { if (storeMutex) xSemaphoreTake(storeMutex, portMAX_DELAY); }
+    ~StoreLock() { if (storeMutex) xSemaphoreGive(storeMutex); }
+    StoreLock(const StoreLock&) = delete;
+    StoreLock& operator=(const StoreLock&) = delete;
+};
+
+// ---- RAM columns ----
+
+// Each tag's samples are packed column-wise in one allocation:
+//   value     int16   per-block delta: value = base + q * 2^shift, in
+//                     10^-decimals units of the tag. A block starts at shift
+//                     0 (exact) and only coarsens when its spread outgrows
+//                     16 bits. Values beyond SAMPLE_VALUE_LIMIT_STEPS steps are clamped
+//                     and flagged in the block's clamp mask.
+//   raw       uint16  ADC code                      (ADC tags only)
+//   smoothed  uint16  1/SMOOTHED_SCALE ADC counts   (ADC tags only)
+// The ring is cut into blocks of SAMPLE_BLOCK slots. Each block header keeps
+// the cumulative (wrapping) sums of every sample written before it, so the
+// sums over any recent window need two header reads and at most two block
+// scans, and a segment tree over the blocks' value min/max gives the window
+// extremes in O(log n). The variance comes from per-block Welford moments
+// merged across the window (no sum of squares to overflow). One spare block
+// keeps the oldest block of a full window intact while the next one is
+// written. Each block costs a header and four tree entries (72 bytes on the
+// ESP32, 2.25 per slot) on top of the slots: about 4.3 bytes per sample,
+// 8.3 with the ADC columns.
+static const int SAMPLE_BLOCK = 32;
+static const float SMOOTHED_SCALE = 16.0f;        // 1/16 ADC count
+
+struct WindowSums {
+    uint32_t raw;
+    uint32_t smoothed;
+    uint64_t value;
+    uint32_t clamped;
+};
+
+// Count, mean and sum of squared deviations of decoded values, the mean
+// relative to `ref` so float keeps the resolution of values far from zero
+struct Moments {
+    int n;
+    int32_t ref;
+    float mean;
+    float m2;
+};
+
+struct BlockHeader {
+    WindowSums before;    // sums of all samples written before this block
+    Moments moments;      // of the samples written into this block so far
+    uint32_t clampMask;   // bit i: slot i of the block was clamped
+    int32_t base;
+    uint8_t shift;
+};
+
+struct SensorColumns {
+    BlockHeader *blocks;  // nblocks
+    int32_t *treeMin;     // 2 * nblocks, leaf of block b at nblocks + b
+    int32_t *treeMax;
+    int16_t *value;       // slots
+    uint16_t *raw;        // slots, nullptr for value tags
+    uint16_t *smoothed;
+    int nblocks;
+    int slots;            // nblocks * SAMPLE_BLOCK
+    int capacity;         // window length
+    int writePos;         // next slot
+    int filled;           // samples in the window, <= capacity
+    int decimals;
+    float scale;          // steps per unit, 10^decimals
+};
+
+static float decimalScale(int decimals) {
+    float scale = 1.0f;
+    for (int i = 0; i < decimals; ++i) scale *= 10.0f;
+    for (int i = 0; i > decimals; --i) scale /= 10.0f;
+    return scale;
+}
+
+static int clampDecimals(int decimals) {
+    if (decimals < SAMPLE_MIN_DECIMALS) return SAMPLE_MIN_DECIMALS;
+    if (decimals > SAMPLE_MAX_DECIMALS) return SAMPLE_MAX_DECIMALS;
+    return decimals;
+}
+
+static int blocksFor(int capacity) {
+    return (capacity + SAMPLE_BLOCK - 1) / SAMPLE_BLOCK + 1;
+}
+
+// Lay out the columns of one tag in a single allocation; nullptr when the
+// heap is short, i.e. the allocation would not leave
+// SAMPLE_STORE_HEAP_RESERVE_BYTES in the largest free block (a resize holds
+// the old window too until the swap)
+static uint8_t *allocColumns(SampleTagKind kind, int capacity, int decimals, SensorColumns &c) {
+    int nblocks = blocksFor(capacity);
+    int slots = nblocks * SAMPLE_BLOCK;
+    int slotBytes = kind == SAMPLE_TAG_ADC ? sizeof(int16_t) + 2 * sizeof(uint16_t) : sizeof(int16_t);
+    size_t bytes = sizeof(BlockHeader) * nblocks + sizeof(int32_t) * 4 * nblocks + (size_t)slotBytes * slots;
+    if (heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < bytes + SAMPLE_STORE_HEAP_RESERVE_BYTES) return nullptr;
+    uint8_t *mem = (uint8_t *)malloc(bytes);
+    if (!mem) return nullptr;
+    uint8_t *p = mem;
+    c.nblocks = nblocks;
+    c.slots = slots;
+    c.capacity = capacity;
+    c.decimals = clampDecimals(decimals);
+    c.scale = decimalScale(c.decimals);
+    c.blocks = reinterpret_cast<BlockHeader *>(p);
+    p += sizeof(BlockHeader) * nblocks;
+    c.treeMin = reinterpret_cast<int32_t *>(p);
+    p += sizeof(int32_t) * 2 * nblocks;
+    c.treeMax = reinterpret_cast<int32_t *>(p);
+    p += sizeof(int32_t) * 2 * nblocks;
+    c.value = reinterpret_cast<int16_t *>(p);
+    p += sizeof(int16_t) * slots;
+    c.raw = nullptr;
+    c.smoothed = nullptr;
+    if (kind == SAMPLE_TAG_ADC) {
+        c.raw = reinterpret_cast<uint16_t *>(p);
+        p += sizeof(uint16_t) * slots;
+        c.smoothed = reinterpret_cast<uint16_t *>(p);
+    }
+    memset(c.treeMin, 0, sizeof(int32_t) * 4 * nblocks);
+    c.writePos = 0;
+    c.filled = 0;
+    return mem;
+}
+
+static void resetColumns(SensorColumns &c) {
+    c.writePos = 0;
+    c.filled = 0;
+}
+
+static int32_t quantize(int32_t d, uint8_t shift) {
+    return shift ? (d + (1 << (shift - 1))) >> shift : d;
+}
+
+static int32_t decodeValue(const SensorColumns &c, int slot) {
+    const BlockHeader &h = c.blocks[slot / SAMPLE_BLOCK];
+    return h.base + (int32_t)c.value[slot] * (1 << h.shift);
+}
+
+static void addSlot(const SensorColumns &c, int slot, WindowSums &s) {
+    int32_t v = decodeValue(c, slot);
+    if (c.raw) {
+        s.raw += c.raw[slot];
+        s.smoothed += c.smoothed[slot];
+    }
+    s.value += (uint64_t)(int64_t)v;
+    s.clamped += (c.blocks[slot / SAMPLE_BLOCK].clampMask >> (slot % SAMPLE_BLOCK)) & 1;
+}
+
+// Welford update
+static void momentsAdd(Moments &m, int32_t v) {
+    if (m.n == 0) m.ref = v;
+    float x = (float)((int64_t)v - m.ref);
+    m.n++;
+    float delta = x - m.mean;
+    m.mean += delta / m.n;
+    m.m2 += delta * (x - m.mean);
+}
+
+// Chan's pairwise merge of b into a
+static void momentsMerge(Moments &a, const Moments &b) {
+    if (b.n == 0) return;
+    if (a.n == 0) {
+        a = b;
+        return;
+    }
+    float delta = (float)((int64_t)b.ref - a.ref) + b.mean - a.mean;
+    int n = a.n + b.n;
+    a.mean += delta * b.n / n;
+    a.m2 += b.m2 + delta * delta * ((float)a.n * b.n / n);
+    a.n = n;
+}
+
+static void scanMoments(const SensorColumns &c, int first, int last, Moments &m) {
+    for (int j = first; j <= last; ++j) momentsAdd(m, decodeValue(c, j));
+}
+
+// Sums of every sample written before / up to and including `slot`
+static WindowSums sumsBefore(const SensorColumns &c, int slot) {
+    int first = slot - slot % SAMPLE_BLOCK;
+    WindowSums s = c.blocks[first / SAMPLE_BLOCK].before;
+    for (int j = first; j < slot; ++j) addSlot(c, j, s);
+    return s;
+}
+
+static WindowSums sumsThrough(const SensorColumns &c, int slot) {
+    WindowSums s = sumsBefore(c, slot);
+    addSlot(c, slot, s);
+    return s;
+}
+
+static void treeSet(SensorColumns &c, int block, int32_t lo, int32_t hi) {
+    int i = block + c.nblocks;
+    c.treeMin[i] = lo;
+    c.treeMax[i] = hi;
+    for (i >>= 1; i >= 1; i >>= 1) {
+        c.treeMin[i] = min(c.treeMin[2 * i], c.treeMin[2 * i + 1]);
+        c.treeMax[i] = max(c.treeMax[2 * i], c.treeMax[2 * i + 1]);
+    }
+}
+
+// Merge the min/max of blocks first..last (inclusive) into lo/hi
+static void treeQuery(const SensorColumns &c, int first, int last, int32_t &lo, int32_t &hi) {
+    for (int l = first + c.nblocks, r = last + c.nblocks + 1; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) {
+            lo = min(lo, c.treeMin[l]);
+            hi = max(hi, c.treeMax[l]);
+            l++;
+        }
+        if (r & 1) {
+            --r;
+            lo = min(lo, c.treeMin[r]);
+            hi = max(hi, c.treeMax[r]);
+        }
+    }
+}
+
+static void scanRange(const SensorColumns &c, int first, int last, int32_t &lo, int32_t &hi) {
+    for (int j = first; j <= last; ++j) {
+        int32_t v = decodeValue(c, j);
+        lo = min(lo, v);
+        hi = max(hi, v);
+    }
+}
+
+// Returns true when the value was out of the tag's range and got clamped
+static bool columnsPush(SensorColumns &c, const SampleEntry &e) {
+    int pos = c.writePos;
+    int block = pos / SAMPLE_BLOCK;
+    int first = block * SAMPLE_BLOCK;
+    BlockHeader &h = c.blocks[block];
+    float scaled = e.volt * c.scale;
+    bool clamped = scaled >= (float)SAMPLE_VALUE_LIMIT_STEPS || scaled <= -(float)SAMPLE_VALUE_LIMIT_STEPS;
+    int32_t v = clamped ? (scaled > 0 ? SAMPLE_VALUE_LIMIT_STEPS : -SAMPLE_VALUE_LIMIT_STEPS) : (int32_t)lroundf(scaled);
+
+    if (pos == first) {
+        if (c.filled > 0) {
+            int prev = (block + c.nblocks - 1) % c.nblocks;
+            h.before = sumsThrough(c, prev * SAMPLE_BLOCK + SAMPLE_BLOCK - 1);
+        } else {
+            memset(&h.before, 0, sizeof(h.before));
+        }
+        h.base = v;
+        h.shift = 0;
+        h.clampMask = 0;
+        memset(&h.moments, 0, sizeof(h.moments));
+    }
+    int32_t d = v - h.base;
+    int32_t q = quantize(d, h.shift);
+    bool coarsened = false;
+    while (q > INT16_MAX || q < INT16_MIN) {
+        h.shift++;
+        for (int j = first; j < pos; ++j) c.value[j] = (int16_t)quantize(c.value[j], 1);
+        q = quantize(d, h.shift);
+        coarsened = true;
+    }
+    c.value[pos] = (int16_t)q;
+    if (clamped) h.clampMask |= 1UL << (pos - first);
+    if (c.raw) {
+        c.raw[pos] = (uint16_t)constrain(e.raw, 0, 0xFFFF);
+        c.smoothed[pos] = (uint16_t)constrain(lroundf(e.smoothed * SMOOTHED_SCALE), 0L, 0xFFFFL);
+    }
+
+    int32_t decoded = decodeValue(c, pos);
+    int32_t lo = decoded;
+    int32_t hi = decoded;
+    if (coarsened) {
+        // Earlier slots decode differently now
+        scanRange(c, first, pos, lo, hi);
+        memset(&h.moments, 0, sizeof(h.moments));
+        scanMoments(c, first, pos, h.moments);
+    } else {
+        if (pos != first) {
+            lo = min(lo, c.treeMin[block + c.nblocks]);
+            hi = max(hi, c.treeMax[block + c.nblocks]);
+        }
+        momentsAdd(h.moments, decoded);
+    }
+    treeSet(c, block, lo, hi);
+
+    c.writePos = (pos + 1) % c.slots;
+    if (c.filled < c.capacity) c.filled++;
+    return clamped;
+}
+
+static SampleEntry entryAtSlot(const SensorColumns &c, int slot) {
+    SampleEntry e;
+    e.raw = c.raw ? c.raw[slot] : 0;
+    e.smoothed = c.raw ? (float)c.smoothed[slot] / SMOOTHED_SCALE : 0.0f;
+    e.volt = (float)decodeValue(c, slot) / c.scale;
+    return e;
+}
+
+// Copy the newest samples of `from` into the empty columns `to`, oldest first
+static void columnsCopy(const SensorColumns &from, SensorColumns &to, int count) {
+    if (count > from.filled) count = from.filled;
+    for (int j = count; j >= 1; --j) {
+        columnsPush(to, entryAtSlot(from, (from.writePos - j + from.slots) % from.slots));
+    }
+}
+
+static bool windowStats(const SensorColumns &c, int n, SampleWindowStats &out) {
+    if (c.filled == 0) return false;
+    if (n <= 0 || n > c.filled) n = c.filled;
+    int newest = (c.writePos - 1 + c.slots) % c.slots;
+    int oldest = (c.writePos - n + c.slots) % c.slots;
+
+    WindowSums end = sumsThrough(c, newest);
+    WindowSums start = sumsBefore(c, oldest);
+    uint32_t sumRaw = end.raw - start.raw;
+    uint32_t sumSmoothed = end.smoothed - start.smoothed;
+    uint64_t sumValue = end.value - start.value;
+
+    int32_t lo = INT32_MAX;
+    int32_t hi = INT32_MIN;
+    Moments m = {};
+    int oldestBlock = oldest / SAMPLE_BLOCK;
+    int newestBlock = newest / SAMPLE_BLOCK;
+    if (oldestBlock == newestBlock && oldest <= newest) {
+        scanRange(c, oldest, newest, lo, hi);
+        scanMoments(c, oldest, newest, m);
+    } else {
+        // Partial oldest block by hand, the rest (newest block included) from
+        // the tree and the block moments
+        int oldestEnd = oldestBlock * SAMPLE_BLOCK + SAMPLE_BLOCK - 1;
+        scanRange(c, oldest, oldestEnd, lo, hi);
+        scanMoments(c, oldest, oldestEnd, m);
+        int firstFull = (oldestBlock + 1) % c.nblocks;
+        if (firstFull <= newestBlock) {
+            treeQuery(c, firstFull, newestBlock, lo, hi);
+        } else {
+            treeQuery(c, firstFull, c.nblocks - 1, lo, hi);
+            treeQuery(c, 0, newestBlock, lo, hi);
+        }
+        for (int b = firstFull;; b = (b + 1) % c.nblocks) {
+            momentsMerge(m, c.blocks[b].moments);
+            if (b == newestBlock) break;
+        }
+    }
+
+    out.count = n;
+    out.clamped = (int)(end.clamped - start.clamped);
+    out.avg_raw = c.raw ? (float)sumRaw / (float)n : NAN;
+    out.avg_smoothed = c.raw ? (float)sumSmoothed / SMOOTHED_SCALE / (float)n : NAN;
+    out.avg_value = (float)(int64_t)sumValue / c.scale / (float)n;
+    out.min_value = (float)lo / c.scale;
+    out.max_value = (float)hi / c.scale;
+    out.stddev_value = 0.0f;
+    if (m.n > 1 && m.m2 > 0.0f) out.stddev_value = sqrtf(m.m2 / (float)(m.n - 1)) / c.scale;
+    return true;
+}
+
+// ---- Registry ----
+
+struct TagSlot {
+    char name[SAMPLE_TAG_MAX_LEN]; // "" = free
+    uint32_t hash;
+    uint32_t serial;               // changes whenever the handle is reused
+    SampleTagKind kind;
+    SampleRetention retention;
+    bool defaultCapacity;
+    int mirror;                    // RTC mirror slot, -1 = none
+    uint32_t clamped;              // samples clamped since registration
+    uint8_t *mem;
+    SensorColumns cols;
+};
+
+static TagSlot tags[SAMPLE_STORE_MAX_TAGS];
+static uint32_t nextSerial = 1;
+static int aiHandles[SAMPLE_STORE_MAX_SENSORS] = {-1, -1, -1};
+
+static bool tagUsed(int handle) {
+    return handle >= 0 && handle < SAMPLE_STORE_MAX_TAGS && tags[handle].name[0] != '\0';
+}
+
+static int findTagLocked(const char *tag) {
+    for (int h = 0; h < SAMPLE_STORE_MAX_TAGS; ++h) {
+        if (tags[h].name[0] != '\0' && strcmp(tags[h].name, tag) == 0) return h;
+    }
+    return -1;
+}
+
+// FNV-1a; identifies a tag in the RTC mirror and the NVS override key
+static uint32_t hashTag(const char *tag) {
+    uint32_t h = 2166136261UL;
+    for (const char *p = tag; *p; ++p) {
+        h ^= (uint8_t)*p;
+        h *= 16777619UL;
+    }
+    return h ? h : 1;
+}
+
+static int clampCapacity(int samplesPerSensor) {
+    if (samplesPerSensor < 1) return 1;
+    if (samplesPerSensor > SAMPLE_STORE_MAX_CAPACITY) return SAMPLE_STORE_MAX_CAPACITY;
+    return samplesPerSensor;
+}
+
+// ---- RTC mirror ----
+
+// The newest SAMPLE_STORE_RTC_CAPACITY samples of up to SAMPLE_STORE_RTC_TAGS
+// tags are mirrored in RTC slow memory, so they survive soft resets, panics,
+// watchdog and OTA reboots without touching flash. Slots are keyed by tag
+// hash and replayed into a tag's window when it registers, whatever the
+// registration order. The header CRC and one CRC per slot are refreshed on
+// every write (a bad slot is dropped alone); `generation` counts writes so a
+// checkpoint can tell whether anything changed.
+struct MirrorEntry {
+    int16_t raw;
+    uint16_t smoothed; // 1/SMOOTHED_SCALE counts
+    float value;
+};
+
+static const uint32_t RTC_STORE_MAGIC = 0x32545353;    // "SST2"
+static const uint32_t LEGACY_STORE_MAGIC = 0x53535452; // "SSTR": AI pin slots, 12-byte entries
+static const int LEGACY_SENSORS = 3;
+
+struct RtcSampleStore {
+    uint32_t magic;
+    uint32_t generation;
+    uint16_t slots;
+    uint16_t capacity;
+    uint32_t tagHash[SAMPLE_STORE_RTC_TAGS];  // 0 = free slot
+    uint16_t writeIndex[SAMPLE_STORE_RTC_TAGS];
+    uint16_t filledCount[SAMPLE_STORE_RTC_TAGS];
+    uint32_t slotCrc[SAMPLE_STORE_RTC_TAGS];
+    uint8_t persist[SAMPLE_STORE_RTC_TAGS];   // slot goes into NVS checkpoints
+    uint32_t crc;                             // header fields above
+    MirrorEntry entries[SAMPLE_STORE_RTC_TAGS * SAMPLE_STORE_RTC_CAPACITY];
+};
+RTC_NOINIT_ATTR static RtcSampleStore rtcStore;
+
+static const size_t RTC_CRC_BYTES = offsetof(RtcSampleStore, crc);
+static const size_t RTC_HEADER_BYTES = offsetof(RtcSampleStore, entries);
+static const size_t SLOT_BYTES = sizeof(MirrorEntry) * SAMPLE_STORE_RTC_CAPACITY;
+
+// Layout written by earlier firmware: one slot per AI pin
+struct LegacyStoreHeader {
+    uint32_t magic;
+    uint32_t generation;
+    uint16_t sensors;
+    uint16_t capacity;
+    uint16_t writeIndex[LEGACY_SENSORS];
+    uint16_t filledCount[LEGACY_SENSORS];
+};
+
+// Claims are only made once initSampleStore() validated the RTC contents
+static bool mirrorReady = false;
+
+static MirrorEntry *mirrorSlot(int slot) {
+    return &rtcStore.entries[slot * SAMPLE_STORE_RTC_CAPACITY];
+}
+
+static uint32_t slotCrc(int slot) {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(mirrorSlot(slot)), SLOT_BYTES);
+}
+
+static uint32_t headerCrc() {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&rtcStore), RTC_CRC_BYTES);
+}
+
+static void sealHeader() {
+    rtcStore.generation++;
+    rtcStore.crc = headerCrc();
+}
+
+static void sealSlot(int slot) {
+    rtcStore.slotCrc[slot] = slotCrc(slot);
+    sealHeader();
+}
+
+static void resetMirror() {
+    memset(&rtcStore, 0, RTC_HEADER_BYTES);
+    rtcStore.magic = RTC_STORE_MAGIC;
+    rtcStore.slots = SAMPLE_STORE_RTC_TAGS;
+    rtcStore.capacity = SAMPLE_STORE_RTC_CAPACITY;
+    rtcStore.crc = headerCrc();
+}
+
+static void releaseMirror(int slot) {
+    rtcStore.tagHash[slot] = 0;
+    rtcStore.writeIndex[slot] = 0;
+    rtcStore.filledCount[slot] = 0;
+    rtcStore.persist[slot] = 0;
+}
+
+static void mirrorPush(int slot, const SampleEntry &e) {
+    int idx = rtcStore.writeIndex[slot];
+    MirrorEntry &m = mirrorSlot(slot)[idx];
+    m.raw = (int16_t)constrain(e.raw, -32768, 32767);
+    m.smoothed = (uint16_t)constrain(lroundf(e.smoothed * SMOOTHED_SCALE), 0L, 0xFFFFL);
+    m.value = e.volt;
+    rtcStore.writeIndex[slot] = (uint16_t)((idx + 1) % SAMPLE_STORE_RTC_CAPACITY);
+    if (rtcStore.filledCount[slot] < SAMPLE_STORE_RTC_CAPACITY) rtcStore.filledCount[slot]++;
+}
+
+static bool rtcStoreValid() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) return false;
+    if (rtcStore.magic != RTC_STORE_MAGIC || rtcStore.crc != headerCrc()) return false;
+    if (rtcStore.slots != SAMPLE_STORE_RTC_TAGS || rtcStore.capacity != SAMPLE_STORE_RTC_CAPACITY) return false;
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS; ++i) {
+        if (rtcStore.writeIndex[i] >= SAMPLE_STORE_RTC_CAPACITY ||
+            rtcStore.filledCount[i] > SAMPLE_STORE_RTC_CAPACITY) return false;
+    }
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS; ++i) {
+        if (rtcStore.tagHash[i] && rtcStore.slotCrc[i] != slotCrc(i)) releaseMirror(i);
+    }
+    return true;
+}
+
+// Feed the mirrored samples of a slot into a window, oldest first
+static void replayMirror(int slot, SensorColumns &cols) {
+    int count = rtcStore.filledCount[slot];
+    int start = (rtcStore.writeIndex[slot] - count + SAMPLE_STORE_RTC_CAPACITY) % SAMPLE_STORE_RTC_CAPACITY;
+    for (int j = 0; j < count; ++j) {
+        const MirrorEntry &m = mirrorSlot(slot)[(start + j) % SAMPLE_STORE_RTC_CAPACITY];
+        SampleEntry e;
+        e.raw = m.raw;
+        e.smoothed = (float)m.smoothed / SMOOTHED_SCALE;
+        e.volt = m.value;
+        columnsPush(cols, e);
+    }
+}
 
-// Helper: preference keys
-static String sbufKey(int idx) { char b[32]; snprintf(b, sizeof(b), "sbuf_%d", idx); return String(b); }
-static String swiKey(int idx) { char b[32]; snprintf(b, sizeof(b), "swi_%d", idx); return String(b); }
-static String scntKey(int idx) { char b[32]; snprintf(b, sizeof(b), "scnt_%d", idx); return String(b); }
-
-// Persist a single sensor buffer into Preferences
-static void persistSensor(int idx) {
-    size_t bytes = sizeof(SampleEntry) * g_capacity;
-    saveBytesToNVSns(PREF_NS, sbufKey(idx).c_str(), buffers[idx].data(), bytes);
-    saveIntToNVSns(PREF_NS, swiKey(idx).c_str(), writeIndex[idx]);
-    saveIntToNVSns(PREF_NS, scntKey(idx).c_str(), filledCount[idx]);
-}
-
-// Load a single sensor buffer from Preferences if present
-static void loadSensor(int idx) {
-    size_t expected = sizeof(SampleEntry) * g_capacity;
-    size_t have = getBytesLengthFromNVSns(PREF_NS, sbufKey(idx).c_str());
-    if (have == expected) {
-        if (!loadBytesFromNVSns(PREF_NS, sbufKey(idx).c_str(), buffers[idx].data(), expected)) {
-            // fallback to empty
-            writeIndex[idx] = 0;
-            filledCount[idx] = 0;
-            for (int j = 0; j < g_capacity; ++j) buffers[idx][j].raw = INT_MIN;
-            return;
-        }
-        writeIndex[idx] = loadIntFromNVSns(PREF_NS, swiKey(idx).c_str(), 0);
-        filledCount[idx] = loadIntFromNVSns(PREF_NS, scntKey(idx).c_str(), g_capacity);
+// Fill a slot from `count` entries of a ring laid out in `stride` slots
+static void importMirror(int slot, uint32_t hash, const SampleEntry *ring, int stride, int writeIndex, int count) {
+    releaseMirror(slot);
+    rtcStore.tagHash[slot] = hash;
+    rtcStore.persist[slot] = 1;
+    int start = (writeIndex - count + stride) % stride;
+    for (int j = 0; j < count; ++j) mirrorPush(slot, ring[(start + j) % stride]);
+    sealSlot(slot);
+}
+
+static bool mirrorOwned(int slot) {
+    for (int h = 0; h < SAMPLE_STORE_MAX_TAGS; ++h) {
+        if (tags[h].name[0] != '\0' && tags[h].mirror == slot) return true;
+    }
+    return false;
+}
+
+// Give a tag an RTC slot: its own from before the reset (restored into the
+// window when `restore`), else a free one, else one no registered tag owns.
+// -1 when every slot is in use.
+static int claimMirror(TagSlot &t, bool restore) {
+    if (!mirrorReady) return -1;
+    int match = -1, freeSlot = -1, stale = -1;
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS && match < 0; ++i) {
+        if (rtcStore.tagHash[i] == t.hash) match = i;
+        else if (rtcStore.tagHash[i] == 0) { if (freeSlot < 0) freeSlot = i; }
+        else if (stale < 0 && !mirrorOwned(i)) stale = i;
+    }
+    int slot = match;
+    if (match >= 0 && restore) {
+        replayMirror(match, t.cols);
     } else {
-        // mark empty
-        writeIndex[idx] = 0;
-        filledCount[idx] = 0;
-        for (int j = 0; j < g_capacity; ++j) buffers[idx][j].raw = INT_MIN;
+        if (slot < 0) slot = freeSlot >= 0 ? freeSlot : stale;
+        if (slot < 0) return -1;
+        // Seed the slot with the newest samples already in the window
+        releaseMirror(slot);
+        rtcStore.tagHash[slot] = t.hash;
+        int count = min(t.cols.filled, SAMPLE_STORE_RTC_CAPACITY);
+        for (int j = count; j >= 1; --j) {
+            mirrorPush(slot, entryAtSlot(t.cols, (t.cols.writePos - j + t.cols.slots) % t.cols.slots));
+        }
+    }
+    rtcStore.persist[slot] = t.retention == SAMPLE_RETAIN_NVS;
+    sealSlot(slot);
+    return slot;
+}
+
+// Copy the header and the slots of nvs-retention tags into a checkpoint blob.
+// Called with the lock held; the NVS write happens after release so it never
+// holds up a sample.
+static void copyCheckpoint(std::vector<uint8_t> &blob) {
+    blob.assign(reinterpret_cast<const uint8_t *>(&rtcStore),
+                reinterpret_cast<const uint8_t *>(&rtcStore) + RTC_HEADER_BYTES);
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS; ++i) {
+        if (!rtcStore.tagHash[i] || !rtcStore.persist[i]) continue;
+        const uint8_t *slot = reinterpret_cast<const uint8_t *>(mirrorSlot(i));
+        blob.insert(blob.end(), slot, slot + SLOT_BYTES);
+    }
+}
+
+static bool loadLegacyCheckpoint(const std::vector<uint8_t> &blob) {
+    LegacyStoreHeader header;
+    if (blob.size() < sizeof(header)) return false;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.sensors == 0 || header.sensors > LEGACY_SENSORS) return false;
+    if (header.capacity == 0 || blob.size() != sizeof(header) + sizeof(SampleEntry) * header.sensors * header.capacity) {
+        return false;
+    }
+    const SampleEntry *entries = reinterpret_cast<const SampleEntry *>(blob.data() + sizeof(header));
+    char name[12];
+    for (int i = 0; i < header.sensors; ++i) {
+        if (header.writeIndex[i] >= header.capacity || header.filledCount[i] > header.capacity) continue;
+        snprintf(name, sizeof(name), "AI%d", i + 1);
+        importMirror(i, hashTag(name), entries + i * header.capacity, header.capacity,
+                     header.writeIndex[i], header.filledCount[i]);
     }
+    rtcStore.generation = header.generation;
+    rtcStore.crc = headerCrc();
+    return true;
+}
+
+static bool loadCheckpoint() {
+    size_t length = getBytesLengthFromNVSns(PREF_NS, CKPT_KEY);
+    if (length < sizeof(uint32_t)) return false;
+    std::vector<uint8_t> blob(length);
+    if (!loadBytesFromNVSns(PREF_NS, CKPT_KEY, blob.data(), length)) return false;
+    uint32_t magic;
+    memcpy(&magic, blob.data(), sizeof(magic));
+    if (magic == LEGACY_STORE_MAGIC) return loadLegacyCheckpoint(blob);
+    if (magic != RTC_STORE_MAGIC || length < RTC_HEADER_BYTES) return false;
+
+    memcpy(&rtcStore, blob.data(), RTC_HEADER_BYTES);
+    bool ok = rtcStore.slots == SAMPLE_STORE_RTC_TAGS && rtcStore.capacity == SAMPLE_STORE_RTC_CAPACITY;
+    size_t expected = RTC_HEADER_BYTES;
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS && ok; ++i) {
+        if (!rtcStore.tagHash[i] || !rtcStore.persist[i]) continue;
+        ok = rtcStore.writeIndex[i] < SAMPLE_STORE_RTC_CAPACITY && rtcStore.filledCount[i] <= SAMPLE_STORE_RTC_CAPACITY;
+        expected += SLOT_BYTES;
+    }
+    if (!ok || length != expected) {
+        resetMirror();
+        return false;
+    }
+    size_t offset = RTC_HEADER_BYTES;
+    for (int i = 0; i < SAMPLE_STORE_RTC_TAGS; ++i) {
+        if (rtcStore.tagHash[i] && rtcStore.persist[i]) {
+            memcpy(mirrorSlot(i), blob.data() + offset, SLOT_BYTES);
+            offset += SLOT_BYTES;
+            rtcStore.slotCrc[i] = slotCrc(i);
+        } else {
+            releaseMirror(i);
+        }
+    }
+    rtcStore.crc = headerCrc();
+    return true;
+}
+
+// Per-sensor blobs written by earlier firmware on every buffer wrap
+static void loadLegacySensor(int idx, int legacyCapacity) {
+    char key[32];
+    snprintf(key, sizeof(key), "sbuf_%d", idx);
+    std::vector<SampleEntry> legacy(legacyCapacity);
+    size_t expected = sizeof(SampleEntry) * legacyCapacity;
+    if (getBytesLengthFromNVSns(PREF_NS, key) != expected ||
+        !loadBytesFromNVSns(PREF_NS, key, legacy.data(), expected)) {
+        return;
+    }
+    snprintf(key, sizeof(key), "swi_%d", idx);
+    int wi = loadIntFromNVSns(PREF_NS, key, 0);
+    snprintf(key, sizeof(key), "scnt_%d", idx);
+    int cnt = loadIntFromNVSns(PREF_NS, key, legacyCapacity);
+    if (wi < 0 || wi >= legacyCapacity || cnt < 0 || cnt > legacyCapacity) return;
+    char name[12];
+    snprintf(name, sizeof(name), "AI%d", idx + 1);
+    importMirror(idx, hashTag(name), legacy.data(), legacyCapacity, wi, cnt);
+}
+
+static void checkpointOnShutdown() {
+    // Best effort: esp_restart() may be called while a writer holds the lock
+    if (storeMutex && xSemaphoreTake(storeMutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    std::vector<uint8_t> blob;
+    bool changed = mirrorReady && rtcStore.generation != checkpointGeneration;
+    if (changed) copyCheckpoint(blob);
+    if (storeMutex) xSemaphoreGive(storeMutex);
+    if (changed) saveBytesToNVSns(PREF_NS, CKPT_KEY, blob.data(), blob.size());
+}
+
+// ---- Per-tag overrides ----
+
+static const int OVERRIDE_SET = 0x40000000;
+
+static void overrideKey(uint32_t hash, char *key, size_t size) {
+    snprintf(key, size, "t%08lx", (unsigned long)hash);
+}
+
+static void releaseAllTags() {
+    for (int h = 0; h < SAMPLE_STORE_MAX_TAGS; ++h) {
+        free(tags[h].mem);
+        tags[h] = TagSlot();
+        tags[h].mirror = -1;
+    }
+    for (int i = 0; i < SAMPLE_STORE_MAX_SENSORS; ++i) aiHandles[i] = -1;
+}
+
+static const int KEEP_DECIMALS = INT_MIN;
+
+// Swap a tag's window for one of `capacity` samples at `decimals`, keeping
+// the newest ones. Allocates outside the lock; keeps the current window if
+// the heap is short.
+static bool resizeTag(int handle, int capacity, int decimals = KEEP_DECIMALS) {
+    SampleTagKind kind;
+    uint32_t serial;
+    char name[SAMPLE_TAG_MAX_LEN];
+    int current;
+    {
+        StoreLock lock;
+        if (!tagUsed(handle)) return false;
+        current = tags[handle].cols.capacity;
+        if (decimals == KEEP_DECIMALS) decimals = tags[handle].cols.decimals;
+        decimals = clampDecimals(decimals);
+        if (current == capacity && tags[handle].cols.decimals == decimals) return true;
+        kind = tags[handle].kind;
+        serial = tags[handle].serial;
+        strcpy(name, tags[handle].name);
+    }
+    SensorColumns fresh;
+    uint8_t *mem = allocColumns(kind, capacity, decimals, fresh);
+    if (!mem) {
+        Serial.printf("[SSTORE] No memory for %d samples of %s, keeping %d\n", capacity, name, current);
+        return false;
+    }
+    uint8_t *old = mem;
+    {
+        StoreLock lock;
+        TagSlot &t = tags[handle];
+        if (tagUsed(handle) && t.serial == serial) {
+            columnsCopy(t.cols, fresh, capacity);
+            t.cols = fresh;
+            old = t.mem;
+            t.mem = mem;
+        }
+    }
+    free(old);
+    return true;
 }
 
+// ---- Public API ----
+
 void initSampleStore(int totalSensors, int samplesPerSensor) {
-    g_totalSensors = totalSensors;
-    g_capacity = samplesPerSensor;
-    buffers.clear();
-    writeIndex.clear();
-    filledCount.clear();
-    buffers.resize(totalSensors);
-    writeIndex.resize(totalSensors);
-    filledCount.resize(totalSensors);
+    static bool shutdownHookRegistered = false;
+    if (storeMutex == NULL) storeMutex = xSemaphoreCreateMutex();
+    if (totalSensors > SAMPLE_STORE_MAX_SENSORS) totalSensors = SAMPLE_STORE_MAX_SENSORS;
+    if (totalSensors < 0) totalSensors = 0;
+    int legacyCapacity = samplesPerSensor > 0 ? samplesPerSensor : 1;
+    bool restored;
+    {
+        StoreLock lock;
+        releaseAllTags();
+        g_defaultCapacity = clampCapacity(samplesPerSensor);
+        restored = rtcStoreValid();
+        if (!restored) {
+            resetMirror();
+            if (!loadCheckpoint()) {
+                for (int i = 0; i < totalSensors; ++i) loadLegacySensor(i, legacyCapacity);
+            }
+        }
+        rtcStore.crc = headerCrc();
+        checkpointGeneration = rtcStore.generation;
+        mirrorReady = true;
+    }
+    if (restored) {
+        Serial.printf("[SSTORE] Restored from RTC memory (generation %lu)\n", (unsigned long)rtcStore.generation);
+    }
+    char name[12];
     for (int i = 0; i < totalSensors; ++i) {
-        buffers[i].resize(samplesPerSensor);
-        // attempt to load persisted buffer
-        loadSensor(i);
+        snprintf(name, sizeof(name), "AI%d", i + 1);
+        aiHandles[i] = registerSampleTag(name, SAMPLE_TAG_ADC);
+    }
+    if (!shutdownHookRegistered) {
+        shutdownHookRegistered = esp_register_shutdown_handler(checkpointOnShutdown) == ESP_OK;
     }
 }
 
-// Resize per-sensor sample capacity at runtime; preserve as many recent samples as possible
+int registerSampleTag(const char *tag, SampleTagKind kind, int capacity, SampleRetention retention,
+                      int decimals) {
+    if (!tag || tag[0] == '\0' || strlen(tag) >= (size_t)SAMPLE_TAG_MAX_LEN) return -1;
+    int defaultCapacity;
+    int existing;
+    int current = 0;
+    {
+        StoreLock lock;
+        existing = findTagLocked(tag);
+        if (existing >= 0) {
+            if (tags[existing].cols.decimals == clampDecimals(decimals)) return existing;
+            current = tags[existing].cols.capacity;
+        }
+        defaultCapacity = g_defaultCapacity;
+    }
+    if (existing >= 0) {
+        // Same tag at a new resolution (e.g. a changed Modbus divisor)
+        resizeTag(existing, current, decimals);
+        return existing;
+    }
+    uint32_t hash = hashTag(tag);
+    char key[12];
+    overrideKey(hash, key, sizeof(key));
+    int stored = loadIntFromNVSns(PREF_NS, key, 0);
+    if (stored & OVERRIDE_SET) {
+        capacity = stored & 0xFFFFFF;
+        retention = (SampleRetention)((stored >> 24) & 0x3);
+    }
+    bool followsDefault = capacity <= 0;
+    int cap = clampCapacity(followsDefault ? defaultCapacity : capacity);
+    SensorColumns cols;
+    uint8_t *mem = allocColumns(kind, cap, decimals, cols);
+    if (!mem && cap > SAMPLE_STORE_RTC_CAPACITY) {
+        // Heap too small for the configured window: fall back to the RTC size
+        Serial.printf("[SSTORE] No memory for %d samples of %s, using %d\n", cap, tag, SAMPLE_STORE_RTC_CAPACITY);
+        cap = SAMPLE_STORE_RTC_CAPACITY;
+        mem = allocColumns(kind, cap, decimals, cols);
+    }
+    if (!mem) {
+        Serial.printf("[SSTORE] No memory for %s\n", tag);
+        return -1;
+    }
+
+    uint8_t *discard = nullptr;
+    bool full = false;
+    bool noMirror = false;
+    int handle;
+    {
+        StoreLock lock;
+        handle = findTagLocked(tag);
+        if (handle >= 0) {
+            discard = mem;
+        } else {
+            for (int h = 0; h < SAMPLE_STORE_MAX_TAGS && handle < 0; ++h) {
+                if (tags[h].name[0] == '\0') handle = h;
+            }
+            if (handle < 0) {
+                discard = mem;
+                full = true;
+            } else {
+                TagSlot &t = tags[handle];
+                strcpy(t.name, tag);
+                t.hash = hash;
+                t.serial = nextSerial++;
+                t.kind = kind;
+                t.retention = retention;
+                t.defaultCapacity = followsDefault;
+                t.clamped = 0;
+                t.mem = mem;
+                t.cols = cols;
+                t.mirror = retention != SAMPLE_RETAIN_RAM ? claimMirror(t, true) : -1;
+                noMirror = retention != SAMPLE_RETAIN_RAM && t.mirror < 0 && mirrorReady;
+            }
+        }
+    }
+    free(discard);
+    if (full) Serial.printf("[SSTORE] Tag table full, %s not stored\n", tag);
+    if (noMirror) Serial.printf("[SSTORE] No RTC slot left, %s is kept in RAM only\n", tag);
+    return full ? -1 : handle;
+}
+
+void unregisterSampleTag(int handle) {
+    uint8_t *mem = nullptr;
+    {
+        StoreLock lock;
+        if (!tagUsed(handle)) return;
+        TagSlot &t = tags[handle];
+        if (t.mirror >= 0) {
+            releaseMirror(t.mirror);
+            sealHeader();
+        }
+        mem = t.mem;
+        t = TagSlot();
+        t.mirror = -1;
+        for (int i = 0; i < SAMPLE_STORE_MAX_SENSORS; ++i) {
+            if (aiHandles[i] == handle) aiHandles[i] = -1;
+        }
+    }
+    free(mem);
+}
+
+int findSampleTag(const char *tag) {
+    if (!tag) return -1;
+    StoreLock lock;
+    return findTagLocked(tag);
+}
+
+void addTagSample(int handle, int raw, float smoothed, float value) {
+    if (!isfinite(smoothed) || !isfinite(value)) return;
+    StoreLock lock;
+    if (!tagUsed(handle)) return;
+    TagSlot &t = tags[handle];
+    SampleEntry e;
+    e.raw = raw;
+    e.smoothed = smoothed;
+    e.volt = value;
+    if (columnsPush(t.cols, e)) t.clamped++;
+    if (t.mirror >= 0) {
+        mirrorPush(t.mirror, e);
+        sealSlot(t.mirror);
+    }
+}
+
+void addTagSample(int handle, float value) {
+    addTagSample(handle, 0, 0.0f, value);
+}
+
+bool getTagWindowStats(int handle, int maxSamples, SampleWindowStats &out) {
+    StoreLock lock;
+    if (!tagUsed(handle)) return false;
+    return windowStats(tags[handle].cols, maxSamples, out);
+}
+
+bool getSampleTagInfo(int handle, SampleTagInfo &out) {
+    StoreLock lock;
+    if (!tagUsed(handle)) return false;
+    const TagSlot &t = tags[handle];
+    strcpy(out.tag, t.name);
+    out.kind = t.kind;
+    out.retention = t.retention;
+    out.capacity = t.cols.capacity;
+    out.default_capacity = t.defaultCapacity;
+    out.mirrored = t.mirror >= 0;
+    out.count = t.cols.filled;
+    out.decimals = t.cols.decimals;
+    out.clamped = t.clamped;
+    return true;
+}
+
+bool setSampleTagConfig(const char *tag, int capacity, SampleRetention retention) {
+    if (!tag || tag[0] == '\0' || strlen(tag) >= (size_t)SAMPLE_TAG_MAX_LEN) return false;
+    if (capacity < 0) capacity = 0;
+    if (capacity > SAMPLE_STORE_MAX_CAPACITY) capacity = SAMPLE_STORE_MAX_CAPACITY;
+    char key[12];
+    overrideKey(hashTag(tag), key, sizeof(key));
+    saveIntToNVSns(PREF_NS, key, OVERRIDE_SET | ((int)retention << 24) | capacity);
+
+    int handle;
+    int target;
+    bool ok = true;
+    {
+        StoreLock lock;
+        handle = findTagLocked(tag);
+        if (handle < 0) return true;
+        TagSlot &t = tags[handle];
+        t.retention = retention;
+        t.defaultCapacity = capacity == 0;
+        target = t.defaultCapacity ? g_defaultCapacity : capacity;
+        if (retention == SAMPLE_RETAIN_RAM) {
+            if (t.mirror >= 0) {
+                releaseMirror(t.mirror);
+                sealHeader();
+                t.mirror = -1;
+            }
+        } else if (t.mirror < 0) {
+            t.mirror = claimMirror(t, false);
+            ok = t.mirror >= 0;
+        } else {
+            rtcStore.persist[t.mirror] = retention == SAMPLE_RETAIN_NVS;
+            sealHeader();
+        }
+    }
+    return resizeTag(handle, target) && ok;
+}
+
+const char *sampleRetentionName(SampleRetention retention) {
+    switch (retention) {
+        case SAMPLE_RETAIN_RTC: return "rtc";
+        case SAMPLE_RETAIN_NVS: return "nvs";
+        default: return "ram";
+    }
+}
+
+bool parseSampleRetention(const String &name, SampleRetention &out) {
+    for (int r = SAMPLE_RETAIN_RAM; r <= SAMPLE_RETAIN_NVS; ++r) {
+        if (name.equalsIgnoreCase(sampleRetentionName((SampleRetention)r))) {
+            out = (SampleRetention)r;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Resize the default capacity; tags following it are resized one by one
 void resizeSampleStore(int samplesPerSensor) {
     if (samplesPerSensor <= 0) return;
-    // If capacity unchanged, nothing to do
-    if (samplesPerSensor == g_capacity) return;
-    // Create new buffers and copy recent data
-    std::vector<std::vector<SampleEntry>> newBuffers;
-    newBuffers.resize(g_totalSensors);
-    for (int i = 0; i < g_totalSensors; ++i) {
-        newBuffers[i].resize(samplesPerSensor);
-        int copyCount = min(filledCount[i], samplesPerSensor);
-        // start index of most recent samples in old buffer
-        int oldCap = g_capacity;
-        int start = (writeIndex[i] - copyCount + oldCap) % oldCap;
-        for (int j = 0; j < copyCount; ++j) {
-            int oldIdx = (start + j) % oldCap;
-            newBuffers[i][j] = buffers[i][oldIdx];
-        }
-        // initialize rest
-        for (int j = copyCount; j < samplesPerSensor; ++j) newBuffers[i][j].raw = INT_MIN;
-    }
-    // Swap buffers and update metadata
-    buffers.swap(newBuffers);
-    g_capacity = samplesPerSensor;
-    writeIndex.assign(g_totalSensors, 0);
-    for (int i = 0; i < g_totalSensors; ++i) {
-        filledCount[i] = min(filledCount[i], samplesPerSensor);
+    samplesPerSensor = clampCapacity(samplesPerSensor);
+    {
+        StoreLock lock;
+        // If capacity unchanged, nothing to do
+        if (samplesPerSensor == g_defaultCapacity) return;
+        g_defaultCapacity = samplesPerSensor;
+    }
+    for (int h = 0; h < SAMPLE_STORE_MAX_TAGS; ++h) {
+        bool follows;
+        {
+            StoreLock lock;
+            follows = tagUsed(h) && tags[h].defaultCapacity;
+        }
+        if (follows) resizeTag(h, samplesPerSensor);
     }
 }
 
+static int aiHandle(int sensorIndex) {
+    return (sensorIndex >= 0 && sensorIndex < SAMPLE_STORE_MAX_SENSORS) ? aiHandles[sensorIndex] : -1;
+}
+
 void addSample(int sensorIndex, int raw, float smoothed, float volt) {
-    if (sensorIndex < 0 || sensorIndex >= g_totalSensors) return;
-    int idx = writeIndex[sensorIndex] % g_capacity;
-    buffers[sensorIndex][idx].raw = raw;
-    buffers[sensorIndex][idx].smoothed = smoothed;
-    buffers[sensorIndex][idx].volt = volt;
-    writeIndex[sensorIndex] = (writeIndex[sensorIndex] + 1) % g_capacity;
-    if (filledCount[sensorIndex] < g_capacity) filledCount[sensorIndex]++;
+    addTagSample(aiHandle(sensorIndex), raw, smoothed, volt);
+}
 
-    // Persist when buffer wraps (i.e., writeIndex returns to 0)
-    if (writeIndex[sensorIndex] == 0) {
-        persistSensor(sensorIndex);
-    }
+bool getWindowStats(int sensorIndex, int maxSamples, SampleWindowStats &out) {
+    return getTagWindowStats(aiHandle(sensorIndex), maxSamples, out);
 }
 
 bool getAverages(int sensorIndex, float &avgRaw, float &avgSmoothed, float &avgVolt) {
-    if (sensorIndex < 0 || sensorIndex >= g_totalSensors) return false;
-    int count = filledCount[sensorIndex];
-    if (count == 0) return false;
-    long sumRaw = 0;
-    double sumSm = 0.0;
-    double sumV = 0.0;
-    // oldest index = (writeIndex - filledCount + capacity) % capacity
-    int cap = g_capacity;
-    int start = (writeIndex[sensorIndex] - filledCount[sensorIndex] + cap) % cap;
-    for (int i = 0; i < filledCount[sensorIndex]; ++i) {
-        int idx = (start + i) % cap;
-        sumRaw += buffers[sensorIndex][idx].raw;
-        sumSm += buffers[sensorIndex][idx].smoothed;
-        sumV += buffers[sensorIndex][idx].volt;
-    }
-    avgRaw = (float)sumRaw / (float)count;
-    avgSmoothed = (float)(sumSm / count);
-    avgVolt = (float)(sumV / count);
+    SampleWindowStats stats;
+    if (!getWindowStats(sensorIndex, 0, stats)) return false;
+    avgRaw = stats.avg_raw;
+    avgSmoothed = stats.avg_smoothed;
+    avgVolt = stats.avg_value;
     return true;
 }
 
 bool getRecentAverage(int sensorIndex, int maxSamples, float &avgRaw, float &avgSmoothed,
                       float &avgVolt, int &samplesUsed) {
     samplesUsed = 0;
-    if (sensorIndex < 0 || sensorIndex >= g_totalSensors) return false;
-    int available = filledCount[sensorIndex];
-    if (available == 0) return false;
-
-    int use = available;
-    if (maxSamples > 0 && maxSamples < available) {
-        use = maxSamples;
-    }
-
-    long sumRaw = 0;
-    double sumSm = 0.0;
-    double sumV = 0.0;
-    int cap = g_capacity;
-    int start = (writeIndex[sensorIndex] - use + cap) % cap;
-    for (int i = 0; i < use; ++i) {
-        int idx = (start + i) % cap;
-        sumRaw += buffers[sensorIndex][idx].raw;
-        sumSm += buffers[sensorIndex][idx].smoothed;
-        sumV += buffers[sensorIndex][idx].volt;
-    }
-
-    samplesUsed = use;
-    avgRaw = (float)sumRaw / (float)use;
-    avgSmoothed = (float)(sumSm / use);
-    avgVolt = (float)(sumV / use);
+    SampleWindowStats stats;
+    if (!getWindowStats(sensorIndex, maxSamples, stats)) return false;
+    samplesUsed = stats.count;
+    avgRaw = stats.avg_raw;
+    avgSmoothed = stats.avg_smoothed;
+    avgVolt = stats.avg_value;
     return true;
 }
 
 int getSampleCount(int sensorIndex) {
-    if (sensorIndex < 0 || sensorIndex >= g_totalSensors) return 0;
-    return filledCount[sensorIndex];
+    StoreLock lock;
+    int handle = aiHandle(sensorIndex);
+    return tagUsed(handle) ? tags[handle].cols.filled : 0;
 }
 
 int getSampleCapacity() {
-    return g_capacity;
+    return g_defaultCapacity;
+}
+
+bool checkpointSampleStore() {
+    std::vector<uint8_t> blob;
+    {
+        StoreLock lock;
+        if (!mirrorReady || rtcStore.generation == checkpointGeneration) return true;
+        copyCheckpoint(blob);
+    }
+    uint32_t generation;
+    memcpy(&generation, blob.data() + offsetof(RtcSampleStore, generation), sizeof(generation));
+    if (!saveBytesToNVSns(PREF_NS, CKPT_KEY, blob.data(), blob.size())) return false;
+    StoreLock lock;
+    checkpointGeneration = generation;
+    return true;
 }
 
 void deinitSampleStore() {
-    // Persist all buffers on deinit
-    for (int i = 0; i < g_totalSensors; ++i) persistSensor(i);
-    buffers.clear();
-    writeIndex.clear();
-    filledCount.clear();
-    g_totalSensors = 0;
-    g_capacity = 0;
+    checkpointSampleStore();
+    StoreLock lock;
+    releaseAllTags();
+    mirrorReady = false;
+    g_defaultCapacity = 0;
 }
 
 void clearSampleStore() {
-    // Reset write indices and filled counts and mark entries as empty
-    for (int i = 0; i < g_totalSensors; ++i) {
-        writeIndex[i] = 0;
-        filledCount[i] = 0;
-        for (int j = 0; j < g_capacity; ++j) buffers[i][j].raw = INT_MIN;
-        // Persist cleared buffer so restart/resume doesn't restore old samples
-        persistSensor(i);
+    {
+        StoreLock lock;
+        // Reset write positions and filled counts of every window and mirror slot
+        for (int h = 0; h < SAMPLE_STORE_MAX_TAGS; ++h) {
+            if (tagUsed(h)) resetColumns(tags[h].cols);
+        }
+        if (mirrorReady) {
+            for (int i = 0; i < SAMPLE_STORE_RTC_TAGS; ++i) {
+                rtcStore.writeIndex[i] = 0;
+                rtcStore.filledCount[i] = 0;
+                rtcStore.slotCrc[i] = slotCrc(i);
+            }
+            sealHeader();
+        }
     }
+    // Checkpoint at once so a power cycle doesn't restore old samples
+    checkpointSampleStore();
 }
@@ -1,4 +1,8 @@
 #include "sd_logger.h"
+#include "sd_writer.h"
+#include "binary_log.h"
+#include "log_partition.h"
+#include "outbound_queue.h"
 #include <SPI.h> // Required for SD library
 #include "pins_config.h" // For SD_CS pin
 #include "config.h"
@@ -9,10 +13,14 @@
 // Global variable defined here
 bool sdCardFound = false;
 static bool sdEnabled = true;
+static int sdLogFormat = DEFAULT_SD_LOG_FORMAT;
+// Channel layout the datalog header was last built for (-1 = none yet)
+static int32_t csvHeaderLayout = -1;
 
 void setupSdLogger() {
     // Load persisted SD enabled flag
     sdEnabled = loadBoolFromNVSns("sd", PREF_SD_ENABLED, DEFAULT_SD_ENABLED != 0);
+    sdLogFormat = loadIntFromNVSns("sd", PREF_SD_LOG_FORMAT, DEFAULT_SD_LOG_FORMAT);
 
     if (!sdEnabled) {
         Serial.println("SD logging disabled by configuration.");
@@ -25,17 +33,9 @@ void setupSdLogger() {
         Serial.println("SD card initialized.");
         uint64_t cardSize = SD.cardSize() / (1024 * 1024);
         Serial.printf("SD Card Size: %lluMB\n", cardSize);
-        // Create header for log file if it doesn't exist
-        File dataFile = SD.open("/datalog.csv");
-        if (!dataFile) {
-            Serial.println("Creating datalog.csv with header...");
-            dataFile = SD.open("/datalog.csv", FILE_WRITE);
-            if (dataFile) {
-                dataFile.println("Timestamp,RawADC,SmoothedADC,Voltage");
-                dataFile.close();
-            }
-        }
-        dataFile.close();
+        // Log appends from here on go through the background writer
+        startSdWriter();
+        beginOutboundQueue();
     } else {
         Serial.println("SD card initialization failed!");
     }
@@ -43,152 +43,171 @@ void setupSdLogger() {
 
 void logSensorDataToSd(String data) {
     if (!sdCardFound) return;
+    sdWriterAppendLine(SD_FILE_DATALOG, data);
+}
 
-    File dataFile = SD.open("/datalog.csv", FILE_APPEND);
-    if (dataFile) {
-        dataFile.println(data);
-        dataFile.close();
-        Serial.println("Data logged to SD card.");
-    } else {
-        Serial.println("Error opening datalog.csv");
+void logSensorRecord(const SensorSnapshot &snap, const String &csvRow) {
+    if (!sdCardFound) return;
+    if (sdLogFormat == SD_LOG_FORMAT_BIN) {
+        appendBinaryRecord(snap);
+        return;
     }
+    // The header depends on the channel layout; the writer puts it at the
+    // top of every partition
+    int32_t layout = snap.num_ai | (snap.num_ads << 8) | (snap.num_di << 16);
+    if (layout != csvHeaderLayout && sdWriterSetHeader(SD_FILE_DATALOG, logCsvHeader(snap))) {
+        csvHeaderLayout = layout;
+    }
+    sdWriterAppendLine(SD_FILE_DATALOG, csvRow);
 }
 
-// Append a JSON line to pending notification file. Returns true on success.
+// Queue a JSON line in the outbound queue. Returns false when it was dropped.
 bool appendPendingNotification(const String &jsonLine) {
     if (!sdCardFound) return false;
-    File f = SD.open("/pending_notifications.jsonl", FILE_APPEND);
-    if (!f) return false;
-    f.println(jsonLine);
-    f.close();
-    return true;
+    return outboundQueuePush(jsonLine.c_str(), jsonLine.length());
 }
 
-// Flush pending notifications: read the file and attempt to send via HTTP using existing upload logic
+// Send the queue head in batches of at most OUTQ_BATCH_MAX_RECORDS lines /
+// OUTQ_BATCH_MAX_BYTES, up to OUTQ_BATCHES_PER_RUN per call; each accepted
+// batch is acknowledged before the next is read. After a failure the next
+// attempt waits OUTQ_RETRY_MIN_MS, doubling up to OUTQ_RETRY_MAX_MS.
 bool flushPendingNotifications() {
+    static uint32_t retryAtMs = 0;
+    static uint32_t retryDelayMs = 0;
     if (!sdCardFound) return false;
     if (WiFi.status() != WL_CONNECTED) return false;
-    // Read all pending lines
-    File f = SD.open("/pending_notifications.jsonl", FILE_READ);
-    if (!f) return false;
-    String body;
-    while (f.available()) {
-        String line = f.readStringUntil('\n');
-        line.trim();
-        if (line.length() == 0) continue;
-        body += line;
-        body += "\n";
+    if (retryDelayMs && (int32_t)(millis() - retryAtMs) < 0) return true;
+    if (getOutboundQueueStats().records == 0) return true;
+
+    char *body = (char *)malloc(OUTQ_BATCH_MAX_BYTES);
+    if (!body) return false;
+    bool ok = true;
+    uint32_t sent = 0;
+    for (int batch = 0; batch < OUTQ_BATCHES_PER_RUN; ++batch) {
+        uint32_t records;
+        OutboundPos next;
+        size_t len = outboundQueuePeek(body, OUTQ_BATCH_MAX_BYTES, OUTQ_BATCH_MAX_RECORDS, records, next);
+        if (records == 0) {
+            // Only finished segments (or nothing) before the tail
+            outboundQueueAck(next, 0, 0, 0);
+            break;
+        }
+        uint32_t t0 = millis();
+        HTTPClient http;
+        http.begin(HTTP_NOTIFICATION_URL);
+        http.addHeader("Content-Type", "application/json");
+        int code = http.POST(reinterpret_cast<uint8_t *>(body), len);
+        http.end();
+        if (code < 200 || code >= 300) {
+            outboundQueueSendFailed();
+            ok = false;
+            break;
+        }
+        outboundQueueAck(next, records, (uint32_t)len, millis() - t0);
+        sent += records;
     }
-    f.close();
-
-    if (body.length() == 0) return true; // nothing to do
-
-    // Send as text/plain (line-delimited JSON) to configured HTTP_NOTIFICATION_URL
-    HTTPClient http;
-    http.begin(HTTP_NOTIFICATION_URL);
-    http.addHeader("Content-Type", "application/json");
-    int code = http.POST((uint8_t*)body.c_str(), body.length());
-    bool ok = false;
-    if (code > 0 && code >= 200 && code < 300) ok = true;
-    http.end();
+    free(body);
 
     if (ok) {
-        // remove pending file
-        SD.remove("/pending_notifications.jsonl");
+        retryDelayMs = 0;
+    } else {
+        retryDelayMs = retryDelayMs ? retryDelayMs * 2 : OUTQ_RETRY_MIN_MS;
+        if (retryDelayMs > OUTQ_RETRY_MAX_MS) retryDelayMs = OUTQ_RETRY_MAX_MS;
+        retryAtMs = millis() + retryDelayMs;
+    }
+    if (sent) {
+        Serial.printf("[OUTQ] Sent %lu pending notifications, %lu left\n", (unsigned long)sent,
+                      (unsigned long)getOutboundQueueStats().records);
     }
     return ok;
 }
 
-String readPendingNotifications(int maxLines) {
-    if (!sdCardFound) return String();
-    File f = SD.open("/pending_notifications.jsonl", FILE_READ);
-    if (!f) return String();
-
-    String out;
-    int lines = 0;
-    while (f.available()) {
-        String line = f.readStringUntil('\n');
-        if (line.length() == 0) continue;
-        out += line + "\n";
-        lines++;
-        if (maxLines >= 0 && lines >= maxLines) break;
-    }
-    f.close();
+// Lines at the head of the queue, without consuming them
+String readPendingNotifications(int maxLines, size_t maxBytes, bool *truncated) {
+    if (truncated) *truncated = false;
+    if (!sdCardFound || maxLines == 0 || maxBytes == 0) return String();
+    char *buf = (char *)malloc(maxBytes + 1);
+    if (!buf) return String();
+    uint32_t records;
+    OutboundPos next;
+    uint32_t limit = maxLines > 0 ? (uint32_t)maxLines : UINT32_MAX;
+    size_t len = outboundQueuePeek(buf, maxBytes, limit, records, next, SD_WRITER_WEB_SYNC_MS);
+    buf[len] = '\0';
+    if (truncated) *truncated = records < limit && records < getOutboundQueueStats().records;
+    String out(buf);
+    free(buf);
     return out;
 }
 
 bool clearPendingNotifications() {
     if (!sdCardFound) return false;
-    if (!SD.exists("/pending_notifications.jsonl")) return true;
-    return SD.remove("/pending_notifications.jsonl");
+    return clearOutboundQueue();
 }
 
 size_t countPendingNotifications() {
-    if (!sdCardFound) return 0;
-    File f = SD.open("/pending_notifications.jsonl", FILE_READ);
-    if (!f) return 0;
-    size_t count = 0;
-    while (f.available()) {
-        String line = f.readStringUntil('\n');
-        if (line.length() == 0) continue;
-        count++;
-    }
-    f.close();
-    return count;
+    return sdCardFound ? getOutboundQueueStats().records : 0;
 }
 
 size_t pendingNotificationsFileSize() {
-    if (!sdCardFound) return 0;
-    File f = SD.open("/pending_notifications.jsonl", FILE_READ);
-    if (!f) return 0;
-    size_t sz = f.size();
-    f.close();
-    return sz;
+    return sdCardFound ? getOutboundQueueStats().bytes : 0;
 }
 
-// Append an error message with timestamp to /error.log
+// Queue an error message with timestamp for the error log partitions
 #include "time_sync.h"
 void logErrorToSd(const String &msg) {
     if (!sdCardFound) return;
-    File f = SD.open("/error.log", FILE_APPEND);
-    if (!f) {
-        Serial.println("Error opening error.log for append");
-        return;
-    }
-    // Include ISO timestamp if time available
+    // Include ISO timestamp if time available (taken now, not when written)
     extern String getIsoTimestamp();
-    String ts = getIsoTimestamp();
-    f.print(ts);
-    f.print(" ");
-    f.println(msg);
-    f.close();
-}
-
-// Read error log; return up to maxLines (if maxLines < 0, return whole file)
-String readErrorLog(int maxLines) {
-    if (!sdCardFound) return String();
-    File f = SD.open("/error.log", FILE_READ);
-    if (!f) return String();
-
-    String out;
-    int lines = 0;
-    while (f.available()) {
-        String line = f.readStringUntil('\n');
-        out += line + "\n";
-        lines++;
-        if (maxLines >= 0 && lines >= maxLines) break;
+    String line = getIsoTimestamp();
+    line += " ";
+    line += msg;
+    if (!sdWriterAppendLine(SD_FILE_ERRORLOG, line)) {
+        Serial.println("Error queueing error.log line");
     }
-    f.close();
-    return out;
 }
 
-// Clear the error log
-void clearErrorLog() {
+ErrorLogStream::ErrorLogStream(int maxLines) : linesLeft(maxLines) {
     if (!sdCardFound) return;
-    // Overwrite file by opening in write mode
-    File f = SD.open("/error.log", FILE_WRITE);
-    if (!f) return;
-    f.close();
+    // Web handler: lines still queued may be missing from the tail
+    sdWriterSync(1UL << SD_FILE_ERRORLOG, false, SD_WRITER_WEB_SYNC_MS);
+    hours = listLogPartitions(LOG_STREAM_ERROR, 0, UINT32_MAX);
+}
+
+ErrorLogStream::~ErrorLogStream() {
+    if (file) file.close();
+}
+
+size_t ErrorLogStream::read(uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen && linesLeft != 0) {
+        if (!file) {
+            if (next >= hours.size()) break;
+            char path[LOG_PARTITION_PATH_LEN];
+            logPartitionPath(LOG_STREAM_ERROR, hours[next++], path, sizeof(path));
+            file = SD.open(path, FILE_READ);
+            continue;
+        }
+        int n = file.read(buffer + written, maxLen - written);
+        if (n <= 0) {
+            file.close();
+            continue;
+        }
+        // Stop right after the last requested line
+        for (int i = 0; i < n && linesLeft > 0; ++i) {
+            if (buffer[written + i] == '\n' && --linesLeft == 0) n = i + 1;
+        }
+        written += n;
+    }
+    return written;
+}
+
+// Clear the error log (every partition). False when the writer did not
+// release its handle in time.
+bool clearErrorLog() {
+    if (!sdCardFound) return true;
+    if (!sdWriterSync(1UL << SD_FILE_ERRORLOG, true, SD_WRITER_WEB_SYNC_MS)) return false;
+    removeLogPartitions(LOG_STREAM_ERROR);
+    return true;
 }
 
 void setSdEnabled(bool enabled) {
@@ -201,3 +220,20 @@ bool getSdEnabled() {
     sdEnabled = loadBoolFromNVSns("sd", PREF_SD_ENABLED, DEFAULT_SD_ENABLED != 0);
     return sdEnabled;
 }
+
+void setSdLogFormat(int format) {
+    if (format != SD_LOG_FORMAT_BIN) format = SD_LOG_FORMAT_CSV;
+    if (format == sdLogFormat) return;
+    // Leave nothing of the old format in RAM
+    if (sdLogFormat == SD_LOG_FORMAT_BIN) flushBinaryLog();
+    saveIntToNVSns("sd", PREF_SD_LOG_FORMAT, format);
+    sdLogFormat = format;
+}
+
+int getSdLogFormat() {
+    return sdLogFormat;
+}
+
+const char *sdLogFormatName(int format) {
+    return format == SD_LOG_FORMAT_BIN ? "bin" : "csv";
+}
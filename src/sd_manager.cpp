@@ -1,15 +1,20 @@
 #include "sd_manager.h"
+#include "sd_logger.h"
+#include "sd_writer.h"
+#include "log_partition.h"
 #include "storage_helpers.h"
+#include "config.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 // time helpers from project (isRtcPresent, getRtcEpoch, getIsoTimestamp)
 #include "time_sync.h"
-#include <vector>
 
 // Config
 static uint8_t csPinGlobal = 5;
-static const char* LOG_PATH = "/sensor_log.csv"; // CSV: epoch,value\n
-static const char* PREF_LAST_UPLOADED = "last_uploaded_epoch"; // key in NVS
+// CSV rows "epoch,value" in the hourly /logs/YYYY/MM/DD-HH.sns partitions
+static const char* LOG_PATH = LOG_PARTITION_DIR;
+static const char* PREF_LAST_UPLOADED = "last_uploaded_epoch"; // earlier firmware; seeds the cursor once
+static const char* PREF_CURSOR = "upload_cur"; // UploadCursor blob
 static const char* PREF_NAMESPACE_LOCAL = "sd_mgr"; // separate namespace for sd manager prefs
 
 static String uploadUrl = "";
@@ -32,11 +37,9 @@ bool sdManagerBegin(uint8_t csPin, uint32_t spiFreq) {
     }
     sdReady = true;
     Serial.println("SD initialized");
-    // Ensure log file exists
-    if (!SD.exists(LOG_PATH)) {
-        File f = SD.open(LOG_PATH, FILE_WRITE);
-        if (f) f.close();
-    }
+    // Rows go through the background SD writer like the other logs
+    sdCardFound = true;
+    startSdWriter();
     lastLogMs = millis();
     lastUploadMs = millis();
     return true;
@@ -56,134 +59,173 @@ float readSensor(int sensorPin) {
 
 bool logToSD(const String &csvLine) {
     if (!sdReady) return false;
-    File f = SD.open(LOG_PATH, FILE_APPEND);
-    if (!f) return false;
-    f.println(csvLine);
-    f.close();
-    return true;
+    return sdWriterAppendLine(SD_FILE_SENSORLOG, csvLine);
 }
 
-// Internal: get last_uploaded_epoch from Preferences
-static unsigned long getLastUploadedEpoch() {
-    return loadULongFromNVSns(PREF_NAMESPACE_LOCAL, PREF_LAST_UPLOADED, 0UL);
+// Upload cursor: the next unsent byte of the sensor stream. Partitions are
+// only read forward from it, so an upload costs what was logged since the
+// last one; sent rows stay until retention removes their whole hour.
+struct __attribute__((packed)) UploadCursor {
+    uint32_t magic;
+    uint32_t hour;        // partition
+    uint32_t offset;      // byte offset in it
+    uint32_t skipBefore;  // rows older than this epoch are passed over (first run only)
+};
+
+static_assert(SD_UPLOAD_BATCH_MAX_BYTES >= SD_WRITER_RING_BYTES / 4, "a batch must fit the longest logged line");
+
+static const uint32_t CURSOR_MAGIC = 0x31435055; // "UPC1"
+
+static bool loadCursor(UploadCursor &c) {
+    if (getBytesLengthFromNVSns(PREF_NAMESPACE_LOCAL, PREF_CURSOR) != sizeof(c)) return false;
+    if (!loadBytesFromNVSns(PREF_NAMESPACE_LOCAL, PREF_CURSOR, &c, sizeof(c))) return false;
+    return c.magic == CURSOR_MAGIC;
 }
-static void setLastUploadedEpoch(unsigned long epoch) {
-    saveULongToNVSns(PREF_NAMESPACE_LOCAL, PREF_LAST_UPLOADED, epoch);
+
+static bool saveCursor(const UploadCursor &c) {
+    return saveBytesToNVSns(PREF_NAMESPACE_LOCAL, PREF_CURSOR, &c, sizeof(c));
 }
 
-// Read CSV and collect rows newer than (now - minutes)
-static std::vector<String> collectRecentRows(int minutes) {
-    std::vector<String> rows;
-    if (!sdReady) return rows;
-    File f = SD.open(LOG_PATH, FILE_READ);
-    if (!f) return rows;
+// Cursor of the first run: after the epoch earlier firmware recorded as
+// uploaded, else SD_UPLOAD_FIRST_WINDOW_S back. The index entry before that
+// time is the start; older rows after it are skipped by their epoch.
+static UploadCursor initialCursor() {
+    UploadCursor c;
+    c.magic = CURSOR_MAGIC;
+    unsigned long uploaded = loadULongFromNVSns(PREF_NAMESPACE_LOCAL, PREF_LAST_UPLOADED, 0UL);
     unsigned long nowEpoch = (unsigned long)(isRtcPresent() ? getRtcEpoch() : time(nullptr));
-    unsigned long threshold = (nowEpoch > (unsigned long)minutes * 60) ? (nowEpoch - (unsigned long)minutes * 60) : 0;
-    while (f.available()) {
-        String line = f.readStringUntil('\n');
-        line.trim();
-        if (line.length() == 0) continue;
-        // parse epoch as first csv column
-        int comma = line.indexOf(',');
-        if (comma <= 0) continue;
-        String sEpoch = line.substring(0, comma);
-        unsigned long ep = sEpoch.toInt();
-        if (ep >= threshold) rows.push_back(line);
+    unsigned long from = nowEpoch > SD_UPLOAD_FIRST_WINDOW_S ? nowEpoch - SD_UPLOAD_FIRST_WINDOW_S : 0;
+    if (uploaded > 0) from = uploaded + 1;
+    c.skipBefore = (uint32_t)from;
+    c.hour = logPartitionHour((time_t)from);
+    c.offset = logIndexSeek(LOG_STREAM_SENSOR, c.hour, c.skipBefore);
+    return c;
+}
+
+// Keep a row "epoch,..." unless its epoch is missing or before `skipBefore`
+static bool keepRow(const char *line, size_t len, uint32_t skipBefore) {
+    if (len == 0 || line[0] < '0' || line[0] > '9') return false;
+    unsigned long epoch = strtoul(line, nullptr, 10);
+    return epoch > 0 && epoch >= skipBefore;
+}
+
+// Copy whole rows from `next` on into `buf`, across partitions, and move
+// `next` behind the last one read. Partitions removed by retention are
+// passed over; a line torn by a reset at the end of a finished partition is
+// left behind. Returns the bytes copied; `more` when the batch filled up
+// before the rows ran out.
+static size_t readBatch(char *buf, size_t cap, UploadCursor &next, uint32_t &rows, bool &more) {
+    rows = 0;
+    more = false;
+    size_t used = 0;
+    uint32_t nowHour = logPartitionHour(time(nullptr));
+    char path[LOG_PARTITION_PATH_LEN];
+    for (uint32_t hour : listLogPartitions(LOG_STREAM_SENSOR, next.hour, nowHour > next.hour ? nowHour : next.hour)) {
+        if (hour > next.hour) {
+            next.hour = hour;
+            next.offset = 0;
+        }
+        logPartitionPath(LOG_STREAM_SENSOR, hour, path, sizeof(path));
+        File f = SD.open(path, FILE_READ);
+        if (!f) continue;
+        // A partition shorter than the cursor was cleared and started over
+        if (next.offset > f.size()) next.offset = 0;
+        bool full = false;
+        if (next.offset < f.size() && f.seek(next.offset)) {
+            while (rows < SD_UPLOAD_BATCH_MAX_RECORDS) {
+                size_t room = cap - used;
+                int got = f.read(reinterpret_cast<uint8_t *>(buf + used), room);
+                if (got <= 0) break;
+                // Compact the kept rows in place
+                size_t start = used, keep = used;
+                for (size_t i = used; i < used + got && rows < SD_UPLOAD_BATCH_MAX_RECORDS; ++i) {
+                    if (buf[i] != '\n') continue;
+                    if (keepRow(buf + start, i - start, next.skipBefore)) {
+                        memmove(buf + keep, buf + start, i + 1 - start);
+                        keep += i + 1 - start;
+                        rows++;
+                    }
+                    start = i + 1;
+                }
+                next.offset += start - used;
+                bool partial = start < used + got;
+                used = keep;
+                if (partial) {
+                    // Out of rows or room: the rest is read again by the next
+                    // batch. Otherwise the partition ends mid-line.
+                    full = rows >= SD_UPLOAD_BATCH_MAX_RECORDS || (size_t)got == room;
+                    break;
+                }
+            }
+        }
+        f.close();
+        more = full || rows >= SD_UPLOAD_BATCH_MAX_RECORDS || used == cap;
+        if (more) break;
     }
-    f.close();
-    return rows;
+    return used;
 }
 
-// upload rows via HTTP POST application/csv or JSON array
+// POST the rows after the cursor as text/csv, up to SD_UPLOAD_BATCHES_PER_RUN
+// bounded batches; the cursor is saved after each accepted one
 bool uploadBatchToCloud() {
     if (!sdReady) return false;
     if (uploadUrl.length() == 0) {
         Serial.println("Upload URL not configured");
         return false;
     }
-    std::vector<String> rows = collectRecentRows(5); // last 5 minutes
-    if (rows.size() == 0) {
-        Serial.println("No recent rows to upload");
-        return true; // nothing to do
-    }
+    sdWriterSync(1UL << SD_FILE_SENSORLOG);
+    UploadCursor cursor;
+    if (!loadCursor(cursor)) cursor = initialCursor();
+    char *body = (char *)malloc(SD_UPLOAD_BATCH_MAX_BYTES);
+    if (!body) return false;
 
-    // Build CSV body
-    String body;
-    for (auto &r : rows) {
-        body += r;
-        body += "\n";
-    }
+    bool ok = true;
+    uint32_t sent = 0;
+    for (int batch = 0; batch < SD_UPLOAD_BATCHES_PER_RUN; ++batch) {
+        UploadCursor next = cursor;
+        uint32_t rows = 0;
+        bool more = false;
+        size_t len = readBatch(body, SD_UPLOAD_BATCH_MAX_BYTES, next, rows, more);
+        if (len == 0) {
+            // Only skipped rows or emptied partitions: nothing to send, but
+            // do not read them again
+            if (memcmp(&next, &cursor, sizeof(next)) != 0 && saveCursor(next)) cursor = next;
+            break;
+        }
 
-    HTTPClient http;
-    http.begin(uploadUrl);
-    http.addHeader("Content-Type", "text/csv");
-    if (deviceIdGlobal.length()) http.addHeader("X-Device-Id", deviceIdGlobal);
-    if (apiTokenGlobal.length()) http.addHeader("Authorization", String("Bearer ") + apiTokenGlobal);
-
-    int code = http.POST((uint8_t*)body.c_str(), body.length());
-    bool ok = false;
-    if (code > 0) {
-        Serial.printf("Upload HTTP code: %d\n", code);
-        if (code >= 200 && code < 300) ok = true;
-    } else {
-        Serial.printf("HTTP POST failed: %s\n", http.errorToString(code).c_str());
-    }
-    http.end();
+        HTTPClient http;
+        http.begin(uploadUrl);
+        http.addHeader("Content-Type", "text/csv");
+        if (deviceIdGlobal.length()) http.addHeader("X-Device-Id", deviceIdGlobal);
+        if (apiTokenGlobal.length()) http.addHeader("Authorization", String("Bearer ") + apiTokenGlobal);
 
-    if (ok) {
-        // Mark uploaded rows by rotating file: create temp file with rows older than earliest uploaded epoch
-        // Find earliest epoch uploaded
-        unsigned long earliest = 0;
-        for (auto &r : rows) {
-            int comma = r.indexOf(',');
-            if (comma <= 0) continue;
-            unsigned long ep = r.substring(0, comma).toInt();
-            if (earliest == 0 || ep < earliest) earliest = ep;
-        }
-        if (earliest == 0) return true;
-
-        // Rewrite log with rows that have epoch > earliest (i.e., newer than uploaded) or < earliest (older) ???
-        // We'll preserve rows with epoch > earliest (newer) and rows < earliest (older but not uploaded) — effectively remove uploaded rows with epoch >= earliest and <= latest_uploaded
-        unsigned long latest = 0;
-        for (auto &r : rows) {
-            int comma = r.indexOf(',');
-            if (comma <= 0) continue;
-            unsigned long ep = r.substring(0, comma).toInt();
-            if (ep > latest) latest = ep;
+        int code = http.POST(reinterpret_cast<uint8_t *>(body), len);
+        ok = false;
+        if (code > 0) {
+            Serial.printf("Upload HTTP code: %d\n", code);
+            if (code >= 200 && code < 300) ok = true;
+        } else {
+            Serial.printf("HTTP POST failed: %s\n", http.errorToString(code).c_str());
         }
+        http.end();
+        if (!ok) break;
 
-        // Read original file and write to temp excluding uploaded range [earliest..latest]
-        File fin = SD.open(LOG_PATH, FILE_READ);
-        String tmpPath = String(LOG_PATH) + ".tmp";
-        File fout = SD.open(tmpPath.c_str(), FILE_WRITE);
-        if (!fin || !fout) {
-            if (fin) fin.close();
-            if (fout) fout.close();
-            Serial.println("Failed to open files for rotation after upload");
-            return true; // uploaded ok, but cannot rotate; keep data as-is
-        }
-        while (fin.available()) {
-            String line = fin.readStringUntil('\n');
-            line.trim();
-            if (line.length() == 0) continue;
-            int comma = line.indexOf(',');
-            if (comma <= 0) continue;
-            unsigned long ep = line.substring(0, comma).toInt();
-            // keep line if it's outside uploaded interval
-            if (ep < earliest || ep > latest) {
-                fout.println(line);
-            }
-        }
-        fin.close(); fout.close();
-        // replace original
-        SD.remove(LOG_PATH);
-        SD.rename(tmpPath.c_str(), LOG_PATH);
-
-        // persist last_uploaded_epoch
-        setLastUploadedEpoch(latest);
-        Serial.printf("Upload succeeded, removed rows between %lu and %lu\n", earliest, latest);
+        // Everything up to `next` is sent; the first accepted batch also
+        // ends the catch-up filter
+        next.skipBefore = 0;
+        if (!saveCursor(next)) Serial.println("Upload cursor not saved, rows may be sent again");
+        cursor = next;
+        sent += rows;
+        if (!more) break;
+    }
+    free(body);
+
+    if (ok) {
+        if (sent > 0) Serial.printf("Upload succeeded, %lu rows, cursor %lu:%lu\n", (unsigned long)sent,
+                                    (unsigned long)cursor.hour, (unsigned long)cursor.offset);
+        else Serial.println("No new rows to upload");
     } else {
-        Serial.println("Upload failed, keeping data on SD");
+        Serial.println("Upload failed, cursor kept; rows stay on SD");
     }
     return ok;
 }
@@ -0,0 +1,656 @@
+#include "sd_writer.h"
+#include "sd_logger.h"
+#include "log_partition.h"
+#include "outbound_queue.h"
+
+#include <SD.h>
+#include <atomic>
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+namespace {
+
+static_assert((SD_WRITER_RING_BYTES & (SD_WRITER_RING_BYTES - 1)) == 0 && SD_WRITER_RING_BYTES <= 32768,
+              "SD_WRITER_RING_BYTES must be a power of two up to 32 KB");
+static_assert(SD_WRITER_BLOCK_BYTES >= 4096 && SD_WRITER_BLOCK_BYTES <= 32768 && SD_WRITER_BLOCK_BYTES % 512 == 0,
+              "SD_WRITER_BLOCK_BYTES must be 4..32 KB and a multiple of 512");
+
+// Hourly partition stream of each file (-1 = outbound queue segments)
+const int8_t FILE_STREAMS[SD_FILE_COUNT] = {
+    LOG_STREAM_DATA, -1, LOG_STREAM_ERROR, LOG_STREAM_SENSOR
+};
+
+// Ring records. A producer reserves header + payload by moving `ringHead`
+// with a CAS, copies its payload and then publishes `state`; the writer
+// stops at the first unpublished record. A record that would cross the end
+// of the ring is preceded by a padding record filling the rest. The writer
+// zeroes what it consumed, so an unpublished header always reads REC_EMPTY.
+enum RecordState : uint8_t { REC_EMPTY = 0, REC_READY, REC_PAD };
+
+struct RecordHeader {
+    uint16_t len;  // payload bytes; padding: bytes to the end of the ring
+    uint8_t file;
+    uint8_t state;
+};
+
+const uint32_t HEADER_BYTES = sizeof(RecordHeader);
+const uint32_t RING_MASK = SD_WRITER_RING_BYTES - 1;
+const uint32_t MAX_RECORD = SD_WRITER_RING_BYTES / 4;
+// Records waiting to be published are skipped this many ticks at most while syncing
+const int PUBLISH_WAIT_TICKS = 20;
+
+uint8_t *ring = nullptr;
+std::atomic<uint32_t> ringHead(0); // reserved by producers
+std::atomic<uint32_t> ringTail(0); // consumed by the writer
+std::atomic<uint32_t> ringRecords(0);
+
+// Payload of a block record
+struct BlockWrite {
+    const uint8_t *data;
+    std::atomic<bool> *busy;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t extendTo;
+    char path[SD_WRITER_PATH_LEN];
+};
+
+// Ring file id of block records; also the index of the block file in files[]
+const uint8_t BLOCK_FILE = SD_FILE_COUNT;
+// Ring file id bit of a header record (sdWriterSetHeader)
+const uint8_t HEADER_RECORD = 0x80;
+// Ring file id bit of a segment switch (sdWriterSetSegment)
+const uint8_t SEGMENT_RECORD = 0x40;
+
+// One open handle per file plus, for the text logs, the block being filled
+struct LogFile {
+    File handle;
+    bool open;
+    uint8_t *buf;
+    uint32_t used;
+    uint32_t target;     // bytes that complete the current block of the file
+    uint32_t size;       // file size after the last write (block file: its extent)
+    uint32_t firstMs;    // arrival of the oldest buffered byte
+    uint32_t lastSyncMs;
+    bool dirty;          // written since the last fsync
+    // Partitioned and segmented files
+    uint32_t hour;       // partition hour (or segment) of the open handle
+    uint32_t segment;    // segment later records go to
+    uint32_t indexRecords;
+    uint32_t indexEpoch;
+    uint8_t indexUsed;
+    LogIndexEntry index[LOG_INDEX_BATCH];
+    char *header;        // line (with newline) that starts every partition
+    bool headerWritten;  // the open partition carries `header` already
+};
+
+LogFile files[SD_FILE_COUNT + 1];
+char blockPath[SD_WRITER_PATH_LEN] = "";
+TaskHandle_t writerTask = nullptr;
+uint32_t retentionHour = UINT32_MAX;
+
+// Sync requests: callers OR in their files and bump the sequence; the writer
+// answers every sequence up to the one it read
+SemaphoreHandle_t syncCallerMutex = NULL;
+SemaphoreHandle_t syncDone = NULL;
+std::atomic<uint32_t> syncMask(0);
+std::atomic<uint32_t> syncCloseMask(0);
+std::atomic<uint32_t> syncRequested(0);
+std::atomic<uint32_t> syncAnswered(0);
+
+portMUX_TYPE writerMux = portMUX_INITIALIZER_UNLOCKED;
+SdWriterStats stats;
+uint64_t writeUsSum = 0;
+std::atomic<uint32_t> stagedBytes(0); // changed by the writer task only
+
+uint32_t recordBytes(uint32_t len) {
+    return (HEADER_BYTES + len + 3) & ~3u;
+}
+
+void countDrop() {
+    portENTER_CRITICAL(&writerMux);
+    stats.dropped++;
+    portEXIT_CRITICAL(&writerMux);
+}
+
+void countLostBytes(uint32_t bytes) {
+    portENTER_CRITICAL(&writerMux);
+    stats.dropped_bytes += bytes;
+    stats.write_errors++;
+    portEXIT_CRITICAL(&writerMux);
+}
+
+// Reserve, copy and publish one record; text records get a trailing newline
+bool enqueue(uint8_t file, const void *data, size_t len, bool newline) {
+    uint32_t total = (uint32_t)len + (newline ? 1 : 0);
+    if (total > MAX_RECORD) {
+        countDrop();
+        return false;
+    }
+    uint32_t need = recordBytes(total);
+    uint32_t head = ringHead.load(std::memory_order_relaxed);
+    uint32_t pos, pad, used;
+    for (;;) {
+        pos = head & RING_MASK;
+        uint32_t toEnd = SD_WRITER_RING_BYTES - pos;
+        pad = need > toEnd ? toEnd : 0;
+        used = head - ringTail.load(std::memory_order_acquire);
+        if (used + pad + need > SD_WRITER_RING_BYTES) {
+            countDrop();
+            return false;
+        }
+        if (ringHead.compare_exchange_weak(head, head + pad + need,
+                                           std::memory_order_acq_rel, std::memory_order_relaxed)) break;
+    }
+    if (pad) {
+        RecordHeader *h = reinterpret_cast<RecordHeader *>(ring + pos);
+        h->len = (uint16_t)pad;
+        __atomic_store_n(&h->state, (uint8_t)REC_PAD, __ATOMIC_RELEASE);
+        pos = 0;
+    }
+    RecordHeader *h = reinterpret_cast<RecordHeader *>(ring + pos);
+    memcpy(ring + pos + HEADER_BYTES, data, len);
+    if (newline) ring[pos + HEADER_BYTES + len] = '\n';
+    h->len = (uint16_t)total;
+    h->file = file;
+    __atomic_store_n(&h->state, (uint8_t)REC_READY, __ATOMIC_RELEASE);
+    ringRecords.fetch_add(1, std::memory_order_relaxed);
+
+    used += pad + need;
+    portENTER_CRITICAL(&writerMux);
+    stats.records++;
+    if (used > stats.max_queue_bytes) stats.max_queue_bytes = used;
+    portEXIT_CRITICAL(&writerMux);
+    // Below half full the writer's own poll is soon enough
+    if (used >= SD_WRITER_RING_BYTES / 2) xTaskNotifyGive(writerTask);
+    return true;
+}
+
+// Partition hour of a partitioned file, segment number of a segmented one
+uint32_t fileKey(int index) {
+    return FILE_STREAMS[index] >= 0 ? logPartitionHour(time(nullptr)) : files[index].segment;
+}
+
+// File of `index` for partition hour or segment `key`; false when its
+// partition directory is missing
+bool filePath(int index, uint32_t key, char *out, size_t len) {
+    if (FILE_STREAMS[index] < 0) {
+        if (key == 0) return false;
+        outboundSegmentPath(key, out, len);
+        return true;
+    }
+    if (!ensureLogPartitionDir(key)) return false;
+    logPartitionPath((LogStream)FILE_STREAMS[index], key, out, len);
+    return true;
+}
+
+// Synchronous path used when the task is not running (no index entries)
+bool appendDirect(uint8_t file, const char *data, size_t len) {
+    char path[SD_WRITER_PATH_LEN];
+    if (!filePath(file, fileKey(file), path, sizeof(path))) return false;
+    File f = SD.open(path, FILE_APPEND);
+    if (!f) return false;
+    const char *header = files[file].header;
+    if (header && f.size() == 0) f.write(reinterpret_cast<const uint8_t *>(header), strlen(header));
+    size_t n = f.write(reinterpret_cast<const uint8_t *>(data), len);
+    n += f.write('\n');
+    f.close();
+    return n == len + 1;
+}
+
+bool writeBlockDirect(const BlockWrite &w) {
+    File f = SD.open(w.path, "r+");
+    if (!f) f = SD.open(w.path, FILE_WRITE);
+    if (!f) return false;
+    if (w.extendTo > f.size() && f.seek(w.extendTo - 1)) f.write((uint8_t)0);
+    bool ok = f.seek(w.offset) && f.write(w.data, w.len) == w.len;
+    f.close();
+    return ok;
+}
+
+// ---- Writer task ----
+
+void writeStaged(LogFile &f);
+void syncFile(LogFile &f);
+void closeFile(LogFile &f);
+
+// Whether the file at `path` begins with `text`
+bool fileStartsWith(const char *path, const char *text) {
+    File f = SD.open(path, FILE_READ);
+    if (!f) return false;
+    size_t len = strlen(text);
+    char buf[128];
+    bool same = true;
+    for (size_t done = 0; same && done < len;) {
+        size_t n = len - done < sizeof(buf) ? len - done : sizeof(buf);
+        same = f.read(reinterpret_cast<uint8_t *>(buf), n) == (int)n && memcmp(buf, text + done, n) == 0;
+        done += n;
+    }
+    f.close();
+    return same;
+}
+
+// Append the buffered index entries of a partitioned file
+void flushIndex(LogFile &f) {
+    if (f.indexUsed == 0) return;
+    if (!appendLogIndex(f.hour, f.index, f.indexUsed)) countLostBytes(0);
+    f.indexUsed = 0;
+}
+
+// Open the file of `index` for appending; a partition whose hour has passed
+// or a segment that was switched away from is closed first
+bool ensureOpen(LogFile &f, int index, uint32_t hour) {
+    if (f.open && f.hour == hour) return true;
+    if (f.open) {
+        writeStaged(f);
+        syncFile(f);
+        closeFile(f);
+    }
+    char path[SD_WRITER_PATH_LEN];
+    if (!filePath(index, hour, path, sizeof(path))) return false;
+    bool continued = f.header && SD.exists(path) && fileStartsWith(path, f.header);
+    f.handle = SD.open(path, FILE_APPEND);
+    if (!f.handle && FILE_STREAMS[index] >= 0) {
+        // The month directory may have been removed behind the cache
+        forgetLogPartitionDirs();
+        if (filePath(index, hour, path, sizeof(path))) f.handle = SD.open(path, FILE_APPEND);
+    }
+    if (!f.handle) return false;
+    f.open = true;
+    f.size = f.handle.size();
+    f.dirty = false;
+    f.lastSyncMs = millis();
+    f.hour = hour;
+    f.indexRecords = 0;
+    f.indexEpoch = 0;
+    f.headerWritten = continued && f.size > 0;
+    return true;
+}
+
+void closeFile(LogFile &f) {
+    flushIndex(f);
+    if (f.open) f.handle.close();
+    f.open = false;
+    stagedBytes -= f.used;
+    f.used = 0;
+    free(f.buf);
+    f.buf = nullptr;
+}
+
+void recordWrite(uint32_t bytes, uint32_t us) {
+    portENTER_CRITICAL(&writerMux);
+    stats.writes++;
+    stats.bytes_written += bytes;
+    stats.last_write_us = us;
+    if (us > stats.max_write_us) stats.max_write_us = us;
+    writeUsSum += us;
+    portEXIT_CRITICAL(&writerMux);
+}
+
+// Write `len` bytes at the handle's position; a failed write drops the
+// handle so the next record reopens it (and rereads the size)
+uint32_t writeOut(LogFile &f, const uint8_t *data, uint32_t len) {
+    int64_t t0 = esp_timer_get_time();
+    uint32_t n = (uint32_t)f.handle.write(data, len);
+    recordWrite(n, (uint32_t)(esp_timer_get_time() - t0));
+    f.dirty = true;
+    if (n != len) {
+        countLostBytes(len - n);
+        f.handle.close();
+        f.open = false;
+    }
+    return n;
+}
+
+void writeStaged(LogFile &f) {
+    if (f.used == 0) return;
+    uint32_t used = f.used;
+    f.used = 0;
+    stagedBytes -= used;
+    f.size += writeOut(f, f.buf, used);
+}
+
+void syncFile(LogFile &f) {
+    if (!f.open || !f.dirty) return;
+    int64_t t0 = esp_timer_get_time();
+    f.handle.flush();
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    f.dirty = false;
+    f.lastSyncMs = millis();
+    portENTER_CRITICAL(&writerMux);
+    stats.syncs++;
+    if (us > stats.max_sync_us) stats.max_sync_us = us;
+    portEXIT_CRITICAL(&writerMux);
+}
+
+// Copy bytes into the file's block buffer, writing each block the moment
+// it completes. The first block after an open only runs up to the next
+// block boundary of the file, so later writes start block-aligned.
+void stageBytes(LogFile &f, const uint8_t *data, uint32_t len) {
+    if (!f.buf) f.buf = (uint8_t *)malloc(SD_WRITER_BLOCK_BYTES);
+    if (!f.buf) {
+        f.size += writeOut(f, data, len);
+        return;
+    }
+    while (len > 0 && f.open) {
+        if (f.used == 0) {
+            f.target = SD_WRITER_BLOCK_BYTES - f.size % SD_WRITER_BLOCK_BYTES;
+            f.firstMs = millis();
+        }
+        uint32_t n = f.target - f.used;
+        if (n > len) n = len;
+        memcpy(f.buf + f.used, data, n);
+        f.used += n;
+        stagedBytes += n;
+        data += n;
+        len -= n;
+        if (f.used == f.target) writeStaged(f);
+    }
+    if (len > 0) countLostBytes(len);
+}
+
+// One record of a text log. Partitioned logs go to the partition of the
+// current hour, start with the file's header line and get an index entry
+// every LOG_INDEX_EVERY records; the outbound queue goes to its current
+// segment.
+void stageRecord(int index, const uint8_t *data, uint32_t len) {
+    LogFile &f = files[index];
+    uint32_t now = (uint32_t)time(nullptr);
+    if (!sdCardFound || !ensureOpen(f, index, fileKey(index))) {
+        countLostBytes(len);
+        return;
+    }
+    if (FILE_STREAMS[index] >= 0) {
+        if (f.header && !f.headerWritten) {
+            f.headerWritten = true;
+            stageBytes(f, reinterpret_cast<const uint8_t *>(f.header), strlen(f.header));
+        }
+        if (f.indexRecords++ % LOG_INDEX_EVERY == 0) {
+            // Monotonic per partition even if the clock steps back
+            if (now < f.indexEpoch) now = f.indexEpoch;
+            f.indexEpoch = now;
+            LogIndexEntry &e = f.index[f.indexUsed++];
+            memset(&e, 0, sizeof(e));
+            e.epoch = now;
+            e.offset = f.size + f.used;
+            e.stream = (uint8_t)FILE_STREAMS[index];
+            if (f.indexUsed == LOG_INDEX_BATCH) flushIndex(f);
+        }
+    }
+    stageBytes(f, data, len);
+}
+
+// A header record: a changed header is written again before the next record
+void setHeader(int index, const uint8_t *data, uint32_t len) {
+    LogFile &f = files[index];
+    if (f.header && strlen(f.header) == len && memcmp(f.header, data, len) == 0) return;
+    free(f.header);
+    f.header = (char *)malloc(len + 1);
+    if (!f.header) return;
+    memcpy(f.header, data, len);
+    f.header[len] = '\0';
+    f.headerWritten = false;
+}
+
+bool openBlockFile(LogFile &f, const char *path) {
+    if (f.open && strcmp(blockPath, path) == 0) return true;
+    if (f.open) {
+        syncFile(f);
+        closeFile(f);
+    }
+    f.handle = SD.open(path, "r+");
+    if (!f.handle) f.handle = SD.open(path, FILE_WRITE);
+    if (!f.handle) return false;
+    strlcpy(blockPath, path, sizeof(blockPath));
+    f.open = true;
+    f.size = f.handle.size();
+    f.dirty = false;
+    f.lastSyncMs = millis();
+    return true;
+}
+
+void writeBlock(const BlockWrite &w) {
+    LogFile &f = files[BLOCK_FILE];
+    if (!sdCardFound || !openBlockFile(f, w.path)) {
+        countLostBytes(w.len);
+    } else {
+        if (w.extendTo > f.size) {
+            // Allocate the whole extent now rather than a cluster per write
+            if (f.handle.seek(w.extendTo - 1) && f.handle.write((uint8_t)0) == 1) f.size = w.extendTo;
+            else countLostBytes(0);
+        }
+        if (f.handle.seek(w.offset)) writeOut(f, w.data, w.len);
+        else countLostBytes(w.len);
+    }
+    w.busy->store(false, std::memory_order_release);
+}
+
+// Consume published records in order. While syncing, wait briefly for a
+// producer that reserved a slot but has not published it yet.
+void drainRing(bool syncing) {
+    uint32_t tail = ringTail.load(std::memory_order_relaxed);
+    int waited = 0;
+    while (tail != ringHead.load(std::memory_order_acquire)) {
+        uint32_t pos = tail & RING_MASK;
+        RecordHeader *h = reinterpret_cast<RecordHeader *>(ring + pos);
+        uint8_t state = __atomic_load_n(&h->state, __ATOMIC_ACQUIRE);
+        if (state == REC_EMPTY) {
+            if (!syncing || waited++ >= PUBLISH_WAIT_TICKS) break;
+            vTaskDelay(1);
+            continue;
+        }
+        uint32_t step;
+        if (state == REC_PAD) {
+            step = h->len;
+        } else {
+            step = recordBytes(h->len);
+            if (h->file < SD_FILE_COUNT) {
+                stageRecord(h->file, ring + pos + HEADER_BYTES, h->len);
+            } else if (h->file & HEADER_RECORD) {
+                setHeader(h->file & ~HEADER_RECORD, ring + pos + HEADER_BYTES, h->len);
+            } else if (h->file & SEGMENT_RECORD) {
+                memcpy(&files[h->file & ~SEGMENT_RECORD].segment, ring + pos + HEADER_BYTES, sizeof(uint32_t));
+            } else if (h->file == BLOCK_FILE) {
+                BlockWrite w;
+                memcpy(&w, ring + pos + HEADER_BYTES, sizeof(w));
+                writeBlock(w);
+            }
+            ringRecords.fetch_sub(1, std::memory_order_relaxed);
+        }
+        memset(ring + pos, 0, step);
+        tail += step;
+        ringTail.store(tail, std::memory_order_release);
+    }
+}
+
+void applyPolicy(uint32_t now) {
+    for (int i = 0; i <= SD_FILE_COUNT; ++i) {
+        LogFile &f = files[i];
+        if (!f.open) continue;
+        if (!sdCardFound) {
+            // SD logging was switched off: write what is buffered and let go
+            writeStaged(f);
+            syncFile(f);
+            closeFile(f);
+            continue;
+        }
+        if (f.used > 0 && now - f.firstMs >= SD_WRITER_FLUSH_MS) writeStaged(f);
+        if (f.dirty && now - f.lastSyncMs >= SD_WRITER_SYNC_MS) syncFile(f);
+    }
+}
+
+void answerSync() {
+    uint32_t requested = syncRequested.load(std::memory_order_acquire);
+    if (requested == syncAnswered.load(std::memory_order_relaxed)) return;
+    uint32_t mask = syncMask.exchange(0);
+    uint32_t closeMask = syncCloseMask.exchange(0);
+    drainRing(true);
+    for (int i = 0; i <= SD_FILE_COUNT; ++i) {
+        if (!(mask & (1UL << i))) continue;
+        LogFile &f = files[i];
+        if (f.open) {
+            writeStaged(f);
+            flushIndex(f);
+            syncFile(f);
+        }
+        if (closeMask & (1UL << i)) closeFile(f);
+    }
+    syncAnswered.store(requested, std::memory_order_release);
+    xSemaphoreGive(syncDone);
+}
+
+// Once an hour: close the partitions of the past hour (their last block and
+// index entries land now, not with the next record) and apply retention
+void rotatePartitions() {
+    if (!sdCardFound) return;
+    uint32_t hour = logPartitionHour(time(nullptr));
+    if (hour == retentionHour) return;
+    retentionHour = hour;
+    for (int i = 0; i < SD_FILE_COUNT; ++i) {
+        LogFile &f = files[i];
+        if (FILE_STREAMS[i] < 0 || !f.open || f.hour == hour) continue;
+        writeStaged(f);
+        syncFile(f);
+        closeFile(f);
+    }
+    enforceLogRetention(hour);
+}
+
+void flushOnShutdown() {
+    sdWriterSync(SD_FILE_ALL, true, 500);
+}
+
+void sdWriterLoop(void *) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SD_WRITER_POLL_MS));
+        drainRing(false);
+        applyPolicy(millis());
+        rotatePartitions();
+        answerSync();
+    }
+}
+
+} // namespace
+
+bool startSdWriter() {
+    if (writerTask) return true;
+    if (!ring) ring = (uint8_t *)calloc(SD_WRITER_RING_BYTES, 1);
+    if (syncCallerMutex == NULL) syncCallerMutex = xSemaphoreCreateMutex();
+    if (syncDone == NULL) syncDone = xSemaphoreCreateBinary();
+    if (!ring || !syncCallerMutex || !syncDone) {
+        Serial.println("[SDW] No memory for the SD writer; writing synchronously");
+        return false;
+    }
+    BaseType_t ok = xTaskCreatePinnedToCore(sdWriterLoop, "sd_writer", SD_WRITER_TASK_STACK, nullptr,
+                                            SD_WRITER_TASK_PRIORITY, &writerTask, SD_WRITER_TASK_CORE);
+    if (ok != pdPASS) {
+        writerTask = nullptr;
+        Serial.println("[SDW] Failed to create SD writer task; writing synchronously");
+        return false;
+    }
+    esp_register_shutdown_handler(flushOnShutdown);
+    portENTER_CRITICAL(&writerMux);
+    stats.running = true;
+    stats.queue_capacity = SD_WRITER_RING_BYTES;
+    portEXIT_CRITICAL(&writerMux);
+    return true;
+}
+
+bool isSdWriterRunning() {
+    return writerTask != nullptr;
+}
+
+bool sdWriterAppendLine(SdWriterFile file, const char *data, size_t len) {
+    if (file >= SD_FILE_COUNT || !sdCardFound) return false;
+    if (!writerTask) return appendDirect(file, data, len);
+    return enqueue(file, data, len, true);
+}
+
+bool sdWriterAppendLine(SdWriterFile file, const String &line) {
+    return sdWriterAppendLine(file, line.c_str(), line.length());
+}
+
+bool sdWriterSetHeader(SdWriterFile file, const String &line) {
+    if (file >= SD_FILE_COUNT || FILE_STREAMS[file] < 0) return false;
+    if (!writerTask) {
+        // No writer task, so nothing else touches files[]
+        String withNewline = line + "\n";
+        setHeader(file, reinterpret_cast<const uint8_t *>(withNewline.c_str()), withNewline.length());
+        return true;
+    }
+    return enqueue(HEADER_RECORD | file, line.c_str(), line.length(), true);
+}
+
+bool sdWriterSetSegment(SdWriterFile file, uint32_t segment) {
+    if (file >= SD_FILE_COUNT || FILE_STREAMS[file] >= 0 || segment == 0) return false;
+    if (!writerTask) {
+        files[file].segment = segment;
+        return true;
+    }
+    return enqueue(SEGMENT_RECORD | file, &segment, sizeof(segment), false);
+}
+
+bool sdWriterWriteBlock(const char *path, uint32_t offset, const uint8_t *data, uint32_t len,
+                        uint32_t extendTo, std::atomic<bool> *busy) {
+    if (!sdCardFound || !path || strlen(path) >= (size_t)SD_WRITER_PATH_LEN) return false;
+    BlockWrite w;
+    w.data = data;
+    w.busy = busy;
+    w.offset = offset;
+    w.len = len;
+    w.extendTo = extendTo;
+    strlcpy(w.path, path, sizeof(w.path));
+    if (!writerTask) return writeBlockDirect(w);
+    busy->store(true, std::memory_order_release);
+    if (enqueue(BLOCK_FILE, &w, sizeof(w), false)) return true;
+    busy->store(false, std::memory_order_release);
+    return false;
+}
+
+bool sdWriterSync(uint32_t fileMask, bool close, uint32_t timeoutMs) {
+    if (!writerTask || xTaskGetCurrentTaskHandle() == writerTask) return true;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(timeoutMs);
+    if (xSemaphoreTake(syncCallerMutex, limit) != pdTRUE) return false;
+    syncMask.fetch_or(fileMask & SD_FILE_ALL);
+    if (close) syncCloseMask.fetch_or(fileMask & SD_FILE_ALL);
+    uint32_t seq = syncRequested.fetch_add(1, std::memory_order_acq_rel) + 1;
+    xTaskNotifyGive(writerTask);
+    bool done = false;
+    for (;;) {
+        // Wrap-safe: answered has reached or passed our sequence
+        if ((int32_t)(syncAnswered.load(std::memory_order_acquire) - seq) >= 0) {
+            done = true;
+            break;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit || xSemaphoreTake(syncDone, limit - elapsed) != pdTRUE) break;
+    }
+    xSemaphoreGive(syncCallerMutex);
+    return done;
+}
+
+SdWriterStats getSdWriterStats() {
+    portENTER_CRITICAL(&writerMux);
+    SdWriterStats out = stats;
+    uint64_t sum = writeUsSum;
+    portEXIT_CRITICAL(&writerMux);
+    uint32_t tail = ringTail.load(std::memory_order_acquire);
+    out.queue_bytes = ringHead.load(std::memory_order_acquire) - tail;
+    out.queue_records = ringRecords.load(std::memory_order_relaxed);
+    out.staged_bytes = stagedBytes;
+    out.avg_write_us = out.writes > 0 ? (uint32_t)(sum / out.writes) : 0;
+    return out;
+}
+
+void resetSdWriterStats() {
+    portENTER_CRITICAL(&writerMux);
+    bool running = stats.running;
+    stats = SdWriterStats();
+    stats.running = running;
+    stats.queue_capacity = running ? SD_WRITER_RING_BYTES : 0;
+    writeUsSum = 0;
+    portEXIT_CRITICAL(&writerMux);
+}
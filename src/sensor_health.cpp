@@ -0,0 +1,146 @@
+#include "sensor_health.h"
+
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+
+namespace {
+
+const char *const CODE_NAMES[] = {"stuck", "noisy", "spikes", "open_loop", "over_range", "saturated"};
+
+// Welford accumulator for one block
+struct Welford {
+    uint32_t n = 0;
+    float mean = 0.0f;
+    float m2 = 0.0f;
+
+    void add(float x) {
+        n++;
+        float d = x - mean;
+        mean += d / (float)n;
+        m2 += d * (x - mean);
+    }
+    float stddev() const { return n > 1 ? sqrtf(m2 / (float)(n - 1)) : 0.0f; }
+};
+
+// Per-channel state, owned by the acquisition task
+struct ChannelState {
+    Welford values;             // block statistics of the value
+    Welford steps;              // block statistics of sample-to-sample steps
+    float stepStd = NAN;        // steps stddev of the last completed block
+    float lastValue = NAN;
+    uint16_t blockSpikes = 0;
+    int32_t anchorRaw = 0;
+    int64_t anchorUs = 0;
+    bool anchored = false;
+    int64_t lastSampleUs = -1;
+    uint16_t blockCodes = 0;    // NOISY/SPIKES from the last completed block
+    SensorHealthStats stats;
+};
+
+portMUX_TYPE healthMux = portMUX_INITIALIZER_UNLOCKED;
+ChannelState channels[HEALTH_MAX_CHANNELS];
+bool resetRequested[HEALTH_MAX_CHANNELS] = {false};
+
+// Published for readers
+SensorHealthStats statsCopy[HEALTH_MAX_CHANNELS];
+
+void closeBlock(ChannelState &st) {
+    st.stats.mean = st.values.mean;
+    st.stats.stddev = st.values.stddev();
+    st.stats.block_spikes = st.blockSpikes;
+    st.stepStd = st.steps.stddev();
+    st.blockCodes = 0;
+    if (st.stats.stddev > HEALTH_NOISE_BAR) st.blockCodes |= HEALTH_NOISY;
+    if (st.blockSpikes > HEALTH_SPIKE_MAX_PER_BLOCK) st.blockCodes |= HEALTH_SPIKES;
+    st.values = Welford();
+    st.steps = Welford();
+    st.blockSpikes = 0;
+}
+
+} // namespace
+
+uint16_t updateSensorHealth(int channel, float value, int32_t rawCode, float loopMa,
+                            bool saturated, int64_t sampleUs) {
+    if (channel < 0 || channel >= HEALTH_MAX_CHANNELS) return 0;
+    ChannelState &st = channels[channel];
+
+    portENTER_CRITICAL(&healthMux);
+    bool reset = resetRequested[channel];
+    resetRequested[channel] = false;
+    portEXIT_CRITICAL(&healthMux);
+    if (reset) st = ChannelState();
+    // The same conversion handed over twice (job faster than the converter)
+    if (sampleUs == st.lastSampleUs) return st.stats.codes;
+    st.lastSampleUs = sampleUs;
+
+    st.stats.samples++;
+    if (isfinite(value)) {
+        // A step far outside the usual step spread is a spike; a ramp is not
+        if (isfinite(st.lastValue)) {
+            float step = value - st.lastValue;
+            float limit = isnan(st.stepStd) ? INFINITY : HEALTH_SPIKE_SIGMA * st.stepStd;
+            if (limit < HEALTH_SPIKE_MIN_BAR) limit = HEALTH_SPIKE_MIN_BAR;
+            if (fabsf(step) > limit) {
+                st.blockSpikes++;
+                st.stats.spikes++;
+            }
+            st.steps.add(step);
+        }
+        st.lastValue = value;
+        st.values.add(value);
+        if (st.values.n >= HEALTH_WINDOW_SAMPLES) closeBlock(st);
+    }
+
+    if (!st.anchored || abs(rawCode - st.anchorRaw) > HEALTH_STUCK_COUNTS) {
+        st.anchorRaw = rawCode;
+        st.anchorUs = sampleUs;
+        st.anchored = true;
+    }
+    st.stats.flat_ms = (uint32_t)((sampleUs - st.anchorUs) / 1000);
+
+    uint16_t codes = st.blockCodes;
+    if (st.stats.flat_ms >= HEALTH_STUCK_MS) codes |= HEALTH_STUCK;
+    if (!isnan(loopMa)) {
+        if (loopMa < HEALTH_LOOP_MIN_MA) codes |= HEALTH_OPEN_LOOP;
+        else if (loopMa > HEALTH_LOOP_MAX_MA) codes |= HEALTH_OVER_RANGE;
+    }
+    if (saturated) codes |= HEALTH_SATURATED;
+    st.stats.codes = codes;
+    st.stats.loop_ma = loopMa;
+
+    portENTER_CRITICAL(&healthMux);
+    statsCopy[channel] = st.stats;
+    portEXIT_CRITICAL(&healthMux);
+    return codes;
+}
+
+bool getSensorHealth(int channel, SensorHealthStats &out) {
+    if (channel < 0 || channel >= HEALTH_MAX_CHANNELS) return false;
+    portENTER_CRITICAL(&healthMux);
+    out = statsCopy[channel];
+    portEXIT_CRITICAL(&healthMux);
+    return true;
+}
+
+void resetSensorHealth() {
+    portENTER_CRITICAL(&healthMux);
+    for (int i = 0; i < HEALTH_MAX_CHANNELS; ++i) {
+        resetRequested[i] = true;
+        statsCopy[i] = SensorHealthStats();
+    }
+    portEXIT_CRITICAL(&healthMux);
+}
+
+uint8_t healthStatusFlags(uint16_t codes) {
+    uint8_t flags = 0;
+    if (codes & HEALTH_FAULT_MASK) flags |= SENSOR_FLAG_FAULT;
+    if (codes & HEALTH_DEGRADED_MASK) flags |= SENSOR_FLAG_DEGRADED;
+    if (codes & HEALTH_SATURATED) flags |= SENSOR_FLAG_SATURATED;
+    return flags;
+}
+
+void healthCodesToJson(uint16_t codes, JsonArray out) {
+    for (int bit = 0; bit < (int)(sizeof(CODE_NAMES) / sizeof(CODE_NAMES[0])); ++bit) {
+        if (codes & (1 << bit)) out.add(CODE_NAMES[bit]);
+    }
+}
@@ -0,0 +1,87 @@
+#include "sensor_snapshot.h"
+#include "config.h"
+
+#include "freertos/FreeRTOS.h"
+
+namespace {
+
+portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+SensorSnapshot latestSnapshot;
+uint32_t snapshotSeq = 0;
+
+SensorSnapshot recordQueue[SNAPSHOT_RECORD_QUEUE_LEN];
+uint32_t recordHead = 0;  // oldest
+uint32_t recordCount = 0;
+uint32_t lastQueuedRecordSeq = 0;
+uint32_t recordDrops = 0;
+
+} // namespace
+
+uint32_t publishSensorSnapshot(SensorSnapshot &snap) {
+    snap.millis_at = millis();
+    portENTER_CRITICAL(&snapshotMux);
+    snap.seq = ++snapshotSeq;
+    latestSnapshot = snap;
+    if (snap.record_seq != lastQueuedRecordSeq) {
+        lastQueuedRecordSeq = snap.record_seq;
+        if (recordCount == SNAPSHOT_RECORD_QUEUE_LEN) {
+            // Full: the oldest record gives way
+            recordHead = (recordHead + 1) % SNAPSHOT_RECORD_QUEUE_LEN;
+            recordCount--;
+            recordDrops++;
+        }
+        recordQueue[(recordHead + recordCount) % SNAPSHOT_RECORD_QUEUE_LEN] = snap;
+        recordCount++;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+    return snap.seq;
+}
+
+bool takeRecordSnapshot(SensorSnapshot &out) {
+    portENTER_CRITICAL(&snapshotMux);
+    bool have = recordCount > 0;
+    if (have) {
+        out = recordQueue[recordHead];
+        recordHead = (recordHead + 1) % SNAPSHOT_RECORD_QUEUE_LEN;
+        recordCount--;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+    return have;
+}
+
+uint32_t getRecordSnapshotDrops() {
+    portENTER_CRITICAL(&snapshotMux);
+    uint32_t drops = recordDrops;
+    portEXIT_CRITICAL(&snapshotMux);
+    return drops;
+}
+
+void resetRecordSnapshotDrops() {
+    portENTER_CRITICAL(&snapshotMux);
+    recordDrops = 0;
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+bool getSensorSnapshot(SensorSnapshot &out) {
+    portENTER_CRITICAL(&snapshotMux);
+    out = latestSnapshot;
+    portEXIT_CRITICAL(&snapshotMux);
+    return out.seq != 0;
+}
+
+uint32_t getSensorSnapshotSeq() {
+    portENTER_CRITICAL(&snapshotMux);
+    uint32_t seq = snapshotSeq;
+    portEXIT_CRITICAL(&snapshotMux);
+    return seq;
+}
+
+const char *sensorStatusString(uint8_t flags) {
+    if (flags & SENSOR_FLAG_DISABLED) return "disabled";
+    if (flags & SENSOR_FLAG_UNAVAILABLE) return "unavailable";
+    if (flags & SENSOR_FLAG_FAULT) return "fault";
+    if (flags & SENSOR_FLAG_SATURATED) return "alert";
+    if (flags & SENSOR_FLAG_STALE) return "stale";
+    if (flags & SENSOR_FLAG_DEGRADED) return "degraded";
+    return "ok";
+}
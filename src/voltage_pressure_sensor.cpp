@@ -5,14 +5,22 @@
 #include <math.h>
 
 #include "sensor_calibration_types.h" // For SensorCalibration struct
+#include "filter_pipeline.h"
+#include "burst_capture.h"
 
 #include "esp_adc_cal.h"
+#include "driver/adc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "sd_logger.h"
 // Storage helpers provide NVS read/write helpers used to fetch runtime config like divider_mv
 #include "storage_helpers.h"
 
 // ADC calibration handle and characteristics (declared early so conversion helpers can use it)
 static esp_adc_cal_characteristics_t adc_chars;
+// esp_adc_cal_raw_to_voltage() for every 12-bit code, built once after characterization
+static uint16_t adcMvLut[4096];
+static bool adcMvLutReady = false;
 
 // Define the voltage pressure sensor pins
 const int VOLTAGE_SENSOR_PINS[] = {AI1_PIN, AI2_PIN, AI3_PIN};
@@ -21,6 +29,8 @@ const int NUM_VOLTAGE_SENSORS = sizeof(VOLTAGE_SENSOR_PINS) / sizeof(VOLTAGE_SEN
 // Global variables defined here
 // Array to store smoothed ADC values for each sensor
 static float smoothedADC[NUM_VOLTAGE_SENSORS];
+// Last single raw conversion taken during the most recent update
+static int lastRawADC[NUM_VOLTAGE_SENSORS];
 // consecutive full-scale raw reads counter to detect real saturation vs transient spike
 static int consecutiveSaturations[NUM_VOLTAGE_SENSORS];
 // Array to store calibration data for each sensor
@@ -38,6 +48,92 @@ static const char* const ADC_DIVIDER_SCALE_KEYS[NUM_VOLTAGE_SENSORS] = {
     "div_scale2"
 };
 
+// Continuous ADC1 DMA capture. The digital controller scans AI1..AI3 in the
+// background at ADC_DMA_SAMPLE_FREQ_HZ; a drain task folds every conversion
+// into a per-channel boxcar accumulator, and updateVoltagePressureSensor()
+// takes sum/count as the decimated reading and restarts the window.
+static int adcMode = DEFAULT_ADC_MODE;
+static volatile bool adcDmaRunning = false;
+static volatile bool adcDmaStopRequested = false;
+static TaskHandle_t adcDmaTaskHandle = nullptr;
+static portMUX_TYPE adcDmaMux = portMUX_INITIALIZER_UNLOCKED;
+static int adcDmaChannel[NUM_VOLTAGE_SENSORS];
+static uint64_t dmaSum[NUM_VOLTAGE_SENSORS];
+static uint32_t dmaCount[NUM_VOLTAGE_SENSORS];
+static int dmaLatest[NUM_VOLTAGE_SENSORS];
+static uint32_t dmaLastWindow[NUM_VOLTAGE_SENSORS];
+static uint32_t dmaOverflows = 0;
+
+// Capture-mode switch requested from another task (-1 = none). The DMA <->
+// analogRead switch reconfigures ADC1, so only the sampling path applies it,
+// between conversions; setup applies it directly until sampling has started.
+static int adcModeRequested = -1;
+static bool adcSamplingStarted = false;
+static portMUX_TYPE adcModeMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Optional filter chain per pin applied to each averaged reading (empty by
+// default = pass-through). Owned by the sampling path; new configs from other
+// tasks are staged and picked up on the next update.
+static FilterPipeline adcFilter[NUM_VOLTAGE_SENSORS];
+static FilterPipelineConfig adcFilterConfig[NUM_VOLTAGE_SENSORS]; // latest requested
+static bool adcFilterDirty[NUM_VOLTAGE_SENSORS];
+static portMUX_TYPE adcFilterMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void applyPendingAdcFilter(int pinIndex) {
+    if (!adcFilterDirty[pinIndex]) return;
+    portENTER_CRITICAL(&adcFilterMux);
+    FilterPipelineConfig cfg = adcFilterConfig[pinIndex];
+    adcFilterDirty[pinIndex] = false;
+    portEXIT_CRITICAL(&adcFilterMux);
+    adcFilter[pinIndex].configure(cfg);
+}
+
+// Raw code -> 0..10 V -> calibrated pressure, folded into constants per channel:
+//   volts    = clamp(mv * mvToVolts + voltsOffset, 0, 10)
+//   pressure = volts * pressureSlope + pressureOffset   (volts when !pressureValid)
+// Rebuilt whenever calibration, divider scale or linear correction change.
+struct AdcChannelTransform {
+    float mvToVolts = 0.0f;
+    float voltsOffset = 0.0f;
+    float pressureSlope = 1.0f;
+    float pressureOffset = 0.0f;
+    bool pressureValid = false;
+};
+static AdcChannelTransform adcTransform[NUM_VOLTAGE_SENSORS];
+static portMUX_TYPE adcTransformMux = portMUX_INITIALIZER_UNLOCKED;
+
+static AdcChannelTransform getTransform(int channelIndex) {
+    portENTER_CRITICAL(&adcTransformMux);
+    AdcChannelTransform t = adcTransform[channelIndex];
+    portEXIT_CRITICAL(&adcTransformMux);
+    return t;
+}
+
+// Interpolated table lookup for a (possibly fractional) code
+static float adcCodeToMv(float code) {
+    if (code <= 0.0f) code = 0.0f;
+    if (code >= 4095.0f) code = 4095.0f;
+    int i = (int)code;
+    if (!adcMvLutReady) return (float)esp_adc_cal_raw_to_voltage(i, &adc_chars);
+    float mv = adcMvLut[i];
+    float frac = code - (float)i;
+    if (frac > 0.0f && i < 4095) mv += frac * (float)(adcMvLut[i + 1] - adcMvLut[i]);
+    return mv;
+}
+
+static float transformToVolts(const AdcChannelTransform &t, float mv) {
+    float v = mv * t.mvToVolts + t.voltsOffset;
+    if (v < 0.0f) v = 0.0f;
+    if (v > 10.0f) v = 10.0f;
+    return v;
+}
+
+static void rebuildAdcTransform(int channelIndex);
+
+static void rebuildAllAdcTransforms() {
+    for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) rebuildAdcTransform(i);
+}
+
 static void loadDividerScalesFromNvs() {
     for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
         float stored = loadFloatFromNVSns("adc_cfg", ADC_DIVIDER_SCALE_KEYS[i], DEFAULT_ADC_DIVIDER_SCALE[i]);
@@ -46,30 +142,26 @@ static void loadDividerScalesFromNvs() {
         }
         adcDividerScale[i] = stored;
     }
+    rebuildAllAdcTransforms();
 }
 
 float convert010V(int adc, int channelIndex) {
-    if (adc < 0) adc = 0;
-    if (adc > 4095) adc = 4095;
-
     if (channelIndex < 0 || channelIndex >= NUM_VOLTAGE_SENSORS) {
         channelIndex = 0;
     }
+    return transformToVolts(getTransform(channelIndex), adcCodeToMv((float)adc));
+}
 
-    float scale = adcDividerScale[channelIndex];
-    if (!isfinite(scale) || scale <= 0.0f) {
-        scale = DEFAULT_ADC_DIVIDER_SCALE[channelIndex];
-    }
-
-    int mv = adcRawToMv(adc);
-    float adcVoltage = (float)mv / 1000.0f;
-    float voltage_v = adcVoltage * scale;
-
-    float corrected_v = voltage_v * voltageLinearScale + voltageLinearOffset;
+float adcCodeToVoltage(float code, int channelIndex) {
+    if (channelIndex < 0 || channelIndex >= NUM_VOLTAGE_SENSORS) return 0.0f;
+    return transformToVolts(getTransform(channelIndex), adcCodeToMv(code));
+}
 
-    if (corrected_v < 0.0f) corrected_v = 0.0f;
-    if (corrected_v > 10.0f) corrected_v = 10.0f;
-    return corrected_v;
+float adcCodeToPressure(float code, int channelIndex) {
+    if (channelIndex < 0 || channelIndex >= NUM_VOLTAGE_SENSORS) return 0.0f;
+    AdcChannelTransform t = getTransform(channelIndex);
+    float v = transformToVolts(t, adcCodeToMv(code));
+    return t.pressureValid ? v * t.pressureSlope + t.pressureOffset : v;
 }
 
 void setVoltageLinearCalibration(float scale, float offset) {
@@ -83,6 +175,7 @@ void setVoltageLinearCalibration(float scale, float offset) {
     voltageLinearOffset = offset;
     saveFloatToNVSns("adc_cfg", "linear_scale", voltageLinearScale);
     saveFloatToNVSns("adc_cfg", "linear_offset", voltageLinearOffset);
+    rebuildAllAdcTransforms();
 }
 
 void getVoltageLinearCalibration(float &scale, float &offset) {
@@ -91,7 +184,10 @@ void getVoltageLinearCalibration(float &scale, float &offset) {
 }
 
 int adcRawToMv(int raw) {
-    return esp_adc_cal_raw_to_voltage(raw, &adc_chars);
+    if (raw < 0) raw = 0;
+    if (raw > 4095) raw = 4095;
+    if (!adcMvLutReady) return esp_adc_cal_raw_to_voltage(raw, &adc_chars);
+    return adcMvLut[raw];
 }
 
 float getSmoothedVoltagePressure(int pinIndex) {
@@ -99,32 +195,36 @@ float getSmoothedVoltagePressure(int pinIndex) {
         Serial.printf("Error: Invalid pinIndex %d for voltage sensor.\n", pinIndex);
         return 0.0; // Return a default or error value
     }
+    // Map the smoothed code through the channel transform: corrected 0..10 V,
+    // then linear interpolation between the voltages at the zero and span points
+    return adcCodeToPressure(smoothedADC[pinIndex], pinIndex);
+}
 
-    // 1. Get the current voltage reading using the complex conversion.
-    float currentVoltage = convert010V((int)smoothedADC[pinIndex], pinIndex);
-
-    // 2. Get the calibration data for the sensor.
-    SensorCalibration cal = voltageSensorCalibrations[pinIndex];
-
-    // 3. At calibration time, the raw ADC values for zero and span pressures were stored.
-    //    Let's find out what the corrected voltage was at those calibration points.
-    float voltageAtZeroPoint = convert010V((int)cal.zeroRawAdc, pinIndex);
-    float voltageAtSpanPoint = convert010V((int)cal.spanRawAdc, pinIndex);
-
-    // 4. Now, map the `currentVoltage` from the measured voltage range [voltageAtZeroPoint, voltageAtSpanPoint]
-    //    to the desired pressure range [cal.zeroPressureValue, cal.spanPressureValue].
-
-    // Avoid division by zero if calibration points are identical.
-    if (fabs(voltageAtSpanPoint - voltageAtZeroPoint) < 0.001f) {
-        return currentVoltage; // Return uncalibrated voltage if calibration is invalid.
+// Fold divider scale, linear correction and the zero/span calibration of one
+// channel into AdcChannelTransform
+static void rebuildAdcTransform(int channelIndex) {
+    float scale = adcDividerScale[channelIndex];
+    if (!isfinite(scale) || scale <= 0.0f) {
+        scale = DEFAULT_ADC_DIVIDER_SCALE[channelIndex];
+    }
+    AdcChannelTransform t;
+    t.mvToVolts = scale * voltageLinearScale / 1000.0f;
+    t.voltsOffset = voltageLinearOffset;
+
+    // Corrected voltages the sensor produced at the calibration points
+    SensorCalibration cal = voltageSensorCalibrations[channelIndex];
+    float voltageAtZeroPoint = transformToVolts(t, adcCodeToMv((float)(int)cal.zeroRawAdc));
+    float voltageAtSpanPoint = transformToVolts(t, adcCodeToMv((float)(int)cal.spanRawAdc));
+    // Identical calibration points: report uncalibrated voltage
+    if (fabs(voltageAtSpanPoint - voltageAtZeroPoint) >= 0.001f) {
+        t.pressureSlope = (cal.spanPressureValue - cal.zeroPressureValue) / (voltageAtSpanPoint - voltageAtZeroPoint);
+        t.pressureOffset = cal.zeroPressureValue - voltageAtZeroPoint * t.pressureSlope;
+        t.pressureValid = true;
     }
 
-    // Perform linear interpolation (map function).
-    float calibratedPressure = cal.zeroPressureValue + (currentVoltage - voltageAtZeroPoint) * 
-                             (cal.spanPressureValue - cal.zeroPressureValue) / 
-                             (voltageAtSpanPoint - voltageAtZeroPoint);
-
-    return calibratedPressure;
+    portENTER_CRITICAL(&adcTransformMux);
+    adcTransform[channelIndex] = t;
+    portEXIT_CRITICAL(&adcTransformMux);
 }
 
 // (Legacy wrappers removed) Use indexed APIs instead
@@ -145,6 +245,11 @@ void initAdcCalibration() {
     } else {
         Serial.println("ADC characterization used default Vref (approx)");
     }
+    for (int raw = 0; raw < 4096; ++raw) {
+        adcMvLut[raw] = (uint16_t)esp_adc_cal_raw_to_voltage(raw, &adc_chars);
+    }
+    adcMvLutReady = true;
+    rebuildAllAdcTransforms();
 }
 
 void loadVoltagePressureCalibration() {
@@ -222,6 +327,176 @@ void loadVoltagePressureCalibration() {
                       voltageSensorCalibrations[i].offset,
                       voltageSensorCalibrations[i].scale);
     }
+    rebuildAllAdcTransforms();
+}
+
+static int dmaIndexForChannel(int channel) {
+    for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
+        if (adcDmaChannel[i] == channel) return i;
+    }
+    return -1;
+}
+
+// Pull frames from the driver ring and accumulate them. Sums for one frame are
+// built locally so the spinlock is only held for the final merge.
+static void adcDmaDrainTask(void *) {
+    uint8_t frame[ADC_DMA_FRAME_BYTES];
+    static int16_t captureCodes[NUM_VOLTAGE_SENSORS][ADC_DMA_FRAME_BYTES / sizeof(adc_digi_output_data_t)];
+    while (!adcDmaStopRequested) {
+        uint32_t len = 0;
+        esp_err_t err = adc_digi_read_bytes(frame, sizeof(frame), &len, 100);
+        if (err == ESP_ERR_TIMEOUT) continue;
+        if (err == ESP_ERR_INVALID_STATE) {
+            // Driver ring overflowed and dropped frames; the bytes returned are still valid
+            portENTER_CRITICAL(&adcDmaMux);
+            dmaOverflows++;
+            portEXIT_CRITICAL(&adcDmaMux);
+        } else if (err != ESP_OK) {
+            continue;
+        }
+
+        uint32_t sum[NUM_VOLTAGE_SENSORS] = {0};
+        uint32_t count[NUM_VOLTAGE_SENSORS] = {0};
+        int latest[NUM_VOLTAGE_SENSORS];
+        for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) latest[i] = -1;
+        // Every conversion of the frame, per pin, while a burst capture records
+        const bool capturing = burstCaptureActive();
+
+        for (uint32_t off = 0; off + sizeof(adc_digi_output_data_t) <= len; off += sizeof(adc_digi_output_data_t)) {
+            const adc_digi_output_data_t *d = reinterpret_cast<const adc_digi_output_data_t *>(&frame[off]);
+            int idx = dmaIndexForChannel(d->type1.channel);
+            if (idx < 0) continue;
+            if (capturing) captureCodes[idx][count[idx]] = (int16_t)d->type1.data;
+            sum[idx] += d->type1.data;
+            count[idx]++;
+            latest[idx] = d->type1.data;
+        }
+        if (capturing) {
+            for (int i = 0; i < NUM_VOLTAGE_SENSORS && i < CAPTURE_SRC_ADS0; ++i) {
+                if (count[i] > 0) burstCaptureFeed((CaptureSource)(CAPTURE_SRC_AI1 + i), captureCodes[i], count[i]);
+            }
+        }
+
+        portENTER_CRITICAL(&adcDmaMux);
+        for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
+            if (count[i] == 0) continue;
+            dmaSum[i] += sum[i];
+            dmaCount[i] += count[i];
+            dmaLatest[i] = latest[i];
+        }
+        portEXIT_CRITICAL(&adcDmaMux);
+    }
+    adcDmaTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+static bool startAdcDma() {
+    if (adcDmaRunning) return true;
+
+    uint32_t mask = 0;
+    adc_digi_pattern_config_t pattern[NUM_VOLTAGE_SENSORS] = {};
+    for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
+        int ch = digitalPinToAnalogChannel(VOLTAGE_SENSOR_PINS[i]);
+        if (ch < 0 || ch >= ADC1_CHANNEL_MAX) {
+            Serial.printf("[ADC] Pin %d is not on ADC1, DMA capture unavailable\n", VOLTAGE_SENSOR_PINS[i]);
+            return false;
+        }
+        adcDmaChannel[i] = ch;
+        mask |= (1UL << ch);
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = ch;
+        pattern[i].unit = 0; // ADC1
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        dmaSum[i] = 0;
+        dmaCount[i] = 0;
+        dmaLatest[i] = lastRawADC[i];
+        dmaLastWindow[i] = 0;
+    }
+
+    adc_digi_init_config_t initCfg = {};
+    initCfg.max_store_buf_size = ADC_DMA_FRAME_BYTES * 8;
+    initCfg.conv_num_each_intr = ADC_DMA_FRAME_BYTES;
+    initCfg.adc1_chan_mask = mask;
+    initCfg.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&initCfg) != ESP_OK) {
+        Serial.println("[ADC] adc_digi_initialize failed");
+        return false;
+    }
+
+    adc_digi_configuration_t digCfg = {};
+    digCfg.conv_limit_en = true;
+    digCfg.conv_limit_num = 250;
+    digCfg.pattern_num = NUM_VOLTAGE_SENSORS;
+    digCfg.adc_pattern = pattern;
+    digCfg.sample_freq_hz = ADC_DMA_SAMPLE_FREQ_HZ;
+    digCfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    digCfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&digCfg) != ESP_OK || adc_digi_start() != ESP_OK) {
+        Serial.println("[ADC] DMA controller configuration failed");
+        adc_digi_deinitialize();
+        return false;
+    }
+
+    adcDmaStopRequested = false;
+    if (xTaskCreatePinnedToCore(adcDmaDrainTask, "adc_dma", 4096, nullptr,
+                                ACQ_TASK_PRIORITY + 1, &adcDmaTaskHandle, ACQ_TASK_CORE) != pdPASS) {
+        adcDmaTaskHandle = nullptr;
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        Serial.println("[ADC] Failed to create DMA drain task");
+        return false;
+    }
+    adcDmaRunning = true;
+    Serial.printf("[ADC] Continuous DMA capture started at %d Hz over %d pins\n", ADC_DMA_SAMPLE_FREQ_HZ, NUM_VOLTAGE_SENSORS);
+    return true;
+}
+
+static void stopAdcDma() {
+    if (!adcDmaRunning) return;
+    // Switch readers back to analogRead first, then let the drain task exit on its own
+    adcDmaRunning = false;
+    adcDmaStopRequested = true;
+    for (int i = 0; i < 50 && adcDmaTaskHandle; ++i) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    adcDmaStopRequested = false;
+    Serial.println("[ADC] Continuous DMA capture stopped");
+}
+
+static void applyPendingAdcMode() {
+    portENTER_CRITICAL(&adcModeMux);
+    int mode = adcModeRequested;
+    adcModeRequested = -1;
+    portEXIT_CRITICAL(&adcModeMux);
+    if (mode == ADC_MODE_DMA) {
+        startAdcDma();
+    } else if (mode == ADC_MODE_ONESHOT) {
+        stopAdcDma();
+    }
+}
+
+static void requestAdcMode(int mode) {
+    portENTER_CRITICAL(&adcModeMux);
+    adcModeRequested = mode;
+    portEXIT_CRITICAL(&adcModeMux);
+}
+
+// Take the boxcar window accumulated since the previous call. Returns false if
+// no conversions arrived for this pin.
+static bool takeDmaWindow(int pinIndex, float &avg, int &latest) {
+    portENTER_CRITICAL(&adcDmaMux);
+    uint64_t sum = dmaSum[pinIndex];
+    uint32_t count = dmaCount[pinIndex];
+    latest = dmaLatest[pinIndex];
+    dmaSum[pinIndex] = 0;
+    dmaCount[pinIndex] = 0;
+    if (count > 0) dmaLastWindow[pinIndex] = count;
+    portEXIT_CRITICAL(&adcDmaMux);
+    if (count == 0) return false;
+    avg = (float)((double)sum / (double)count);
+    return true;
 }
 
 void setupVoltagePressureSensor() {
@@ -229,20 +504,50 @@ void setupVoltagePressureSensor() {
     loadVoltagePressureCalibration(); // Load calibration on startup
     loadDividerScalesFromNvs();
 
-    // Seed smoothed ADCs using vendor-style averaging to match sample code
     // Read persisted value if present
     adcNumSamples = loadIntFromNVSns("adc_cfg", "num_samples", adcNumSamples);
+    for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
+        char key[16]; snprintf(key, sizeof(key), "filt_%d", i);
+        FilterPipelineConfig cfg;
+        loadFilterPipeline("adc_cfg", key, cfg);
+        portENTER_CRITICAL(&adcFilterMux);
+        adcFilterConfig[i] = cfg;
+        adcFilterDirty[i] = true;
+        portEXIT_CRITICAL(&adcFilterMux);
+    }
+    adcMode = loadIntFromNVSns("adc_cfg", "mode", adcMode);
+    requestAdcMode(adcMode);
+    if (!adcSamplingStarted) {
+        bool wasRunning = adcDmaRunning;
+        applyPendingAdcMode();
+        // Give the controller a few frames so the seed below has data
+        if (adcDmaRunning && !wasRunning) vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    // Seed smoothed ADCs: from the DMA window when capturing continuously,
+    // otherwise using vendor-style averaging to match sample code
     const int SAMPLE_DELAY_MS = 2;
     for (int i = 0; i < NUM_VOLTAGE_SENSORS; ++i) {
-        int pin = VOLTAGE_SENSOR_PINS[i];
-        long sum = 0;
-        for (int s = 0; s < adcNumSamples; ++s) {
-            sum += analogRead(pin);
-            delay(SAMPLE_DELAY_MS);
+        float avg = 0.0f;
+        int latest = 0;
+        applyPendingAdcFilter(i);
+        if (adcDmaRunning && takeDmaWindow(i, avg, latest)) {
+            smoothedADC[i] = adcFilter[i].process(avg);
+            lastRawADC[i] = latest;
+        } else if (!adcDmaRunning) {
+            int pin = VOLTAGE_SENSOR_PINS[i];
+            long sum = 0;
+            for (int s = 0; s < adcNumSamples; ++s) {
+                sum += analogRead(pin);
+                delay(SAMPLE_DELAY_MS);
+            }
+            avg = (float)(sum / adcNumSamples);
+            smoothedADC[i] = adcFilter[i].process(avg);
+            lastRawADC[i] = (int)avg;
+        } else {
+            continue;
         }
-        int avg = (int)(sum / adcNumSamples);
-        smoothedADC[i] = (float)avg;
-        consecutiveSaturations[i] = (avg >= 4095) ? 1 : 0;
+        consecutiveSaturations[i] = (smoothedADC[i] >= 4095.0f) ? 1 : 0;
     }
 }
 
@@ -292,6 +597,7 @@ void saveCalibrationForPin(int pinIndex, float zeroRawAdc, float spanRawAdc, flo
         voltageSensorCalibrations[pinIndex].scale = 1.0;
         voltageSensorCalibrations[pinIndex].offset = 0.0;
     }
+    rebuildAdcTransform(pinIndex);
 }
 
 struct SensorCalibration getCalibrationForPin(int pinIndex) {
@@ -303,33 +609,46 @@ struct SensorCalibration getCalibrationForPin(int pinIndex) {
 }
 
 
-void updateVoltagePressureSensor(int pinIndex) {
+bool updateVoltagePressureSensor(int pinIndex) {
     if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) {
         Serial.printf("Error: Invalid pinIndex %d for voltage sensor update.\n", pinIndex);
-        return;
+        return false;
     }
-    // Vendor-style averaging: take NUM_SAMPLES samples with short delay, compute average
-    int NUM_SAMPLES = adcNumSamples; // runtime-configurable
-    const int SAMPLE_DELAY_MS = 2;
-    long sum = 0;
+    adcSamplingStarted = true;
+    applyPendingAdcMode();
     int rawADC = 0;
-    for (int s = 0; s < NUM_SAMPLES; ++s) {
-        rawADC = analogRead(VOLTAGE_SENSOR_PINS[pinIndex]);
-        sum += rawADC;
-        delay(SAMPLE_DELAY_MS);
+    float avg = 0.0f;
+    if (adcDmaRunning) {
+        // Boxcar decimation of every conversion since the previous update
+        if (!takeDmaWindow(pinIndex, avg, rawADC)) {
+            return false; // no fresh conversions; keep the previous reading
+        }
+    } else {
+        // Vendor-style averaging: take NUM_SAMPLES samples with short delay, compute average
+        int NUM_SAMPLES = adcNumSamples; // runtime-configurable
+        const int SAMPLE_DELAY_MS = 2;
+        long sum = 0;
+        for (int s = 0; s < NUM_SAMPLES; ++s) {
+            rawADC = analogRead(VOLTAGE_SENSOR_PINS[pinIndex]);
+            sum += rawADC;
+            delay(SAMPLE_DELAY_MS);
+        }
+        avg = (float)(sum / NUM_SAMPLES);
     }
-    int avg = (int)(sum / NUM_SAMPLES);
-    smoothedADC[pinIndex] = (float)avg;
+    lastRawADC[pinIndex] = rawADC;
+    applyPendingAdcFilter(pinIndex);
+    smoothedADC[pinIndex] = adcFilter[pinIndex].process(avg);
     // Clamp to ADC range
     if (smoothedADC[pinIndex] < 0.0f) smoothedADC[pinIndex] = 0.0f;
     if (smoothedADC[pinIndex] > 4095.0f) smoothedADC[pinIndex] = 4095.0f;
     // Update saturation tracking (simple threshold)
-    if (avg >= 4095) {
+    if (avg >= 4095.0f) {
         consecutiveSaturations[pinIndex]++;
         if (consecutiveSaturations[pinIndex] > 1000) consecutiveSaturations[pinIndex] = 1000;
     } else {
         consecutiveSaturations[pinIndex] = 0;
     }
+    return true;
 }
 
 // Returns true if the pin has been saturated recently
@@ -348,6 +667,7 @@ void setAdcDividerScale(int index, float scale) {
     if (!isfinite(scale) || scale <= 0.0f) return;
     adcDividerScale[index] = scale;
     saveFloatToNVSns("adc_cfg", ADC_DIVIDER_SCALE_KEYS[index], scale);
+    rebuildAdcTransform(index);
 }
 
 const float* getAllAdcDividerScales() {
@@ -362,6 +682,12 @@ float getSmoothedADC(int pinIndex) {
     return smoothedADC[pinIndex];
 }
 
+// Accessor for the last single raw conversion taken by updateVoltagePressureSensor()
+int getLastRawADC(int pinIndex) {
+    if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) return 0;
+    return lastRawADC[pinIndex];
+}
+
 // Runtime getters/setters for ADC per-read sample count
 int getAdcNumSamples() {
     return loadIntFromNVSns("adc_cfg", "num_samples", adcNumSamples);
@@ -373,3 +699,65 @@ void setAdcNumSamples(int n) {
     // Update runtime variable
     adcNumSamples = n;
 }
+
+int readVoltageSensorRaw(int pinIndex) {
+    if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) return 0;
+    if (adcDmaRunning) {
+        portENTER_CRITICAL(&adcDmaMux);
+        int latest = dmaLatest[pinIndex];
+        portEXIT_CRITICAL(&adcDmaMux);
+        return latest;
+    }
+    return analogRead(VOLTAGE_SENSOR_PINS[pinIndex]);
+}
+
+int getAdcCaptureMode() {
+    return adcMode;
+}
+
+bool setAdcCaptureMode(int mode) {
+    if (mode != ADC_MODE_ONESHOT && mode != ADC_MODE_DMA) return false;
+    saveIntToNVSns("adc_cfg", "mode", mode);
+    adcMode = mode;
+    requestAdcMode(mode);
+    return true;
+}
+
+bool isAdcDmaRunning() {
+    return adcDmaRunning;
+}
+
+uint32_t getAdcDmaWindowSamples(int pinIndex) {
+    if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) return 0;
+    portENTER_CRITICAL(&adcDmaMux);
+    uint32_t n = dmaLastWindow[pinIndex];
+    portEXIT_CRITICAL(&adcDmaMux);
+    return n;
+}
+
+uint32_t getAdcDmaOverflows() {
+    portENTER_CRITICAL(&adcDmaMux);
+    uint32_t n = dmaOverflows;
+    portEXIT_CRITICAL(&adcDmaMux);
+    return n;
+}
+
+bool setAdcFilterPipeline(int pinIndex, const FilterPipelineConfig &config) {
+    if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) return false;
+    if (validateFilterPipeline(config).length() > 0) return false;
+    portENTER_CRITICAL(&adcFilterMux);
+    adcFilterConfig[pinIndex] = config;
+    adcFilterDirty[pinIndex] = true;
+    portEXIT_CRITICAL(&adcFilterMux);
+    char key[16]; snprintf(key, sizeof(key), "filt_%d", pinIndex);
+    saveFilterPipeline("adc_cfg", key, config);
+    return true;
+}
+
+FilterPipelineConfig getAdcFilterPipeline(int pinIndex) {
+    if (pinIndex < 0 || pinIndex >= NUM_VOLTAGE_SENSORS) return FilterPipelineConfig();
+    portENTER_CRITICAL(&adcFilterMux);
+    FilterPipelineConfig cfg = adcFilterConfig[pinIndex];
+    portEXIT_CRITICAL(&adcFilterMux);
+    return cfg;
+}
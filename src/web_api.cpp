@@ -7,9 +7,14 @@
 #include "sensors_config.h"
 #include "http_notifier.h"
 #include "sd_logger.h"
+#include "sd_writer.h"
+#include "log_partition.h"
+#include "outbound_queue.h"
+#include "binary_log.h"
 #include "current_pressure_sensor.h"
 #include "device_id.h"
 #include "sample_store.h"
+#include "sensor_snapshot.h"
 #include "time_sync.h"
 #include "voltage_pressure_sensor.h"
 #include "calibration_keys.h"
@@ -27,8 +32,10 @@
 #include <SPI.h>
 #include <SD.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include <ESPmDNS.h>
 #include <map>
+#include <memory>
 #include <algorithm>
 #include <vector>
 #include <math.h>
@@ -193,6 +200,7 @@ static void populateUnifiedConfig(JsonDocument &doc) {
 
     JsonObject sdObj = doc["sd"].to<JsonObject>();
     sdObj["enabled"] = getSdEnabled() ? 1 : 0;
+    sdObj["log_format"] = sdLogFormatName(getSdLogFormat());
 
     JsonObject notifObj = doc["notifications"].to<JsonObject>();
     int storedMode = loadIntFromNVSns(PREF_NAMESPACE, PREF_NOTIFICATION_MODE, DEFAULT_NOTIFICATION_MODE);
@@ -303,6 +311,14 @@ void handleConfigPost(AsyncWebServerRequest *request, JsonVariant &json) {
                 bool enabled = sdObj["enabled"].is<bool>() ? sdObj["enabled"].as<bool>() : (sdObj["enabled"].as<int>() != 0);
                 setSdEnabled(enabled);
             }
+            if (sdObj["log_format"].is<const char*>()) {
+                String fmt = sdObj["log_format"].as<String>();
+                if (fmt != "csv" && fmt != "bin") {
+                    sendJsonError(request, 400, "sd.log_format must be csv or bin");
+                    return;
+                }
+                setSdLogFormat(fmt == "bin" ? SD_LOG_FORMAT_BIN : SD_LOG_FORMAT_CSV);
+            }
         }
 
         if (incoming["notifications"].is<JsonObject>()) {
@@ -567,6 +583,16 @@ void setupWebServer(int port /*= 80*/) {
     registerSystemHandlers(server);
     // Register sensor and calibration handlers (moved to web_api_handlers_sensors.cpp)
     registerSensorHandlers(server);
+    // Local alarm rules driving DO1..DO4
+    registerRuleHandlers(server);
+    // Triggered burst capture of AI/ADS transients
+    registerCaptureHandlers(server);
+    // In-RAM trend rollups for dashboard charts
+    registerHistoryHandlers(server);
+    // Averaging windows of every tag (AI, ADS, DI, Modbus)
+    registerSampleHandlers(server);
+    // Datalog export (binary log converted on the fly)
+    registerLogHandlers(server);
     // Expose a generic config endpoint to GET/POST small config (persisted to NVS)
     server->on("/api/config", HTTP_GET, handleConfigGet);
     AsyncCallbackJsonWebHandler* configHandler = new AsyncCallbackJsonWebHandler("/api/config", handleConfigPost);
@@ -1365,12 +1391,22 @@ void setupWebServer(int port /*= 80*/) {
     server->on("/api/sd/error_log", HTTP_GET, [](AsyncWebServerRequest *request) {
         int lines = -1;
         if (request->hasParam("lines")) lines = request->getParam("lines")->value().toInt();
-        String content = readErrorLog(lines);
-        sendCorsJson(request, 200, "text/plain", content);
+        // Streamed from the partitions; the log is never held in RAM
+        std::shared_ptr<ErrorLogStream> stream(new ErrorLogStream(lines));
+        AsyncWebServerResponse *response = request->beginChunkedResponse(
+            "text/plain",
+            [stream](uint8_t *buffer, size_t maxLen, size_t) -> size_t {
+                return stream->read(buffer, maxLen);
+            });
+        setCorsHeaders(response);
+        request->send(response);
     });
 
     server->on("/api/sd/error_log/clear", HTTP_POST, [](AsyncWebServerRequest *request) {
-        clearErrorLog();
+        if (!clearErrorLog()) {
+            sendJsonError(request, 503, "SD writer busy, try again");
+            return;
+        }
         {
             sendJsonSuccess(request, 200, "error log cleared");
 
@@ -1384,6 +1420,26 @@ void setupWebServer(int port /*= 80*/) {
         size_t pendingCount = countPendingNotifications();
         doc["pending_count"] = (uint32_t)pendingCount;
         doc["file_size"] = (uint32_t)pendingNotificationsFileSize();
+        // Segmented queue: cursors and drain throughput
+        OutboundQueueStats q = getOutboundQueueStats();
+        JsonObject queue = doc["queue"].to<JsonObject>();
+        queue["ready"] = q.ready ? 1 : 0;
+        queue["segments"] = q.segments;
+        queue["head_segment"] = q.head.segment;
+        queue["head_offset"] = q.head.offset;
+        queue["tail_segment"] = q.tail.segment;
+        queue["tail_offset"] = q.tail.offset;
+        queue["pushed"] = q.pushed;
+        queue["dropped"] = q.dropped;
+        queue["batches"] = q.batches;
+        queue["failed_batches"] = q.failed_batches;
+        queue["acked_records"] = q.acked_records;
+        queue["acked_bytes"] = q.acked_bytes;
+        queue["last_batch_records"] = q.last_batch_records;
+        queue["last_batch_bytes"] = q.last_batch_bytes;
+        queue["last_batch_ms"] = q.last_batch_ms;
+        queue["drain_per_min"] = q.drain_per_min;
+        queue["eta_s"] = q.eta_s;
         bool includeContent = false;
         if (request->hasParam("include")) {
             includeContent = request->getParam("include")->value().toInt() != 0;
@@ -1393,7 +1449,9 @@ void setupWebServer(int port /*= 80*/) {
             lines = request->getParam("lines")->value().toInt();
         }
         if (includeContent && sdCardFound && pendingCount > 0) {
-            doc["content"] = readPendingNotifications(lines);
+            bool truncated = false;
+            doc["content"] = readPendingNotifications(lines, PENDING_PREVIEW_MAX_BYTES, &truncated);
+            doc["content_truncated"] = truncated ? 1 : 0;
         }
         sendCorsJsonDoc(request, 200, doc);
     });
@@ -1409,6 +1467,44 @@ void setupWebServer(int port /*= 80*/) {
         }
     });
 
+    // Background SD writer: queue depth, write latency, drops
+    server->on("/api/sd/writer", HTTP_GET, [](AsyncWebServerRequest *request) {
+        SdWriterStats st = getSdWriterStats();
+        JsonDocument doc;
+        doc["running"] = st.running ? 1 : 0;
+        doc["block_bytes"] = SD_WRITER_BLOCK_BYTES;
+        doc["flush_ms"] = SD_WRITER_FLUSH_MS;
+        doc["sync_ms"] = SD_WRITER_SYNC_MS;
+        doc["queue_bytes"] = st.queue_bytes;
+        doc["queue_records"] = st.queue_records;
+        doc["queue_capacity"] = st.queue_capacity;
+        doc["max_queue_bytes"] = st.max_queue_bytes;
+        doc["staged_bytes"] = st.staged_bytes;
+        doc["records"] = st.records;
+        doc["dropped"] = st.dropped;
+        doc["dropped_bytes"] = st.dropped_bytes;
+        doc["write_errors"] = st.write_errors;
+        doc["writes"] = st.writes;
+        doc["bytes_written"] = st.bytes_written;
+        doc["syncs"] = st.syncs;
+        doc["last_write_us"] = st.last_write_us;
+        doc["max_write_us"] = st.max_write_us;
+        doc["avg_write_us"] = st.avg_write_us;
+        doc["max_sync_us"] = st.max_sync_us;
+        BinlogWriterStats bin = getBinlogWriterStats();
+        JsonObject binObj = doc["binlog"].to<JsonObject>();
+        binObj["block"] = bin.block;
+        binObj["sealed"] = bin.sealed ? 1 : 0;
+        binObj["failed_submits"] = bin.failed_submits;
+        binObj["dropped_records"] = bin.dropped_records;
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    server->on("/api/sd/writer/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        resetSdWriterStats();
+        sendJsonSuccess(request, 200, "SD writer counters reset");
+    });
+
     // Reliable SD directory listing without problematic openNextFile()
     server->on("/api/sd/files", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (!sdReady) {
@@ -1526,6 +1622,9 @@ void setupWebServer(int port /*= 80*/) {
             sendJsonError(request, 400, "Invalid path");
             return;
         }
+        // Serve the logs with what the writer gets out in time; a tail still
+        // queued lands shortly after
+        sdWriterSync(SD_FILE_ALL, false, SD_WRITER_WEB_SYNC_MS);
         if (!SD.exists(path.c_str())) {
             sendJsonError(request, 404, "File not found");
             return;
@@ -1570,6 +1669,12 @@ void setupWebServer(int port /*= 80*/) {
             sendJsonError(request, 400, "Invalid path");
             return;
         }
+        // The writer reopens its logs on the next record. Its handles must be
+        // closed first; if it is busy, let the client retry
+        if (!sdWriterSync(SD_FILE_ALL, true, SD_WRITER_WEB_SYNC_MS)) {
+            sendJsonError(request, 503, "SD writer busy, try again");
+            return;
+        }
         if (!SD.exists(path.c_str())) {
             sendJsonError(request, 404, "Path not found");
             return;
@@ -1584,6 +1689,7 @@ void setupWebServer(int port /*= 80*/) {
         bool ok = false;
         if (isDir) {
             ok = removeDirRecursive(path);
+            forgetLogPartitionDirs();
         } else {
             ok = SD.remove(path.c_str());
         }
@@ -1937,6 +2043,7 @@ void setupWebServer(int port /*= 80*/) {
             // Persist into calibration namespace as key "tp_scale_%d"
             char key[16]; snprintf(key, sizeof(key), "tp_scale_%d", ch);
             saveFloatToNVSns(CAL_NAMESPACE, key, new_tp_scale);
+            reloadAdsChannelConfig(ch);
 
             JsonObject r = results.add<JsonObject>();
             r["channel"] = ch;
@@ -2122,7 +2229,7 @@ void setupWebServer(int port /*= 80*/) {
     sensorsConfigHandler->setMaxContentLength(2048);
     server->addHandler(sensorsConfigHandler);
 
-    // Live sensor readings: raw ADC (current analogRead), smoothed ADC, and calibrated voltage
+    // Live sensor readings: raw ADC (latest conversion), smoothed ADC, and calibrated voltage
     server->on("/api/sensors/readings", HTTP_GET, [](AsyncWebServerRequest *request) {
     JsonDocument doc;
         buildSensorsReadingsJson(doc);
@@ -2170,6 +2277,9 @@ void setupWebServer(int port /*= 80*/) {
             o["tp_model"] = String("TP5551");
             o["tp_scale_mv_per_ma"] = getAdsTpScale(ch);
             o["ads_mode"] = getAdsChannelMode(ch);
+            o["enabled"] = getAdsChannelEnabled(ch);
+            o["filters_custom"] = isAdsFilterCustom(ch);
+            filterPipelineToJson(getAdsFilterPipeline(ch), o["filters"].to<JsonArray>());
         }
         // Expose smoothing params
     float ema = loadFloatFromNVSns("ads_cfg", "ema_alpha", 0.1f);
@@ -2177,6 +2287,22 @@ void setupWebServer(int port /*= 80*/) {
     doc["ema_alpha"] = ema;
     doc["num_avg"] = numavg;
 
+        AdsEngineStatus eng = getAdsEngineStatus();
+        JsonObject engObj = doc["engine"].to<JsonObject>();
+        engObj["running"] = eng.running;
+        engObj["sps"] = eng.sps;
+        engObj["channels"] = eng.channels;
+        engObj["rdy_paced"] = eng.rdy_paced;
+        engObj["timeouts"] = eng.timeouts;
+        JsonArray engCh = engObj["conversions"].to<JsonArray>();
+        JsonArray engAge = engObj["age_ms"].to<JsonArray>();
+        int64_t nowUs = esp_timer_get_time();
+        for (int ch = 0; ch < eng.channels; ++ch) {
+            engCh.add(eng.conversions[ch]);
+            if (eng.last_us[ch] > 0) engAge.add((uint32_t)((nowUs - eng.last_us[ch]) / 1000));
+            else engAge.add(nullptr);
+        }
+
         sendCorsJsonDoc(request, 200, doc);
     });
 
@@ -2184,7 +2310,29 @@ void setupWebServer(int port /*= 80*/) {
         JsonObject doc = json.as<JsonObject>();
         if (doc.isNull()) { sendCorsJson(request, 400, "application/json", "{\"status\":\"error\", \"message\": \"Invalid JSON\"}"); return; }
 
-        if (!doc["channels"].is<JsonArray>()) { sendCorsJson(request, 400, "application/json", "{\"status\":\"error\", \"message\": \"Missing channels array\"}"); return; }
+        if (!doc["channels"].is<JsonArray>() && doc["sps"].isNull()) { sendCorsJson(request, 400, "application/json", "{\"status\":\"error\", \"message\": \"Missing channels array\"}"); return; }
+        // Validate filter pipelines up front so a bad entry changes nothing.
+        // "filters": [...] sets a custom pipeline, "filters": "default" reverts.
+        FilterPipelineConfig filterCfg[4];
+        int filterAction[4] = {0, 0, 0, 0}; // 0 keep, 1 set, 2 default
+        for (JsonObject chObj : doc["channels"].as<JsonArray>()) {
+            int ch = chObj["channel"].as<int>();
+            if (ch < 0 || ch > 3 || chObj["filters"].isNull()) continue;
+            if (chObj["filters"].is<const char*>() && chObj["filters"].as<String>() == "default") {
+                filterAction[ch] = 2;
+                continue;
+            }
+            String error;
+            if (!parseFilterPipeline(chObj["filters"], filterCfg[ch], error)) {
+                auto resp = makeErrorDoc(String("channel ") + ch + ": " + error);
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            filterAction[ch] = 1;
+        }
+        if (!doc["sps"].isNull()) {
+            setAdsSampleRate(doc["sps"].as<int>());
+        }
         // Use storage helpers to persist ads_cfg values
         // Preferences p;
         // p.begin("ads_cfg", false);
@@ -2203,10 +2351,15 @@ void setupWebServer(int port /*= 80*/) {
                 char key[16]; snprintf(key, sizeof(key), "mode_%d", ch);
                 saveIntToNVSns("ads_cfg", key, (int)chObj["ads_mode"].as<int>());
             }
+            if (!chObj["enabled"].isNull()) {
+                char key[16]; snprintf(key, sizeof(key), "en_%d", ch);
+                saveIntToNVSns("ads_cfg", key, chObj["enabled"].as<bool>() ? 1 : 0);
+            }
             if (!chObj["tp_scale_mv_per_ma"].isNull()) {
                 char key[16]; snprintf(key, sizeof(key), "tp_scale_%d", ch);
                 saveFloatToNVSns(CAL_NAMESPACE, key, (float)chObj["tp_scale_mv_per_ma"].as<float>());
             }
+            reloadAdsChannelConfig(ch);
         }
         if (!doc["ema_alpha"].isNull()) {
             float ema = (float)doc["ema_alpha"].as<float>();
@@ -2218,6 +2371,10 @@ void setupWebServer(int port /*= 80*/) {
             saveIntToNVSns("ads_cfg", "num_avg", na);
             setAdsNumAvg(na);
         }
+        for (int ch = 0; ch < 4; ++ch) {
+            if (filterAction[ch] == 1) setAdsFilterPipeline(ch, filterCfg[ch]);
+            else if (filterAction[ch] == 2) resetAdsFilterPipeline(ch);
+        }
         {
             sendJsonSuccess(request, 200, "ADS config saved");
 
@@ -2225,7 +2382,7 @@ void setupWebServer(int port /*= 80*/) {
     };
 
     AsyncCallbackJsonWebHandler* adsConfigHandler = new AsyncCallbackJsonWebHandler("/api/ads/config", handleAdsConfigPost);
-    adsConfigHandler->setMaxContentLength(1024);
+    adsConfigHandler->setMaxContentLength(2048);
     server->addHandler(adsConfigHandler);
 
     // ADC smoothing/runtime sample-store configuration
@@ -2321,11 +2478,18 @@ void setupWebServer(int port /*= 80*/) {
                 sendCorsJson(request, 400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid ads_channel\"}");
                 return;
             }
-            // Read ADS values and send single ADS notification
-            int16_t raw = readAdsRaw(ch);
-            float mv = adsRawToMv(raw);
-            float ma = readAdsMa(ch, DEFAULT_SHUNT_OHM, DEFAULT_AMP_GAIN);
-            sendAdsNotification(ch, raw, mv, ma);
+            // Send the channel's values from the latest snapshot (channels outside
+            // the snapshot get a cached/single-shot conversion, without filtering)
+            SensorSnapshot snap;
+            if (ch < SNAPSHOT_MAX_ADS && getSensorSnapshot(snap)) {
+                const AdsSnapshot &ads = snap.ads[ch];
+                sendAdsNotification(ch, ads.raw, ads.mv, ads.ma);
+            } else {
+                int16_t raw = readAdsRaw(ch);
+                float mv = adsRawToMv(raw);
+                float ma = adsMvToMa(getAdsChannelConfig(ch), mv);
+                sendAdsNotification(ch, raw, mv, isnan(ma) ? 0.0f : ma);
+            }
             {
                 sendJsonSuccess(request, 200, "Notification triggered for ADS channel");
 
@@ -2333,14 +2497,21 @@ void setupWebServer(int port /*= 80*/) {
             return;
         }
 
-        // If a specific sensor requested, send single notification using smoothed/current values
+        SensorSnapshot snap;
+        if (!getSensorSnapshot(snap)) {
+            sendJsonError(request, 503, "No sensor snapshot yet");
+            return;
+        }
+
+        // If a specific sensor requested, send single notification from the latest snapshot
         if (targetIndex >= 0) {
-            int pin = getVoltageSensorPin(targetIndex);
-            int raw = analogRead(pin);
-            float smoothed = getSmoothedADC(targetIndex);
-            float calibrated = getSmoothedVoltagePressure(targetIndex);
+            if (targetIndex >= snap.num_ai) {
+                sendJsonError(request, 400, "Invalid sensor_index");
+                return;
+            }
+            const AiSnapshot &ai = snap.ai[targetIndex];
             // Use calibrated value as the 'voltage' parameter expected by notifier
-            sendHttpNotification(targetIndex, raw, smoothed, calibrated);
+            sendHttpNotification(targetIndex, ai.avg_raw, ai.avg_smoothed, ai.value);
             {
                 sendJsonSuccess(request, 200, "Notification triggered for sensor");
 
@@ -2349,20 +2520,7 @@ void setupWebServer(int port /*= 80*/) {
         }
 
         // Otherwise trigger a batch notification for all configured sensors
-        int n = getNumVoltageSensors();
-        int *rawArr = new int[n];
-        float *smoothedArr = new float[n];
-        int *indices = new int[n];
-        for (int i = 0; i < n; ++i) {
-            int pin = getVoltageSensorPin(i);
-            rawArr[i] = analogRead(pin);
-            smoothedArr[i] = getSmoothedADC(i);
-            indices[i] = i;
-        }
-        sendHttpNotificationBatch(n, indices, rawArr, smoothedArr);
-        delete[] rawArr;
-        delete[] smoothedArr;
-        delete[] indices;
+        sendHttpNotificationBatch(snap, false);
         {
             sendJsonSuccess(request, 200, "Batch notification triggered");
 
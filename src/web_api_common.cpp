@@ -200,8 +200,7 @@ void captureCalibrationSamples(int pinIndex, int requestedSamples,
         return;
     }
 
-    int pin = getVoltageSensorPin(pinIndex);
-    avgRaw = (float)analogRead(pin);
+    avgRaw = (float)readVoltageSensorRaw(pinIndex);
     avgSmoothed = getSmoothedADC(pinIndex);
     if (avgSmoothed <= 0.0f) avgSmoothed = avgRaw;
     avgVolt = getSmoothedVoltagePressure(pinIndex);
@@ -0,0 +1,152 @@
+// Burst capture handlers (/api/capture)
+#include "web_api_handlers.h"
+#include "web_api_common.h"
+#include "burst_capture.h"
+
+#include <ArduinoJson.h>
+#include <AsyncJson.h>
+
+namespace {
+
+const char *const PHASE_NAMES[] = {"idle", "armed", "triggered", "complete"};
+const char *const TRIGGER_NAMES[] = {"manual", "above", "below", "dpdt"};
+
+int sourceFromTag(const String &tag) {
+    for (int src = 0; src < CAPTURE_SRC_COUNT; ++src) {
+        if (tag.equalsIgnoreCase(captureSourceName((CaptureSource)src))) return src;
+    }
+    return -1;
+}
+
+bool parseTriggerType(const String &name, CaptureTriggerType &out) {
+    for (int t = 0; t < 4; ++t) {
+        if (name.equalsIgnoreCase(TRIGGER_NAMES[t])) {
+            out = (CaptureTriggerType)t;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sendCaptureStatus(AsyncWebServerRequest *request) {
+    CaptureStatus st = getBurstCaptureStatus();
+    JsonDocument doc;
+    doc["phase"] = PHASE_NAMES[st.phase];
+    if (st.phase != CAPTURE_IDLE) {
+        JsonArray channels = doc["channels"].to<JsonArray>();
+        for (int src = 0; src < CAPTURE_SRC_COUNT; ++src) {
+            if (st.config.channel_mask & (1 << src)) channels.add(captureSourceName((CaptureSource)src));
+        }
+        doc["pre_ms"] = st.config.pre_ms;
+        doc["post_ms"] = st.config.post_ms;
+        JsonObject trig = doc["trigger"].to<JsonObject>();
+        trig["type"] = TRIGGER_NAMES[st.config.trigger];
+        trig["tag"] = captureSourceName((CaptureSource)st.config.trigger_source);
+        if (st.config.trigger != CAPTURE_TRIG_MANUAL) trig["level"] = st.config.level;
+        if (st.config.trigger == CAPTURE_TRIG_DPDT) trig["window_ms"] = st.config.dpdt_window_ms;
+    }
+    doc["captures_saved"] = st.captures_saved;
+    if (st.last_file.length()) doc["last_file"] = st.last_file;
+    if (st.last_error.length()) doc["last_error"] = st.last_error;
+    sendCorsJsonDoc(request, 200, doc);
+}
+
+} // namespace
+
+void registerCaptureHandlers(AsyncWebServer *server) {
+    if (!server) return;
+
+    server->on("/api/capture/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+        sendCaptureStatus(request);
+    });
+
+    server->on("/api/capture/trigger", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (!triggerBurstCapture()) {
+            sendJsonError(request, 409, "No armed capture");
+            return;
+        }
+        sendJsonSuccess(request, 200, "Capture triggered");
+    });
+
+    server->on("/api/capture/stop", HTTP_POST, [](AsyncWebServerRequest *request) {
+        abortBurstCapture();
+        sendJsonSuccess(request, 200, "Capture stopped");
+    });
+
+    // Arm a capture:
+    // {"channels":["AI1","ADS0"],"pre_ms":100,"post_ms":400,"rate_hz":0,
+    //  "trigger":{"type":"dpdt","tag":"AI1","level":5.0,"window_ms":10}}
+    AsyncCallbackJsonWebHandler* startHandler = new AsyncCallbackJsonWebHandler("/api/capture/start", [](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject doc = json.as<JsonObject>();
+        if (doc.isNull()) {
+            auto resp = makeErrorDoc("Invalid JSON");
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        CaptureConfig cfg;
+        JsonArrayConst channels = doc["channels"].as<JsonArrayConst>();
+        if (!channels.isNull()) {
+            cfg.channel_mask = 0;
+            for (JsonVariantConst v : channels) {
+                int src = sourceFromTag(v.as<String>());
+                if (src < 0) {
+                    auto resp = makeErrorDoc(String("Unknown channel: ") + v.as<String>());
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                cfg.channel_mask |= (uint8_t)(1 << src);
+            }
+        }
+        for (const char *key : {"pre_ms", "post_ms"}) {
+            JsonVariantConst v = doc[key];
+            if (!v.isNull() && (!v.is<uint32_t>() || v.as<uint32_t>() > CAPTURE_MAX_WINDOW_MS)) {
+                auto resp = makeErrorDoc(String(key) + " must be 0.." + CAPTURE_MAX_WINDOW_MS);
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+        }
+        if (!doc["rate_hz"].isNull() && !doc["rate_hz"].is<uint32_t>()) {
+            auto resp = makeErrorDoc("rate_hz must be a non-negative integer");
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        cfg.pre_ms = doc["pre_ms"] | cfg.pre_ms;
+        cfg.post_ms = doc["post_ms"] | cfg.post_ms;
+        cfg.rate_hz = doc["rate_hz"] | cfg.rate_hz;
+
+        JsonObjectConst trig = doc["trigger"].as<JsonObjectConst>();
+        if (!trig.isNull()) {
+            if (!parseTriggerType(trig["type"] | String("manual"), cfg.trigger)) {
+                auto resp = makeErrorDoc("trigger.type must be manual, above, below or dpdt");
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            if (cfg.trigger != CAPTURE_TRIG_MANUAL) {
+                int src = sourceFromTag(trig["tag"] | String(""));
+                if (src < 0) {
+                    auto resp = makeErrorDoc("trigger.tag must name a captured channel");
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                if (!trig["level"].is<float>()) {
+                    auto resp = makeErrorDoc("trigger.level is required");
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                cfg.trigger_source = (uint8_t)src;
+                cfg.level = trig["level"].as<float>();
+                cfg.dpdt_window_ms = trig["window_ms"] | cfg.dpdt_window_ms;
+            }
+        }
+
+        String error;
+        if (!armBurstCapture(cfg, error)) {
+            auto resp = makeErrorDoc(error);
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        sendCaptureStatus(request);
+    });
+    startHandler->setMaxContentLength(1024);
+    server->addHandler(startHandler);
+}
@@ -0,0 +1,253 @@
+// Trend history handlers (/api/history)
+#include "web_api_handlers.h"
+#include "web_api_common.h"
+#include "history_rollup.h"
+
+#include <ArduinoJson.h>
+#include <memory>
+#include <vector>
+#include <math.h>
+
+namespace {
+
+// Columns per tag, in response order
+enum HistoryColumn { COL_AVG = 0, COL_MIN, COL_MAX, COL_COUNT, COL_END };
+const char *const COLUMN_NAMES[] = {"avg", "min", "max", "count"};
+// HistoryTagState
+const char *const STATE_NAMES[] = {"idle", "pending", "recording", "no_memory"};
+
+// Response state for one request. The body is produced a column at a time
+// as the chunked response drains, so memory stays O(points) however many
+// tags are asked for.
+struct HistoryStream {
+    HistoryPlan plan;
+    bool binary = false;
+    std::vector<int> tags;
+    std::vector<String> names;
+    size_t tagIndex = 0;
+    int column = -1;          // -1 = header not sent yet
+    bool available = false;   // current tag has history
+    std::vector<float> avg, minV, maxV;
+    std::vector<uint32_t> count;
+    std::vector<uint8_t> pending;
+    size_t offset = 0;
+    bool done = false;
+
+    void append(const char *text) {
+        pending.insert(pending.end(), text, text + strlen(text));
+    }
+
+    void appendFloats(const std::vector<float> &values) {
+        if (binary) {
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(values.data());
+            pending.insert(pending.end(), bytes, bytes + values.size() * sizeof(float));
+            return;
+        }
+        char num[24];
+        for (size_t k = 0; k < values.size(); ++k) {
+            if (isnan(values[k])) snprintf(num, sizeof(num), "%snull", k ? "," : "");
+            else snprintf(num, sizeof(num), "%s%.6g", k ? "," : "", values[k]);
+            append(num);
+        }
+    }
+
+    void appendCounts() {
+        char num[16];
+        for (size_t k = 0; k < count.size(); ++k) {
+            snprintf(num, sizeof(num), "%s%lu", k ? "," : "", (unsigned long)count[k]);
+            append(num);
+        }
+    }
+
+    // Queue the next piece of the body; false once everything was queued
+    bool refill() {
+        pending.clear();
+        offset = 0;
+        if (done) return false;
+        char buf[160];
+        if (column < 0) {
+            column = COL_END;
+            if (!binary) {
+                snprintf(buf, sizeof(buf),
+                         "{\"tier\":%d,\"bucket_s\":%lu,\"step\":%lu,\"from\":%lu,\"to\":%lu,\"points\":%lu,\"series\":[",
+                         plan.tier, (unsigned long)plan.width, (unsigned long)plan.step,
+                         (unsigned long)plan.start,
+                         (unsigned long)(plan.start + (plan.points - 1) * plan.step),
+                         (unsigned long)plan.points);
+                append(buf);
+                return true;
+            }
+        }
+        if (column == COL_END) {
+            if (tagIndex >= tags.size()) {
+                if (!binary) append("]}");
+                done = true;
+                return !pending.empty();
+            }
+            int tag = tags[tagIndex];
+            available = readHistory(tag, plan, avg.data(), minV.data(), maxV.data(), count.data());
+            column = COL_AVG;
+            if (!binary) {
+                // Modbus tag names are user-defined: let ArduinoJson quote them
+                JsonDocument nameDoc;
+                nameDoc.set(names[tagIndex]);
+                String quoted;
+                serializeJson(nameDoc, quoted);
+                append(tagIndex ? ",{\"tag\":" : "{\"tag\":");
+                append(quoted.c_str());
+                snprintf(buf, sizeof(buf), ",\"state\":\"%s\",\"available\":%s",
+                         STATE_NAMES[historyTagState(tag)], available ? "true" : "false");
+                append(buf);
+                if (!available) {
+                    append("}");
+                    column = COL_END;
+                    tagIndex++;
+                    return true;
+                }
+            }
+        }
+        // Binary responses carry avg/min/max only; NAN marks a gap
+        if (binary && column == COL_COUNT) column = COL_END;
+        if (column == COL_END) {
+            tagIndex++;
+            return refill();
+        }
+        if (!binary) {
+            snprintf(buf, sizeof(buf), ",\"%s\":[", COLUMN_NAMES[column]);
+            append(buf);
+        }
+        if (column == COL_AVG) appendFloats(avg);
+        else if (column == COL_MIN) appendFloats(minV);
+        else if (column == COL_MAX) appendFloats(maxV);
+        else appendCounts();
+        if (!binary) append(column == COL_COUNT ? "]}" : "]");
+        column++;
+        if (column == COL_END) tagIndex++;
+        return true;
+    }
+
+    size_t fill(uint8_t *buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (offset >= pending.size() && !refill()) break;
+            size_t n = pending.size() - offset;
+            if (n > maxLen - written) n = maxLen - written;
+            memcpy(buffer + written, pending.data() + offset, n);
+            offset += n;
+            written += n;
+        }
+        return written;
+    }
+};
+
+bool parseTags(const String &list, std::vector<int> &tags, String &error) {
+    if (list.length() == 0 || list == "*") {
+        for (int t = 0; t < HISTORY_MAX_TAGS; ++t) {
+            if (t < REPORT_MAX_TAGS || historyTagName(t).length() > 0) tags.push_back(t);
+        }
+        return true;
+    }
+    int start = 0;
+    while (start <= (int)list.length()) {
+        int comma = list.indexOf(',', start);
+        if (comma < 0) comma = list.length();
+        String name = list.substring(start, comma);
+        name.trim();
+        start = comma + 1;
+        if (name.length() == 0) continue;
+        int found = findHistoryTag(name);
+        if (found < 0) {
+            error = "unknown tag '" + name + "'";
+            return false;
+        }
+        // Asking for a tag by name starts (or retries) its recording
+        requestHistoryTag(found);
+        tags.push_back(found);
+    }
+    if (tags.empty()) {
+        error = "no tags given";
+        return false;
+    }
+    return true;
+}
+
+long paramLong(AsyncWebServerRequest *request, const char *name, long fallback) {
+    if (!request->hasParam(name)) return fallback;
+    return request->getParam(name)->value().toInt();
+}
+
+} // namespace
+
+void registerHistoryHandlers(AsyncWebServer *server) {
+    if (!server) return;
+
+    // GET /api/history?tags=AI1,ADS0,MB1.temperature&from=&to=&step=&format=json|f32
+    // from/to are epoch seconds; from <= 0 is relative to `to` (default -3600)
+    server->on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request) {
+        std::shared_ptr<HistoryStream> stream(new HistoryStream());
+        String error;
+        String list = request->hasParam("tags") ? request->getParam("tags")->value() : "";
+        if (!parseTags(list, stream->tags, error)) {
+            sendJsonError(request, 400, error);
+            return;
+        }
+        for (int tag : stream->tags) stream->names.push_back(historyTagName(tag));
+        String format = request->hasParam("format") ? request->getParam("format")->value() : "json";
+        if (format == "f32") stream->binary = true;
+        else if (format != "json") {
+            sendJsonError(request, 400, "format must be json or f32");
+            return;
+        }
+
+        if (historyLatestEpoch() == 0) {
+            sendJsonError(request, 503, "No history recorded yet (clock not set?)");
+            return;
+        }
+        long to = paramLong(request, "to", 0);
+        if (to <= 0) to = (long)historyLatestEpoch();
+        long from = paramLong(request, "from", -3600);
+        if (from <= 0) from = to + from;
+        long step = paramLong(request, "step", 0);
+        if (from < 0 || step < 0 || from > to) {
+            sendJsonError(request, 400, "from/to/step out of range");
+            return;
+        }
+        if (!planHistoryQuery((uint32_t)from, (uint32_t)to, (uint32_t)step, stream->plan)) {
+            sendJsonError(request, 503, "No history recorded yet (clock not set?)");
+            return;
+        }
+        size_t points = stream->plan.points;
+        stream->avg.resize(points);
+        stream->minV.resize(points);
+        stream->maxV.resize(points);
+        stream->count.resize(points);
+
+        AsyncWebServerResponse *response = request->beginChunkedResponse(
+            stream->binary ? "application/octet-stream" : "application/json",
+            [stream](uint8_t *buffer, size_t maxLen, size_t) -> size_t {
+                return stream->fill(buffer, maxLen);
+            });
+        setCorsHeaders(response);
+        if (stream->binary) {
+            String names;
+            for (size_t i = 0; i < stream->tags.size(); ++i) {
+                if (i) names += ",";
+                names += stream->names[i];
+            }
+            String states;
+            for (size_t i = 0; i < stream->tags.size(); ++i) {
+                if (i) states += ",";
+                states += STATE_NAMES[historyTagState(stream->tags[i])];
+            }
+            response->addHeader("X-History-Tags", names);
+            response->addHeader("X-History-States", states);
+            response->addHeader("X-History-Columns", "avg,min,max");
+            response->addHeader("X-History-From", String((unsigned long)stream->plan.start));
+            response->addHeader("X-History-Step", String((unsigned long)stream->plan.step));
+            response->addHeader("X-History-Points", String((unsigned long)points));
+            response->addHeader("Access-Control-Expose-Headers",
+                                "X-History-Tags, X-History-States, X-History-Columns, X-History-From, X-History-Step, X-History-Points");
+        }
+        request->send(response);
+    });
+}
@@ -0,0 +1,276 @@
+// Datalog export and query handlers (/api/logs)
+#include "web_api_handlers.h"
+#include "web_api_common.h"
+#include "binary_log.h"
+#include "log_partition.h"
+#include "log_query.h"
+#include "sd_logger.h"
+#include "sd_writer.h"
+#include "sensor_snapshot.h"
+
+#include <memory>
+#include <vector>
+#include <time.h>
+
+namespace {
+
+// Binary log decoded to CSV while the chunked response drains; one record
+// is buffered at a time, so memory does not grow with the file.
+struct CsvExportStream {
+    BinlogReader reader;
+    int64_t values[BINLOG_MAX_COLUMNS];
+    bool headerSent = false;
+    bool done = false;
+    std::vector<uint8_t> pending;
+    size_t offset = 0;
+
+    void append(const char *text) {
+        pending.insert(pending.end(), text, text + strlen(text));
+    }
+
+    bool refill() {
+        pending.clear();
+        offset = 0;
+        if (done) return false;
+        const BinlogFileHeader &hdr = reader.header();
+        if (!headerSent) {
+            headerSent = true;
+            append("timestamp");
+            for (int c = 0; c < hdr.columns; ++c) {
+                append(",");
+                append(hdr.column[c].name);
+            }
+            append("\n");
+            return true;
+        }
+        int64_t epochMs;
+        uint32_t missing;
+        if (!reader.next(epochMs, values, missing)) {
+            done = true;
+            reader.close();
+            return false;
+        }
+        char buf[32];
+        formatLogTimestamp(epochMs, buf, sizeof(buf));
+        append(buf);
+        for (int c = 0; c < hdr.columns; ++c) {
+            append(",");
+            if (missing & (1UL << c)) continue;
+            formatBinlogValue(values[c], hdr.column[c].decimals, buf, sizeof(buf));
+            append(buf);
+        }
+        append("\n");
+        return true;
+    }
+
+    size_t fill(uint8_t *buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (offset >= pending.size() && !refill()) break;
+            size_t n = pending.size() - offset;
+            if (n > maxLen - written) n = maxLen - written;
+            memcpy(buffer + written, pending.data() + offset, n);
+            offset += n;
+            written += n;
+        }
+        return written;
+    }
+};
+
+// Raw file up to the end of its last valid block (the preallocated tail is
+// left out)
+struct BinExportStream {
+    File file;
+    uint32_t length = 0;
+
+    ~BinExportStream() {
+        if (file) file.close();
+    }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) {
+        if (index >= length) return 0;
+        if (maxLen > length - index) maxLen = length - index;
+        if (file.position() != index && !file.seek(index)) return 0;
+        int n = file.read(buffer, maxLen);
+        return n > 0 ? (size_t)n : 0;
+    }
+};
+
+long paramLong(AsyncWebServerRequest *request, const char *name, long fallback) {
+    if (!request->hasParam(name)) return fallback;
+    return request->getParam(name)->value().toInt();
+}
+
+} // namespace
+
+void registerLogHandlers(AsyncWebServer *server) {
+    if (!server) return;
+
+    // GET /api/logs/export?format=csv|bin&file=current|previous
+    // Binary datalog as CSV (converted on the fly) or as stored
+    server->on("/api/logs/export", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!sdCardFound) {
+            sendJsonError(request, 503, "SD card not available");
+            return;
+        }
+        String format = request->hasParam("format") ? request->getParam("format")->value() : "csv";
+        if (format != "csv" && format != "bin") {
+            sendJsonError(request, 400, "format must be csv or bin");
+            return;
+        }
+        String which = request->hasParam("file") ? request->getParam("file")->value() : "current";
+        const char *path;
+        if (which == "current") {
+            path = BINLOG_PATH;
+            // Records still in RAM are part of the export if the writer keeps up;
+            // otherwise the newest ones follow in the next export
+            flushBinaryLog(SD_WRITER_WEB_SYNC_MS);
+        } else if (which == "previous") {
+            path = BINLOG_PREV_PATH;
+        } else {
+            sendJsonError(request, 400, "file must be current or previous");
+            return;
+        }
+
+        String name = String(path + 1);
+        if (format == "csv") name.replace(".bin", ".csv");
+        String disposition = "attachment; filename=\"" + name + "\"";
+
+        if (format == "csv") {
+            std::shared_ptr<CsvExportStream> stream(new CsvExportStream());
+            if (!stream->reader.open(path)) {
+                sendJsonError(request, 404, "No binary log");
+                return;
+            }
+            AsyncWebServerResponse *response = request->beginChunkedResponse(
+                "text/csv",
+                [stream](uint8_t *buffer, size_t maxLen, size_t) -> size_t {
+                    return stream->fill(buffer, maxLen);
+                });
+            setCorsHeaders(response);
+            response->addHeader("Content-Disposition", disposition);
+            request->send(response);
+            return;
+        }
+
+        std::shared_ptr<BinExportStream> stream(new BinExportStream());
+        {
+            BinlogReader reader;
+            if (!reader.open(path)) {
+                sendJsonError(request, 404, "No binary log");
+                return;
+            }
+            stream->length = reader.validBytes();
+        }
+        stream->file = SD.open(path, FILE_READ);
+        if (!stream->file) {
+            sendJsonError(request, 404, "No binary log");
+            return;
+        }
+        AsyncWebServerResponse *response = request->beginResponse(
+            "application/octet-stream", stream->length,
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return stream->fill(buffer, maxLen, index);
+            });
+        setCorsHeaders(response);
+        response->addHeader("Content-Disposition", disposition);
+        request->send(response);
+    });
+
+    // GET /api/logs/query?from=&to=&tags=AI1,ADS0.ma&step=&format=csv|json|bin&source=csv|bin
+    // Datalog rows in [from, to] (epoch seconds; from <= 0 is relative to
+    // `to`, default -3600), averaged per `step` seconds when step > 0. The
+    // source defaults to the configured log format.
+    server->on("/api/logs/query", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!sdCardFound) {
+            sendJsonError(request, 503, "SD card not available");
+            return;
+        }
+        String formatName = request->hasParam("format") ? request->getParam("format")->value() : "csv";
+        LogQueryFormat format;
+        if (formatName == "csv") format = LOG_QUERY_FORMAT_CSV;
+        else if (formatName == "json") format = LOG_QUERY_FORMAT_JSON;
+        else if (formatName == "bin") format = LOG_QUERY_FORMAT_BIN;
+        else {
+            sendJsonError(request, 400, "format must be csv, json or bin");
+            return;
+        }
+        LogQuerySource source = getSdLogFormat() == SD_LOG_FORMAT_BIN ? LOG_QUERY_SOURCE_BIN : LOG_QUERY_SOURCE_CSV;
+        if (request->hasParam("source")) {
+            String name = request->getParam("source")->value();
+            if (name == "csv") source = LOG_QUERY_SOURCE_CSV;
+            else if (name == "bin") source = LOG_QUERY_SOURCE_BIN;
+            else {
+                sendJsonError(request, 400, "source must be csv or bin");
+                return;
+            }
+        }
+
+        long to = paramLong(request, "to", 0);
+        if (to <= 0) {
+            time_t now = time(nullptr);
+            if (logPartitionHour(now) == 0) {
+                sendJsonError(request, 503, "Clock not set; give 'to' explicitly");
+                return;
+            }
+            to = (long)now;
+        }
+        long from = paramLong(request, "from", -3600);
+        if (from <= 0) from = to + from;
+        long step = paramLong(request, "step", 0);
+        if (from < 0 || step < 0 || from > to) {
+            sendJsonError(request, 400, "from/to/step out of range");
+            return;
+        }
+
+        // Column names come from the current channel layout
+        SensorSnapshot snap;
+        if (!getSensorSnapshot(snap)) {
+            sendJsonError(request, 503, "No sensor snapshot yet");
+            return;
+        }
+        BinlogColumn schema[BINLOG_MAX_COLUMNS];
+        int count = buildLogSchema(snap, schema, BINLOG_MAX_COLUMNS);
+        std::vector<BinlogColumn> columns;
+        String error;
+        String list = request->hasParam("tags") ? request->getParam("tags")->value() : "";
+        if (!selectLogColumns(list, schema, count, columns, error)) {
+            sendJsonError(request, 400, error);
+            return;
+        }
+
+        // Records still queued or in the open block are part of the answer when
+        // the writer gets them out in time; the handler never waits longer
+        if (source == LOG_QUERY_SOURCE_BIN) flushBinaryLog(SD_WRITER_WEB_SYNC_MS);
+        else sdWriterSync(1UL << SD_FILE_DATALOG, false, SD_WRITER_WEB_SYNC_MS);
+
+        std::shared_ptr<LogQuery> query(new LogQuery(source, format, (int64_t)from * 1000,
+                                                     (int64_t)to * 1000 + 999, (uint32_t)step, columns));
+        const char *type = format == LOG_QUERY_FORMAT_JSON  ? "application/json"
+                           : format == LOG_QUERY_FORMAT_BIN ? "application/octet-stream"
+                                                            : "text/csv";
+        AsyncWebServerResponse *response = request->beginChunkedResponse(
+            type,
+            [query](uint8_t *buffer, size_t maxLen, size_t) -> size_t {
+                size_t n = query->fill(buffer, maxLen);
+                // 0 would end the response; ask to be called again instead
+                if (n == 0 && !query->done()) return RESPONSE_TRY_AGAIN;
+                return n;
+            });
+        setCorsHeaders(response);
+        if (format == LOG_QUERY_FORMAT_BIN) {
+            String names;
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (i) names += ",";
+                names += columns[i].name;
+            }
+            response->addHeader("X-Log-Columns", names);
+            response->addHeader("X-Log-From", String(from));
+            response->addHeader("X-Log-To", String(to));
+            response->addHeader("X-Log-Step", String(step));
+            response->addHeader("Access-Control-Expose-Headers",
+                                "X-Log-Columns, X-Log-From, X-Log-To, X-Log-Step");
+        }
+        request->send(response);
+    });
+}
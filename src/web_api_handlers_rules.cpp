@@ -0,0 +1,86 @@
+// Alarm rule handlers (/api/rules)
+#include "web_api_handlers.h"
+#include "web_api_common.h"
+#include "alarm_rules.h"
+#include "http_notifier.h"
+#include "json_helper.h"
+
+#include <ArduinoJson.h>
+#include <AsyncJson.h>
+
+void registerRuleHandlers(AsyncWebServer *server) {
+    if (!server) return;
+
+    server->on("/api/rules", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonDocument doc;
+        AlarmRuleConfig rules[ALARM_MAX_RULES];
+        int count = getAlarmRules(rules);
+        JsonArray arr = doc["rules"].to<JsonArray>();
+        for (int i = 0; i < count; ++i) {
+            JsonObject obj = arr.add<JsonObject>();
+            alarmRuleToJson(rules[i], obj);
+            AlarmRuleStatus st;
+            getAlarmRuleStatus(i, st);
+            JsonObject status = obj["status"].to<JsonObject>();
+            status["active"] = st.active;
+            status["hits"] = st.hits;
+            if (!isnan(st.value)) status["value"] = roundToDecimals(st.value, 3);
+            if (!isnan(st.rate)) status["rate_per_s"] = roundToDecimals(st.rate, 4);
+            if (st.last_change_ms > 0) status["last_change_ms"] = st.last_change_ms;
+        }
+
+        AlarmEngineStats stats = getAlarmEngineStats();
+        JsonArray outputs = doc["outputs"].to<JsonArray>();
+        for (int o = 1; o <= ALARM_NUM_OUTPUTS; ++o) {
+            JsonObject out = outputs.add<JsonObject>();
+            out["id"] = String("DO") + String(o);
+            out["pin"] = getAlarmOutputPin(o);
+            out["state"] = (stats.outputs & (1 << (o - 1))) ? 1 : 0;
+        }
+        JsonObject eval = doc["evaluation"].to<JsonObject>();
+        eval["count"] = stats.evaluations;
+        eval["last_us"] = stats.last_eval_us;
+        eval["max_us"] = stats.max_eval_us;
+        AlarmNotifierStats notify = getAlarmNotifierStats();
+        JsonObject notif = doc["notifications"].to<JsonObject>();
+        notif["queued"] = stats.events_queued;
+        notif["dropped"] = stats.events_dropped;
+        notif["sent"] = notify.sent;
+        notif["failed"] = notify.failed;
+        notif["requeued"] = notify.requeued;
+        notif["lost"] = notify.lost;
+        notif["last_latency_ms"] = notify.last_latency_ms;
+        notif["max_latency_ms"] = notify.max_latency_ms;
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    // Registered before the JSON handler, which also matches sub-paths
+    server->on("/api/rules/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        resetAlarmRuleStats();
+        sendJsonSuccess(request, 200, "Rule counters reset");
+    });
+
+    // Replace the whole rule set: {"rules":[...]}
+    AsyncCallbackJsonWebHandler* rulesHandler = new AsyncCallbackJsonWebHandler("/api/rules", [](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject doc = json.as<JsonObject>();
+        if (doc.isNull()) {
+            auto resp = makeErrorDoc("Invalid JSON");
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        AlarmRuleConfig rules[ALARM_MAX_RULES];
+        int count = 0;
+        String error;
+        if (!parseAlarmRules(doc["rules"], rules, count, error)) {
+            auto resp = makeErrorDoc(error);
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        setAlarmRules(rules, count);
+        auto resp = makeSuccessDoc("Rules updated");
+        resp["count"] = count;
+        sendCorsJsonDoc(request, 200, resp);
+    });
+    rulesHandler->setMaxContentLength(4096);
+    server->addHandler(rulesHandler);
+}
@@ -0,0 +1,129 @@
+// Tag-keyed sample window handlers (/api/samples)
+#include "web_api_handlers.h"
+#include "web_api_common.h"
+#include "config.h"
+#include "sample_store.h"
+
+#include <ArduinoJson.h>
+#include <AsyncJson.h>
+
+namespace {
+
+void tagToJson(int handle, int maxSamples, JsonObject out) {
+    SampleTagInfo info;
+    if (!getSampleTagInfo(handle, info)) return;
+    out["tag"] = info.tag;
+    out["kind"] = info.kind == SAMPLE_TAG_ADC ? "adc" : "value";
+    out["capacity"] = info.capacity;
+    out["default_capacity"] = info.default_capacity;
+    out["retention"] = sampleRetentionName(info.retention);
+    out["mirrored"] = info.mirrored;
+    out["count"] = info.count;
+    out["decimals"] = info.decimals;
+    out["clamped"] = info.clamped;
+    SampleWindowStats stats;
+    if (!getTagWindowStats(handle, maxSamples, stats)) return;
+    JsonObject window = out["window"].to<JsonObject>();
+    window["samples"] = stats.count;
+    window["avg"] = stats.avg_value;
+    window["min"] = stats.min_value;
+    window["max"] = stats.max_value;
+    window["stddev"] = stats.stddev_value;
+    window["clamped"] = stats.clamped;
+    if (info.kind == SAMPLE_TAG_ADC) {
+        window["avg_raw"] = stats.avg_raw;
+        window["avg_smoothed"] = stats.avg_smoothed;
+    }
+}
+
+// Apply one {tag, capacity?, retention?} entry; omitted fields keep the
+// tag's current setting. Returns the HTTP status (200 = applied).
+int applyTagConfig(JsonObjectConst entry, String &error) {
+    String tag = entry["tag"] | String("");
+    if (tag.length() == 0 || tag.length() >= (unsigned)SAMPLE_TAG_MAX_LEN) {
+        error = "tag is required (at most " + String(SAMPLE_TAG_MAX_LEN - 1) + " characters)";
+        return 400;
+    }
+    int capacity = 0;
+    SampleRetention retention = SAMPLE_RETAIN_NVS;
+    SampleTagInfo info;
+    if (getSampleTagInfo(findSampleTag(tag.c_str()), info)) {
+        capacity = info.default_capacity ? 0 : info.capacity;
+        retention = info.retention;
+    }
+    if (!entry["capacity"].isNull()) {
+        if (!entry["capacity"].is<int>() || entry["capacity"].as<int>() < 0 ||
+            entry["capacity"].as<int>() > SAMPLE_STORE_MAX_CAPACITY) {
+            error = tag + ": capacity must be 0.." + String(SAMPLE_STORE_MAX_CAPACITY);
+            return 400;
+        }
+        capacity = entry["capacity"].as<int>();
+    }
+    if (!entry["retention"].isNull() && !parseSampleRetention(entry["retention"].as<String>(), retention)) {
+        error = tag + ": retention must be ram, rtc or nvs";
+        return 400;
+    }
+    if (!setSampleTagConfig(tag.c_str(), capacity, retention)) {
+        error = tag + ": saved, but not applied (heap short or no RTC slot left)";
+        return 503;
+    }
+    return 200;
+}
+
+} // namespace
+
+void registerSampleHandlers(AsyncWebServer *server) {
+    if (!server) return;
+
+    // GET /api/samples[?tag=MB1.temperature][&samples=N]
+    server->on("/api/samples", HTTP_GET, [](AsyncWebServerRequest *request) {
+        int maxSamples = request->hasParam("samples") ? request->getParam("samples")->value().toInt() : 0;
+        JsonDocument doc;
+        if (request->hasParam("tag")) {
+            int handle = findSampleTag(request->getParam("tag")->value().c_str());
+            if (handle < 0) {
+                sendJsonError(request, 404, "Unknown tag");
+                return;
+            }
+            tagToJson(handle, maxSamples, doc.to<JsonObject>());
+            sendCorsJsonDoc(request, 200, doc);
+            return;
+        }
+        doc["default_capacity"] = getSampleCapacity();
+        doc["max_capacity"] = SAMPLE_STORE_MAX_CAPACITY;
+        doc["rtc_tags"] = SAMPLE_STORE_RTC_TAGS;
+        doc["rtc_samples"] = SAMPLE_STORE_RTC_CAPACITY;
+        JsonArray tags = doc["tags"].to<JsonArray>();
+        for (int handle = 0; handle < SAMPLE_STORE_MAX_TAGS; ++handle) {
+            SampleTagInfo info;
+            if (getSampleTagInfo(handle, info)) tagToJson(handle, maxSamples, tags.add<JsonObject>());
+        }
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    // POST /api/samples/config {"tag":"ADS0","capacity":600,"retention":"rtc"}
+    // or an array of such entries. capacity 0 follows samples_per_sensor.
+    AsyncCallbackJsonWebHandler* configHandler = new AsyncCallbackJsonWebHandler("/api/samples/config", [](AsyncWebServerRequest *request, JsonVariant &json) {
+        String error;
+        int code = 200;
+        if (json.is<JsonArray>()) {
+            for (JsonObjectConst entry : json.as<JsonArrayConst>()) {
+                code = applyTagConfig(entry, error);
+                if (code != 200) break;
+            }
+        } else if (json.is<JsonObject>()) {
+            code = applyTagConfig(json.as<JsonObjectConst>(), error);
+        } else {
+            error = "Invalid JSON";
+            code = 400;
+        }
+        if (code != 200) {
+            auto resp = makeErrorDoc(error);
+            sendCorsJsonDoc(request, code, resp);
+            return;
+        }
+        sendJsonSuccess(request, 200, "Sample tag config saved");
+    });
+    configHandler->setMaxContentLength(2048);
+    server->addHandler(configHandler);
+}
@@ -13,6 +13,10 @@
 #include "json_helper.h"
 #include "current_pressure_sensor.h"
 #include "modbus_manager.h"
+#include "acquisition_task.h"
+#include "pulse_counter.h"
+#include "report_filter.h"
+#include "sensor_health.h"
 
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
@@ -74,7 +78,7 @@ void registerSensorHandlers(AsyncWebServer *server) {
         }
 
         if (!haveAvg) {
-            avgRaw = (float)analogRead(pin);
+            avgRaw = (float)readVoltageSensorRaw(pinIndex);
             avgSmoothed = getSmoothedADC(pinIndex);
             if (avgSmoothed <= 0.0f) avgSmoothed = avgRaw;
             avgVolt = getSmoothedVoltagePressure(pinIndex);
@@ -112,6 +116,26 @@ void registerSensorHandlers(AsyncWebServer *server) {
             obj["enabled"] = getSensorEnabled(i) ? 1 : 0;
             obj["notification_interval_ms"] = getSensorNotificationInterval(i);
         }
+        // Per-source sample schedule: acquisition jobs, then Modbus slaves as "MB<addr>"
+        JsonArray sampling = doc["sampling"].to<JsonArray>();
+        for (int job = 0; job < ACQ_JOB_COUNT; ++job) {
+            JobInfo info;
+            if (!getAcquisitionJobInfo(job, info)) continue;
+            JsonObject obj = sampling.add<JsonObject>();
+            obj["tag"] = getAcquisitionJobTag(job);
+            obj["period_ms"] = info.period_ms;
+            obj["phase_ms"] = info.phase_ms;
+            obj["runs"] = info.runs;
+            obj["skipped"] = info.skipped;
+            obj["last_late_us"] = info.last_late_us;
+            obj["max_late_us"] = info.max_late_us;
+        }
+        for (const auto &slave : getModbusSlaves()) {
+            JsonObject obj = sampling.add<JsonObject>();
+            obj["tag"] = String("MB") + String(slave.address);
+            obj["period_ms"] = slave.poll_interval_ms;
+            obj["phase_ms"] = slave.poll_phase_ms;
+        }
         sendCorsJsonDoc(request, 200, doc);
     });
 
@@ -123,12 +147,55 @@ void registerSensorHandlers(AsyncWebServer *server) {
             return;
         }
 
-        if (!doc["sensors"].is<JsonArray>()) {
+        bool hasSampling = doc["sampling"].is<JsonArray>();
+        if (!doc["sensors"].is<JsonArray>() && !hasSampling) {
             auto resp = makeErrorDoc("Missing sensors array", 160);
             sendCorsJsonDoc(request, 400, resp);
             return;
         }
 
+        // Validate every sampling entry before applying any of them
+        if (hasSampling) {
+            for (JsonObject entry : doc["sampling"].as<JsonArray>()) {
+                String tag = entry["tag"].as<String>();
+                uint32_t period = entry["period_ms"].as<uint32_t>();
+                bool known = findAcquisitionJob(tag) >= 0;
+                if (!known && tag.startsWith("MB")) {
+                    int addr = tag.substring(2).toInt();
+                    for (const auto &slave : getModbusSlaves()) {
+                        if (slave.address == addr) known = true;
+                    }
+                }
+                if (!known || period == 0) {
+                    auto resp = makeErrorDoc(String("Invalid sampling entry: ") + tag);
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                if (findAcquisitionJob(tag) >= 0 && !isAcquisitionRunning()) {
+                    auto resp = makeErrorDoc(String("Acquisition task not running, cannot schedule ") + tag);
+                    sendCorsJsonDoc(request, 503, resp);
+                    return;
+                }
+            }
+            bool modbusChanged = false;
+            for (JsonObject entry : doc["sampling"].as<JsonArray>()) {
+                String tag = entry["tag"].as<String>();
+                uint32_t period = entry["period_ms"].as<uint32_t>();
+                uint32_t phase = entry["phase_ms"].as<uint32_t>();
+                int job = findAcquisitionJob(tag);
+                if (job >= 0) {
+                    if (!setAcquisitionJobPeriod(job, period, phase)) {
+                        auto resp = makeErrorDoc(String("Failed to schedule ") + tag);
+                        sendCorsJsonDoc(request, 503, resp);
+                        return;
+                    }
+                } else if (setModbusSlavePollInterval((uint8_t)tag.substring(2).toInt(), period, phase)) {
+                    modbusChanged = true;
+                }
+            }
+            if (modbusChanged) saveModbusConfigJsonToFile(getModbusConfigJson());
+        }
+
         JsonArray arr = doc["sensors"].as<JsonArray>();
         for (JsonObject sensor : arr) {
             int idx = sensor["sensor_index"].as<int>();
@@ -291,6 +358,14 @@ void registerSensorHandlers(AsyncWebServer *server) {
     server->on("/api/adc/config", HTTP_GET, [](AsyncWebServerRequest *request) {
         JsonDocument doc;
         doc["adc_num_samples"] = getAdcNumSamples();
+        doc["adc_mode"] = getAdcCaptureMode() == ADC_MODE_DMA ? "dma" : "oneshot";
+        doc["adc_dma_running"] = isAdcDmaRunning();
+        doc["adc_dma_sample_rate_hz"] = ADC_DMA_SAMPLE_FREQ_HZ;
+        doc["adc_dma_overflows"] = getAdcDmaOverflows();
+        JsonArray windowArr = doc["adc_dma_window_samples"].to<JsonArray>();
+        for (int i = 0; i < getNumVoltageSensors(); ++i) {
+            windowArr.add(getAdcDmaWindowSamples(i));
+        }
         doc["samples_per_sensor"] = getSampleCapacity();
         float scale = 1.0f;
         float offset = 0.0f;
@@ -303,6 +378,10 @@ void registerSensorHandlers(AsyncWebServer *server) {
         for (int i = 0; i < num; ++i) {
             dividerArr.add(dividers[i]);
         }
+        JsonArray filtersArr = doc["filters"].to<JsonArray>();
+        for (int i = 0; i < num; ++i) {
+            filterPipelineToJson(getAdcFilterPipeline(i), filtersArr.add<JsonArray>());
+        }
         sendCorsJsonDoc(request, 200, doc);
     });
 
@@ -314,12 +393,63 @@ void registerSensorHandlers(AsyncWebServer *server) {
             return;
         }
         bool changed = false;
+        // filters: array indexed by sensor (null entries skipped) or {"AI1": [...], ...}.
+        // Every pipeline is parsed before any is applied.
+        if (!doc["filters"].isNull()) {
+            FilterPipelineConfig parsed[3];
+            bool present[3] = {false, false, false};
+            int num = min(getNumVoltageSensors(), 3);
+            String error;
+            if (doc["filters"].is<JsonArray>()) {
+                JsonArray arr = doc["filters"].as<JsonArray>();
+                for (int i = 0; i < num && i < (int)arr.size(); ++i) {
+                    if (arr[i].isNull()) continue;
+                    if (!parseFilterPipeline(arr[i], parsed[i], error)) break;
+                    present[i] = true;
+                }
+            } else if (doc["filters"].is<JsonObject>()) {
+                for (JsonPair kv : doc["filters"].as<JsonObject>()) {
+                    const char *key = kv.key().c_str();
+                    int idx = strncasecmp(key, "AI", 2) == 0 ? atoi(key + 2) - 1 : -1;
+                    if (idx < 0 || idx >= num) {
+                        error = String("unknown filter channel: ") + key;
+                        break;
+                    }
+                    if (!parseFilterPipeline(kv.value(), parsed[idx], error)) break;
+                    present[idx] = true;
+                }
+            } else {
+                error = "filters must be an array or object";
+            }
+            if (error.length() > 0) {
+                auto resp = makeErrorDoc(error);
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            for (int i = 0; i < num; ++i) {
+                if (present[i] && setAdcFilterPipeline(i, parsed[i])) changed = true;
+            }
+        }
         if (!doc["adc_num_samples"].isNull()) {
             int ns = doc["adc_num_samples"].as<int>();
             setAdcNumSamples(ns);
             saveIntToNVSns("adc_cfg", "num_samples", ns);
             changed = true;
         }
+        if (!doc["adc_mode"].isNull()) {
+            String mode = doc["adc_mode"].as<String>();
+            mode.toLowerCase();
+            int m = mode == "dma" ? ADC_MODE_DMA : (mode == "oneshot" ? ADC_MODE_ONESHOT : -1);
+            if (m < 0) {
+                auto resp = makeErrorDoc("adc_mode must be 'dma' or 'oneshot'");
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            // Applied by the acquisition task at its next AI sample
+            if (m != getAdcCaptureMode() || (m == ADC_MODE_DMA && !isAdcDmaRunning())) {
+                if (setAdcCaptureMode(m)) changed = true;
+            }
+        }
         if (!doc["samples_per_sensor"].isNull()) {
             int sp = doc["samples_per_sensor"].as<int>();
             resizeSampleStore(sp);
@@ -398,7 +528,7 @@ void registerSensorHandlers(AsyncWebServer *server) {
             sendCorsJsonDoc(request, 400, resp);
         }
     });
-    adcConfigHandler->setMaxContentLength(256);
+    adcConfigHandler->setMaxContentLength(1024);
     server->addHandler(adcConfigHandler);
 
     // Reseed endpoints
@@ -415,6 +545,181 @@ void registerSensorHandlers(AsyncWebServer *server) {
         sendCorsJsonDoc(request, 200, resp);
     });
 
+    // DI pulse counters
+    server->on("/api/di/config", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonDocument doc;
+        JsonArray arr = doc["channels"].to<JsonArray>();
+        for (int i = 0; i < getNumPulseCounters(); ++i) {
+            PulseCounterConfig cfg = getPulseCounterConfig(i);
+            PulseCounterReading r;
+            getPulseCounterReading(i, r);
+            JsonObject ch = arr.add<JsonObject>();
+            ch["index"] = i;
+            ch["tag"] = String("DI") + String(i + 1);
+            ch["pin"] = getPulseCounterPin(i);
+            ch["enabled"] = cfg.enabled;
+            ch["running"] = r.enabled;
+            ch["units_per_pulse"] = cfg.units_per_pulse;
+            ch["unit"] = cfg.unit;
+            ch["filter_ns"] = cfg.filter_ns;
+            ch["count"] = r.count;
+            ch["total"] = roundToDecimals(r.total, 3);
+            ch["rate_hz"] = roundToDecimals(r.rate_hz, 3);
+            ch["rate_per_hour"] = roundToDecimals(r.rate_per_hour, 3);
+        }
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    // channels: [{index|tag, enabled?, units_per_pulse?, unit?, filter_ns?, total_pulses?}]
+    // Every entry is validated before any is applied.
+    AsyncCallbackJsonWebHandler* diConfigHandler = new AsyncCallbackJsonWebHandler("/api/di/config", [](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject doc = json.as<JsonObject>();
+        if (doc.isNull() || !doc["channels"].is<JsonArray>()) {
+            auto resp = makeErrorDoc("channels array required");
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        const int num = getNumPulseCounters();
+        PulseCounterConfig configs[4];
+        bool present[4] = {false, false, false, false};
+        bool reset[4] = {false, false, false, false};
+        uint64_t resetTo[4] = {0, 0, 0, 0};
+        for (JsonObject entry : doc["channels"].as<JsonArray>()) {
+            int idx = -1;
+            if (entry["index"].is<int>()) {
+                idx = entry["index"].as<int>();
+            } else if (entry["tag"].is<const char*>()) {
+                String tag = entry["tag"].as<String>();
+                if (tag.length() == 3 && tag.startsWith("DI")) idx = tag.substring(2).toInt() - 1;
+            }
+            if (idx < 0 || idx >= num || idx >= 4) {
+                auto resp = makeErrorDoc("Invalid channel index/tag");
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            PulseCounterConfig cfg = getPulseCounterConfig(idx);
+            if (!entry["enabled"].isNull()) cfg.enabled = entry["enabled"].as<bool>();
+            if (!entry["units_per_pulse"].isNull()) cfg.units_per_pulse = entry["units_per_pulse"].as<float>();
+            if (!entry["unit"].isNull()) cfg.unit = entry["unit"].as<String>();
+            if (!entry["filter_ns"].isNull()) {
+                int ns = entry["filter_ns"].as<int>();
+                if (ns < 0 || ns > 12700) {
+                    auto resp = makeErrorDoc("filter_ns must be 0..12700");
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                cfg.filter_ns = (uint16_t)ns;
+            }
+            if (!isfinite(cfg.units_per_pulse) || cfg.units_per_pulse <= 0.0f) {
+                auto resp = makeErrorDoc("units_per_pulse must be > 0");
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            if (cfg.unit.length() == 0 || cfg.unit.length() > 15) {
+                auto resp = makeErrorDoc("unit must be 1..15 characters");
+                sendCorsJsonDoc(request, 400, resp);
+                return;
+            }
+            if (!entry["total_pulses"].isNull()) {
+                if (!entry["total_pulses"].is<uint64_t>()) {
+                    auto resp = makeErrorDoc("total_pulses must be a non-negative integer");
+                    sendCorsJsonDoc(request, 400, resp);
+                    return;
+                }
+                reset[idx] = true;
+                resetTo[idx] = entry["total_pulses"].as<uint64_t>();
+            }
+            configs[idx] = cfg;
+            present[idx] = true;
+        }
+        for (int i = 0; i < num && i < 4; ++i) {
+            if (!present[i]) continue;
+            setPulseCounterConfig(i, configs[i]);
+            if (reset[i]) resetPulseCounter(i, resetTo[i]);
+        }
+        auto resp = makeSuccessDoc("DI config updated");
+        sendCorsJsonDoc(request, 200, resp);
+        flagSensorsSnapshotUpdate();
+    });
+    diConfigHandler->setMaxContentLength(1024);
+    server->addHandler(diConfigHandler);
+
+    // Streaming health statistics per analog channel
+    server->on("/api/sensors/health", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonDocument doc;
+        JsonArray arr = doc["channels"].to<JsonArray>();
+        for (int c = 0; c < HEALTH_MAX_CHANNELS; ++c) {
+            SensorHealthStats st;
+            getSensorHealth(c, st);
+            JsonObject ch = arr.add<JsonObject>();
+            ch["id"] = c < SNAPSHOT_MAX_AI ? String("AI") + String(c + 1) : String("ADS") + String(c - SNAPSHOT_MAX_AI);
+            healthCodesToJson(st.codes, ch["health"].to<JsonArray>());
+            ch["samples"] = st.samples;
+            if (!isnan(st.mean)) ch["mean"] = roundToDecimals(st.mean, 4);
+            if (!isnan(st.stddev)) ch["stddev"] = roundToDecimals(st.stddev, 4);
+            ch["spikes"] = st.spikes;
+            ch["block_spikes"] = st.block_spikes;
+            ch["flat_ms"] = st.flat_ms;
+            if (!isnan(st.loop_ma)) ch["loop_ma"] = roundToDecimals(st.loop_ma, 3);
+        }
+        JsonObject limits = doc["limits"].to<JsonObject>();
+        limits["window_samples"] = HEALTH_WINDOW_SAMPLES;
+        limits["stuck_ms"] = HEALTH_STUCK_MS;
+        limits["noise_bar"] = HEALTH_NOISE_BAR;
+        limits["spike_sigma"] = HEALTH_SPIKE_SIGMA;
+        limits["spike_max_per_block"] = HEALTH_SPIKE_MAX_PER_BLOCK;
+        limits["loop_min_ma"] = HEALTH_LOOP_MIN_MA;
+        limits["loop_max_ma"] = HEALTH_LOOP_MAX_MA;
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    server->on("/api/sensors/health/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        resetSensorHealth();
+        sendJsonSuccess(request, 200, "Health statistics reset");
+    });
+
+    // Report-by-exception (deadband / swinging door) shared by the SD log,
+    // pending notifications, webhook batch and SSE
+    server->on("/api/report/config", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonDocument doc;
+        ReportFilterConfig configs[REPORT_MAX_TAGS];
+        getReportFilters(configs);
+        JsonArray arr = doc["tags"].to<JsonArray>();
+        for (int t = 0; t < REPORT_MAX_TAGS; ++t) reportFilterToJson(t, configs[t], arr.add<JsonObject>());
+        JsonObject sinks = doc["sinks"].to<JsonObject>();
+        for (int s = 0; s < REPORT_SINK_COUNT; ++s) {
+            ReportSinkStats st = getReportSinkStats((ReportSink)s);
+            JsonObject o = sinks[reportSinkName((ReportSink)s)].to<JsonObject>();
+            o["offered"] = st.offered;
+            o["emitted"] = st.emitted;
+            if (st.offered > 0) o["ratio"] = roundToDecimals((float)st.emitted / (float)st.offered, 4);
+        }
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    // tags: [{tag ("*" = all), enabled?, mode?, deadband?, deadband_pct?, max_silence_ms?}]
+    AsyncCallbackJsonWebHandler* reportConfigHandler = new AsyncCallbackJsonWebHandler("/api/report/config", [](AsyncWebServerRequest *request, JsonVariant &json) {
+        JsonObject doc = json.as<JsonObject>();
+        if (doc.isNull()) {
+            auto resp = makeErrorDoc("Invalid JSON");
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        ReportFilterConfig configs[REPORT_MAX_TAGS];
+        getReportFilters(configs);
+        String error;
+        if (!parseReportFilters(doc["tags"], configs, error)) {
+            auto resp = makeErrorDoc(error);
+            sendCorsJsonDoc(request, 400, resp);
+            return;
+        }
+        setReportFilters(configs);
+        auto resp = makeSuccessDoc("Report config updated");
+        sendCorsJsonDoc(request, 200, resp);
+    });
+    reportConfigHandler->setMaxContentLength(2048);
+    server->addHandler(reportConfigHandler);
+
     // SSE debug push endpoint (JSON POST). This endpoint is intentionally
     // lightweight and DOES NOT use the central sensors readings builder; it's
     // meant for quick debugging of individual sensor channels.
@@ -446,8 +751,8 @@ void registerSensorHandlers(AsyncWebServer *server) {
         int pin = getVoltageSensorPin(pinIndex);
         payload["pin"] = pin;
 
-        // Raw analog read
-        int raw = analogRead(pin);
+        // Latest single conversion (DMA scan or analogRead fallback)
+        int raw = readVoltageSensorRaw(pinIndex);
         payload["raw_adc"] = raw;
 
         // Smoothed values if available
@@ -1,6 +1,7 @@
 #include "web_api_handlers.h"
 #include "web_api_common.h"
 #include "time_sync.h"
+#include "acquisition_task.h"
 #include <ArduinoJson.h>
 #include <WiFi.h>
 
@@ -49,6 +50,31 @@ void registerSystemHandlers(AsyncWebServer *server) {
     sendCorsJsonDoc(request, 200, doc);
     });
 
+    // Acquisition timing: proves the sample period holds while loop() is busy
+    server->on("/api/acquisition/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+        AcquisitionStats st = getAcquisitionStats();
+        JsonDocument doc;
+        doc["running"] = st.running ? 1 : 0;
+        doc["period_us"] = st.period_us;
+        doc["cycles"] = st.cycles;
+        doc["seq"] = getSensorSnapshotSeq();
+        doc["overruns"] = st.overruns;
+        doc["missed_ticks"] = st.missed_ticks;
+        doc["record_drops"] = getRecordSnapshotDrops();
+        doc["last_jitter_us"] = st.last_jitter_us;
+        doc["max_jitter_us"] = st.max_jitter_us;
+        doc["avg_jitter_us"] = st.avg_jitter_us;
+        doc["last_cycle_us"] = st.last_cycle_us;
+        doc["max_cycle_us"] = st.max_cycle_us;
+        sendCorsJsonDoc(request, 200, doc);
+    });
+
+    server->on("/api/acquisition/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        resetAcquisitionStats();
+        resetRecordSnapshotDrops();
+        sendJsonSuccess(request, 200, "Acquisition counters reset");
+    });
+
     server->on("/api/tags", HTTP_GET, [](AsyncWebServerRequest *request) {
         String payload = loadTagMetadataJson();
         JsonDocument doc;
@@ -4,16 +4,19 @@
 #include "sensor_calibration_types.h"
 #include "current_pressure_sensor.h"
 #include "config.h"
-#include "sample_store.h"
+#include "sensor_snapshot.h"
 #include "sensors_config.h"
 #include "time_sync.h"
 #include "device_id.h"
 #include "wifi_manager_module.h"
 #include "modbus_manager.h"
+#include "pulse_counter.h"
+#include "sensor_health.h"
 #include "json_helper.h"
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include <math.h>
+#include <esp_timer.h>
 
 namespace {
 
@@ -60,14 +63,20 @@ String buildModbusSensorId(const ModbusSlave &slave, const ModbusRegister &reg)
 
 } // namespace
 
-// Note: this implementation reuses existing getters from the project
-// (getNumVoltageSensors, getVoltageSensorPin, getSmoothedADC, etc.)
+// AI and ADS entries are rendered from the latest SensorSnapshot only, so HTTP,
+// SSE, notifications and the SD log agree sample-for-sample and a dashboard
+// refresh never touches the ADC, the I2C bus or the filter state.
 void buildSensorsReadingsJson(JsonDocument &doc) {
     doc.clear();
 
+    SensorSnapshot snap;
+    const bool haveSnap = getSensorSnapshot(snap);
+
     const bool wifiUp = isWifiConnected();
     doc["timestamp"] = getIsoTimestamp();
     doc["rtu"] = String(getChipId());
+    doc["seq"] = snap.seq;
+    if (haveSnap) doc["sample_age_ms"] = (uint32_t)(millis() - snap.millis_at);
 
     JsonObject net = doc["network"].to<JsonObject>();
     net["status"] = wifiUp ? "connected" : "disconnected";
@@ -78,36 +87,24 @@ void buildSensorsReadingsJson(JsonDocument &doc) {
 
     JsonArray sensors = doc["sensors"].to<JsonArray>();
 
-    const int numVoltage = getNumVoltageSensors();
+    const int numVoltage = min(getNumVoltageSensors(), SNAPSHOT_MAX_AI);
     for (int i = 0; i < numVoltage; ++i) {
+        const AiSnapshot &ai = snap.ai[i];
         bool enabled = getSensorEnabled(i);
-        int pin = getVoltageSensorPin(i);
-        int raw = analogRead(pin);
-        float smoothed = getSmoothedADC(i);
-        float avgRawF, avgSmoothedF, avgVoltF;
-        if (getAverages(i, avgRawF, avgSmoothedF, avgVoltF)) {
-            raw = (int)round(avgRawF);
-            smoothed = avgSmoothedF;
-        }
-        bool saturated = isPinSaturated(i);
-        if (raw == 4095 && !saturated) raw = (int)round(smoothed);
-
-        float voltageRaw = convert010V(raw, i);
-        float voltageFiltered = convert010V(round(smoothed), i);
+        bool saturated = ai.flags & SENSOR_FLAG_SATURATED;
         SensorCalibration cal = getCalibrationForPin(i);
-        float pressureRaw = (raw * cal.scale) + cal.offset;
-        float pressureFiltered = (round(smoothed) * cal.scale) + cal.offset;
 
         JsonObject sensor = sensors.add<JsonObject>();
         sensor["id"] = String("AI") + String(i + 1);
         sensor["type"] = "adc";
         sensor["enabled"] = enabled ? 1 : 0;
-        sensor["status"] = !enabled ? "disabled" : (saturated ? "alert" : "ok");
-        sensor["port"] = pin;
+        sensor["status"] = !haveSnap ? "pending" : sensorStatusString(ai.flags);
+        healthCodesToJson(ai.health, sensor["health"].to<JsonArray>());
+        sensor["port"] = getVoltageSensorPin(i);
 
         JsonObject meta = sensor["meta"].to<JsonObject>();
-        meta["raw_adc"] = raw;
-        meta["smoothed_adc"] = roundToDecimals(smoothed, 2);
+        meta["raw_adc"] = ai.avg_raw;
+        meta["smoothed_adc"] = roundToDecimals(ai.avg_smoothed, 2);
         meta["cal_zero_raw_adc"] = cal.zeroRawAdc;
         meta["cal_span_raw_adc"] = cal.spanRawAdc;
         meta["cal_zero_pressure_value"] = cal.zeroPressureValue;
@@ -117,46 +114,76 @@ void buildSensorsReadingsJson(JsonDocument &doc) {
         meta["cal_scale"] = roundToDecimals(cal.scale, 4);
         meta["cal_offset"] = roundToDecimals(cal.offset, 3);
         if (saturated) meta["saturated"] = 1;
+        if (ai.window_samples > 0) {
+            JsonObject window = meta["window"].to<JsonObject>();
+            window["samples"] = ai.window_samples;
+            window["min"] = roundToDecimals(ai.window_min, 3);
+            window["max"] = roundToDecimals(ai.window_max, 3);
+            window["stddev"] = roundToDecimals(ai.window_stddev, 4);
+        }
 
         JsonArray readings = sensor["readings"].to<JsonArray>();
-        JsonObject voltMeas = addMeasurement(readings, "voltage", voltageFiltered, "V", 3);
-        if (!isnan(voltageRaw)) voltMeas["raw"] = roundToDecimals(voltageRaw, 3);
+        JsonObject voltMeas = addMeasurement(readings, "voltage", ai.voltage, "V", 3);
+        if (!isnan(ai.voltage_raw)) voltMeas["raw"] = roundToDecimals(ai.voltage_raw, 3);
 
-        JsonObject pressureMeas = addMeasurement(readings, "pressure", pressureFiltered, "bar", 2);
-        if (!isnan(pressureRaw)) pressureMeas["raw"] = roundToDecimals(pressureRaw, 2);
+        JsonObject pressureMeas = addMeasurement(readings, "pressure", ai.pressure, "bar", 2);
+        if (!isnan(ai.pressure_raw)) pressureMeas["raw"] = roundToDecimals(ai.pressure_raw, 2);
     }
 
-    for (int ch = 0; ch < 2; ++ch) {
-        int16_t raw = readAdsRaw(ch);
-        float mv = adsRawToMv(raw);
-        float currentMa = readAdsMa(ch, DEFAULT_SHUNT_OHM, DEFAULT_AMP_GAIN);
-        float depthMm = computeDepthMm(currentMa, DEFAULT_CURRENT_INIT_MA, DEFAULT_RANGE_MM, DEFAULT_DENSITY_WATER);
-        float tpScale = getAdsTpScale(ch);
-        float maSmoothed = getAdsSmoothedMa(ch);
-        float voltageSmoothed = (maSmoothed * tpScale) / 1000.0f;
-        float voltageRaw = mv / 1000.0f;
-        float pressureBar = (voltageSmoothed / 10.0f) * DEFAULT_RANGE_BAR;
+    for (int ch = 0; ch < SNAPSHOT_MAX_ADS; ++ch) {
+        const AdsSnapshot &ads = snap.ads[ch];
 
         JsonObject sensor = sensors.add<JsonObject>();
         sensor["id"] = String("ADS") + String(ch);
         sensor["type"] = "ads1115";
-        sensor["enabled"] = 1;
-        sensor["status"] = isnan(maSmoothed) ? "pending" : "ok";
+        sensor["enabled"] = (ads.flags & SENSOR_FLAG_DISABLED) ? 0 : 1;
+        sensor["status"] = !haveSnap ? "pending" : sensorStatusString(ads.flags);
+        healthCodesToJson(ads.health, sensor["health"].to<JsonArray>());
         sensor["channel"] = ch;
 
         JsonObject meta = sensor["meta"].to<JsonObject>();
-        meta["tp_scale_mv_per_ma"] = tpScale;
-        meta["raw_code"] = raw;
+        meta["tp_scale_mv_per_ma"] = ads.tp_scale;
+        meta["raw_code"] = ads.raw;
+        if (ads.sample_us > 0) {
+            meta["sample_age_ms"] = (uint32_t)((esp_timer_get_time() - ads.sample_us) / 1000);
+        }
 
         JsonArray readings = sensor["readings"].to<JsonArray>();
-        JsonObject voltMeas = addMeasurement(readings, "voltage", voltageSmoothed, "V", 3);
-        if (!isnan(voltageRaw)) voltMeas["raw"] = roundToDecimals(voltageRaw, 3);
+        JsonObject voltMeas = addMeasurement(readings, "voltage", ads.voltage, "V", 3);
+        if (!isnan(ads.voltage_raw)) voltMeas["raw"] = roundToDecimals(ads.voltage_raw, 3);
+
+        JsonObject currentMeas = addMeasurement(readings, "current", ads.ma, "mA", 3);
+        if (!isnan(ads.ma_raw)) currentMeas["raw"] = roundToDecimals(ads.ma_raw, 3);
+
+        addMeasurement(readings, "pressure", ads.pressure, "bar", 2);
+        addMeasurement(readings, "depth", ads.depth_mm, "mm", 0);
+    }
+
+    for (int i = 0; i < snap.num_di; ++i) {
+        const DiSnapshot &di = snap.di[i];
+        PulseCounterConfig cfg = getPulseCounterConfig(i);
+        bool enabled = !(di.flags & SENSOR_FLAG_DISABLED);
 
-        JsonObject currentMeas = addMeasurement(readings, "current", maSmoothed, "mA", 3);
-        if (!isnan(currentMa)) currentMeas["raw"] = roundToDecimals(currentMa, 3);
+        JsonObject sensor = sensors.add<JsonObject>();
+        sensor["id"] = String("DI") + String(i + 1);
+        sensor["type"] = "pulse";
+        sensor["enabled"] = enabled ? 1 : 0;
+        sensor["status"] = !haveSnap ? "pending" : sensorStatusString(di.flags);
+        sensor["port"] = getPulseCounterPin(i);
 
-        addMeasurement(readings, "pressure", pressureBar, "bar", 2);
-        addMeasurement(readings, "depth", depthMm, "mm", 0);
+        JsonObject meta = sensor["meta"].to<JsonObject>();
+        meta["units_per_pulse"] = cfg.units_per_pulse;
+        meta["filter_ns"] = cfg.filter_ns;
+
+        JsonArray readings = sensor["readings"].to<JsonArray>();
+        JsonObject countMeas = readings.add<JsonObject>();
+        countMeas["name"] = "count";
+        countMeas["value"] = di.count;
+        countMeas["unit"] = "pulse";
+        // cfg is a local copy; store the unit strings by value
+        addMeasurement(readings, "total", di.total, nullptr, 3)["unit"] = cfg.unit;
+        addMeasurement(readings, "rate", di.rate_hz, "Hz", 3);
+        addMeasurement(readings, "rate_per_hour", di.rate_per_hour, nullptr, 3)["unit"] = cfg.unit + "/h";
     }
 
     const auto &slaves = getModbusSlaves();
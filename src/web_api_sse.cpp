@@ -45,6 +45,11 @@ void pushSensorsSnapshotEvent() {
     broadcastSensorsSnapshot();
 }
 
+void pushSensorsAlarmEvent(const String &payload) {
+    if (!eventSourceSensors) return;
+    eventSourceSensors->send(payload.c_str(), "alarm", millis());
+}
+
 void flagSensorsSnapshotUpdate() {
     sensorsSnapshotDirty = true;
 }